@@ -52,15 +52,36 @@
   extern uint32_t SystemCoreClock;
 #endif
 #define configUSE_PREEMPTION                     1
+#if defined(USE_STATIC_ALLOC)
+/* The tasks and objects get their storage from the osXxxDef() macros of
+ * cmsis_os.h, the idle task from vApplicationGetIdleTaskMemory() (user.c).
+ * The heap stays for the benches of the host and USE_KERNEL_BENCH only,
+ * heap_4.c is left out of the target build. */
+#define configSUPPORT_STATIC_ALLOCATION          1
+#if defined(USE_HOST_SIM) || defined(USE_KERNEL_BENCH)
+#define configSUPPORT_DYNAMIC_ALLOCATION         1
+#else
+#define configSUPPORT_DYNAMIC_ALLOCATION         0
+#endif
+#else
 #define configSUPPORT_STATIC_ALLOCATION          0
 #define configSUPPORT_DYNAMIC_ALLOCATION         1
+#endif
 #define configUSE_IDLE_HOOK                      0
 #define configUSE_TICK_HOOK                      0
 #define configCPU_CLOCK_HZ                       ( SystemCoreClock )
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
-#define configMAX_PRIORITIES                     ( 3 )
+#define configMAX_PRIORITIES                     ( 4 )
 #define configMINIMAL_STACK_SIZE                 ((uint16_t)64)
+#if defined(USE_HOST_SIM)
+/* 64-bit pointers make the TCBs of the host simulation bigger */
+#define configTOTAL_HEAP_SIZE                    ((size_t)8192)
+#elif defined(USE_KERNEL_BENCH)
+/* room for the two benchmark tasks, see kernel_bench.c */
+#define configTOTAL_HEAP_SIZE                    ((size_t)4096)
+#else
 #define configTOTAL_HEAP_SIZE                    ((size_t)3072)
+#endif
 #define configMAX_TASK_NAME_LEN                  ( 12 )
 #define configUSE_16_BIT_TICKS                   0
 #define configQUEUE_REGISTRY_SIZE                2
@@ -74,7 +95,11 @@
 #define configMAX_CO_ROUTINE_PRIORITIES          ( 2 )
 
 /* The following flag must be enabled only when using newlib */
+#if defined(USE_HOST_SIM)
+#define configUSE_NEWLIB_REENTRANT          0
+#else
 #define configUSE_NEWLIB_REENTRANT          1
+#endif
 
 /* Set the following definitions to 1 to include the API function, or zero
 to exclude the API function. */
@@ -87,6 +112,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelay                  1
 #define INCLUDE_xTaskGetSchedulerState      1
 #define INCLUDE_uxTaskGetStackHighWaterMark 1
+#define INCLUDE_xTaskGetCurrentTaskHandle   1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -132,6 +158,104 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+#if defined(USE_HOST_SIM)
+/* The tick comes from the TIM1 model through HAL_IncTick(), like on the target */
+#define portHOST_TICK_TIMER                 0
+#endif
+
+#if defined(USE_RTSTATS) || defined(USE_TRACE)
+/* task and queue numbers */
+#define configUSE_TRACE_FACILITY            1
+#endif
+
+#if defined(USE_RTSTATS)
+/* Per task run time and context switches for rtstats.c: the kernel adds the
+ * counter ticks since the last switch to the task switched out, the hook
+ * counts the switches in by task number. */
+#define configGENERATE_RUN_TIME_STATS       1
+#define RTSTATS_MAX_TASKS                   8U
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+extern volatile uint32_t rtstats_switches[RTSTATS_MAX_TASKS];
+void rtstats_clock_init(void);
+uint32_t rtstats_clock(void);
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()    rtstats_clock_init()
+#if defined(USE_HOST_SIM)
+/* CLOCK_MONOTONIC in us */
+#define portGET_RUN_TIME_COUNTER_VALUE()            rtstats_clock()
+#else
+/* DWT->CYCCNT, started by rtstats_clock_init() */
+#define portGET_RUN_TIME_COUNTER_VALUE()            (*(volatile uint32_t *)0xE0001004UL)
+#endif
+#define RTSTATS_SWITCHED_IN()                                                     \
+    rtstats_switches[pxCurrentTCB->uxTCBNumber & (RTSTATS_MAX_TASKS - 1U)]++
+#else
+#define RTSTATS_SWITCHED_IN()
+#endif
+
+#if defined(USE_TRACE)
+/* Kernel events for trace.c, see trace.h */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+#include "trace.h"
+#endif
+#define TRACE_SWITCHED_IN()                                                       \
+    trace_record(TRACE_EVENT_SWITCH, pxCurrentTCB->uxTCBNumber, 0U)
+#define traceTASK_CREATE(pxNewTCB)                                                \
+    trace_task_create((pxNewTCB)->uxTCBNumber, (pxNewTCB)->pcTaskName)
+#define traceQUEUE_CREATE(pxNewQueue)                                             \
+    ((pxNewQueue)->uxQueueNumber = trace_queue_create())
+#define traceQUEUE_SEND(pxQueue)                                                  \
+    trace_record(TRACE_EVENT_QUEUE_SEND, (pxQueue)->ucQueueType, (pxQueue)->uxQueueNumber)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)                                         \
+    trace_record(TRACE_EVENT_QUEUE_SEND_ISR, (pxQueue)->ucQueueType, (pxQueue)->uxQueueNumber)
+#define traceQUEUE_RECEIVE(pxQueue)                                               \
+    trace_record(TRACE_EVENT_QUEUE_RECEIVE, (pxQueue)->ucQueueType, (pxQueue)->uxQueueNumber)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)                                      \
+    trace_record(TRACE_EVENT_QUEUE_RECEIVE_ISR, (pxQueue)->ucQueueType, (pxQueue)->uxQueueNumber)
+#define traceTASK_DELAY()                                                         \
+    trace_record(TRACE_EVENT_DELAY, pxCurrentTCB->uxTCBNumber,                    \
+                 (xTicksToDelay > 0xFFFFU) ? 0xFFFFU : xTicksToDelay)
+#define traceTASK_NOTIFY()                                                        \
+    trace_record(TRACE_EVENT_NOTIFY, pxTCB->uxTCBNumber, 0U)
+#define traceTASK_NOTIFY_FROM_ISR()                                               \
+    trace_record(TRACE_EVENT_NOTIFY_ISR, pxTCB->uxTCBNumber, 0U)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR()                                          \
+    trace_record(TRACE_EVENT_NOTIFY_ISR, pxTCB->uxTCBNumber, 0U)
+#else
+#define TRACE_SWITCHED_IN()
+#endif
+
+#if defined(USE_RTSTATS) || defined(USE_TRACE)
+#define traceTASK_SWITCHED_IN()                                                   \
+    do                                                                            \
+    {                                                                             \
+        RTSTATS_SWITCHED_IN();                                                    \
+        TRACE_SWITCHED_IN();                                                      \
+    } while (0)
+#endif
+
+#if defined(USE_TICKLESS)
+/* Tickless idle on the TIM1 time base, see tickless.h.  Not 1: that would
+ * build the SysTick version of the port. */
+#define configUSE_TICKLESS_IDLE             2
+/* required by the tickless idle of the kernel */
+#undef INCLUDE_vTaskSuspend
+#define INCLUDE_vTaskSuspend                1
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+void tickless_sleep(uint32_t expected);
+#endif
+#define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) tickless_sleep(xExpectedIdleTime)
+#endif
+
+#if defined(USE_STATIC_BENCH)
+/* Every call of heap_4.c, for host_static_bench.c */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+void host_static_bench_malloc(void *address, size_t size);
+void host_static_bench_free(void *address, size_t size);
+#endif
+#define traceMALLOC(pvAddress, uiSize)      host_static_bench_malloc((pvAddress), (uiSize))
+#define traceFREE(pvAddress, uiSize)        host_static_bench_free((pvAddress), (uiSize))
+#endif
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,67 @@
+/**
+ ******************************************************************************
+ * @file           : binlog.h
+ * @brief          : Deferred binary logging: format string IDs and raw args
+ ******************************************************************************
+ * BINLOG(fmt, ...) does not format anything.  The format string is put in the
+ * binlog_fmt section of the ELF, its offset there is its ID, and only the ID
+ * and the arguments go out on the console.  Host/Tools/binlog_decode.c reads
+ * the strings back from the ELF and prints the text.
+ *
+ * The arguments are 32-bit words: integers, chars and enums.  %s, %f and
+ * 64-bit values cannot be logged this way, pointers need a cast to uint32_t.
+ *
+ * Record on the wire, the numbers in unsigned LEB128 (7 bits per byte, low
+ * group first, bit 7 set on all bytes but the last):
+ *
+ *   BINLOG_SYNC, id, nargs, arg[0] .. arg[nargs - 1]
+ *
+ * Text that does not go through BINLOG (printf) is passed through by the
+ * decoder, so both can share the console.
+ ******************************************************************************
+ */
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdint.h>
+
+#define BINLOG_SECTION                  "binlog_fmt"
+#define BINLOG_SYNC                     0xA5U
+#define BINLOG_MAX_ARGS                 8U
+
+/* Staging ring between the producers and the console, a power of 2. */
+#ifndef BINLOG_BUFFER_SIZE
+#define BINLOG_BUFFER_SIZE              256U
+#endif
+
+#define BINLOG(fmt, ...)                                                                                  \
+    do                                                                                                    \
+    {                                                                                                     \
+        static const char binlog_fmt_[] __attribute__((section(BINLOG_SECTION), aligned(1))) = fmt;      \
+        const uint32_t binlog_args_[] = {0U, ##__VA_ARGS__};                                              \
+        _Static_assert((sizeof(binlog_args_) / sizeof(binlog_args_[0])) <= (BINLOG_MAX_ARGS + 1U),        \
+                       "too many BINLOG arguments");                                                      \
+        binlog_write(binlog_fmt_, &binlog_args_[1],                                                       \
+                     (uint32_t)(sizeof(binlog_args_) / sizeof(binlog_args_[0])) - 1U);                    \
+    } while (0)
+
+/* The log statements of the application: binary with USE_BINLOG, whole
+ * printf lines otherwise, none in the CAN gateway (USE_SLCAN) that has
+ * USART1 for itself. */
+#if defined(USE_SLCAN)
+#define LOG_PRINTF(...)                 ((void)0)
+#elif defined(USE_BINLOG)
+#define LOG_PRINTF(...)                 BINLOG(__VA_ARGS__)
+#else
+#include "logline.h"
+#define LOG_PRINTF(...)                 logline_printf(__VA_ARGS__)
+#endif
+
+/* Callable from tasks and interrupts, without locks.  A record that does not
+ * fit in the ring is dropped. */
+void binlog_write(const char *fmt, const uint32_t *args, uint32_t nargs);
+
+/* Records lost to a full ring since start-up. */
+uint32_t binlog_dropped(void);
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ ******************************************************************************
+ * @file           : can_dbc.h
+ * @brief          : Common part of the CAN signal headers made by dbc_gen
+ ******************************************************************************
+ * Host/Tools/dbc_gen.c turns a DBC file into a header of pack and unpack
+ * functions, one set per message, that work on the 8-byte payload as one
+ * 64-bit word: byte 0 in bits 0 to 7, like the little endian load of the
+ * bytes and like RDLR/RDHR and TDLR/TDHR of the mailboxes.  Every signal is
+ * one shift and one mask of that word, Motorola (big endian) signals of the
+ * byte swapped word; sign extension is an xor and a subtraction.  There is no
+ * loop and no branch.
+ *
+ * The functions are static inline in C and constexpr in C++ (C++14), so a
+ * payload of constant signals is folded at compile time.
+ ******************************************************************************
+ */
+#ifndef CAN_DBC_H
+#define CAN_DBC_H
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+#define CAN_DBC_FN                      static constexpr inline
+#else
+#define CAN_DBC_FN                      static inline
+#endif
+
+/* Byte 0 to the top: the word the Motorola signals are numbered in. */
+CAN_DBC_FN uint64_t can_dbc_swap(uint64_t payload)
+{
+    return __builtin_bswap64(payload);
+}
+
+CAN_DBC_FN uint64_t can_dbc_load(const uint8_t data[8])
+{
+    return (uint64_t)data[0] | ((uint64_t)data[1] << 8U) | ((uint64_t)data[2] << 16U)
+           | ((uint64_t)data[3] << 24U) | ((uint64_t)data[4] << 32U) | ((uint64_t)data[5] << 40U)
+           | ((uint64_t)data[6] << 48U) | ((uint64_t)data[7] << 56U);
+}
+
+CAN_DBC_FN void can_dbc_store(uint8_t data[8], uint64_t payload)
+{
+    data[0] = (uint8_t)payload;
+    data[1] = (uint8_t)(payload >> 8U);
+    data[2] = (uint8_t)(payload >> 16U);
+    data[3] = (uint8_t)(payload >> 24U);
+    data[4] = (uint8_t)(payload >> 32U);
+    data[5] = (uint8_t)(payload >> 40U);
+    data[6] = (uint8_t)(payload >> 48U);
+    data[7] = (uint8_t)(payload >> 56U);
+}
+
+/* From the two data words of a mailbox (RDLR, RDHR). */
+CAN_DBC_FN uint64_t can_dbc_words(uint32_t low, uint32_t high)
+{
+    return (uint64_t)low | ((uint64_t)high << 32U);
+}
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ ******************************************************************************
+ * @file           : can_dispatch.h
+ * @brief          : CAN frame handlers looked up by filter match index
+ ******************************************************************************
+ * The filter match index (FMI) the hardware stores with every frame says
+ * which filter accepted it.  can_dispatch_init() turns the filter plan of
+ * can_filter_plan() into a table indexed by FIFO and FMI, so that
+ * can_dispatch() finds the handler of a frame without searching:
+ *
+ *  - a filter that lies inside one range (every list filter, and every mask
+ *    filter the planner did not merge) maps straight to the handler of that
+ *    range;
+ *  - a mask filter merged over several ranges gets a perfect hash of the
+ *    subscribed identifiers it lets through (hash and displace: two
+ *    multiplies, a displacement byte and one compare), which also drops the
+ *    frames the merge lets in.
+ *
+ * The hashes are searched once, next to the filter plan and from the same
+ * const table of ranges; both are pure functions of it.
+ ******************************************************************************
+ */
+#ifndef CAN_DISPATCH_H
+#define CAN_DISPATCH_H
+
+#include "main.h"
+#include "can_filter.h"
+#include "can_rx.h"
+
+/* Hash slots of the merged mask filters, over all of them. */
+#ifndef CAN_DISPATCH_HASH_SIZE
+#define CAN_DISPATCH_HASH_SIZE          32U
+#endif
+
+/* Merged mask filters with a hash. */
+#ifndef CAN_DISPATCH_HASHES
+#define CAN_DISPATCH_HASHES             4U
+#endif
+
+/* Filter numbers of the two FIFOs together: 4 per 16-bit list bank at most. */
+#define CAN_DISPATCH_FILTERS            (CAN_FILTER_BANKS * 4U)
+
+#define CAN_DISPATCH_HASHED             0xFEU
+#define CAN_DISPATCH_NONE               0xFFU
+
+typedef void (*can_dispatch_handler_t)(const can_rx_frame_t *frame);
+
+typedef struct
+{
+    uint8_t route;          /* range, CAN_DISPATCH_HASHED or CAN_DISPATCH_NONE */
+    uint8_t hash;           /* hashed: index in hash[] */
+} can_dispatch_filter_t;
+
+/* Identifier key k: bucket k * mult1 >> (32 - dbits), slot
+ * (k * mult2 >> (32 - bits)) ^ disp[bucket], relative to base. */
+typedef struct
+{
+    uint32_t mult1;
+    uint32_t mult2;
+    uint16_t base;          /* first slot in hash_key[] */
+    uint16_t disp;          /* first byte in hash_disp[] */
+    uint8_t bits;           /* log2 of the slots */
+    uint8_t dbits;          /* log2 of the buckets */
+} can_dispatch_hash_t;
+
+typedef struct
+{
+    const can_filter_range_t *ranges;
+    const can_dispatch_handler_t *handlers;
+    uint32_t count;
+    uint8_t first[2];                                   /* of each FIFO in filter[] */
+    uint8_t numbers[2];                                 /* filter numbers of each FIFO */
+    can_dispatch_filter_t filter[CAN_DISPATCH_FILTERS];
+    can_dispatch_hash_t hash[CAN_DISPATCH_HASHES];
+    uint32_t hash_key[CAN_DISPATCH_HASH_SIZE];          /* identifier | IDE << 31 */
+    uint8_t hash_route[CAN_DISPATCH_HASH_SIZE];
+    uint8_t hash_disp[CAN_DISPATCH_HASH_SIZE / 2U];
+    uint32_t hashes;
+    uint32_t hash_used;
+    uint32_t disp_used;
+} can_dispatch_t;
+
+/* Builds the table of the plan computed from ranges[]; handlers[i] handles
+ * ranges[i].  Both arrays must outlive the table.  HAL_ERROR when the merged
+ * filters need more than CAN_DISPATCH_HASHES hashes or CAN_DISPATCH_HASH_SIZE
+ * slots, or there are more than 253 ranges. */
+HAL_StatusTypeDef can_dispatch_init(can_dispatch_t *table, const can_filter_plan_t *plan,
+                                    const can_filter_range_t ranges[], const can_dispatch_handler_t handlers[],
+                                    uint32_t count);
+
+/* Index of the range the frame belongs to, CAN_DISPATCH_NONE when it is not
+ * subscribed (let in by a merged filter). */
+uint32_t can_dispatch_route(const can_dispatch_t *table, const can_rx_frame_t *frame);
+
+/* Calls the handler of the frame.  1 when there is one, 0 when the frame is
+ * dropped. */
+uint32_t can_dispatch(const can_dispatch_t *table, const can_rx_frame_t *frame);
+
+#endif
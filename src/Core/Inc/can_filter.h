@@ -0,0 +1,96 @@
+/**
+ ******************************************************************************
+ * @file           : can_filter.h
+ * @brief          : bxCAN filter banks computed from the subscribed identifiers
+ ******************************************************************************
+ * can_filter_plan() takes the identifiers the application receives, as
+ * ranges, and lays them out over the filter banks so that as few other
+ * identifiers as possible get through:
+ *
+ *  - a range is first cut into aligned blocks, one identifier/mask each, so
+ *    the filters accept exactly the ranges;
+ *  - one standard identifier takes a quarter of a bank (16-bit list), a block
+ *    of them half a bank (16-bit mask); one extended identifier takes half a
+ *    bank (32-bit list), a block of them a whole bank (32-bit mask);
+ *  - while that needs more banks than given, the two filters of the same
+ *    FIFO whose merge into one mask lets through the fewest extra identifiers
+ *    per quarter of bank saved are merged, greedily.  A merge that would let
+ *    through identifiers subscribed to the other FIFO is never made.
+ *
+ * List filters compare the RTR bit too and only accept data frames, mask
+ * filters accept remote frames as well.  The plan is a pure function of its
+ * input; can_filter_program() writes it to the hardware.
+ ******************************************************************************
+ */
+#ifndef CAN_FILTER_H
+#define CAN_FILTER_H
+
+#include "main.h"
+
+/* Filter banks of CAN1 on a single-CAN device. */
+#define CAN_FILTER_BANKS                14U
+
+/* Filters before merging: the blocks of all the ranges. */
+#ifndef CAN_FILTER_MAX_ENTRIES
+#define CAN_FILTER_MAX_ENTRIES          32U
+#endif
+
+typedef struct
+{
+    uint32_t first;         /* first identifier of the range */
+    uint32_t last;          /* last identifier, first for a single one */
+    uint8_t ide;            /* 1: extended identifiers */
+    uint8_t fifo;           /* CAN_RX_FIFO0 or CAN_RX_FIFO1 */
+} can_filter_range_t;
+
+/* One identifier/mask filter: accepts the identifiers x of the same IDE with
+ * (x & mask) == id.  A mask of all the identifier bits is one identifier. */
+typedef struct
+{
+    uint32_t id;
+    uint32_t mask;
+    uint8_t ide;
+    uint8_t fifo;
+} can_filter_entry_t;
+
+/* One bank as the hardware sees it: FR1, FR2 and its configuration, and the
+ * filter of the plan behind each of its filter numbers.  A slot the plan does
+ * not need repeats the first filter of the bank. */
+typedef struct
+{
+    uint32_t fr1;
+    uint32_t fr2;
+    uint8_t scale;          /* CAN_FILTERSCALE_16BIT or CAN_FILTERSCALE_32BIT */
+    uint8_t mode;           /* CAN_FILTERMODE_IDMASK or CAN_FILTERMODE_IDLIST */
+    uint8_t fifo;
+    uint8_t filters;        /* filter numbers the bank takes: 1, 2 or 4 */
+    uint8_t entry[4];       /* index in entries[], in filter number order */
+} can_filter_bank_t;
+
+typedef struct
+{
+    can_filter_entry_t entries[CAN_FILTER_MAX_ENTRIES];
+    uint32_t entry_count;
+    can_filter_bank_t banks[CAN_FILTER_BANKS];
+    uint32_t bank_count;
+    /* identifiers accepted outside the ranges, summed over the filters: exact
+     * unless two merged masks overlap */
+    uint64_t false_accepts;
+} can_filter_plan_t;
+
+/* Plans the filters of count ranges over at most banks filter banks.  The
+ * ranges must not overlap.  HAL_ERROR when a range is invalid, when there are
+ * more blocks than CAN_FILTER_MAX_ENTRIES or fewer banks than classes of
+ * filters (FIFO and IDE) to keep apart. */
+HAL_StatusTypeDef can_filter_plan(const can_filter_range_t ranges[], uint32_t count, uint32_t banks,
+                                  can_filter_plan_t *plan);
+
+/* Runs a data frame through the banks of the plan like the hardware: 1 and
+ * its FIFO when a filter accepts it, 0 when it is dropped. */
+uint32_t can_filter_match(const can_filter_plan_t *plan, uint32_t id, uint32_t ide, uint32_t *fifo);
+
+/* Writes the banks of the plan through HAL_CAN_ConfigFilter() and
+ * deactivates the other banks. */
+HAL_StatusTypeDef can_filter_program(CAN_HandleTypeDef *hcan, const can_filter_plan_t *plan);
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * @file           : can_rx.h
+ * @brief          : CAN RX ring from the FIFO interrupts to one task
+ ******************************************************************************
+ * The message pending interrupts of both FIFOs copy every frame waiting in
+ * the FIFO into a ring with the tick it arrived at, and wake the task blocked
+ * in can_rx_receive() with a task notification.  A frame that finds the ring
+ * full is dropped and counted, the ones already in it are kept.
+ *
+ * Which frames go to which FIFO is up to the filter banks, see
+ * user_can_set_rx_filer().  The order of frames of different FIFOs in the
+ * ring is the order the interrupts read them in, not the bus order.
+ *
+ * The ring has one producer, the two interrupts, which have the same priority
+ * and never preempt each other, and one consumer: only one task may call
+ * can_rx_receive().
+ *
+ * A hook (can_rx_set_hook()) sees every frame first, in the interrupt, and
+ * may take it: a protocol that answers within the interrupt (isotp.c) copies
+ * the data words where they belong instead of going through the ring.
+ ******************************************************************************
+ */
+#ifndef CAN_RX_H
+#define CAN_RX_H
+
+#include "main.h"
+#include "FreeRTOS.h"
+
+/* Frames between the interrupt and the task, a power of two.  The gateway
+ * (USE_SLCAN) keeps every frame of the bus and waits for the UART. */
+#ifndef CAN_RX_QUEUE_SIZE
+#if defined(USE_SLCAN)
+#define CAN_RX_QUEUE_SIZE               32U
+#else
+#define CAN_RX_QUEUE_SIZE               16U
+#endif
+#endif
+
+typedef struct
+{
+    uint32_t id;            /* StdId or ExtId, see ide */
+    uint32_t tick;          /* xTaskGetTickCountFromISR() at the interrupt */
+    uint16_t timestamp;     /* bit time of the SOF (RDTR.TIME), with TTCM */
+    uint8_t ide;            /* 1: extended identifier */
+    uint8_t rtr;            /* 1: remote frame */
+    uint8_t dlc;
+    uint8_t filter;         /* filter match index (FMI) */
+    uint8_t fifo;           /* CAN_RX_FIFO0 or CAN_RX_FIFO1 */
+    uint8_t data[8];
+} can_rx_frame_t;
+
+/* Called by the FIFO interrupts with the words of the output mailbox.
+ * Returns 1 when it took the frame, which then does not go to the ring. */
+typedef uint32_t (*can_rx_hook_t)(uint32_t rir, uint32_t rdtr, uint32_t rdlr, uint32_t rdhr);
+
+/* Called once after HAL_CAN_Start(), enables the message pending interrupts
+ * of both FIFOs. */
+void can_rx_init(CAN_HandleTypeDef *hcan);
+
+/* Waits up to timeout ticks for a frame.  1 with the frame copied to frame,
+ * 0 on timeout. */
+uint32_t can_rx_receive(can_rx_frame_t *frame, TickType_t timeout);
+
+/* Frames in the ring. */
+uint32_t can_rx_pending(void);
+
+/* Frames dropped by a full ring since start-up. */
+uint32_t can_rx_dropped(void);
+
+/* Sets the one hook, NULL for none. */
+void can_rx_set_hook(can_rx_hook_t hook);
+
+#endif
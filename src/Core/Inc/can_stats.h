@@ -0,0 +1,75 @@
+/**
+ ******************************************************************************
+ * @file           : can_stats.h
+ * @brief          : CAN bus load and TX latency statistics
+ ******************************************************************************
+ * Counters kept by the CAN interrupts of can_rx.c and can_tx.c:
+ *
+ *  - frames and bits of the last whole second, in both directions.  The bits
+ *    of a frame are its worst case on the wire, from IDE, RTR and DLC: every
+ *    stuff bit the SOF to CRC field can have, the interframe space included.
+ *    Only the frames this node sends or its filters accept are seen.
+ *  - per RX FIFO, the most frames found in it by one interrupt (high-water
+ *    mark, 3 is full) and the overruns (FOVR seen set, then cleared; several
+ *    frames may be lost in one).
+ *  - a histogram of the time from can_tx_send() (or from the load of a
+ *    source frame) to the TX complete interrupt, log2 buckets of us: bucket
+ *    0 is below 1 us, bucket b from 2^(b-1) to 2^b - 1 us, the last one
+ *    everything above.
+ *
+ * The statistics are compiled in with USE_CAN_STATS and Core/Src/can_stats.c;
+ * without it the CAN_STATS_* hooks are empty and cost nothing.
+ ******************************************************************************
+ */
+#ifndef CAN_STATS_H
+#define CAN_STATS_H
+
+#include "main.h"
+
+#define CAN_STATS_BUCKETS               16U
+
+typedef struct
+{
+    uint32_t rx_frames;                 /* since start-up */
+    uint32_t tx_frames;
+    uint32_t frames_per_s;              /* last whole second, both directions */
+    uint32_t bits_per_s;
+    uint32_t load_permille;             /* bits_per_s of the current bit rate, worst
+                                         * case: may pass 1000 */
+    uint32_t bit_rate;
+    uint8_t rx_high_water[2];           /* per FIFO */
+    uint32_t rx_overruns[2];
+    uint32_t latency_max_us;
+    uint32_t latency[CAN_STATS_BUCKETS];
+} can_stats_t;
+
+#if defined(USE_CAN_STATS)
+#define CAN_STATS_RX_FIFO(fifo, rfr)    can_stats_rx_fifo((fifo), (rfr))
+#define CAN_STATS_RX(rir, rdtr)         can_stats_frame(0U, (rir), (rdtr))
+#define CAN_STATS_TX(tir, tdtr, queued) can_stats_tx((tir), (tdtr), (queued))
+#define CAN_STATS_TICK()                can_stats_tick()
+#else
+#define CAN_STATS_RX_FIFO(fifo, rfr)
+#define CAN_STATS_RX(rir, rdtr)
+#define CAN_STATS_TX(tir, tdtr, queued)
+#define CAN_STATS_TICK()
+#endif
+
+/* Keeps hcan for its bit rate and starts the clock of the latency, before
+ * can_rx_init() and can_tx_init(). */
+void can_stats_init(CAN_HandleTypeDef *hcan);
+
+/* Copy of the counters, consistent with each other. */
+void can_stats_get(can_stats_t *stats);
+
+/* Prints the counters on the console, one line each. */
+void can_stats_dump(void);
+
+/* Hooks, through the CAN_STATS_* macros */
+uint32_t can_stats_clock(void);
+void can_stats_rx_fifo(uint32_t fifo, volatile uint32_t *rfr);
+void can_stats_frame(uint32_t tx, uint32_t id_word, uint32_t dt_word);
+void can_stats_tx(uint32_t tir, uint32_t tdtr, uint32_t queued);
+void can_stats_tick(void);
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * @file           : can_tx.h
+ * @brief          : CAN TX priority queue behind the three bxCAN mailboxes
+ ******************************************************************************
+ * can_tx_send() queues a frame in RAM, ordered like the bus arbitration
+ * (identifier, then RTR/IDE) and in call order among equal identifiers.  The
+ * mailboxes are refilled from the queue by the TX mailbox empty interrupt, so
+ * a burst longer than three frames goes out back to back.
+ *
+ * The mailboxes are sent in request order (TXFP set in MX_CAN_Init()), which
+ * is the order of the queue.  A frame queued while the three mailboxes hold
+ * frames of lower priority waits for those three.
+ *
+ * A mailbox that loses the arbitration in single-shot mode (NART) is queued
+ * again, other errors lose the frame and count in can_tx_failed().
+ *
+ * A frame source (can_tx_set_source()) builds its frames in the mailbox
+ * itself when one is free, e.g. the segments of an ISO-TP message straight
+ * from the buffer of the caller.  Its next frame competes with the top of the
+ * queue by identifier.  It has one frame in the mailboxes at a time: with
+ * NART a mailbox behind one that lost the arbitration would go out first.
+ ******************************************************************************
+ */
+#ifndef CAN_TX_H
+#define CAN_TX_H
+
+#include "main.h"
+
+/* Frames waiting for a mailbox, on top of the three in the mailboxes. */
+#ifndef CAN_TX_QUEUE_SIZE
+#define CAN_TX_QUEUE_SIZE               16U
+#endif
+
+/* Called once after HAL_CAN_Start(), enables the TX mailbox empty interrupt. */
+void can_tx_init(CAN_HandleTypeDef *hcan);
+
+/* Queues a frame, data may be NULL for a remote frame.  Callable from tasks
+ * and from interrupts.  HAL_ERROR when the queue is full. */
+HAL_StatusTypeDef can_tx_send(const CAN_TxHeaderTypeDef *header, const uint8_t data[]);
+
+/* Frames in the queue, not counting the mailboxes. */
+uint32_t can_tx_pending(void);
+
+/* Frames refused by a full queue since start-up. */
+uint32_t can_tx_dropped(void);
+
+/* Frames lost to a transmit error since start-up. */
+uint32_t can_tx_failed(void);
+
+/* peek() of a source with no frame due */
+#define CAN_TX_SOURCE_IDLE              0xFFFFFFFFU
+
+/* Results passed to done() */
+#define CAN_TX_SOURCE_SENT              0U
+#define CAN_TX_SOURCE_LOST              1U      /* arbitration lost: load the same frame again */
+#define CAN_TX_SOURCE_FAILED            2U
+
+/* Called in the critical section, from tasks and interrupts. */
+typedef struct
+{
+    uint32_t (*peek)(void);                             /* TIR key of the next frame, or CAN_TX_SOURCE_IDLE */
+    uint32_t (*load)(uint32_t *tdlr, uint32_t *tdhr);   /* data of that frame, returns its DLC */
+    void (*done)(uint32_t result);                      /* the mailbox of the frame is free again */
+} can_tx_source_t;
+
+/* Sets the one frame source, NULL for none. */
+void can_tx_set_source(const can_tx_source_t *source);
+
+/* Fills the free mailboxes again, for a source whose peek() was
+ * CAN_TX_SOURCE_IDLE and no longer is. */
+void can_tx_resume(void);
+
+#endif
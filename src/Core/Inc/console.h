@@ -0,0 +1,54 @@
+/**
+ ******************************************************************************
+ * @file           : console.h
+ * @brief          : Buffered printf console on USART1, drained by DMA
+ ******************************************************************************
+ * The formatter writes into a RAM ring buffer, the buffer goes out through
+ * HAL_UART_Transmit_DMA() (DMA1 channel 4) and every TX complete callback
+ * starts the next chunk.  Writing costs a copy into the buffer instead of a
+ * byte time per character.
+ ******************************************************************************
+ */
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+
+/* Ring buffer size in bytes, a power of 2. */
+#ifndef CONSOLE_BUFFER_SIZE
+#if defined(USE_SLCAN)
+#define CONSOLE_BUFFER_SIZE             1024U
+#else
+#define CONSOLE_BUFFER_SIZE             512U
+#endif
+#endif
+
+/* What a write does when the buffer is full. */
+typedef enum
+{
+    CONSOLE_FULL_DROP = 0,      /* the bytes that do not fit are lost */
+    CONSOLE_FULL_BLOCK,         /* the task waits for the DMA to make room */
+    CONSOLE_FULL_OVERWRITE      /* the oldest bytes not yet sent are lost */
+} console_full_policy_t;
+
+#ifndef CONSOLE_FULL_POLICY
+#define CONSOLE_FULL_POLICY             CONSOLE_FULL_BLOCK
+#endif
+
+/* Called once after MX_USART1_UART_Init(). */
+void console_init(void);
+
+void console_set_full_policy(console_full_policy_t policy);
+
+/* Queues len bytes and starts the DMA if it is idle.  Callable from tasks and
+ * from interrupts, which never block: CONSOLE_FULL_BLOCK drops there and
+ * before the scheduler runs.  Returns the number of bytes queued. */
+uint32_t console_write(const char *data, uint32_t len);
+
+/* Waits until everything queued so far is on the line. */
+void console_flush(void);
+
+/* Bytes lost to a full buffer since start-up. */
+uint32_t console_dropped(void);
+
+#endif
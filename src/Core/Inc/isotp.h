@@ -0,0 +1,86 @@
+/**
+ ******************************************************************************
+ * @file           : isotp.h
+ * @brief          : ISO-TP (ISO 15765-2) transport over the CAN link
+ ******************************************************************************
+ * One link, identified by a pair of identifiers, carries messages of up to
+ * ISOTP_MAX_LENGTH bytes in each direction: single frames up to 7 bytes,
+ * above that a first frame, flow control from the receiver and consecutive
+ * frames of 7 bytes.  Every frame is padded to 8 bytes.
+ *
+ * Nothing is copied on the way: the frames are built in the TX mailbox from
+ * the buffer passed to isotp_send_start(), which must stay untouched until
+ * isotp_send_wait() returns, and the received frames are unpacked from the
+ * RX mailbox into the buffer passed to isotp_receive_start().  The transfers
+ * run in the interrupts: the TX mailbox empty interrupt loads the next
+ * consecutive frame (see can_tx_set_source()), the FIFO interrupts take the
+ * frames of the link before the RX ring (see can_rx_set_hook()) and answer
+ * with flow control, and isotp_tick() in the tick interrupt handles STmin and
+ * the timeouts.  The task only starts a transfer and waits for its end.
+ *
+ * The block size and STmin of the configuration are the ones this node asks
+ * for as a receiver; as a sender it follows those of the flow control frames
+ * of the other node.  STmin is counted in ticks: a nonzero STmin, including
+ * the 100 us to 900 us values, waits for at least that many milliseconds.
+ *
+ * One task may send and one task receive at the same time, the same one
+ * included.  With tx_id equal to rx_id and the controller in loopback mode
+ * the node talks to itself.
+ ******************************************************************************
+ */
+#ifndef ISOTP_H
+#define ISOTP_H
+
+#include "main.h"
+#include "FreeRTOS.h"
+
+/* First frame length field */
+#define ISOTP_MAX_LENGTH                4095U
+
+/* N_Bs and N_Cr: flow control or the next consecutive frame, in ticks */
+#ifndef ISOTP_TIMEOUT
+#define ISOTP_TIMEOUT                   1000U
+#endif
+
+#define ISOTP_PADDING                   0xCCU
+
+typedef struct
+{
+    uint32_t tx_id;
+    uint32_t rx_id;
+    uint8_t ide;            /* 1: extended identifiers */
+    uint8_t block_size;     /* consecutive frames between flow controls, 0: all */
+    uint8_t st_min;         /* between consecutive frames, ISO 15765-2 encoding */
+} isotp_config_t;
+
+/* Takes the TX source and RX hook, after can_tx_init() and can_rx_init().
+ * Also called again to change the configuration while no transfer runs. */
+void isotp_init(const isotp_config_t *config);
+
+/* Starts sending length bytes of data.  HAL_BUSY while a message is being
+ * sent, HAL_ERROR for a length of 0 or above ISOTP_MAX_LENGTH. */
+HAL_StatusTypeDef isotp_send_start(const uint8_t data[], uint32_t length);
+
+/* Waits up to timeout ticks for the end of the message.  HAL_OK when it was
+ * sent, HAL_ERROR when the receiver refused it (overflow) or a frame could not
+ * be sent, HAL_TIMEOUT when no flow control came, HAL_BUSY when it still
+ * runs. */
+HAL_StatusTypeDef isotp_send_wait(TickType_t timeout);
+
+/* Accepts the next message into buffer, up to size bytes.  A longer message
+ * is refused with an overflow.  HAL_BUSY while a message is being received;
+ * before that the buffer may be replaced by calling it again. */
+HAL_StatusTypeDef isotp_receive_start(uint8_t buffer[], uint32_t size);
+
+/* Waits up to timeout ticks for the message.  HAL_OK with its length in
+ * *length, HAL_ERROR on a consecutive frame out of sequence, HAL_TIMEOUT when
+ * the sender stopped, HAL_BUSY when none is complete yet. */
+HAL_StatusTypeDef isotp_receive_wait(uint32_t *length, TickType_t timeout);
+
+/* STmin and the timeouts, called from HAL_IncTick(). */
+void isotp_tick(void);
+
+/* Non-zero while isotp_tick() has a deadline to watch. */
+uint32_t isotp_busy(void);
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ ******************************************************************************
+ * @file           : kernel_bench.h
+ * @brief          : Micro-benchmarks of the FreeRTOS primitives
+ ******************************************************************************
+ * Built when USE_KERNEL_BENCH is defined.  kernel_bench_start() creates the
+ * benchmark tasks next to the application tasks, the results are printed once
+ * as CSV:
+ *
+ *   test,iterations,min_cycles,avg_cycles,max_cycles,min_ns,avg_ns,max_ns
+ *
+ * On the target the samples come from the DWT cycle counter and the ns are
+ * derived from SystemCoreClock.  In the host simulation (USE_HOST_SIM) the
+ * samples are CLOCK_MONOTONIC ns and the cycles are those ns at
+ * SystemCoreClock, the program exits after printing.
+ ******************************************************************************
+ */
+#ifndef KERNEL_BENCH_H
+#define KERNEL_BENCH_H
+
+void kernel_bench_start(void);
+
+/* Called by HAL_IncTick() around the kernel tick to time it. */
+void kernel_bench_tick_enter(void);
+void kernel_bench_tick_exit(void);
+
+/* Called at the entry and the exit of TIM1_UP_IRQHandler() to time the whole
+ * tick interrupt. */
+void kernel_bench_isr_enter(void);
+void kernel_bench_isr_exit(void);
+
+#if defined(USE_KERNEL_BENCH)
+#define KERNEL_BENCH_ISR_ENTER()        kernel_bench_isr_enter()
+#define KERNEL_BENCH_ISR_EXIT()         kernel_bench_isr_exit()
+#else
+#define KERNEL_BENCH_ISR_ENTER()
+#define KERNEL_BENCH_ISR_EXIT()
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ ******************************************************************************
+ * @file           : logline.h
+ * @brief          : Whole-line printf logging from many tasks, without locks
+ ******************************************************************************
+ * logline_printf() formats into a line buffer on the stack of the caller, so
+ * tasks never share a buffer while they format, then commits the finished
+ * line to a lock-free ring in one piece.  One drainer at a time moves the
+ * lines from the ring to console_write(), so lines from different tasks do
+ * not interleave on the console.
+ *
+ * Record in the ring: len (1 .. LOGLINE_SIZE - 1), then len bytes of text.
+ ******************************************************************************
+ */
+#ifndef LOGLINE_H
+#define LOGLINE_H
+
+#include <stdint.h>
+
+/* Longest line with its terminator; a longer one is cut and ends in '\n'.
+ * This much goes on the stack of every caller. */
+#ifndef LOGLINE_SIZE
+#define LOGLINE_SIZE                    64U
+#endif
+
+/* Ring between the tasks and the drainer, a power of 2. */
+#ifndef LOGLINE_BUFFER_SIZE
+#define LOGLINE_BUFFER_SIZE             256U
+#endif
+
+/* printf() of one line.  Callable from tasks and interrupts; a line that
+ * does not fit in the ring is dropped.  Returns the length of the line. */
+int logline_printf(const char *format, ...);
+
+/* Commits len bytes of already formatted text as one line. */
+void logline_write(const char *line, uint32_t len);
+
+/* Called when the ring is full and another caller is draining it, e.g. a
+ * task it preempted.  Returns nonzero after it gave the drainer time to run
+ * and the line should be tried again, 0 to drop the line.  The weak default
+ * drops. */
+uint32_t logline_wait(void);
+
+/* Lines lost to a full ring since start-up. */
+uint32_t logline_dropped(void);
+
+#endif
@@ -51,6 +51,16 @@ extern uint8_t print_from_isr_enbale;
 void _putchar(char character);
 
 
+/**
+ * Output a block of characters, used by the printf() function instead of one _putchar() per character
+ * The default implementation calls _putchar() for every character, override it for devices that
+ * take a block at once (buffer copy, DMA)
+ * \param data Characters to output, not terminated
+ * \param len Number of characters
+ */
+void _putspan(const char* data, size_t len);
+
+
 /**
  * Tiny printf implementation
  * You have to implement _putchar if you use printf()
@@ -111,6 +121,72 @@ int vprintf_(const char* format, va_list va);
 int fctprintf(void (*out)(char character, void* arg), void* arg, const char* format, ...);
 
 
+/**
+ * printf with block output function
+ * Like fctprintf(), but the output function takes the literal runs of the format, the converted
+ * values and the padding as whole blocks
+ * \param out An output function which takes a block of characters, its length and an argument pointer
+ * \param arg An argument pointer for user data passed to output function
+ * \param format A string that specifies the format of the output
+ * \return The number of characters that are sent to the output function
+ */
+int spanprintf(void (*out)(const char* data, size_t len, void* arg), void* arg, const char* format, ...);
+
+
+/**
+ * Flags of a conversion, as parsed from the format
+ */
+#define PRINTF_FLAGS_ZEROPAD   (1U <<  0U)
+#define PRINTF_FLAGS_LEFT      (1U <<  1U)
+#define PRINTF_FLAGS_PLUS      (1U <<  2U)
+#define PRINTF_FLAGS_SPACE     (1U <<  3U)
+#define PRINTF_FLAGS_HASH      (1U <<  4U)
+#define PRINTF_FLAGS_UPPERCASE (1U <<  5U)
+#define PRINTF_FLAGS_CHAR      (1U <<  6U)
+#define PRINTF_FLAGS_SHORT     (1U <<  7U)
+#define PRINTF_FLAGS_LONG      (1U <<  8U)
+#define PRINTF_FLAGS_LONG_LONG (1U <<  9U)
+#define PRINTF_FLAGS_PRECISION (1U << 10U)
+
+
+/**
+ * One piece of a pre-parsed format: the literal text up to a conversion and the conversion
+ * Built at compile time by the C++ front end in printf_fmt.hpp, with the flags, base and width
+ * already adjusted the way the runtime parser does it
+ */
+typedef struct {
+    const char*    literal;      // text before the conversion, not terminated
+    unsigned short literal_len;
+    unsigned short flags;        // PRINTF_FLAGS_*
+    unsigned short width;
+    unsigned short precision;
+    unsigned char  base;         // 2, 8, 10 or 16 for the integer conversions
+    char           specifier;    // d, i, u, x, X, o, b, c, s, p, f, F, k, K or %, 0 for text only
+} printf_op_t;
+
+
+/**
+ * Argument of a pre-parsed format, one per conversion
+ */
+typedef union {
+    long long          i;        // d, i, c, k
+    unsigned long long u;        // u, x, X, o, b, K
+    double             f;        // f, F
+    const void*        p;        // s, p
+} printf_arg_t;
+
+
+/**
+ * printf/snprintf of a pre-parsed format, see printf_fmt.hpp
+ * \param ops The pieces of the format
+ * \param count Number of pieces
+ * \param args The arguments, in the order of the conversions
+ * \return Like printf() and snprintf()
+ */
+int printf_ops_(const printf_op_t* ops, size_t count, const printf_arg_t* args);
+int snprintf_ops_(char* buffer, size_t n, const printf_op_t* ops, size_t count, const printf_arg_t* args);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,442 @@
+/**
+ ******************************************************************************
+ * @file           : printf_fmt.hpp
+ * @brief          : Compile-time checked and pre-parsed printf formats (C++17)
+ ******************************************************************************
+ * PRINTF_FMT("%u:%08x\n", a, b) parses the format while compiling, checks the
+ * arguments against it and keeps the result as a table of printf_op_t in
+ * flash.  At run time only the arguments are converted, by printf_ops_():
+ * there is no format left to scan.
+ *
+ * What does not compile:
+ *   - '*' width or precision, unknown conversions, a '%' at the end
+ *   - %lld, %llu and %j on the target, 64-bit conversions are not built in
+ *   - the wrong number of arguments
+ *   - %d or %i with an unsigned argument, %u with a signed one, of the size
+ *     of the conversion; types smaller than int are promoted and pass
+ *   - %x, %X, %o, %b with an integer that is not of the size of the
+ *     conversion, either signedness passes
+ *   - %s without a char pointer, %p without a pointer, %f without a float
+ *     or double, %k and %K like %d and %u
+ *
+ * The table follows printf.c as it is built by default (fixed-point %f and
+ * %k, no long long).
+ ******************************************************************************
+ */
+#ifndef PRINTF_FMT_HPP
+#define PRINTF_FMT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+#include "printf.h"
+
+/* printf() / snprintf() with a string literal format, checked and parsed at
+ * compile time. */
+#define PRINTF_FMT(fmt, ...)                                                                              \
+    ([&]() {                                                                                              \
+        struct printf_fmt_str                                                                             \
+        {                                                                                                 \
+            static constexpr const char *str() { return fmt; }                                           \
+        };                                                                                                \
+        return ::printf_fmt::print<printf_fmt_str>(__VA_ARGS__);                                          \
+    }())
+
+#define SNPRINTF_FMT(buffer, n, fmt, ...)                                                                 \
+    ([&]() {                                                                                              \
+        struct printf_fmt_str                                                                             \
+        {                                                                                                 \
+            static constexpr const char *str() { return fmt; }                                           \
+        };                                                                                                \
+        return ::printf_fmt::snprint<printf_fmt_str>((buffer), (n), ##__VA_ARGS__);                       \
+    }())
+
+namespace printf_fmt
+{
+
+enum class error : unsigned char
+{
+    none,
+    star,
+    unknown_conversion,
+    trailing_percent,
+    long_long,
+    too_wide,
+};
+
+enum class kind : unsigned char
+{
+    sint,       /* d i k */
+    uint,       /* u K */
+    bits,       /* x X o b */
+    chr,        /* c */
+    str,        /* s */
+    ptr,        /* p */
+    flt,        /* f F */
+};
+
+struct arg_spec
+{
+    kind what;
+    unsigned char size;     /* sizeof the integer the length modifier asks for */
+};
+
+template <size_t N>
+struct table
+{
+    printf_op_t ops[N];
+    arg_spec args[N];
+    size_t op_count;
+    size_t arg_count;
+    error err;
+};
+
+constexpr size_t max_ops(const char *fmt)
+{
+    size_t n = 1U;
+
+    for (; *fmt != '\0'; fmt++)
+    {
+        if (*fmt == '%')
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+constexpr bool is_digit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+constexpr unsigned int read_number(const char *fmt, size_t &pos)
+{
+    unsigned int n = 0U;
+
+    while (is_digit(fmt[pos]))
+    {
+        n = (n * 10U) + (unsigned int)(fmt[pos++] - '0');
+        if (n > 0xFFFFU)
+        {
+            n = 0x10000U;
+        }
+    }
+    return n;
+}
+
+/* The same scan as _vsnprintf(), the flag and base adjustments included. */
+template <size_t N>
+constexpr table<N> parse(const char *fmt)
+{
+    table<N> t{};
+    size_t pos = 0U;
+    size_t run = 0U;
+
+    while (true)
+    {
+        if ((fmt[pos] != '\0') && (fmt[pos] != '%'))
+        {
+            pos++;
+            continue;
+        }
+
+        printf_op_t &op = t.ops[t.op_count];
+        op.literal = &fmt[run];
+        op.literal_len = (unsigned short)(pos - run);
+        if (fmt[pos] == '\0')
+        {
+            if (op.literal_len != 0U)
+            {
+                t.op_count++;
+            }
+            return t;
+        }
+        pos++;
+
+        unsigned int flags = 0U;
+        for (bool more = true; more;)
+        {
+            switch (fmt[pos])
+            {
+            case '0': flags |= PRINTF_FLAGS_ZEROPAD; pos++; break;
+            case '-': flags |= PRINTF_FLAGS_LEFT;    pos++; break;
+            case '+': flags |= PRINTF_FLAGS_PLUS;    pos++; break;
+            case ' ': flags |= PRINTF_FLAGS_SPACE;   pos++; break;
+            case '#': flags |= PRINTF_FLAGS_HASH;    pos++; break;
+            default:  more = false;                         break;
+            }
+        }
+
+        unsigned int width = read_number(fmt, pos);
+        unsigned int precision = 0U;
+        if (fmt[pos] == '.')
+        {
+            flags |= PRINTF_FLAGS_PRECISION;
+            pos++;
+            precision = read_number(fmt, pos);
+        }
+        if (fmt[pos] == '*')
+        {
+            t.err = error::star;
+            return t;
+        }
+        if ((width > 0xFFFFU) || (precision > 0xFFFFU))
+        {
+            t.err = error::too_wide;
+            return t;
+        }
+
+        unsigned char size = sizeof(int);
+        switch (fmt[pos])
+        {
+        case 'l':
+            flags |= PRINTF_FLAGS_LONG;
+            size = sizeof(long);
+            if (fmt[++pos] == 'l')
+            {
+                t.err = error::long_long;
+                return t;
+            }
+            break;
+        case 'h':
+            flags |= PRINTF_FLAGS_SHORT;
+            size = sizeof(short);
+            if (fmt[++pos] == 'h')
+            {
+                flags |= PRINTF_FLAGS_CHAR;
+                size = sizeof(char);
+                pos++;
+            }
+            break;
+        case 'j':
+        case 'z':
+            if ((fmt[pos] == 'j') ? (sizeof(intmax_t) != sizeof(long)) : (sizeof(size_t) != sizeof(long)))
+            {
+                t.err = error::long_long;
+                return t;
+            }
+            flags |= PRINTF_FLAGS_LONG;
+            size = sizeof(long);
+            pos++;
+            break;
+        default:
+            break;
+        }
+
+        const char c = fmt[pos];
+        kind what = kind::sint;
+        switch (c)
+        {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'b':
+            op.base = (c == 'x' || c == 'X') ? 16U : (c == 'o') ? 8U : (c == 'b') ? 2U : 10U;
+            if (op.base == 10U)
+            {
+                flags &= ~PRINTF_FLAGS_HASH;
+            }
+            if (c == 'X')
+            {
+                flags |= PRINTF_FLAGS_UPPERCASE;
+            }
+            if ((c != 'd') && (c != 'i'))
+            {
+                flags &= ~(PRINTF_FLAGS_PLUS | PRINTF_FLAGS_SPACE);
+            }
+            if (flags & PRINTF_FLAGS_PRECISION)
+            {
+                flags &= ~PRINTF_FLAGS_ZEROPAD;
+            }
+            what = ((c == 'd') || (c == 'i')) ? kind::sint : (c == 'u') ? kind::uint : kind::bits;
+            break;
+        case 'f':
+        case 'F':
+            if (c == 'F')
+            {
+                flags |= PRINTF_FLAGS_UPPERCASE;
+            }
+            what = kind::flt;
+            break;
+        case 'k':
+            what = kind::sint;
+            size = sizeof(int);
+            break;
+        case 'K':
+            flags &= ~(PRINTF_FLAGS_PLUS | PRINTF_FLAGS_SPACE);
+            what = kind::uint;
+            size = sizeof(int);
+            break;
+        case 'c':
+            what = kind::chr;
+            break;
+        case 's':
+            what = kind::str;
+            break;
+        case 'p':
+            width = sizeof(void *) * 2U;
+            flags |= PRINTF_FLAGS_ZEROPAD | PRINTF_FLAGS_UPPERCASE;
+            what = kind::ptr;
+            break;
+        case '%':
+            break;
+        case '\0':
+            t.err = error::trailing_percent;
+            return t;
+        default:
+            t.err = error::unknown_conversion;
+            return t;
+        }
+
+        op.flags = (unsigned short)flags;
+        op.width = (unsigned short)width;
+        op.precision = (unsigned short)precision;
+        op.specifier = c;
+        if (c != '%')
+        {
+            t.args[t.arg_count++] = arg_spec{what, size};
+        }
+        t.op_count++;
+        pos++;
+        run = pos;
+    }
+}
+
+template <class S>
+struct format
+{
+    static constexpr table<max_ops(S::str())> parsed = parse<max_ops(S::str())>(S::str());
+};
+
+/* Enums are checked and passed as their underlying type. */
+template <class T, bool = std::is_enum<T>::value>
+struct value_type
+{
+    using type = T;
+};
+
+template <class T>
+struct value_type<T, true>
+{
+    using type = std::underlying_type_t<T>;
+};
+
+template <class T>
+constexpr bool matches(arg_spec spec)
+{
+    using V = typename value_type<std::decay_t<T>>::type;
+    constexpr bool integer = std::is_integral<V>::value && !std::is_same<V, bool>::value;
+    constexpr bool promoted = integer && (sizeof(V) < sizeof(int));
+
+    switch (spec.what)
+    {
+    case kind::sint:
+        return promoted || (integer && std::is_signed<V>::value && (sizeof(V) == spec.size));
+    case kind::uint:
+        return promoted || (integer && std::is_unsigned<V>::value && (sizeof(V) == spec.size));
+    case kind::bits:
+        return promoted || (integer && (sizeof(V) == spec.size));
+    case kind::chr:
+        return integer && (sizeof(V) <= sizeof(int));
+    case kind::str:
+        return std::is_convertible<V, const char *>::value && !std::is_same<V, std::nullptr_t>::value;
+    case kind::ptr:
+        return std::is_pointer<V>::value || std::is_same<V, std::nullptr_t>::value;
+    case kind::flt:
+        return std::is_same<V, float>::value || std::is_same<V, double>::value;
+    }
+    return false;
+}
+
+template <class S, class... Args, size_t... I>
+constexpr size_t first_mismatch(std::index_sequence<I...>)
+{
+    size_t bad = sizeof...(Args);
+    const bool ok[] = {true, matches<Args>(format<S>::parsed.args[I])...};
+
+    for (size_t i = sizeof...(Args); i > 0U; i--)
+    {
+        if (!ok[i])
+        {
+            bad = i - 1U;
+        }
+    }
+    return bad;
+}
+
+template <class T>
+inline printf_arg_t pack(T value)
+{
+    using V = typename value_type<T>::type;
+    printf_arg_t a{};
+
+    if constexpr (std::is_floating_point<V>::value)
+    {
+        a.f = (double)value;
+    }
+    else if constexpr (std::is_pointer<V>::value)
+    {
+        a.p = (const void *)value;
+    }
+    else if constexpr (std::is_same<V, std::nullptr_t>::value)
+    {
+        a.p = nullptr;
+    }
+    else if constexpr (std::is_signed<V>::value)
+    {
+        a.i = (long long)(V)value;
+    }
+    else
+    {
+        a.u = (unsigned long long)(V)value;
+    }
+    return a;
+}
+
+template <class S, class... Args>
+constexpr void check()
+{
+    constexpr auto &t = format<S>::parsed;
+
+    static_assert(t.err != error::star, "printf format: '*' width and precision are not supported");
+    static_assert(t.err != error::unknown_conversion, "printf format: unknown conversion");
+    static_assert(t.err != error::trailing_percent, "printf format: '%' at the end");
+    static_assert(t.err != error::long_long, "printf format: 64-bit conversions are not built in");
+    static_assert(t.err != error::too_wide, "printf format: width or precision above 65535");
+    if constexpr (t.err == error::none)
+    {
+        static_assert(t.arg_count <= sizeof...(Args), "printf format: too few arguments");
+        static_assert(t.arg_count >= sizeof...(Args), "printf format: too many arguments");
+        if constexpr (t.arg_count == sizeof...(Args))
+        {
+            constexpr size_t bad = first_mismatch<S, Args...>(std::index_sequence_for<Args...>{});
+            static_assert(bad == sizeof...(Args), "printf format: argument does not match its conversion");
+        }
+    }
+}
+
+template <class S, class... Args>
+inline int print(Args... args)
+{
+    check<S, std::decay_t<Args>...>();
+    const printf_arg_t packed[sizeof...(Args) + 1U] = {pack(args)...};
+    return printf_ops_(format<S>::parsed.ops, format<S>::parsed.op_count, packed);
+}
+
+template <class S, class... Args>
+inline int snprint(char *buffer, size_t n, Args... args)
+{
+    check<S, std::decay_t<Args>...>();
+    const printf_arg_t packed[sizeof...(Args) + 1U] = {pack(args)...};
+    return snprintf_ops_(buffer, n, format<S>::parsed.ops, format<S>::parsed.op_count, packed);
+}
+
+} /* namespace printf_fmt */
+
+#endif
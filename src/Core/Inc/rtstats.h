@@ -0,0 +1,56 @@
+/**
+ ******************************************************************************
+ * @file           : rtstats.h
+ * @brief          : Per task CPU time, stack high-water mark and switches
+ ******************************************************************************
+ * FreeRTOS keeps the run time of every task when configGENERATE_RUN_TIME_STATS
+ * is set: at each switch vTaskSwitchContext() reads the run time counter and
+ * adds the ticks since the last switch to the task switched out.  The counter
+ * is the DWT cycle counter on the target (1 / SystemCoreClock, 13.9 ns at
+ * 72 MHz) and CLOCK_MONOTONIC in us in the host simulation.  The
+ * traceTASK_SWITCHED_IN() hook of FreeRTOSConfig.h counts the switches into
+ * every task by its number (creation order, from 1; the idle task comes after
+ * the tasks created before the scheduler starts).
+ *
+ * rtstats_report() logs one line per task with what happened since the last
+ * report:
+ *
+ *   rt <number> <name> cpu <percent> stack <words> sw <switches>
+ *
+ * the stack being the high-water mark since the start, in words never used.
+ * With USE_BINLOG the line goes out as a binary record and the name is left
+ * out: binlog has no %s.
+ *
+ * The 32-bit counters wrap, the cycle counter every 59.6 s at 72 MHz: the
+ * reports work on differences and must come more often than that.  The task
+ * numbers share RTSTATS_MAX_TASKS switch counters, a power of 2: with more
+ * tasks two of them count into the same one.
+ *
+ * Built with USE_RTSTATS and Core/Src/rtstats.c; without it RTSTATS_REPORT()
+ * is empty and the kernel keeps no run time.
+ ******************************************************************************
+ */
+#ifndef RTSTATS_H
+#define RTSTATS_H
+
+#include "main.h"
+
+#if defined(USE_RTSTATS)
+#define RTSTATS_REPORT()                rtstats_report()
+#else
+#define RTSTATS_REPORT()
+#endif
+
+/* Starts the run time counter, portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() in
+ * vTaskStartScheduler(). */
+void rtstats_clock_init(void);
+
+/* The run time counter, portGET_RUN_TIME_COUNTER_VALUE() of the host
+ * simulation. */
+uint32_t rtstats_clock(void);
+
+/* Logs the statistics of every task since the last call.  From one task;
+ * suspends the scheduler while it reads the task list and their stacks. */
+void rtstats_report(void);
+
+#endif
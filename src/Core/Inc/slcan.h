@@ -0,0 +1,81 @@
+/**
+ ******************************************************************************
+ * @file           : slcan.h
+ * @brief          : CAN to USART1 gateway, Lawicel (slcan) compatible
+ ******************************************************************************
+ * Built with USE_SLCAN, the board is a serial CAN adapter: every frame on the
+ * bus goes out on USART1 (2 Mbaud), and the host opens the channel, sets the
+ * bit rate and sends frames with the Lawicel commands, so Linux slcand and
+ * the usual tools work with it.
+ *
+ * CAN to UART: the FIFO interrupts put the frames into the CAN RX ring
+ * (can_rx.c), slcan_task() is the one consumer of the ring.  It takes every
+ * frame waiting, encodes them one after the other into a batch and hands the
+ * batch to console_write(), whose DMA (HAL_UART_Transmit_DMA()) sends it
+ * while the next batch fills.  A frame costs the encoding and its share of
+ * one copy; the ring absorbs the time the task waits for room in the console
+ * buffer.
+ *
+ * Two encodings:
+ *
+ *  - ASCII (Lawicel): tiiildd..[ssss]\r, Tiiiiiiiildd..[ssss]\r for
+ *    extended identifiers, r and R for remote frames; ssss is the time stamp
+ *    in ms modulo 60000, with Z1.
+ *  - binary (B1, not Lawicel): a header byte 0x80 | ide << 6 | rtr << 5 |
+ *    timestamps << 4 | dlc, the identifier big endian in 2 or 4 bytes, the
+ *    data, the time stamp big endian in 2 bytes.  11 bytes for a standard
+ *    frame of 8 bytes, against 22 in ASCII.
+ *
+ * UART to CAN: USART1 receives into a circular DMA buffer (DMA1 channel 5,
+ * no interrupt), the task takes the finished command lines from it at every
+ * pass, at least once a tick.  Commands, each ended by \r; the answer is
+ * \r (z\r or Z\r for a frame sent), or \a when refused:
+ *
+ *   Sn     bit rate, n = 0..8: 10k 20k 50k 100k 125k 250k 500k 800k 1M
+ *   O L C  open, open listen only, close
+ *   tiiildd.. Tiiiiiiiildd.. riiil Riiiiiiiil   send a frame (open)
+ *   F      status: Fxx, 0x01 ring full, 0x04 error warning, 0x08 frames lost
+ *          since the last F, 0x20 error passive, 0x80 bus error
+ *   Zn     time stamps off/on
+ *   Bn     ASCII/binary encoding
+ *   V v N  versions and serial number
+ *
+ * The task writes everything on USART1, the answers in between the frames:
+ * the log output (LOG_PRINTF) is off in this build.
+ ******************************************************************************
+ */
+#ifndef SLCAN_H
+#define SLCAN_H
+
+#include "main.h"
+
+/* Circular DMA buffer of USART1 RX */
+#ifndef SLCAN_RX_SIZE
+#define SLCAN_RX_SIZE                   256U
+#endif
+
+/* Encoded frames handed to console_write() at once */
+#ifndef SLCAN_BATCH_SIZE
+#define SLCAN_BATCH_SIZE                256U
+#endif
+
+/* Longest command: T, 8 + 1 + 16 digits */
+#define SLCAN_LINE_SIZE                 32U
+
+/* Takes CAN1 for the gateway, after can_rx_init() and can_tx_init(): lets
+ * every frame through the filters, standard and extended ones split over the
+ * two FIFOs, closes the channel and starts the UART reception.  The host
+ * opens it with O. */
+void slcan_init(CAN_HandleTypeDef *hcan);
+
+/* The gateway task, in place of freertos_lld_can_rx_task(). */
+void slcan_task(void const *argument);
+
+/* Command bytes from somewhere else than USART1 (a test), handled by the
+ * task like received ones.  Returns the number of bytes taken. */
+uint32_t slcan_input(const char *data, uint32_t len);
+
+/* Frames encoded since start-up. */
+uint32_t slcan_forwarded(void);
+
+#endif
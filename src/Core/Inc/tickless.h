@@ -0,0 +1,71 @@
+/**
+ ******************************************************************************
+ * @file           : tickless.h
+ * @brief          : Tickless idle on the TIM1 time base
+ ******************************************************************************
+ * When every task is blocked for at least configEXPECTED_IDLE_TIME_BEFORE_SLEEP
+ * ticks the idle task calls tickless_sleep() (portSUPPRESS_TICKS_AND_SLEEP in
+ * FreeRTOSConfig.h) instead of taking a TIM1 interrupt every millisecond.
+ *
+ * TIM1 keeps counting at 1 MHz (HAL_InitTick()), a tick is TICKLESS_COUNTS
+ * counts and the tick boundaries stay at the multiples of TICKLESS_COUNTS of
+ * the counter: the sleep only moves ARR, immediately (ARPE is 0), to the
+ * boundary the sleep ends at, and never writes CNT or the prescaler, so the
+ * tick keeps its phase to the counter clock across any number of sleeps.
+ *
+ *  - The sleep ends with the update interrupt at its last boundary: the
+ *    ticks before it are stepped, the interrupt brings the last one.
+ *  - Any other interrupt ends it early: the whole ticks elapsed are stepped
+ *    and ARR is set to the next boundary, whose update interrupt brings the
+ *    tick running.  TICKLESS_TICK() in HAL_IncTick() puts ARR back to one
+ *    tick, to the next boundary when the interrupt comes a tick or more
+ *    after its update, and HAL_IncTick() takes the ticks passed too.
+ *
+ * The longest sleep is 65 ticks, the 16-bit counter at 1 MHz; a longer idle
+ * time takes several.  The per tick work of HAL_IncTick() only sees the ticks
+ * of an interrupt: the ISO-TP timers (isotp_busy()) and the XCP DAQ lists of
+ * XCP_EVENT_1MS (XCP_BUSY()) keep the tick running while they run, the
+ * other users count time by the tick count.
+ *
+ * The CPU sleeps with WFI, the clocks stay on.  In the host simulation WFI
+ * is vPortHostWaitForInterrupt() of the Posix port.
+ *
+ * Built with USE_TICKLESS and Core/Src/tickless.c; without it TICKLESS_TICK()
+ * is empty and the tick runs every millisecond.
+ ******************************************************************************
+ */
+#ifndef TICKLESS_H
+#define TICKLESS_H
+
+#include "main.h"
+#include "FreeRTOS.h"
+
+/* TIM1 counts per tick, 1 MHz over configTICK_RATE_HZ */
+#define TICKLESS_COUNTS                 (1000000U / configTICK_RATE_HZ)
+
+typedef struct
+{
+    uint32_t sleeps;                    /* WFI entered */
+    uint32_t early;                     /* of them ended by another interrupt */
+    uint32_t aborted;                   /* a task or the tick came first */
+    uint32_t held;                      /* the tick was needed */
+    uint32_t stepped;                   /* ticks not taken by interrupt */
+} tickless_stats_t;
+
+#if defined(USE_TICKLESS)
+#define TICKLESS_TICK()                 tickless_tick()
+#else
+#define TICKLESS_TICK()                 (0U)
+#endif
+
+/* portSUPPRESS_TICKS_AND_SLEEP(): called by the idle task with the scheduler
+ * suspended, expected is the number of ticks until the next task wakes. */
+void tickless_sleep(TickType_t expected);
+
+/* TICKLESS_TICK(): in the tick interrupt, ahead of the kernel tick.  Returns
+ * the ticks passed since the update, to be taken as well. */
+uint32_t tickless_tick(void);
+
+void tickless_get(tickless_stats_t *stats);
+
+#endif
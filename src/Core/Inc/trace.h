@@ -0,0 +1,116 @@
+/**
+ ******************************************************************************
+ * @file           : trace.h
+ * @brief          : Kernel and interrupt event trace in a RAM ring
+ ******************************************************************************
+ * Every event is one 8-byte record: the time, then a word with the event in
+ * bits 0-7, an id in bits 8-15 and an argument in bits 16-31.
+ *
+ *   TRACE_EVENT_SWITCH               id task number
+ *   TRACE_EVENT_ISR_ENTER / _EXIT    id IRQn
+ *   TRACE_EVENT_QUEUE_SEND[_ISR]     id queue type, arg queue number
+ *   TRACE_EVENT_QUEUE_RECEIVE[_ISR]  id queue type, arg queue number
+ *   TRACE_EVENT_DELAY                id task number, arg ticks (at most 0xFFFF)
+ *   TRACE_EVENT_NOTIFY[_ISR]         id number of the task notified
+ *
+ * The task numbers are those of the kernel (creation order, from 1), the
+ * queue numbers are given at creation, from 1; the queue type is
+ * queueQUEUE_TYPE_* of queue.h (semaphores and mutexes are queues).  The
+ * kernel hooks are defined in FreeRTOSConfig.h, the interrupt handlers of
+ * stm32f1xx_it.c call TRACE_ISR_ENTER() and TRACE_ISR_EXIT().
+ *
+ * The time is the DWT cycle counter on the target and CLOCK_MONOTONIC in ns
+ * in the host simulation, trace_buffer.frequency says which.  It is 32 bits
+ * and wraps (59.6 s at 72 MHz, 4.3 s in ns): the reader takes the difference
+ * to the record before as signed, so the gaps between events must stay below
+ * half of that, which the tick interrupt sees to.
+ *
+ * trace_record() takes its slot with an atomic increment of head and writes
+ * the record without a lock, from tasks and interrupts of any priority; the
+ * ring keeps the last TRACE_RECORDS events.  An interrupt between taking the
+ * slot and reading the clock leaves its records in the slots after, with the
+ * earlier times: the reader sorts by time.
+ *
+ * trace_buffer describes itself: on the target a debugger dumps it as it is
+ * (gdb: dump binary value trace.bin trace_buffer), Host/Tools/trace2json.c
+ * turns the dump into Chrome trace JSON.
+ *
+ * Built with USE_TRACE and Core/Src/trace.c; without it the hooks are empty.
+ ******************************************************************************
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC                     0x31435254U     /* "TRC1" */
+
+/* Records in the ring, a power of 2.  The tick interrupt alone fills 2000
+ * per second. */
+#ifndef TRACE_RECORDS
+#if defined(USE_HOST_SIM)
+#define TRACE_RECORDS                   65536U
+#else
+#define TRACE_RECORDS                   256U
+#endif
+#endif
+
+/* Task name slots, by task number modulo TRACE_TASKS (a power of 2) */
+#define TRACE_TASKS                     8U
+#define TRACE_NAME_LEN                  12U
+
+typedef enum
+{
+    TRACE_EVENT_SWITCH = 1,
+    TRACE_EVENT_ISR_ENTER,
+    TRACE_EVENT_ISR_EXIT,
+    TRACE_EVENT_QUEUE_SEND,
+    TRACE_EVENT_QUEUE_SEND_ISR,
+    TRACE_EVENT_QUEUE_RECEIVE,
+    TRACE_EVENT_QUEUE_RECEIVE_ISR,
+    TRACE_EVENT_DELAY,
+    TRACE_EVENT_NOTIFY,
+    TRACE_EVENT_NOTIFY_ISR,
+} trace_event_t;
+
+typedef struct
+{
+    uint32_t time;
+    uint32_t info;                      /* event | id << 8 | arg << 16 */
+} trace_record_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t frequency;                 /* of time, Hz */
+    uint32_t records;                   /* TRACE_RECORDS */
+    uint32_t tasks;                     /* TRACE_TASKS */
+    uint32_t name_len;                  /* TRACE_NAME_LEN */
+    volatile uint32_t head;             /* records written since trace_init(), the
+                                         * next goes to ring[head % records] */
+    char names[TRACE_TASKS][TRACE_NAME_LEN];
+    trace_record_t ring[TRACE_RECORDS];
+} trace_buffer_t;
+
+extern trace_buffer_t trace_buffer;
+
+#if defined(USE_TRACE)
+#define TRACE_ISR_ENTER(irqn)           trace_record(TRACE_EVENT_ISR_ENTER, (uint32_t)(irqn), 0U)
+#define TRACE_ISR_EXIT(irqn)            trace_record(TRACE_EVENT_ISR_EXIT, (uint32_t)(irqn), 0U)
+#else
+#define TRACE_ISR_ENTER(irqn)
+#define TRACE_ISR_EXIT(irqn)
+#endif
+
+/* Starts the clock and empties the ring, after SystemClock_Config(). */
+void trace_init(void);
+
+void trace_record(uint32_t event, uint32_t id, uint32_t arg);
+
+/* traceTASK_CREATE(): keeps the name of the task. */
+void trace_task_create(uint32_t number, const char *name);
+
+/* traceQUEUE_CREATE(): the number of the new queue. */
+uint32_t trace_queue_create(void);
+
+#endif
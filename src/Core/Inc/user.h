@@ -3,9 +3,24 @@
 
 #include "main.h"
 #include "cmsis_os.h"
+#include "isotp.h"
 
 extern  UART_HandleTypeDef huart1;
 extern CAN_HandleTypeDef hcan;
 void user_can_set_rx_filer(void);
+void freertos_lld_can_rx_task(void const *argument);
+
+/* Frames taken from the CAN RX ring by freertos_lld_can_rx_task(), those
+ * no handler took, and those of each handler. */
+extern uint32_t user_can_rx_frames;
+extern uint32_t user_can_rx_unrouted;
+extern uint32_t user_can_rx_status;
+extern uint32_t user_can_rx_command;
+
+/* The diagnostic link: requests on 0x7E0, responses on 0x7E8. */
+extern const isotp_config_t user_isotp_config;
+
+/* Non-zero once the scheduler runs: HAL_IncTick() calls the kernel tick. */
+extern volatile uint32_t user_tick_kernel;
 
 #endif
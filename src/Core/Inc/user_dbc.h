@@ -0,0 +1,231 @@
+/**
+ ******************************************************************************
+ * @file           : user_dbc.h
+ * @brief          : CAN signals of user.dbc
+ ******************************************************************************
+ * Generated by Host/Tools/dbc_gen.c, do not edit: change the DBC file and
+ * run dbc_gen again.  See Core/Inc/can_dbc.h.
+ ******************************************************************************
+ */
+#ifndef USER_DBC_H
+#define USER_DBC_H
+
+#include "can_dbc.h"
+
+/* USER_TEST: 0x077, 8 bytes, from MCU */
+#define USER_TEST_ID                     0x77U
+#define USER_TEST_IDE                    0U
+#define USER_TEST_DLC                    8U
+
+typedef struct
+{
+    uint8_t counter;                    /* 0|8@1+ (1,0) [0|255] "" */
+    uint8_t led;                        /* 8|1@1+ (1,0) [0|1] "" */
+    uint8_t tx_pending;                 /* 16|8@1+ (1,0) [0|255] "" */
+    uint32_t uptime;                    /* 32|32@1+ (0.001,0) [0|4294967.295] "s" */
+} user_test_t;
+
+CAN_DBC_FN uint64_t user_test_pack(const user_test_t *msg)
+{
+    return ((uint64_t)msg->counter & UINT64_C(0xFF))
+           | (((uint64_t)msg->led & UINT64_C(0x1)) << 8U)
+           | (((uint64_t)msg->tx_pending & UINT64_C(0xFF)) << 16U)
+           | (((uint64_t)msg->uptime & UINT64_C(0xFFFFFFFF)) << 32U);
+}
+
+CAN_DBC_FN void user_test_unpack(user_test_t *msg, uint64_t payload)
+{
+    msg->counter = (uint8_t)(payload & UINT64_C(0xFF));
+    msg->led = (uint8_t)((payload >> 8U) & UINT64_C(0x1));
+    msg->tx_pending = (uint8_t)((payload >> 16U) & UINT64_C(0xFF));
+    msg->uptime = (uint32_t)((payload >> 32U) & UINT64_C(0xFFFFFFFF));
+}
+
+CAN_DBC_FN uint8_t user_test_counter_get(uint64_t payload)
+{
+    return (uint8_t)(payload & UINT64_C(0xFF));
+}
+
+CAN_DBC_FN uint64_t user_test_counter_set(uint64_t payload, uint8_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFFFFFFFF00)) | ((uint64_t)value & UINT64_C(0xFF));
+}
+
+CAN_DBC_FN uint8_t user_test_led_get(uint64_t payload)
+{
+    return (uint8_t)((payload >> 8U) & UINT64_C(0x1));
+}
+
+CAN_DBC_FN uint64_t user_test_led_set(uint64_t payload, uint8_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFFFFFFFEFF)) | (((uint64_t)value & UINT64_C(0x1)) << 8U);
+}
+
+CAN_DBC_FN uint8_t user_test_tx_pending_get(uint64_t payload)
+{
+    return (uint8_t)((payload >> 16U) & UINT64_C(0xFF));
+}
+
+CAN_DBC_FN uint64_t user_test_tx_pending_set(uint64_t payload, uint8_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFFFF00FFFF)) | (((uint64_t)value & UINT64_C(0xFF)) << 16U);
+}
+
+CAN_DBC_FN uint32_t user_test_uptime_get(uint64_t payload)
+{
+    return (uint32_t)((payload >> 32U) & UINT64_C(0xFFFFFFFF));
+}
+
+CAN_DBC_FN uint64_t user_test_uptime_set(uint64_t payload, uint32_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFF)) | (((uint64_t)value & UINT64_C(0xFFFFFFFF)) << 32U);
+}
+
+/* NODE_STATUS: 0x100, 8 bytes, from HOST */
+#define NODE_STATUS_ID                   0x100U
+#define NODE_STATUS_IDE                  0U
+#define NODE_STATUS_DLC                  8U
+
+typedef struct
+{
+    uint8_t state;                      /* 0|4@1+ (1,0) [0|15] "" */
+    uint8_t errors;                     /* 8|8@1+ (1,0) [0|255] "" */
+    uint16_t voltage;                   /* 16|16@1+ (0.001,0) [0|65.535] "V" */
+    int8_t temperature;                 /* 32|8@1- (1,0) [-128|127] "degC" */
+    uint16_t sequence;                  /* 48|16@1+ (1,0) [0|65535] "" */
+} node_status_t;
+
+CAN_DBC_FN uint64_t node_status_pack(const node_status_t *msg)
+{
+    return ((uint64_t)msg->state & UINT64_C(0xF))
+           | (((uint64_t)msg->errors & UINT64_C(0xFF)) << 8U)
+           | (((uint64_t)msg->voltage & UINT64_C(0xFFFF)) << 16U)
+           | (((uint64_t)msg->temperature & UINT64_C(0xFF)) << 32U)
+           | (((uint64_t)msg->sequence & UINT64_C(0xFFFF)) << 48U);
+}
+
+CAN_DBC_FN void node_status_unpack(node_status_t *msg, uint64_t payload)
+{
+    msg->state = (uint8_t)(payload & UINT64_C(0xF));
+    msg->errors = (uint8_t)((payload >> 8U) & UINT64_C(0xFF));
+    msg->voltage = (uint16_t)((payload >> 16U) & UINT64_C(0xFFFF));
+    msg->temperature = (int8_t)(int64_t)((((payload >> 32U) & UINT64_C(0xFF)) ^ UINT64_C(0x80)) - UINT64_C(0x80));
+    msg->sequence = (uint16_t)((payload >> 48U) & UINT64_C(0xFFFF));
+}
+
+CAN_DBC_FN uint8_t node_status_state_get(uint64_t payload)
+{
+    return (uint8_t)(payload & UINT64_C(0xF));
+}
+
+CAN_DBC_FN uint64_t node_status_state_set(uint64_t payload, uint8_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFFFFFFFFF0)) | ((uint64_t)value & UINT64_C(0xF));
+}
+
+CAN_DBC_FN uint8_t node_status_errors_get(uint64_t payload)
+{
+    return (uint8_t)((payload >> 8U) & UINT64_C(0xFF));
+}
+
+CAN_DBC_FN uint64_t node_status_errors_set(uint64_t payload, uint8_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFFFFFF00FF)) | (((uint64_t)value & UINT64_C(0xFF)) << 8U);
+}
+
+CAN_DBC_FN uint16_t node_status_voltage_get(uint64_t payload)
+{
+    return (uint16_t)((payload >> 16U) & UINT64_C(0xFFFF));
+}
+
+CAN_DBC_FN uint64_t node_status_voltage_set(uint64_t payload, uint16_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFF0000FFFF)) | (((uint64_t)value & UINT64_C(0xFFFF)) << 16U);
+}
+
+CAN_DBC_FN int8_t node_status_temperature_get(uint64_t payload)
+{
+    return (int8_t)(int64_t)((((payload >> 32U) & UINT64_C(0xFF)) ^ UINT64_C(0x80)) - UINT64_C(0x80));
+}
+
+CAN_DBC_FN uint64_t node_status_temperature_set(uint64_t payload, int8_t value)
+{
+    return (payload & UINT64_C(0xFFFFFF00FFFFFFFF)) | (((uint64_t)value & UINT64_C(0xFF)) << 32U);
+}
+
+CAN_DBC_FN uint16_t node_status_sequence_get(uint64_t payload)
+{
+    return (uint16_t)((payload >> 48U) & UINT64_C(0xFFFF));
+}
+
+CAN_DBC_FN uint64_t node_status_sequence_set(uint64_t payload, uint16_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFFFFFF)) | (((uint64_t)value & UINT64_C(0xFFFF)) << 48U);
+}
+
+/* NODE_COMMAND: 0x500, 8 bytes, from HOST */
+#define NODE_COMMAND_ID                  0x500U
+#define NODE_COMMAND_IDE                 0U
+#define NODE_COMMAND_DLC                 8U
+
+typedef struct
+{
+    uint8_t command;                    /* 0|8@1+ (1,0) [0|255] "" */
+    uint32_t argument;                  /* 32|32@1+ (1,0) [0|4294967295] "" */
+} node_command_t;
+
+CAN_DBC_FN uint64_t node_command_pack(const node_command_t *msg)
+{
+    return ((uint64_t)msg->command & UINT64_C(0xFF))
+           | (((uint64_t)msg->argument & UINT64_C(0xFFFFFFFF)) << 32U);
+}
+
+CAN_DBC_FN void node_command_unpack(node_command_t *msg, uint64_t payload)
+{
+    msg->command = (uint8_t)(payload & UINT64_C(0xFF));
+    msg->argument = (uint32_t)((payload >> 32U) & UINT64_C(0xFFFFFFFF));
+}
+
+CAN_DBC_FN uint8_t node_command_command_get(uint64_t payload)
+{
+    return (uint8_t)(payload & UINT64_C(0xFF));
+}
+
+CAN_DBC_FN uint64_t node_command_command_set(uint64_t payload, uint8_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFFFFFFFF00)) | ((uint64_t)value & UINT64_C(0xFF));
+}
+
+CAN_DBC_FN uint32_t node_command_argument_get(uint64_t payload)
+{
+    return (uint32_t)((payload >> 32U) & UINT64_C(0xFFFFFFFF));
+}
+
+CAN_DBC_FN uint64_t node_command_argument_set(uint64_t payload, uint32_t value)
+{
+    return (payload & UINT64_C(0xFFFFFFFF)) | (((uint64_t)value & UINT64_C(0xFFFFFFFF)) << 32U);
+}
+
+/* X(message, MESSAGE) for every message */
+#define USER_DBC_MESSAGES(X) \
+    X(user_test, USER_TEST) \
+    X(node_status, NODE_STATUS) \
+    X(node_command, NODE_COMMAND)
+
+/* S(message, signal, start, length, motorola, signed) as in the DBC */
+#define USER_TEST_SIGNALS(S) \
+    S(user_test, counter, 0U, 8U, 0U, 0U) \
+    S(user_test, led, 8U, 1U, 0U, 0U) \
+    S(user_test, tx_pending, 16U, 8U, 0U, 0U) \
+    S(user_test, uptime, 32U, 32U, 0U, 0U)
+#define NODE_STATUS_SIGNALS(S) \
+    S(node_status, state, 0U, 4U, 0U, 0U) \
+    S(node_status, errors, 8U, 8U, 0U, 0U) \
+    S(node_status, voltage, 16U, 16U, 0U, 0U) \
+    S(node_status, temperature, 32U, 8U, 0U, 1U) \
+    S(node_status, sequence, 48U, 16U, 0U, 0U)
+#define NODE_COMMAND_SIGNALS(S) \
+    S(node_command, command, 0U, 8U, 0U, 0U) \
+    S(node_command, argument, 32U, 32U, 0U, 0U)
+
+#endif
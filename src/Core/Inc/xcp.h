@@ -0,0 +1,104 @@
+/**
+ ******************************************************************************
+ * @file           : xcp.h
+ * @brief          : XCP on CAN slave: memory access and synchronous DAQ lists
+ ******************************************************************************
+ * A measurement and calibration slave (ASAM MCD-1 XCP 1.x, CAN transport
+ * layer) on two identifiers: the master sends its command packets (CTO) on
+ * XCP_CRO_ID, the slave answers and sends the DAQ packets (DTO) on
+ * XCP_DTO_ID.  Byte order Intel, address granularity byte, no block mode,
+ * no seed and key; the packets are not padded to 8 bytes.
+ *
+ * The commands arrive through the CAN RX ring and are handled in the task of
+ * the dispatch table (xcp_on_cro()); their answers go out through the TX
+ * queue of can_tx.c:
+ *
+ *   CONNECT DISCONNECT GET_STATUS SYNCH SET_MTA UPLOAD SHORT_UPLOAD DOWNLOAD
+ *   GET_DAQ_PROCESSOR_INFO GET_DAQ_RESOLUTION_INFO FREE_DAQ ALLOC_DAQ
+ *   ALLOC_ODT ALLOC_ODT_ENTRY SET_DAQ_PTR WRITE_DAQ SET_DAQ_LIST_MODE
+ *   START_STOP_DAQ_LIST START_STOP_SYNCH
+ *
+ * DAQ lists are dynamic: FREE_DAQ, ALLOC_DAQ, ALLOC_ODT, ALLOC_ODT_ENTRY in
+ * this order take the lists, ODTs and entries from fixed pools, so there is
+ * no heap.  An ODT is one DTO: its absolute number (PID) in byte 0, then up
+ * to 7 bytes of entries.  No time stamps and no STIM.
+ *
+ * Sampling is synchronous: XCP_EVENT(channel) at the place of the event
+ * (the tick interrupt for XCP_EVENT_1MS, the 500 ms task for
+ * XCP_EVENT_500MS) copies the entries of every running list of that event,
+ * every prescaler cycles, into one DTO per ODT and queues all ODTs of the
+ * list at once with can_tx_send(), from where the TX interrupt sends them
+ * back to back.  The ODTs of one list are sampled in the same event, so they
+ * are consistent with each other.  A burst the TX queue has no room for
+ * stops there: its last ODTs are missing, counted in xcp_overloads().  The
+ * bursts leave the last entry of the queue to the answers, so the master
+ * can still stop an overloaded DAQ.
+ *
+ * The DTOs of one burst leave in PID order unless one loses the arbitration
+ * (NART, see can_tx.h): it is sent again after those already in the other
+ * mailboxes.  The master puts a sample together by PID, not by order.
+ *
+ * XCP_EVENT_1MS samples in the tick interrupt only: with USE_TICKLESS the
+ * tick keeps running while a list of that event runs (XCP_BUSY()).
+ *
+ * Built with USE_XCP and Core/Src/xcp.c; without it XCP_EVENT() is empty and
+ * XCP_BUSY() is 0.
+ ******************************************************************************
+ */
+#ifndef XCP_H
+#define XCP_H
+
+#include "main.h"
+#include "can_rx.h"
+
+#ifndef XCP_CRO_ID
+#define XCP_CRO_ID                      0x7F0U
+#endif
+#ifndef XCP_DTO_ID
+#define XCP_DTO_ID                      0x7F1U
+#endif
+
+/* Pools of the dynamic DAQ configuration */
+#ifndef XCP_DAQ_MAX
+#define XCP_DAQ_MAX                     4U
+#endif
+#ifndef XCP_ODT_MAX
+#define XCP_ODT_MAX                     16U
+#endif
+#ifndef XCP_ODT_ENTRY_MAX
+#define XCP_ODT_ENTRY_MAX               48U
+#endif
+
+/* Event channels */
+#define XCP_EVENT_1MS                   0U
+#define XCP_EVENT_500MS                 1U
+#define XCP_EVENT_CHANNELS              2U
+
+#if defined(USE_XCP)
+#define XCP_EVENT(channel)              xcp_event(channel)
+#define XCP_BUSY()                      xcp_busy()
+#else
+#define XCP_EVENT(channel)
+#define XCP_BUSY()                      (0U)
+#endif
+
+/* Handler of XCP_CRO_ID in the dispatch table: one command, its answer
+ * queued for sending. */
+void xcp_on_cro(const can_rx_frame_t *frame);
+
+/* Samples and sends the running DAQ lists of the event channel.  Callable
+ * from tasks and interrupts, one caller per channel. */
+void xcp_event(uint32_t channel);
+
+/* 1 while a DAQ list runs on XCP_EVENT_1MS, whose event needs every tick,
+ * else 0. */
+uint32_t xcp_busy(void);
+
+/* DAQ bursts cut short by a full TX queue since start-up. */
+uint32_t xcp_overloads(void);
+
+/* Cycles of each event channel since start-up; a DAQ list can sample them to
+ * show the master the cycles it missed. */
+extern volatile uint32_t xcp_event_cycles[XCP_EVENT_CHANNELS];
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ ******************************************************************************
+ * @file           : binlog.c
+ * @brief          : Deferred binary logging: format string IDs and raw args
+ ******************************************************************************
+ * A writer encodes its record on the stack, reserves the space in the ring
+ * with a compare-and-swap on head, copies the record in and writes the sync
+ * byte last: until then the reader sees a 0 and stops there.  The reader
+ * clears the bytes it took before it moves tail, so a slot always reads 0
+ * until the next record in it is complete.
+ *
+ * Whoever writes a record also drains the ring into console_write(), unless
+ * someone else is draining already.  Writers never wait for each other, the
+ * drainer may wait in console_write() for the DMA.
+ ******************************************************************************
+ */
+#include "main.h"
+#include "console.h"
+#include "binlog.h"
+
+#define BINLOG_MASK                     (BINLOG_BUFFER_SIZE - 1U)
+
+/* sync, id and nargs, the arguments; 5 bytes per LEB128 number at most */
+#define BINLOG_RECORD_MAX               (1U + 5U + 1U + (BINLOG_MAX_ARGS * 5U))
+
+#if (BINLOG_BUFFER_SIZE & BINLOG_MASK) != 0U
+#error "BINLOG_BUFFER_SIZE must be a power of 2"
+#endif
+
+#if BINLOG_BUFFER_SIZE < BINLOG_RECORD_MAX
+#error "BINLOG_BUFFER_SIZE must hold a record"
+#endif
+
+/* defined by the linker for the binlog_fmt section */
+extern const char __start_binlog_fmt[] __attribute__((weak));
+
+static uint8_t binlog_ring[BINLOG_BUFFER_SIZE];
+static uint32_t binlog_head;
+static uint32_t binlog_tail;
+static uint32_t binlog_busy;
+static uint32_t binlog_lost;
+
+uint32_t binlog_dropped(void)
+{
+    return __atomic_load_n(&binlog_lost, __ATOMIC_RELAXED);
+}
+
+static uint32_t binlog_encode(uint8_t *out, uint32_t value)
+{
+    uint32_t n = 0U;
+
+    while (value >= 0x80U)
+    {
+        out[n++] = (uint8_t)(value | 0x80U);
+        value >>= 7U;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/* Copies one LEB128 number from the ring at pos into record[len].  Returns
+ * the new len. */
+static uint32_t binlog_copy_number(uint8_t *record, uint32_t len, uint32_t pos)
+{
+    uint8_t b;
+
+    do
+    {
+        b = binlog_ring[(pos + len) & BINLOG_MASK];
+        record[len++] = b;
+    } while ((b & 0x80U) != 0U);
+    return len;
+}
+
+/* Moves the oldest record to the console if it is complete.  Only called by
+ * the drainer. */
+static uint32_t binlog_pop(void)
+{
+    uint8_t record[BINLOG_RECORD_MAX];
+    uint32_t tail = binlog_tail;
+    uint32_t nargs;
+    uint32_t len;
+    uint32_t i;
+
+    if (__atomic_load_n(&binlog_ring[tail & BINLOG_MASK], __ATOMIC_ACQUIRE) != BINLOG_SYNC)
+    {
+        return 0U;
+    }
+
+    record[0] = BINLOG_SYNC;
+    len = binlog_copy_number(record, 1U, tail);
+    len = binlog_copy_number(record, len, tail);
+    nargs = record[len - 1U];
+    for (i = 0U; i < nargs; i++)
+    {
+        len = binlog_copy_number(record, len, tail);
+    }
+
+    for (i = 0U; i < len; i++)
+    {
+        binlog_ring[(tail + i) & BINLOG_MASK] = 0U;
+    }
+    __atomic_store_n(&binlog_tail, tail + len, __ATOMIC_RELEASE);
+
+    (void)console_write((const char *)record, len);
+    return 1U;
+}
+
+static void binlog_drain(void)
+{
+    /* A record completed after the drainer looked at it, but before it let
+     * go, is picked up by the next round. */
+    while ((__atomic_load_n(&binlog_ring[binlog_tail & BINLOG_MASK], __ATOMIC_ACQUIRE) == BINLOG_SYNC) &&
+           (__atomic_exchange_n(&binlog_busy, 1U, __ATOMIC_ACQUIRE) == 0U))
+    {
+        while (binlog_pop() != 0U)
+        {
+        }
+        __atomic_store_n(&binlog_busy, 0U, __ATOMIC_RELEASE);
+    }
+}
+
+void binlog_write(const char *fmt, const uint32_t *args, uint32_t nargs)
+{
+    uint8_t record[BINLOG_RECORD_MAX];
+    uint32_t len = 1U;
+    uint32_t head;
+    uint32_t i;
+
+    len += binlog_encode(&record[len], (uint32_t)((uintptr_t)fmt - (uintptr_t)__start_binlog_fmt));
+    record[len++] = (uint8_t)nargs;
+    for (i = 0U; i < nargs; i++)
+    {
+        len += binlog_encode(&record[len], args[i]);
+    }
+
+    head = __atomic_load_n(&binlog_head, __ATOMIC_RELAXED);
+    do
+    {
+        if ((BINLOG_BUFFER_SIZE - (head - __atomic_load_n(&binlog_tail, __ATOMIC_ACQUIRE))) < len)
+        {
+            (void)__atomic_fetch_add(&binlog_lost, 1U, __ATOMIC_RELAXED);
+            binlog_drain();
+            return;
+        }
+    } while (__atomic_compare_exchange_n(&binlog_head, &head, head + len, 1, __ATOMIC_RELAXED,
+                                         __ATOMIC_RELAXED) == 0);
+
+    for (i = 1U; i < len; i++)
+    {
+        binlog_ring[(head + i) & BINLOG_MASK] = record[i];
+    }
+    __atomic_store_n(&binlog_ring[head & BINLOG_MASK], (uint8_t)BINLOG_SYNC, __ATOMIC_RELEASE);
+
+    binlog_drain();
+}
@@ -0,0 +1,313 @@
+/**
+ ******************************************************************************
+ * @file           : can_dispatch.c
+ * @brief          : CAN frame handlers looked up by filter match index
+ ******************************************************************************
+ * The filter numbers of a FIFO count the filters of every bank assigned to
+ * it in bank order, active or not: 1 for a 32-bit mask bank, 2 for a 32-bit
+ * list or 16-bit mask bank, 4 for a 16-bit list bank.  The plan puts the
+ * inactive banks after the active ones, so the numbers of the filters in use
+ * only depend on the banks of the plan.
+ *
+ * The hash of a merged filter with n subscribed identifiers has the power of
+ * two of slots at or above n and half as many buckets.  The buckets are
+ * placed largest first, each with the first displacement that puts all its
+ * identifiers in free slots.  When a bucket finds none the next pair of
+ * multipliers is tried, after CAN_DISPATCH_SEEDS of them twice the slots, up
+ * to 256 as the displacements are bytes.
+ * The identifiers are walked again from the ranges at every step instead of
+ * being copied, which keeps the stack small at the price of a slower
+ * search at start-up.
+ ******************************************************************************
+ */
+#include <string.h>
+#include "main.h"
+#include "can_dispatch.h"
+
+/* No identifier has all of bits 30:29 set */
+#define CAN_DISPATCH_EMPTY              0xFFFFFFFFU
+#define CAN_DISPATCH_SEEDS              64U
+
+/* What can_dispatch_walk() does with each identifier */
+#define CAN_DISPATCH_COUNT              0U
+#define CAN_DISPATCH_SIZES              1U
+#define CAN_DISPATCH_PLACE              2U
+#define CAN_DISPATCH_CLEAR              3U
+
+static uint32_t can_dispatch_key(uint32_t id, uint32_t ide)
+{
+    return id | (ide << 31U);
+}
+
+static uint32_t can_dispatch_bucket(const can_dispatch_hash_t *h, uint32_t key)
+{
+    return (key * h->mult1) >> (32U - h->dbits);
+}
+
+static uint32_t can_dispatch_slot(const can_dispatch_hash_t *h, uint32_t key, uint32_t disp)
+{
+    return h->base + (((key * h->mult2) >> (32U - h->bits)) ^ disp);
+}
+
+/* The last identifier a filter matches. */
+static uint32_t can_dispatch_last(const can_filter_entry_t *e)
+{
+    return e->id | (~e->mask & ((e->ide != 0U) ? 0x1FFFFFFFU : 0x7FFU));
+}
+
+/* Walks the subscribed identifiers the filter matches.  COUNT counts them,
+ * SIZES counts them per bucket into sizes[], PLACE puts those of the bucket
+ * at their slot with disp and returns UINT32_MAX on a taken slot, CLEAR
+ * takes them out again. */
+static uint32_t can_dispatch_walk(can_dispatch_t *table, const can_filter_entry_t *e, const can_dispatch_hash_t *h,
+                                  uint32_t op, uint32_t bucket, uint32_t disp, uint8_t sizes[])
+{
+    const can_filter_range_t *r;
+    const uint32_t last = can_dispatch_last(e);
+    uint32_t n = 0U;
+    uint32_t i;
+    uint32_t x;
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t key;
+    uint32_t slot;
+
+    for (i = 0U; i < table->count; i++)
+    {
+        r = &table->ranges[i];
+        if ((r->ide != e->ide) || (r->fifo != e->fifo))
+        {
+            continue;
+        }
+        lo = (r->first > e->id) ? r->first : e->id;
+        hi = (r->last < last) ? r->last : last;
+        for (x = lo; (x <= hi) && (x >= lo); x++)
+        {
+            if ((x & e->mask) != e->id)
+            {
+                continue;
+            }
+            n++;
+            if (op == CAN_DISPATCH_COUNT)
+            {
+                continue;
+            }
+            key = can_dispatch_key(x, e->ide);
+            if (op == CAN_DISPATCH_SIZES)
+            {
+                sizes[can_dispatch_bucket(h, key)]++;
+                continue;
+            }
+            if (can_dispatch_bucket(h, key) != bucket)
+            {
+                continue;
+            }
+            slot = can_dispatch_slot(h, key, disp);
+            if (op == CAN_DISPATCH_CLEAR)
+            {
+                if (table->hash_key[slot] == key)
+                {
+                    table->hash_key[slot] = CAN_DISPATCH_EMPTY;
+                }
+            }
+            else if (table->hash_key[slot] != CAN_DISPATCH_EMPTY)
+            {
+                return UINT32_MAX;
+            }
+            else
+            {
+                table->hash_key[slot] = key;
+                table->hash_route[slot] = (uint8_t)i;
+            }
+        }
+    }
+    return n;
+}
+
+/* Places every bucket of the hash, largest first.  HAL_ERROR when one finds
+ * no displacement. */
+static HAL_StatusTypeDef can_dispatch_place(can_dispatch_t *table, const can_filter_entry_t *e,
+                                            const can_dispatch_hash_t *h)
+{
+    uint8_t sizes[128];
+    uint8_t *disp = &table->hash_disp[h->disp];
+    const uint32_t buckets = 1UL << h->dbits;
+    const uint32_t slots = 1UL << h->bits;
+    uint32_t size;
+    uint32_t b;
+    uint32_t d;
+
+    (void)memset(&table->hash_key[h->base], 0xFF, slots * sizeof(uint32_t));
+    (void)memset(sizes, 0, buckets);
+    (void)memset(disp, 0, buckets);
+    (void)can_dispatch_walk(table, e, h, CAN_DISPATCH_SIZES, 0U, 0U, sizes);
+
+    for (size = slots; size > 0U; size--)
+    {
+        for (b = 0U; b < buckets; b++)
+        {
+            if (sizes[b] != size)
+            {
+                continue;
+            }
+            for (d = 0U; d < slots; d++)
+            {
+                if (can_dispatch_walk(table, e, h, CAN_DISPATCH_PLACE, b, d, NULL) != UINT32_MAX)
+                {
+                    break;
+                }
+                (void)can_dispatch_walk(table, e, h, CAN_DISPATCH_CLEAR, b, d, NULL);
+            }
+            if (d == slots)
+            {
+                return HAL_ERROR;
+            }
+            disp[b] = (uint8_t)d;
+        }
+    }
+    return HAL_OK;
+}
+
+/* Route of one filter of the plan. */
+static HAL_StatusTypeDef can_dispatch_filter(can_dispatch_t *table, const can_filter_entry_t *e,
+                                             can_dispatch_filter_t *f)
+{
+    const can_filter_range_t *r;
+    can_dispatch_hash_t *h;
+    uint32_t n;
+    uint32_t seed;
+    uint32_t i;
+
+    for (i = 0U; i < table->count; i++)
+    {
+        r = &table->ranges[i];
+        if ((r->ide == e->ide) && (r->fifo == e->fifo) && (r->first <= e->id) && (can_dispatch_last(e) <= r->last))
+        {
+            f->route = (uint8_t)i;
+            return HAL_OK;
+        }
+    }
+
+    n = can_dispatch_walk(table, e, NULL, CAN_DISPATCH_COUNT, 0U, 0U, NULL);
+    if (n == 0U)
+    {
+        f->route = CAN_DISPATCH_NONE;
+        return HAL_OK;
+    }
+    if (table->hashes == CAN_DISPATCH_HASHES)
+    {
+        return HAL_ERROR;
+    }
+    h = &table->hash[table->hashes];
+    h->base = (uint16_t)table->hash_used;
+    h->disp = (uint16_t)table->disp_used;
+    for (h->bits = 1U; (1UL << h->bits) < n; h->bits++)
+    {
+    }
+    for (;;)
+    {
+        h->dbits = (h->bits > 1U) ? (uint8_t)(h->bits - 1U) : 1U;
+        if ((h->bits > 8U) || ((table->hash_used + (1UL << h->bits)) > CAN_DISPATCH_HASH_SIZE)
+            || ((table->disp_used + (1UL << h->dbits)) > (CAN_DISPATCH_HASH_SIZE / 2U)))
+        {
+            return HAL_ERROR;
+        }
+        for (seed = 1U; seed <= CAN_DISPATCH_SEEDS; seed++)
+        {
+            h->mult1 = (seed * 0x9E3779B1U) | 1U;
+            h->mult2 = ((seed * 0x85EBCA6BU) ^ 0xC2B2AE35U) | 1U;
+            if (can_dispatch_place(table, e, h) == HAL_OK)
+            {
+                f->route = CAN_DISPATCH_HASHED;
+                f->hash = (uint8_t)table->hashes;
+                table->hashes++;
+                table->hash_used += 1UL << h->bits;
+                table->disp_used += 1UL << h->dbits;
+                return HAL_OK;
+            }
+        }
+        h->bits++;
+    }
+}
+
+HAL_StatusTypeDef can_dispatch_init(can_dispatch_t *table, const can_filter_plan_t *plan,
+                                    const can_filter_range_t ranges[], const can_dispatch_handler_t handlers[],
+                                    uint32_t count)
+{
+    can_dispatch_filter_t route[CAN_FILTER_MAX_ENTRIES];
+    const can_filter_bank_t *bank;
+    uint32_t number[2] = {0U, 0U};
+    uint32_t b;
+    uint32_t k;
+    uint32_t i;
+
+    (void)memset(table, 0, sizeof(*table));
+    table->ranges = ranges;
+    table->handlers = handlers;
+    table->count = count;
+    if (count >= CAN_DISPATCH_HASHED)
+    {
+        return HAL_ERROR;
+    }
+
+    (void)memset(route, 0, sizeof(route));
+    for (i = 0U; i < plan->entry_count; i++)
+    {
+        if (can_dispatch_filter(table, &plan->entries[i], &route[i]) != HAL_OK)
+        {
+            return HAL_ERROR;
+        }
+    }
+
+    /* FIFO 0 first, then FIFO 1 */
+    for (b = 0U; b < plan->bank_count; b++)
+    {
+        table->numbers[plan->banks[b].fifo] += plan->banks[b].filters;
+    }
+    table->first[1] = table->numbers[0];
+    for (b = 0U; b < plan->bank_count; b++)
+    {
+        bank = &plan->banks[b];
+        for (k = 0U; k < bank->filters; k++)
+        {
+            table->filter[table->first[bank->fifo] + number[bank->fifo]] = route[bank->entry[k]];
+            number[bank->fifo]++;
+        }
+    }
+    return HAL_OK;
+}
+
+uint32_t can_dispatch_route(const can_dispatch_t *table, const can_rx_frame_t *frame)
+{
+    const can_dispatch_filter_t *f;
+    const can_dispatch_hash_t *h;
+    const uint32_t fifo = frame->fifo & 1U;
+    uint32_t key;
+    uint32_t slot;
+
+    if (frame->filter >= table->numbers[fifo])
+    {
+        return CAN_DISPATCH_NONE;
+    }
+    f = &table->filter[table->first[fifo] + frame->filter];
+    if (f->route != CAN_DISPATCH_HASHED)
+    {
+        return f->route;
+    }
+    h = &table->hash[f->hash];
+    key = can_dispatch_key(frame->id, frame->ide);
+    slot = can_dispatch_slot(h, key, table->hash_disp[h->disp + can_dispatch_bucket(h, key)]);
+    return (table->hash_key[slot] == key) ? table->hash_route[slot] : CAN_DISPATCH_NONE;
+}
+
+uint32_t can_dispatch(const can_dispatch_t *table, const can_rx_frame_t *frame)
+{
+    const uint32_t route = can_dispatch_route(table, frame);
+
+    if ((route == CAN_DISPATCH_NONE) || (table->handlers[route] == NULL))
+    {
+        return 0U;
+    }
+    table->handlers[route](frame);
+    return 1U;
+}
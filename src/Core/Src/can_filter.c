@@ -0,0 +1,542 @@
+/**
+ ******************************************************************************
+ * @file           : can_filter.c
+ * @brief          : bxCAN filter banks computed from the subscribed identifiers
+ ******************************************************************************
+ * Filters of the same FIFO and IDE form a class; only filters of one class
+ * are merged and they share banks by kind (list or mask).  The cost of a
+ * filter is counted in quarters of a bank, its false accepts are the
+ * identifiers it matches minus the subscribed ones among them, counted bit
+ * by bit against the ranges (can_filter_count()).
+ *
+ * The banks are laid out FIFO 0 first, then by kind: 32-bit list, 32-bit
+ * mask, 16-bit mask, 16-bit list.  A free half of the last 16-bit mask bank
+ * takes the first standard identifier as a mask of all the bits.  Register
+ * layouts of RM0008:
+ *
+ *   32-bit:  STID[31:21] EXID[20:3] IDE[2] RTR[1]
+ *   16-bit:  STID[15:5] RTR[4] IDE[3] EXID[17:15][2:0]
+ ******************************************************************************
+ */
+#include <string.h>
+#include "main.h"
+#include "can_filter.h"
+
+#define CAN_FILTER_STD_BITS             11U
+#define CAN_FILTER_EXT_BITS             29U
+#define CAN_FILTER_STD_ALL              0x7FFU
+#define CAN_FILTER_EXT_ALL              0x1FFFFFFFU
+
+#define CAN_FILTER_WORD_IDE             (1UL << 2U)
+#define CAN_FILTER_HALF_IDE             (1UL << 3U)
+
+/* Kinds of filter, in bank order */
+#define CAN_FILTER_EXT_LIST             0U
+#define CAN_FILTER_EXT_MASK             1U
+#define CAN_FILTER_STD_MASK             2U
+#define CAN_FILTER_STD_LIST             3U
+#define CAN_FILTER_KINDS                4U
+
+/* Filters per bank and quarters of bank per filter, by kind */
+static const uint8_t can_filter_per_bank[CAN_FILTER_KINDS] = {2U, 1U, 2U, 4U};
+static const uint8_t can_filter_quarters[CAN_FILTER_KINDS] = {2U, 4U, 2U, 1U};
+
+static uint32_t can_filter_all(uint32_t ide)
+{
+    return (ide != 0U) ? CAN_FILTER_EXT_ALL : CAN_FILTER_STD_ALL;
+}
+
+static uint32_t can_filter_kind(const can_filter_entry_t *e)
+{
+    uint32_t single = (e->mask == can_filter_all(e->ide)) ? 1U : 0U;
+
+    if (e->ide != 0U)
+    {
+        return (single != 0U) ? CAN_FILTER_EXT_LIST : CAN_FILTER_EXT_MASK;
+    }
+    return (single != 0U) ? CAN_FILTER_STD_LIST : CAN_FILTER_STD_MASK;
+}
+
+static uint32_t can_filter_free_bits(uint32_t mask, uint32_t all)
+{
+    uint32_t free = ~mask & all;
+    uint32_t n = 0U;
+
+    while (free != 0U)
+    {
+        free &= free - 1U;
+        n++;
+    }
+    return n;
+}
+
+/* Identifiers x in 0..n with (x & mask) == id, bits below "bits" only. */
+static uint64_t can_filter_count_upto(uint32_t n, uint32_t id, uint32_t mask, uint32_t bits)
+{
+    uint64_t count = 0U;
+    uint32_t b;
+    uint32_t below;
+
+    for (b = bits; b-- > 0U;)
+    {
+        below = (1UL << b) - 1U;
+        if (((n >> b) & 1U) != 0U)
+        {
+            /* x takes 0 here and anything matching below */
+            if ((((mask >> b) & 1U) == 0U) || (((id >> b) & 1U) == 0U))
+            {
+                count += 1ULL << can_filter_free_bits(mask & below, below);
+            }
+            /* x follows n with a 1 */
+            if ((((mask >> b) & 1U) != 0U) && (((id >> b) & 1U) == 0U))
+            {
+                return count;
+            }
+        }
+        else if ((((mask >> b) & 1U) != 0U) && (((id >> b) & 1U) != 0U))
+        {
+            return count;
+        }
+    }
+    return count + 1U;     /* x == n */
+}
+
+/* Identifiers of first..last the filter matches. */
+static uint64_t can_filter_count(uint32_t first, uint32_t last, const can_filter_entry_t *e)
+{
+    uint32_t bits = (e->ide != 0U) ? CAN_FILTER_EXT_BITS : CAN_FILTER_STD_BITS;
+    uint64_t count = can_filter_count_upto(last, e->id, e->mask, bits);
+
+    if (first > 0U)
+    {
+        count -= can_filter_count_upto(first - 1U, e->id, e->mask, bits);
+    }
+    return count;
+}
+
+/* Identifiers the filter lets through that are not subscribed to its FIFO,
+ * UINT64_MAX when some are subscribed to the other FIFO. */
+static uint64_t can_filter_false(const can_filter_entry_t *e, const can_filter_range_t ranges[], uint32_t count)
+{
+    const uint32_t last = e->id | (~e->mask & can_filter_all(e->ide));
+    uint64_t matched = 1ULL << can_filter_free_bits(e->mask, can_filter_all(e->ide));
+    uint64_t n;
+    uint32_t i;
+
+    for (i = 0U; i < count; i++)
+    {
+        /* the filter only matches identifiers from id to last */
+        if ((ranges[i].ide != e->ide) || (ranges[i].last < e->id) || (ranges[i].first > last))
+        {
+            continue;
+        }
+        n = can_filter_count(ranges[i].first, ranges[i].last, e);
+        if ((n != 0U) && (ranges[i].fifo != e->fifo))
+        {
+            return UINT64_MAX;
+        }
+        matched -= n;
+    }
+    return matched;
+}
+
+static uint32_t can_filter_contains(const can_filter_entry_t *outer, const can_filter_entry_t *inner)
+{
+    return ((outer->ide == inner->ide) && (outer->fifo == inner->fifo) && ((inner->mask & outer->mask) == outer->mask)
+            && ((inner->id & outer->mask) == outer->id))
+               ? 1U
+               : 0U;
+}
+
+static uint32_t can_filter_banks_needed(const can_filter_plan_t *plan)
+{
+    uint32_t n[2][CAN_FILTER_KINDS] = {{0U}};
+    uint32_t banks = 0U;
+    uint32_t i;
+    uint32_t k;
+
+    for (i = 0U; i < plan->entry_count; i++)
+    {
+        n[plan->entries[i].fifo][can_filter_kind(&plan->entries[i])]++;
+    }
+    for (i = 0U; i < 2U; i++)
+    {
+        /* the free half of an odd 16-bit mask bank takes one identifier */
+        if (((n[i][CAN_FILTER_STD_MASK] & 1U) != 0U) && (n[i][CAN_FILTER_STD_LIST] != 0U))
+        {
+            n[i][CAN_FILTER_STD_LIST]--;
+        }
+        for (k = 0U; k < CAN_FILTER_KINDS; k++)
+        {
+            banks += (n[i][k] + can_filter_per_bank[k] - 1U) / can_filter_per_bank[k];
+        }
+    }
+    return banks;
+}
+
+/* Cuts the range into aligned blocks, appended to the plan. */
+static HAL_StatusTypeDef can_filter_split(const can_filter_range_t *range, can_filter_plan_t *plan)
+{
+    const uint32_t all = can_filter_all(range->ide);
+    uint32_t first = range->first;
+    uint32_t size;
+    can_filter_entry_t *e;
+
+    for (;;)
+    {
+        /* largest block aligned at first that ends by last */
+        size = (first == 0U) ? (all + 1U) : (first & (~first + 1U));
+        while ((size - 1U) > (range->last - first))
+        {
+            size >>= 1U;
+        }
+        if (plan->entry_count == CAN_FILTER_MAX_ENTRIES)
+        {
+            return HAL_ERROR;
+        }
+        e = &plan->entries[plan->entry_count++];
+        e->id = first;
+        e->mask = all & ~(size - 1U);
+        e->ide = range->ide;
+        e->fifo = range->fifo;
+        if ((range->last - first) == (size - 1U))
+        {
+            return HAL_OK;
+        }
+        first += size;
+    }
+}
+
+/* Merges the pair of filters of one class that costs the fewest false
+ * accepts per quarter of bank saved, with the filters it then contains.
+ * HAL_ERROR when no pair may be merged. */
+static HAL_StatusTypeDef can_filter_merge_best(can_filter_plan_t *plan, const can_filter_range_t ranges[],
+                                               uint32_t count)
+{
+    can_filter_entry_t merged;
+    can_filter_entry_t best;
+    uint64_t cost;
+    uint64_t removed;
+    uint64_t added;
+    uint64_t best_added = 0U;
+    int32_t saved;
+    int32_t best_saved = 0;
+    uint32_t found = 0U;
+    uint32_t i;
+    uint32_t j;
+    uint32_t k;
+
+    for (i = 0U; i < plan->entry_count; i++)
+    {
+        for (j = i + 1U; j < plan->entry_count; j++)
+        {
+            if ((plan->entries[i].ide != plan->entries[j].ide) || (plan->entries[i].fifo != plan->entries[j].fifo))
+            {
+                continue;
+            }
+            merged = plan->entries[i];
+            merged.mask &= plan->entries[j].mask & ~(plan->entries[i].id ^ plan->entries[j].id);
+            merged.id &= merged.mask;
+            cost = can_filter_false(&merged, ranges, count);
+            if (cost == UINT64_MAX)
+            {
+                continue;
+            }
+
+            saved = -(int32_t)can_filter_quarters[can_filter_kind(&merged)];
+            removed = 0U;
+            for (k = 0U; k < plan->entry_count; k++)
+            {
+                if (can_filter_contains(&merged, &plan->entries[k]) != 0U)
+                {
+                    saved += (int32_t)can_filter_quarters[can_filter_kind(&plan->entries[k])];
+                    removed += can_filter_false(&plan->entries[k], ranges, count);
+                }
+            }
+            /* contained filters may overlap once merged masks do */
+            added = (cost > removed) ? (cost - removed) : 0U;
+
+            /* a merge that saves room first, then the fewest false accepts
+             * per quarter; one that saves nothing prepares the next */
+            if ((found == 0U) || ((saved > 0) && (best_saved <= 0))
+                || (((saved > 0) == (best_saved > 0))
+                    && ((added * (uint64_t)((best_saved > 0) ? best_saved : 1))
+                        < (best_added * (uint64_t)((saved > 0) ? saved : 1)))))
+            {
+                best = merged;
+                best_added = added;
+                best_saved = saved;
+                found = 1U;
+            }
+        }
+    }
+    if (found == 0U)
+    {
+        return HAL_ERROR;
+    }
+
+    /* drop the filters the merged one contains, append it */
+    for (i = 0U, k = 0U; i < plan->entry_count; i++)
+    {
+        if (can_filter_contains(&best, &plan->entries[i]) == 0U)
+        {
+            plan->entries[k++] = plan->entries[i];
+        }
+    }
+    plan->entries[k] = best;
+    plan->entry_count = k + 1U;
+    return HAL_OK;
+}
+
+static uint32_t can_filter_word(const can_filter_entry_t *e, uint32_t value)
+{
+    return (e->ide != 0U) ? ((value << 3U) | CAN_FILTER_WORD_IDE) : (value << 21U);
+}
+
+static uint32_t can_filter_half(const can_filter_entry_t *e, uint32_t value)
+{
+    return (value << 5U) | ((e->ide != 0U) ? CAN_FILTER_HALF_IDE : 0U);
+}
+
+/* Register value of one filter: identifier, or identifier and mask. */
+static void can_filter_encode(const can_filter_entry_t *e, uint32_t kind, uint32_t *id, uint32_t *mask)
+{
+    if (kind < CAN_FILTER_STD_MASK)
+    {
+        *id = can_filter_word(e, e->id);
+        *mask = can_filter_word(e, e->mask) | CAN_FILTER_WORD_IDE;
+    }
+    else
+    {
+        *id = can_filter_half(e, e->id);
+        *mask = can_filter_half(e, e->mask) | CAN_FILTER_HALF_IDE;
+    }
+}
+
+/* Fills the banks from the filters, by FIFO and kind. */
+static void can_filter_layout(can_filter_plan_t *plan)
+{
+    can_filter_bank_t *bank = NULL;
+    uint32_t slot = 0U;
+    uint32_t spare;
+    uint32_t fifo;
+    uint32_t kind;
+    uint32_t i;
+    uint32_t id;
+    uint32_t mask;
+
+    (void)memset(plan->banks, 0, sizeof(plan->banks));
+    plan->bank_count = 0U;
+    for (fifo = 0U; fifo < 2U; fifo++)
+    {
+        for (kind = 0U; kind < CAN_FILTER_KINDS; kind++)
+        {
+            /* after an odd number of 16-bit masks, the first identifier goes
+             * to the free half of the last mask bank */
+            spare = ((kind == CAN_FILTER_STD_LIST) && (slot == 1U)) ? 1U : 0U;
+            slot = can_filter_per_bank[kind];
+            for (i = 0U; i < plan->entry_count; i++)
+            {
+                if ((plan->entries[i].fifo != fifo) || (can_filter_kind(&plan->entries[i]) != kind))
+                {
+                    continue;
+                }
+                can_filter_encode(&plan->entries[i], kind, &id, &mask);
+                if (spare != 0U)
+                {
+                    bank->fr2 = id | (mask << 16U);
+                    bank->entry[1] = (uint8_t)i;
+                    spare = 0U;
+                    continue;
+                }
+                if (slot == can_filter_per_bank[kind])
+                {
+                    /* a new bank, its free slots repeat the first filter */
+                    bank = &plan->banks[plan->bank_count++];
+                    bank->scale = (kind < CAN_FILTER_STD_MASK) ? CAN_FILTERSCALE_32BIT : CAN_FILTERSCALE_16BIT;
+                    bank->mode = ((kind == CAN_FILTER_EXT_LIST) || (kind == CAN_FILTER_STD_LIST))
+                                     ? CAN_FILTERMODE_IDLIST
+                                     : CAN_FILTERMODE_IDMASK;
+                    bank->fifo = (uint8_t)fifo;
+                    bank->filters = can_filter_per_bank[kind];
+                    (void)memset(bank->entry, (int)i, sizeof(bank->entry));
+                    slot = 0U;
+                    switch (kind)
+                    {
+                    case CAN_FILTER_EXT_LIST:
+                    case CAN_FILTER_EXT_MASK:
+                        bank->fr1 = id;
+                        bank->fr2 = (kind == CAN_FILTER_EXT_LIST) ? id : mask;
+                        break;
+                    case CAN_FILTER_STD_LIST:
+                        bank->fr1 = id | (id << 16U);
+                        bank->fr2 = bank->fr1;
+                        break;
+                    default:
+                        bank->fr1 = id | (mask << 16U);
+                        bank->fr2 = bank->fr1;
+                        break;
+                    }
+                }
+                switch (kind)
+                {
+                case CAN_FILTER_EXT_LIST:
+                    bank->fr2 = (slot == 1U) ? id : bank->fr2;
+                    break;
+                case CAN_FILTER_STD_LIST:
+                    if (slot == 1U)
+                    {
+                        bank->fr1 = (bank->fr1 & 0xFFFFU) | (id << 16U);
+                    }
+                    else if (slot == 2U)
+                    {
+                        bank->fr2 = (bank->fr2 & 0xFFFF0000U) | id;
+                    }
+                    else if (slot == 3U)
+                    {
+                        bank->fr2 = (bank->fr2 & 0xFFFFU) | (id << 16U);
+                    }
+                    break;
+                case CAN_FILTER_STD_MASK:
+                    bank->fr2 = (slot == 1U) ? (id | (mask << 16U)) : bank->fr2;
+                    break;
+                default:
+                    break;
+                }
+                bank->entry[slot] = (uint8_t)i;
+                slot++;
+            }
+        }
+    }
+}
+
+HAL_StatusTypeDef can_filter_plan(const can_filter_range_t ranges[], uint32_t count, uint32_t banks,
+                                  can_filter_plan_t *plan)
+{
+    uint32_t i;
+    uint32_t j;
+
+    plan->entry_count = 0U;
+    plan->bank_count = 0U;
+    plan->false_accepts = 0U;
+    if (banks > CAN_FILTER_BANKS)
+    {
+        return HAL_ERROR;
+    }
+    for (i = 0U; i < count; i++)
+    {
+        if ((ranges[i].first > ranges[i].last) || (ranges[i].last > can_filter_all(ranges[i].ide))
+            || (ranges[i].fifo > CAN_RX_FIFO1))
+        {
+            return HAL_ERROR;
+        }
+        for (j = 0U; j < i; j++)
+        {
+            if ((ranges[j].ide == ranges[i].ide) && (ranges[j].first <= ranges[i].last)
+                && (ranges[i].first <= ranges[j].last))
+            {
+                return HAL_ERROR;
+            }
+        }
+        if (can_filter_split(&ranges[i], plan) != HAL_OK)
+        {
+            return HAL_ERROR;
+        }
+    }
+
+    while (can_filter_banks_needed(plan) > banks)
+    {
+        if (can_filter_merge_best(plan, ranges, count) != HAL_OK)
+        {
+            return HAL_ERROR;
+        }
+    }
+
+    for (i = 0U; i < plan->entry_count; i++)
+    {
+        plan->false_accepts += can_filter_false(&plan->entries[i], ranges, count);
+    }
+    can_filter_layout(plan);
+    return HAL_OK;
+}
+
+uint32_t can_filter_match(const can_filter_plan_t *plan, uint32_t id, uint32_t ide, uint32_t *fifo)
+{
+    const can_filter_bank_t *bank;
+    const uint32_t word = (ide != 0U) ? ((id << 3U) | CAN_FILTER_WORD_IDE) : (id << 21U);
+    const uint32_t half = (ide != 0U) ? (((id >> 18U) << 5U) | CAN_FILTER_HALF_IDE | ((id >> 15U) & 7U)) : (id << 5U);
+    uint32_t best_rank = 4U;
+    uint32_t rank;
+    uint32_t hit;
+    uint32_t b;
+
+    /* 32-bit before 16-bit scale, list before mask, then the lowest bank */
+    for (b = 0U; b < plan->bank_count; b++)
+    {
+        bank = &plan->banks[b];
+        rank = ((bank->scale == CAN_FILTERSCALE_32BIT) ? 0U : 2U) + ((bank->mode == CAN_FILTERMODE_IDLIST) ? 0U : 1U);
+        if (rank >= best_rank)
+        {
+            continue;
+        }
+        if (bank->scale == CAN_FILTERSCALE_32BIT)
+        {
+            hit = (bank->mode == CAN_FILTERMODE_IDLIST) ? ((word == bank->fr1) || (word == bank->fr2))
+                                                        : (((word ^ bank->fr1) & bank->fr2) == 0U);
+        }
+        else if (bank->mode == CAN_FILTERMODE_IDLIST)
+        {
+            hit = (half == (bank->fr1 & 0xFFFFU)) || (half == (bank->fr1 >> 16U)) || (half == (bank->fr2 & 0xFFFFU))
+                  || (half == (bank->fr2 >> 16U));
+        }
+        else
+        {
+            hit = (((half ^ bank->fr1) & (bank->fr1 >> 16U) & 0xFFFFU) == 0U)
+                  || (((half ^ bank->fr2) & (bank->fr2 >> 16U) & 0xFFFFU) == 0U);
+        }
+        if (hit != 0U)
+        {
+            best_rank = rank;
+            *fifo = bank->fifo;
+        }
+    }
+    return (best_rank < 4U) ? 1U : 0U;
+}
+
+HAL_StatusTypeDef can_filter_program(CAN_HandleTypeDef *hcan, const can_filter_plan_t *plan)
+{
+    CAN_FilterTypeDef filter;
+    const can_filter_bank_t *bank;
+    uint32_t b;
+
+    for (b = 0U; b < CAN_FILTER_BANKS; b++)
+    {
+        bank = &plan->banks[(b < plan->bank_count) ? b : 0U];
+        filter.FilterBank = b;
+        filter.FilterMode = bank->mode;
+        filter.FilterScale = bank->scale;
+        filter.FilterFIFOAssignment = bank->fifo;
+        if (bank->scale == CAN_FILTERSCALE_32BIT)
+        {
+            filter.FilterIdHigh = bank->fr1 >> 16U;
+            filter.FilterIdLow = bank->fr1 & 0xFFFFU;
+            filter.FilterMaskIdHigh = bank->fr2 >> 16U;
+            filter.FilterMaskIdLow = bank->fr2 & 0xFFFFU;
+        }
+        else
+        {
+            /* FR1 is the first mask:identifier, FR2 the second */
+            filter.FilterIdLow = bank->fr1 & 0xFFFFU;
+            filter.FilterMaskIdLow = bank->fr1 >> 16U;
+            filter.FilterIdHigh = bank->fr2 & 0xFFFFU;
+            filter.FilterMaskIdHigh = bank->fr2 >> 16U;
+        }
+        filter.FilterActivation = (b < plan->bank_count) ? CAN_FILTER_ENABLE : CAN_FILTER_DISABLE;
+        filter.SlaveStartFilterBank = CAN_FILTER_BANKS;
+        if (HAL_CAN_ConfigFilter(hcan, &filter) != HAL_OK)
+        {
+            return HAL_ERROR;
+        }
+    }
+    return HAL_OK;
+}
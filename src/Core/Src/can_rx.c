@@ -0,0 +1,213 @@
+/**
+ ******************************************************************************
+ * @file           : can_rx.c
+ * @brief          : CAN RX ring from the FIFO interrupts to one task
+ ******************************************************************************
+ * A single-producer, single-consumer ring.  head and tail run free and are
+ * masked on access: the interrupts alone write head, the task alone writes
+ * tail, so neither side needs a critical section.  The interrupt publishes
+ * its frames by storing head with release, the task frees a slot by storing
+ * tail with release.
+ *
+ * The interrupt does not go through HAL_CAN_GetRxMessage(), which decodes
+ * one frame per call field by field.  It copies the four words of the output
+ * mailbox (RIR, RDTR, RDLR, RDHR) as they are and releases the mailbox, for
+ * every frame pending in the FIFO; the task decodes them in can_rx_receive().
+ * Under load one interrupt entry takes the frames that arrived meanwhile.
+ *
+ * The task that waits puts its handle in can_rx_waiter before it checks the
+ * ring a last time; the interrupt takes the handle after publishing the
+ * frames and notifies it.  A notification that arrives after the task found
+ * the frame by itself only makes the next wait return early, and the loop of
+ * can_rx_receive() checks the ring again.
+ ******************************************************************************
+ */
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "can_rx.h"
+#include "can_stats.h"
+
+#if (CAN_RX_QUEUE_SIZE & (CAN_RX_QUEUE_SIZE - 1U)) != 0U
+#error "CAN_RX_QUEUE_SIZE must be a power of two"
+#endif
+
+/* RFOM is cleared by the hardware once the next frame is in the output
+ * mailbox.  The host model only sees a register write at its next sync. */
+#if defined(USE_HOST_SIM)
+#define CAN_RX_RELEASE_WAIT()           host_periph_sync()
+#else
+#define CAN_RX_RELEASE_WAIT()
+#endif
+
+/* The output mailbox as read, decoded by the task */
+typedef struct
+{
+    uint32_t rir;
+    uint32_t rdtr;
+    uint32_t rdlr;
+    uint32_t rdhr;
+    uint32_t tick;
+    uint32_t fifo;
+} can_rx_entry_t;
+
+static can_rx_entry_t can_rx_ring[CAN_RX_QUEUE_SIZE];
+static uint32_t can_rx_head;            /* written by the interrupts */
+static uint32_t can_rx_tail;            /* written by the task */
+static TaskHandle_t can_rx_waiter;
+static volatile uint32_t can_rx_lost;
+static can_rx_hook_t can_rx_hook;
+
+void can_rx_init(CAN_HandleTypeDef *hcan)
+{
+    (void)HAL_CAN_ActivateNotification(hcan, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING);
+}
+
+uint32_t can_rx_pending(void)
+{
+    return __atomic_load_n(&can_rx_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&can_rx_tail, __ATOMIC_RELAXED);
+}
+
+uint32_t can_rx_dropped(void)
+{
+    return can_rx_lost;
+}
+
+void can_rx_set_hook(can_rx_hook_t hook)
+{
+    can_rx_hook = hook;
+}
+
+static void can_rx_decode(const can_rx_entry_t *entry, can_rx_frame_t *frame)
+{
+    uint32_t i;
+
+    frame->ide = ((entry->rir & CAN_RI0R_IDE) != 0U) ? 1U : 0U;
+    frame->id = (frame->ide != 0U) ? (entry->rir >> CAN_RI0R_EXID_Pos) : (entry->rir >> CAN_RI0R_STID_Pos);
+    frame->rtr = ((entry->rir & CAN_RI0R_RTR) != 0U) ? 1U : 0U;
+    frame->dlc = (uint8_t)(entry->rdtr & CAN_RDT0R_DLC);
+    frame->filter = (uint8_t)((entry->rdtr & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos);
+    frame->timestamp = (uint16_t)(entry->rdtr >> CAN_RDT0R_TIME_Pos);
+    frame->fifo = (uint8_t)entry->fifo;
+    frame->tick = entry->tick;
+    for (i = 0U; i < 4U; i++)
+    {
+        frame->data[i] = (uint8_t)(entry->rdlr >> (8U * i));
+        frame->data[4U + i] = (uint8_t)(entry->rdhr >> (8U * i));
+    }
+}
+
+/* Takes the oldest frame, 0 when the ring is empty.  Task side only. */
+static uint32_t can_rx_take(can_rx_frame_t *frame)
+{
+    uint32_t tail = can_rx_tail;
+
+    if (__atomic_load_n(&can_rx_head, __ATOMIC_ACQUIRE) == tail)
+    {
+        return 0U;
+    }
+    can_rx_decode(&can_rx_ring[tail & (CAN_RX_QUEUE_SIZE - 1U)], frame);
+    __atomic_store_n(&can_rx_tail, tail + 1U, __ATOMIC_RELEASE);
+    return 1U;
+}
+
+uint32_t can_rx_receive(can_rx_frame_t *frame, TickType_t timeout)
+{
+    TimeOut_t start;
+
+    vTaskSetTimeOutState(&start);
+    for (;;)
+    {
+        if (can_rx_take(frame) != 0U)
+        {
+            return 1U;
+        }
+        __atomic_store_n(&can_rx_waiter, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+        if (can_rx_take(frame) != 0U)
+        {
+            __atomic_store_n(&can_rx_waiter, NULL, __ATOMIC_RELAXED);
+            return 1U;
+        }
+        if (xTaskCheckForTimeOut(&start, &timeout) != pdFALSE)
+        {
+            __atomic_store_n(&can_rx_waiter, NULL, __ATOMIC_RELAXED);
+            return 0U;
+        }
+        (void)ulTaskNotifyTake(pdTRUE, timeout);
+    }
+}
+
+/* Empties one FIFO into the ring, then wakes the task.  RF0R and RF1R, and
+ * the two output mailboxes, have the same layout. */
+static void can_rx_drain(CAN_HandleTypeDef *hcan, uint32_t fifo)
+{
+    volatile uint32_t *rfr = (fifo == CAN_RX_FIFO0) ? &hcan->Instance->RF0R : &hcan->Instance->RF1R;
+    const CAN_FIFOMailBox_TypeDef *mailbox = &hcan->Instance->sFIFOMailBox[fifo];
+    const uint32_t tick = xTaskGetTickCountFromISR();
+    const uint32_t start = can_rx_head;
+    uint32_t head = start;
+    can_rx_entry_t *entry;
+    TaskHandle_t waiter;
+    BaseType_t woken = pdFALSE;
+    uint32_t rir;
+    uint32_t rdtr;
+    uint32_t rdlr;
+    uint32_t rdhr;
+
+    CAN_STATS_RX_FIFO(fifo, rfr);
+    while ((*rfr & CAN_RF0R_FMP0) != 0U)
+    {
+        rir = mailbox->RIR;
+        rdtr = mailbox->RDTR;
+        rdlr = mailbox->RDLR;
+        rdhr = mailbox->RDHR;
+        CAN_STATS_RX(rir, rdtr);
+        if ((can_rx_hook != NULL) && (can_rx_hook(rir, rdtr, rdlr, rdhr) != 0U))
+        {
+            /* taken by the hook */
+        }
+        else if ((head - __atomic_load_n(&can_rx_tail, __ATOMIC_ACQUIRE)) < CAN_RX_QUEUE_SIZE)
+        {
+            entry = &can_rx_ring[head & (CAN_RX_QUEUE_SIZE - 1U)];
+            entry->rir = rir;
+            entry->rdtr = rdtr;
+            entry->rdlr = rdlr;
+            entry->rdhr = rdhr;
+            entry->tick = tick;
+            entry->fifo = fifo;
+            head++;
+        }
+        else
+        {
+            can_rx_lost++;
+        }
+        /* FULL and FOVR are cleared by writing 1, they are left alone */
+        *rfr = CAN_RF0R_RFOM0;
+        while ((*rfr & CAN_RF0R_RFOM0) != 0U)
+        {
+            CAN_RX_RELEASE_WAIT();
+        }
+    }
+    if (head == start)
+    {
+        return;
+    }
+    __atomic_store_n(&can_rx_head, head, __ATOMIC_RELEASE);
+
+    waiter = __atomic_exchange_n(&can_rx_waiter, NULL, __ATOMIC_SEQ_CST);
+    if (waiter != NULL)
+    {
+        vTaskNotifyGiveFromISR(waiter, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
+{
+    can_rx_drain(hcan, CAN_RX_FIFO0);
+}
+
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan)
+{
+    can_rx_drain(hcan, CAN_RX_FIFO1);
+}
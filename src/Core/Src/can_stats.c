@@ -0,0 +1,201 @@
+/**
+ ******************************************************************************
+ * @file           : can_stats.c
+ * @brief          : CAN bus load and TX latency statistics
+ ******************************************************************************
+ * The worst-case length of a frame of n data bytes (0 for a remote frame) is
+ * 8n + 47 + floor((34 + 8n - 1) / 4) bits with a standard identifier and
+ * 8n + 67 + floor((54 + 8n - 1) / 4) with an extended one: the fixed fields
+ * and the 3-bit interframe space, plus one stuff bit per 4 bits of the
+ * 34 + 8n (54 + 8n) bits from SOF to the end of the CRC.  They are looked up
+ * in a table by IDE and n.
+ *
+ * The hooks run in the CAN interrupts, which have the same priority, so the
+ * counters need no lock between them; the tick interrupt and
+ * can_stats_get() take them in the critical section.
+ *
+ * The latency clock is the DWT cycle counter on the target and
+ * CLOCK_MONOTONIC on the host, like kernel_bench.c.  The bxCAN time-triggered
+ * counter (TTCM) only stamps the SOF of a frame and cannot be read by
+ * software, so the instant a frame is queued has no value in its time base.
+ ******************************************************************************
+ */
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "binlog.h"
+#include "can_stats.h"
+
+#if defined(USE_HOST_SIM)
+#include <time.h>
+#endif
+
+#define CAN_STATS_BITS(base, stuffed, n) ((base) + (8U * (n)) + (((stuffed) + (8U * (n)) - 1U) / 4U))
+#define CAN_STATS_STD(n)                CAN_STATS_BITS(47U, 34U, n)
+#define CAN_STATS_EXT(n)                CAN_STATS_BITS(67U, 54U, n)
+
+static const uint8_t can_stats_bits[2][9] = {
+    {CAN_STATS_STD(0U), CAN_STATS_STD(1U), CAN_STATS_STD(2U), CAN_STATS_STD(3U), CAN_STATS_STD(4U),
+     CAN_STATS_STD(5U), CAN_STATS_STD(6U), CAN_STATS_STD(7U), CAN_STATS_STD(8U)},
+    {CAN_STATS_EXT(0U), CAN_STATS_EXT(1U), CAN_STATS_EXT(2U), CAN_STATS_EXT(3U), CAN_STATS_EXT(4U),
+     CAN_STATS_EXT(5U), CAN_STATS_EXT(6U), CAN_STATS_EXT(7U), CAN_STATS_EXT(8U)},
+};
+
+static CAN_HandleTypeDef *can_stats_hcan;
+static can_stats_t can_stats;
+static uint32_t can_stats_frames;       /* of the second running */
+static uint32_t can_stats_bits_now;
+static TickType_t can_stats_second;     /* tick the second running started at */
+static uint32_t can_stats_per_us = 1U;
+
+#if defined(USE_HOST_SIM)
+uint32_t can_stats_clock(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec);
+}
+
+static void can_stats_clock_init(void)
+{
+    can_stats_per_us = 1000U;
+}
+#else
+uint32_t can_stats_clock(void)
+{
+    return DWT->CYCCNT;
+}
+
+static void can_stats_clock_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    can_stats_per_us = SystemCoreClock / 1000000U;
+}
+#endif
+
+void can_stats_init(CAN_HandleTypeDef *hcan)
+{
+    can_stats_hcan = hcan;
+    can_stats_clock_init();
+}
+
+/* FMP is the number of frames in the FIFO. */
+void can_stats_rx_fifo(uint32_t fifo, volatile uint32_t *rfr)
+{
+    const uint32_t rf = *rfr;
+    const uint32_t fmp = rf & CAN_RF0R_FMP0;
+
+    if (fmp > can_stats.rx_high_water[fifo])
+    {
+        can_stats.rx_high_water[fifo] = (uint8_t)fmp;
+    }
+    if ((rf & CAN_RF0R_FOVR0) != 0U)
+    {
+        can_stats.rx_overruns[fifo]++;
+        /* cleared by writing 1, RFOM and FULL are left alone */
+        *rfr = CAN_RF0R_FOVR0;
+    }
+}
+
+/* RIR and TIR, RDTR and TDTR have the same layout for IDE, RTR and DLC. */
+void can_stats_frame(uint32_t tx, uint32_t id_word, uint32_t dt_word)
+{
+    const uint32_t dlc = dt_word & CAN_RDT0R_DLC;
+    const uint32_t n = ((id_word & CAN_RI0R_RTR) != 0U) ? 0U : ((dlc < 8U) ? dlc : 8U);
+
+    can_stats_bits_now += can_stats_bits[(id_word & CAN_RI0R_IDE) >> CAN_RI0R_IDE_Pos][n];
+    can_stats_frames++;
+    if (tx != 0U)
+    {
+        can_stats.tx_frames++;
+    }
+    else
+    {
+        can_stats.rx_frames++;
+    }
+}
+
+void can_stats_tx(uint32_t tir, uint32_t tdtr, uint32_t queued)
+{
+    const uint32_t us = (can_stats_clock() - queued) / can_stats_per_us;
+    uint32_t bucket = (us == 0U) ? 0U : (32U - (uint32_t)__builtin_clz(us));
+
+    can_stats_frame(1U, tir, tdtr);
+    if (bucket >= CAN_STATS_BUCKETS)
+    {
+        bucket = CAN_STATS_BUCKETS - 1U;
+    }
+    can_stats.latency[bucket]++;
+    if (us > can_stats.latency_max_us)
+    {
+        can_stats.latency_max_us = us;
+    }
+}
+
+/* Closes the second every configTICK_RATE_HZ ticks. */
+void can_stats_tick(void)
+{
+    const TickType_t now = xTaskGetTickCountFromISR();
+    UBaseType_t mask;
+
+    /* by the tick count, the tickless idle steps over ticks */
+    if ((TickType_t)(now - can_stats_second) < configTICK_RATE_HZ)
+    {
+        return;
+    }
+    can_stats_second = now;
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    can_stats.frames_per_s = can_stats_frames;
+    can_stats.bits_per_s = can_stats_bits_now;
+    can_stats_frames = 0U;
+    can_stats_bits_now = 0U;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+void can_stats_get(can_stats_t *stats)
+{
+    const CAN_InitTypeDef *init;
+    uint32_t tq;
+    UBaseType_t mask;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    *stats = can_stats;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    stats->bit_rate = 0U;
+    stats->load_permille = 0U;
+    if (can_stats_hcan == NULL)
+    {
+        return;
+    }
+    /* the segments are kept in their BTR encoding, length - 1 */
+    init = &can_stats_hcan->Init;
+    tq = 1U + ((init->TimeSeg1 >> CAN_BTR_TS1_Pos) + 1U) + ((init->TimeSeg2 >> CAN_BTR_TS2_Pos) + 1U);
+    stats->bit_rate = HAL_RCC_GetPCLK1Freq() / (init->Prescaler * tq);
+    if (stats->bit_rate != 0U)
+    {
+        stats->load_permille = (uint32_t)(((uint64_t)stats->bits_per_s * 1000U) / stats->bit_rate);
+    }
+}
+
+void can_stats_dump(void)
+{
+    can_stats_t s;
+    const uint32_t *h = s.latency;
+
+    can_stats_get(&s);
+    /* one line fits in a log line: counts above 5 digits may be cut */
+    LOG_PRINTF("CAN load %u/1000 of %u bit/s, %u frames/s\n", (unsigned int)s.load_permille,
+               (unsigned int)s.bit_rate, (unsigned int)s.frames_per_s);
+    LOG_PRINTF("CAN rx %u tx %u fifo hwm %u/%u overruns %u/%u\n", (unsigned int)s.rx_frames,
+               (unsigned int)s.tx_frames, (unsigned int)s.rx_high_water[0], (unsigned int)s.rx_high_water[1],
+               (unsigned int)s.rx_overruns[0], (unsigned int)s.rx_overruns[1]);
+    LOG_PRINTF("CAN tx latency max %u us, log2 us buckets:\n", (unsigned int)s.latency_max_us);
+    LOG_PRINTF(" 0-7: %u %u %u %u %u %u %u %u\n", (unsigned int)h[0], (unsigned int)h[1], (unsigned int)h[2],
+               (unsigned int)h[3], (unsigned int)h[4], (unsigned int)h[5], (unsigned int)h[6], (unsigned int)h[7]);
+    LOG_PRINTF(" 8-15: %u %u %u %u %u %u %u %u\n", (unsigned int)h[8], (unsigned int)h[9], (unsigned int)h[10],
+               (unsigned int)h[11], (unsigned int)h[12], (unsigned int)h[13], (unsigned int)h[14],
+               (unsigned int)h[15]);
+}
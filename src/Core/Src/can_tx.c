@@ -0,0 +1,413 @@
+/**
+ ******************************************************************************
+ * @file           : can_tx.c
+ * @brief          : CAN TX priority queue behind the three bxCAN mailboxes
+ ******************************************************************************
+ * The queue is a binary heap.  The key of a frame is its identifier word in
+ * the TIR layout (STID, EXID, IDE, RTR), which compares like the arbitration
+ * on the bus; the sequence number keeps frames of equal key in call order.
+ *
+ * The heap and the copies of the frames in the mailboxes are shared with the
+ * interrupt inside taskENTER_CRITICAL_FROM_ISR(), like console.c.
+ *
+ * HAL_CAN_IRQHandler() reports the sent mailboxes one by one but the lost
+ * ones together at the end, in HAL_CAN_ErrorCallback().  No mailbox is
+ * refilled while one waits for its report, so the copy of a frame that lost
+ * the arbitration is still there to be queued again, in its place.
+ *
+ * A frame of the source is not copied: load() writes the data words that go
+ * to the mailbox.  A lost one is not queued either, the source keeps it until
+ * done() says it was sent.
+ ******************************************************************************
+ */
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "can_tx.h"
+#include "can_stats.h"
+
+#define CAN_TX_MAILBOXES                3U
+
+#define CAN_TX_ERROR_ALST               (HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_ALST1 | HAL_CAN_ERROR_TX_ALST2)
+#define CAN_TX_ERROR_TERR               (HAL_CAN_ERROR_TX_TERR0 | HAL_CAN_ERROR_TX_TERR1 | HAL_CAN_ERROR_TX_TERR2)
+
+typedef struct
+{
+    uint32_t key;           /* identifier, IDE and RTR in the TIR layout */
+    uint32_t seq;           /* call order */
+    uint8_t dlc;
+    uint8_t global_time;
+    uint8_t data[8];
+#if defined(USE_CAN_STATS)
+    uint32_t queued;        /* can_stats_clock() at can_tx_send() */
+#endif
+} can_tx_entry_t;
+
+static CAN_HandleTypeDef *can_tx_hcan;
+/* room for the frames of the mailboxes, which may come back */
+static can_tx_entry_t can_tx_heap[CAN_TX_QUEUE_SIZE + CAN_TX_MAILBOXES];
+static uint32_t can_tx_count;
+static uint32_t can_tx_seq;
+static can_tx_entry_t can_tx_mailbox[CAN_TX_MAILBOXES];
+static uint32_t can_tx_busy;    /* CAN_TX_MAILBOXx not reported yet */
+static const can_tx_source_t *can_tx_source;
+static uint32_t can_tx_source_busy;     /* CAN_TX_MAILBOXx of the frame of the source */
+#if defined(USE_CAN_STATS)
+static uint32_t can_tx_queued[CAN_TX_MAILBOXES];
+#endif
+static volatile uint32_t can_tx_lost;
+static volatile uint32_t can_tx_errors;
+
+uint32_t can_tx_pending(void)
+{
+    return can_tx_count;
+}
+
+uint32_t can_tx_dropped(void)
+{
+    return can_tx_lost;
+}
+
+uint32_t can_tx_failed(void)
+{
+    return can_tx_errors;
+}
+
+static uint32_t can_tx_before(const can_tx_entry_t *a, const can_tx_entry_t *b)
+{
+    if (a->key != b->key)
+    {
+        return (a->key < b->key) ? 1U : 0U;
+    }
+    return ((int32_t)(a->seq - b->seq) < 0) ? 1U : 0U;
+}
+
+/* Called in the critical section, with room in the heap. */
+static void can_tx_push(const can_tx_entry_t *entry)
+{
+    uint32_t i = can_tx_count++;
+    uint32_t parent;
+
+    while (i > 0U)
+    {
+        parent = (i - 1U) / 2U;
+        if (can_tx_before(entry, &can_tx_heap[parent]) == 0U)
+        {
+            break;
+        }
+        can_tx_heap[i] = can_tx_heap[parent];
+        i = parent;
+    }
+    can_tx_heap[i] = *entry;
+}
+
+/* Called in the critical section, with a frame in the heap. */
+static void can_tx_pop(can_tx_entry_t *entry)
+{
+    const can_tx_entry_t *last;
+    uint32_t i = 0U;
+    uint32_t child;
+
+    *entry = can_tx_heap[0];
+    last = &can_tx_heap[--can_tx_count];
+    for (;;)
+    {
+        child = (2U * i) + 1U;
+        if (child >= can_tx_count)
+        {
+            break;
+        }
+        if (((child + 1U) < can_tx_count) && (can_tx_before(&can_tx_heap[child + 1U], &can_tx_heap[child]) != 0U))
+        {
+            child++;
+        }
+        if (can_tx_before(&can_tx_heap[child], last) == 0U)
+        {
+            break;
+        }
+        can_tx_heap[i] = can_tx_heap[child];
+        i = child;
+    }
+    can_tx_heap[i] = *last;
+}
+
+/* Mailbox for the next frame: an empty one whose last frame has been
+ * reported.  -1 when there is none or when a mailbox is empty but not
+ * reported yet, e.g. it lost the arbitration right after the request. */
+static int32_t can_tx_free_mailbox(void)
+{
+    int32_t free = -1;
+    uint32_t m;
+
+    for (m = 0U; m < CAN_TX_MAILBOXES; m++)
+    {
+        if (HAL_CAN_IsTxMessagePending(can_tx_hcan, CAN_TX_MAILBOX0 << m) != 0U)
+        {
+            continue;
+        }
+        if ((can_tx_busy & (CAN_TX_MAILBOX0 << m)) != 0U)
+        {
+            return -1;
+        }
+        if (free < 0)
+        {
+            free = (int32_t)m;
+        }
+    }
+    return free;
+}
+
+/* Moves frames from the source and the heap to the free mailboxes, until a
+ * mailbox waits for its callback.  Called in the critical section.
+ *
+ * The mailbox is written here rather than by HAL_CAN_AddTxMessage(), which
+ * takes the mailbox of TSR.CODE: that may be one that went empty after the
+ * check above, and its request would clear the ALST the callback has not
+ * seen yet. */
+static void can_tx_refill(void)
+{
+    CAN_TxMailBox_TypeDef *mailbox;
+    can_tx_entry_t *entry;
+    uint32_t source;
+    uint32_t tdlr;
+    uint32_t tdhr;
+    int32_t m;
+
+    if (HAL_CAN_GetState(can_tx_hcan) != HAL_CAN_STATE_LISTENING)
+    {
+        return;
+    }
+    for (;;)
+    {
+        m = can_tx_free_mailbox();
+        if (m < 0)
+        {
+            break;
+        }
+        source = ((can_tx_source != NULL) && (can_tx_source_busy == 0U)) ? can_tx_source->peek()
+                                                                          : CAN_TX_SOURCE_IDLE;
+        mailbox = &can_tx_hcan->Instance->sTxMailBox[m];
+        if ((source != CAN_TX_SOURCE_IDLE) && ((can_tx_count == 0U) || (source < can_tx_heap[0].key)))
+        {
+            can_tx_source_busy = CAN_TX_MAILBOX0 << (uint32_t)m;
+            can_tx_busy |= can_tx_source_busy;
+#if defined(USE_CAN_STATS)
+            can_tx_queued[m] = can_stats_clock();
+#endif
+            mailbox->TIR = source;
+            mailbox->TDTR = can_tx_source->load(&tdlr, &tdhr);
+            mailbox->TDLR = tdlr;
+            mailbox->TDHR = tdhr;
+            mailbox->TIR |= CAN_TI0R_TXRQ;
+            continue;
+        }
+        if (can_tx_count == 0U)
+        {
+            break;
+        }
+        entry = &can_tx_mailbox[m];
+        can_tx_pop(entry);
+        can_tx_busy |= CAN_TX_MAILBOX0 << (uint32_t)m;
+#if defined(USE_CAN_STATS)
+        can_tx_queued[m] = entry->queued;
+#endif
+
+        mailbox->TIR = entry->key;
+        mailbox->TDTR = entry->dlc | ((entry->global_time != 0U) ? CAN_TDT0R_TGT : 0U);
+        mailbox->TDLR = (uint32_t)entry->data[0] | ((uint32_t)entry->data[1] << 8U)
+                        | ((uint32_t)entry->data[2] << 16U) | ((uint32_t)entry->data[3] << 24U);
+        mailbox->TDHR = (uint32_t)entry->data[4] | ((uint32_t)entry->data[5] << 8U)
+                        | ((uint32_t)entry->data[6] << 16U) | ((uint32_t)entry->data[7] << 24U);
+        mailbox->TIR |= CAN_TI0R_TXRQ;
+    }
+}
+
+/* The mailbox of the frame of the source is free again.  Called in the
+ * critical section. */
+static void can_tx_source_done(uint32_t result)
+{
+    can_tx_source_busy = 0U;
+    if (can_tx_source != NULL)
+    {
+        can_tx_source->done(result);
+    }
+}
+
+static uint32_t can_tx_in_mailboxes(void)
+{
+    return (can_tx_busy & 1U) + ((can_tx_busy >> 1U) & 1U) + ((can_tx_busy >> 2U) & 1U);
+}
+
+void can_tx_init(CAN_HandleTypeDef *hcan)
+{
+    can_tx_hcan = hcan;
+    (void)HAL_CAN_ActivateNotification(hcan, CAN_IT_TX_MAILBOX_EMPTY);
+}
+
+void can_tx_set_source(const can_tx_source_t *source)
+{
+    UBaseType_t mask;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    can_tx_source = source;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+void can_tx_resume(void)
+{
+    UBaseType_t mask;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    can_tx_refill();
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+HAL_StatusTypeDef can_tx_send(const CAN_TxHeaderTypeDef *header, const uint8_t data[])
+{
+    HAL_StatusTypeDef status = HAL_OK;
+    can_tx_entry_t entry;
+    UBaseType_t mask;
+
+    entry.key = (header->IDE == CAN_ID_EXT) ? ((header->ExtId << CAN_TI0R_EXID_Pos) | CAN_ID_EXT)
+                                             : (header->StdId << CAN_TI0R_STID_Pos);
+    entry.key |= header->RTR & CAN_RTR_REMOTE;
+    entry.dlc = (uint8_t)header->DLC;
+    entry.global_time = (header->TransmitGlobalTime == ENABLE) ? 1U : 0U;
+    memset(entry.data, 0, sizeof(entry.data));
+    if (data != NULL)
+    {
+        memcpy(entry.data, data, (header->DLC < 8U) ? header->DLC : 8U);
+    }
+#if defined(USE_CAN_STATS)
+    entry.queued = can_stats_clock();
+#endif
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    if ((can_tx_count + can_tx_in_mailboxes()) >= (CAN_TX_QUEUE_SIZE + CAN_TX_MAILBOXES))
+    {
+        can_tx_lost++;
+        status = HAL_ERROR;
+    }
+    else
+    {
+        entry.seq = can_tx_seq++;
+        can_tx_push(&entry);
+        can_tx_refill();
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    return status;
+}
+
+/* A mailbox is free again: sent, or aborted without an error. */
+static void can_tx_mailbox_done(CAN_HandleTypeDef *hcan, uint32_t mailbox, uint32_t sent)
+{
+    UBaseType_t mask;
+
+    if (hcan != can_tx_hcan)
+    {
+        return;
+    }
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    if (sent == 0U)
+    {
+        can_tx_errors++;
+    }
+    else
+    {
+        /* CAN_TX_MAILBOX0..2 are 1, 2 and 4 */
+        CAN_STATS_TX(hcan->Instance->sTxMailBox[mailbox >> 1U].TIR, hcan->Instance->sTxMailBox[mailbox >> 1U].TDTR,
+                     can_tx_queued[mailbox >> 1U]);
+    }
+    can_tx_busy &= ~mailbox;
+    if ((can_tx_source_busy & mailbox) != 0U)
+    {
+        can_tx_source_done((sent != 0U) ? CAN_TX_SOURCE_SENT : CAN_TX_SOURCE_FAILED);
+    }
+    can_tx_refill();
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+    can_tx_mailbox_done(hcan, CAN_TX_MAILBOX0, 1U);
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+    can_tx_mailbox_done(hcan, CAN_TX_MAILBOX1, 1U);
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan)
+{
+    can_tx_mailbox_done(hcan, CAN_TX_MAILBOX2, 1U);
+}
+
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan)
+{
+    can_tx_mailbox_done(hcan, CAN_TX_MAILBOX0, 0U);
+}
+
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan)
+{
+    can_tx_mailbox_done(hcan, CAN_TX_MAILBOX1, 0U);
+}
+
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan)
+{
+    can_tx_mailbox_done(hcan, CAN_TX_MAILBOX2, 0U);
+}
+
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)
+{
+    uint32_t errors = hcan->ErrorCode & (CAN_TX_ERROR_ALST | CAN_TX_ERROR_TERR);
+    UBaseType_t mask;
+    uint32_t m;
+
+    if ((hcan != can_tx_hcan) || (errors == 0U))
+    {
+        return;
+    }
+    /* the HAL only ever adds to ErrorCode */
+    hcan->ErrorCode &= ~(CAN_TX_ERROR_ALST | CAN_TX_ERROR_TERR);
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    for (m = 0U; m < CAN_TX_MAILBOXES; m++)
+    {
+        /* ALSTm and TERRm are bits 11 + 2m and 12 + 2m, the HAL tests ALST
+         * first */
+        if ((can_tx_busy & (CAN_TX_MAILBOX0 << m)) == 0U)
+        {
+            continue;
+        }
+        if ((errors & (HAL_CAN_ERROR_TX_ALST0 << (2U * m))) != 0U)
+        {
+            if (can_tx_source_busy == (CAN_TX_MAILBOX0 << m))
+            {
+                can_tx_source_done(CAN_TX_SOURCE_LOST);
+            }
+            else
+            {
+                /* same seq: back in its place among equal identifiers */
+                can_tx_push(&can_tx_mailbox[m]);
+            }
+        }
+        else if ((errors & (HAL_CAN_ERROR_TX_TERR0 << (2U * m))) != 0U)
+        {
+            can_tx_errors++;
+            if (can_tx_source_busy == (CAN_TX_MAILBOX0 << m))
+            {
+                can_tx_source_done(CAN_TX_SOURCE_FAILED);
+            }
+        }
+        else
+        {
+            continue;
+        }
+        can_tx_busy &= ~(CAN_TX_MAILBOX0 << m);
+    }
+    can_tx_refill();
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
@@ -0,0 +1,213 @@
+/**
+ ******************************************************************************
+ * @file           : console.c
+ * @brief          : Buffered printf console on USART1, drained by DMA
+ ******************************************************************************
+ * head and tail run freely and are masked on access.  The bytes between tail
+ * and tail + console_dma_len are owned by the DMA until its TX complete
+ * callback, the rest up to head are waiting for the next chunk.  A chunk
+ * never wraps, a wrapped buffer goes out in two transfers.
+ *
+ * Writers and the callback share the indexes inside
+ * taskENTER_CRITICAL_FROM_ISR(), which works the same from tasks and from
+ * interrupts of FreeRTOS-safe priority.
+ ******************************************************************************
+ */
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "console.h"
+
+#define CONSOLE_MASK                    (CONSOLE_BUFFER_SIZE - 1U)
+
+#if (CONSOLE_BUFFER_SIZE & CONSOLE_MASK) != 0U
+#error "CONSOLE_BUFFER_SIZE must be a power of 2"
+#endif
+
+extern UART_HandleTypeDef huart1;
+
+static uint8_t console_buffer[CONSOLE_BUFFER_SIZE];
+static volatile uint32_t console_head;
+static volatile uint32_t console_tail;
+static volatile uint32_t console_dma_len;
+static volatile uint32_t console_waiters;
+static volatile uint32_t console_lost;
+static console_full_policy_t console_policy = CONSOLE_FULL_POLICY;
+static SemaphoreHandle_t console_space;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static StaticSemaphore_t console_space_buffer;
+#endif
+
+void console_init(void)
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    console_space = xSemaphoreCreateBinaryStatic(&console_space_buffer);
+#else
+    console_space = xSemaphoreCreateBinary();
+#endif
+}
+
+void console_set_full_policy(console_full_policy_t policy)
+{
+    console_policy = policy;
+}
+
+uint32_t console_dropped(void)
+{
+    return console_lost;
+}
+
+/* Starts the next chunk when the DMA is idle.  Called in the critical
+ * section. */
+static void console_kick(void)
+{
+    uint32_t start;
+    uint32_t len;
+
+    if ((console_dma_len != 0U) || (console_head == console_tail))
+    {
+        return;
+    }
+
+    start = console_tail & CONSOLE_MASK;
+    len = console_head - console_tail;
+    if (len > (CONSOLE_BUFFER_SIZE - start))
+    {
+        len = CONSOLE_BUFFER_SIZE - start;
+    }
+
+    console_dma_len = len;
+    if (HAL_UART_Transmit_DMA(&huart1, &console_buffer[start], (uint16_t)len) != HAL_OK)
+    {
+        /* retried by the next write */
+        console_dma_len = 0U;
+    }
+}
+
+/* Drops the n oldest bytes the DMA does not own yet, the newer ones move
+ * down.  Called in the critical section. */
+static void console_discard(uint32_t n)
+{
+    uint32_t send = console_tail + console_dma_len;
+    uint32_t keep = console_head - send - n;
+    uint32_t i;
+
+    for (i = 0U; i < keep; i++)
+    {
+        console_buffer[(send + i) & CONSOLE_MASK] = console_buffer[(send + n + i) & CONSOLE_MASK];
+    }
+    console_head -= n;
+    console_lost += n;
+}
+
+/* Copies what fits.  Called in the critical section. */
+static uint32_t console_put(const char *data, uint32_t len)
+{
+    uint32_t head = console_head & CONSOLE_MASK;
+    uint32_t room = CONSOLE_BUFFER_SIZE - (console_head - console_tail);
+    uint32_t n = (len < room) ? len : room;
+    uint32_t first = ((CONSOLE_BUFFER_SIZE - head) < n) ? (CONSOLE_BUFFER_SIZE - head) : n;
+
+    memcpy(&console_buffer[head], data, first);
+    memcpy(&console_buffer[0], &data[first], n - first);
+    console_head += n;
+    return n;
+}
+
+uint32_t console_write(const char *data, uint32_t len)
+{
+    UBaseType_t mask;
+    uint32_t done = 0U;
+    uint32_t room;
+    uint32_t pending;
+    uint32_t wait = 0U;
+    uint32_t can_block;
+
+    can_block = ((console_policy == CONSOLE_FULL_BLOCK) && (console_space != NULL) && (__get_IPSR() == 0U) &&
+                 (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)) ? 1U : 0U;
+
+    for (;;)
+    {
+        mask = taskENTER_CRITICAL_FROM_ISR();
+        if (wait != 0U)
+        {
+            console_waiters--;
+        }
+
+        room = CONSOLE_BUFFER_SIZE - (console_head - console_tail);
+        if ((console_policy == CONSOLE_FULL_OVERWRITE) && ((len - done) > room))
+        {
+            pending = console_head - console_tail - console_dma_len;
+            console_discard(((len - done - room) < pending) ? (len - done - room) : pending);
+        }
+        done += console_put(&data[done], len - done);
+        console_kick();
+
+        wait = ((done < len) && (can_block != 0U)) ? 1U : 0U;
+        if (wait != 0U)
+        {
+            console_waiters++;
+        }
+        else
+        {
+            console_lost += len - done;
+        }
+
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+
+        if (wait == 0U)
+        {
+            break;
+        }
+        (void)xSemaphoreTake(console_space, portMAX_DELAY);
+    }
+    return done;
+}
+
+void console_flush(void)
+{
+    while (console_head != console_tail)
+    {
+        vTaskDelay(1U);
+    }
+}
+
+/* The chunk is out (or failed): release it and start the next one. */
+static void console_tx_done(void)
+{
+    BaseType_t woken = pdFALSE;
+    UBaseType_t mask;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    console_tail += console_dma_len;
+    console_dma_len = 0U;
+    console_kick();
+    if (console_waiters != 0U)
+    {
+        /* wakes one writer, the others wait for the next chunk */
+        (void)xSemaphoreGiveFromISR(console_space, &woken);
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    portYIELD_FROM_ISR(woken);
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart == &huart1)
+    {
+        console_tx_done();
+    }
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    /* a reception error (slcan) leaves the transmission running */
+    if ((huart == &huart1) && (huart->gState == HAL_UART_STATE_READY))
+    {
+        console_tx_done();
+    }
+}
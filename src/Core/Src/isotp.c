@@ -0,0 +1,584 @@
+/**
+ ******************************************************************************
+ * @file           : isotp.c
+ * @brief          : ISO-TP (ISO 15765-2) transport over the CAN link
+ ******************************************************************************
+ * The state of both directions is shared by the TX and FIFO interrupts, the
+ * tick interrupt and the tasks, inside taskENTER_CRITICAL_FROM_ISR() like
+ * can_tx.c.  The TX source callbacks already run in the critical section of
+ * can_tx.c.
+ *
+ * The sender has one frame in a mailbox at a time (see can_tx.h) and only
+ * moves on when done() reports it sent: a lost arbitration loads the same
+ * frame again.  A frame is packed into the two data words of the mailbox
+ * from the buffer of the caller, byte by byte into a 64-bit value, and
+ * unpacked the same way on the receiving side.
+ *
+ * The flow control frames are small and go through the queue of
+ * can_tx_send(), which is ISR safe.
+ *
+ * The task waiting for the end of a transfer puts its handle in the waiter
+ * of that direction before it checks the result a last time, like
+ * can_rx_receive().
+ ******************************************************************************
+ */
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "can_tx.h"
+#include "can_rx.h"
+#include "isotp.h"
+
+/* Protocol control information, high nibble of the first byte */
+#define ISOTP_PCI_SF                    0x00U
+#define ISOTP_PCI_FF                    0x10U
+#define ISOTP_PCI_CF                    0x20U
+#define ISOTP_PCI_FC                    0x30U
+
+/* Flow status */
+#define ISOTP_FS_CTS                    0U
+#define ISOTP_FS_WAIT                   1U
+#define ISOTP_FS_OVFLW                  2U
+
+#define ISOTP_SF_MAX                    7U
+#define ISOTP_FF_DATA                   6U
+#define ISOTP_CF_DATA                   7U
+
+#define ISOTP_PADDING64                 (0x0101010101010101ULL * ISOTP_PADDING)
+
+/* Sender states */
+#define ISOTP_TX_IDLE                   0U
+#define ISOTP_TX_SEND                   1U      /* a frame is due */
+#define ISOTP_TX_WAIT_FC                2U
+#define ISOTP_TX_WAIT_ST                3U
+
+/* Receiver states */
+#define ISOTP_RX_IDLE                   0U
+#define ISOTP_RX_READY                  1U      /* buffer posted */
+#define ISOTP_RX_BUSY                   2U      /* first frame received */
+
+typedef struct
+{
+    const uint8_t *data;
+    uint32_t length;
+    uint32_t offset;        /* of the frame in the mailbox or due */
+    uint32_t state;
+    uint32_t sn;
+    uint32_t block_size;    /* of the last flow control */
+    uint32_t block_left;
+    uint32_t st_ticks;
+    TickType_t deadline;
+    HAL_StatusTypeDef result;
+    TaskHandle_t waiter;
+} isotp_tx_t;
+
+typedef struct
+{
+    uint8_t *buffer;
+    uint32_t size;
+    uint32_t length;        /* of the first frame */
+    uint32_t offset;
+    uint32_t state;
+    uint32_t sn;
+    uint32_t block_left;
+    TickType_t deadline;
+    HAL_StatusTypeDef result;
+    TaskHandle_t waiter;
+} isotp_rx_t;
+
+static uint32_t isotp_peek(void);
+static uint32_t isotp_load(uint32_t *tdlr, uint32_t *tdhr);
+static void isotp_done(uint32_t result);
+
+static const can_tx_source_t isotp_source = {isotp_peek, isotp_load, isotp_done};
+
+static isotp_config_t isotp_config;
+static uint32_t isotp_tx_key;           /* TIR layout */
+static uint32_t isotp_rx_key;           /* RIR layout, same as TIR */
+static isotp_tx_t isotp_tx;
+static isotp_rx_t isotp_rx;
+
+static uint32_t isotp_key(uint32_t id, uint32_t ide)
+{
+    return (ide != 0U) ? ((id << CAN_TI0R_EXID_Pos) | CAN_ID_EXT) : (id << CAN_TI0R_STID_Pos);
+}
+
+/* Ticks to wait after a consecutive frame for an STmin byte: at least the
+ * STmin, the current tick being partly gone.  Reserved values count as
+ * 127 ms (ISO 15765-2). */
+static uint32_t isotp_st_ticks(uint32_t st_min)
+{
+    uint32_t ms;
+
+    if (st_min == 0U)
+    {
+        return 0U;
+    }
+    if (st_min <= 0x7FU)
+    {
+        ms = st_min;
+    }
+    else if ((st_min >= 0xF1U) && (st_min <= 0xF9U))
+    {
+        ms = 1U;
+    }
+    else
+    {
+        ms = 0x7FU;
+    }
+    return pdMS_TO_TICKS(ms) + 1U;
+}
+
+static uint32_t isotp_expired(TickType_t deadline, TickType_t now)
+{
+    return ((int32_t)(now - deadline) >= 0) ? 1U : 0U;
+}
+
+/* Wakes the task waiting on a direction.  Called from interrupts. */
+static void isotp_wake(TaskHandle_t *waiter)
+{
+    TaskHandle_t task = __atomic_exchange_n(waiter, NULL, __ATOMIC_SEQ_CST);
+    BaseType_t woken = pdFALSE;
+
+    if (task != NULL)
+    {
+        vTaskNotifyGiveFromISR(task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+/* Called in the critical section. */
+static void isotp_tx_finish(HAL_StatusTypeDef result)
+{
+    isotp_tx.state = ISOTP_TX_IDLE;
+    __atomic_store_n(&isotp_tx.result, result, __ATOMIC_RELEASE);
+    isotp_wake(&isotp_tx.waiter);
+}
+
+/* Called in the critical section. */
+static void isotp_rx_finish(HAL_StatusTypeDef result)
+{
+    isotp_rx.state = ISOTP_RX_IDLE;
+    __atomic_store_n(&isotp_rx.result, result, __ATOMIC_RELEASE);
+    isotp_wake(&isotp_rx.waiter);
+}
+
+static uint32_t isotp_peek(void)
+{
+    return (isotp_tx.state == ISOTP_TX_SEND) ? isotp_tx_key : CAN_TX_SOURCE_IDLE;
+}
+
+/* The frame at isotp_tx.offset: PCI of pci_bytes, then count bytes of the
+ * message, then padding. */
+static uint32_t isotp_load(uint32_t *tdlr, uint32_t *tdhr)
+{
+    const uint8_t *data = &isotp_tx.data[isotp_tx.offset];
+    const uint32_t left = isotp_tx.length - isotp_tx.offset;
+    uint64_t frame;
+    uint32_t pci_bytes;
+    uint32_t count;
+    uint32_t i;
+
+    if (isotp_tx.length <= ISOTP_SF_MAX)
+    {
+        frame = ISOTP_PCI_SF | isotp_tx.length;
+        pci_bytes = 1U;
+        count = isotp_tx.length;
+    }
+    else if (isotp_tx.offset == 0U)
+    {
+        frame = ISOTP_PCI_FF | (isotp_tx.length >> 8U) | ((isotp_tx.length & 0xFFU) << 8U);
+        pci_bytes = 2U;
+        count = ISOTP_FF_DATA;
+    }
+    else
+    {
+        frame = ISOTP_PCI_CF | isotp_tx.sn;
+        pci_bytes = 1U;
+        count = (left < ISOTP_CF_DATA) ? left : ISOTP_CF_DATA;
+    }
+    for (i = 0U; i < count; i++)
+    {
+        frame |= (uint64_t)data[i] << (8U * (pci_bytes + i));
+    }
+    if ((pci_bytes + count) < 8U)
+    {
+        frame |= ISOTP_PADDING64 << (8U * (pci_bytes + count));
+    }
+    *tdlr = (uint32_t)frame;
+    *tdhr = (uint32_t)(frame >> 32U);
+    return 8U;
+}
+
+static void isotp_done(uint32_t result)
+{
+    const TickType_t now = xTaskGetTickCountFromISR();
+    uint32_t left;
+
+    if (isotp_tx.state != ISOTP_TX_SEND)
+    {
+        return;
+    }
+    if (result == CAN_TX_SOURCE_LOST)
+    {
+        return;
+    }
+    if (result != CAN_TX_SOURCE_SENT)
+    {
+        isotp_tx_finish(HAL_ERROR);
+        return;
+    }
+
+    if (isotp_tx.length <= ISOTP_SF_MAX)
+    {
+        isotp_tx_finish(HAL_OK);
+        return;
+    }
+    if (isotp_tx.offset == 0U)
+    {
+        isotp_tx.offset = ISOTP_FF_DATA;
+        isotp_tx.sn = 1U;
+        isotp_tx.state = ISOTP_TX_WAIT_FC;
+        isotp_tx.deadline = now + ISOTP_TIMEOUT;
+        return;
+    }
+
+    left = isotp_tx.length - isotp_tx.offset;
+    isotp_tx.offset += (left < ISOTP_CF_DATA) ? left : ISOTP_CF_DATA;
+    isotp_tx.sn = (isotp_tx.sn + 1U) & 0x0FU;
+    if (isotp_tx.offset == isotp_tx.length)
+    {
+        isotp_tx_finish(HAL_OK);
+    }
+    else if ((isotp_tx.block_size != 0U) && (--isotp_tx.block_left == 0U))
+    {
+        isotp_tx.state = ISOTP_TX_WAIT_FC;
+        isotp_tx.deadline = now + ISOTP_TIMEOUT;
+    }
+    else if (isotp_tx.st_ticks != 0U)
+    {
+        isotp_tx.state = ISOTP_TX_WAIT_ST;
+        isotp_tx.deadline = now + isotp_tx.st_ticks;
+    }
+    else
+    {
+        /* next consecutive frame right away */
+    }
+}
+
+/* Queues a flow control frame.  Called from the FIFO interrupts. */
+static void isotp_send_fc(uint32_t flow_status)
+{
+    CAN_TxHeaderTypeDef header;
+    uint8_t data[8] = {0U, 0U, 0U, ISOTP_PADDING, ISOTP_PADDING, ISOTP_PADDING, ISOTP_PADDING, ISOTP_PADDING};
+
+    header.StdId = isotp_config.tx_id;
+    header.ExtId = isotp_config.tx_id;
+    header.IDE = (isotp_config.ide != 0U) ? CAN_ID_EXT : CAN_ID_STD;
+    header.RTR = CAN_RTR_DATA;
+    header.DLC = 8U;
+    header.TransmitGlobalTime = DISABLE;
+    data[0] = (uint8_t)(ISOTP_PCI_FC | flow_status);
+    data[1] = isotp_config.block_size;
+    data[2] = isotp_config.st_min;
+    (void)can_tx_send(&header, data);
+}
+
+/* Copies count bytes of the frame, from byte first on, to the buffer. */
+static void isotp_unpack(uint64_t frame, uint32_t first, uint32_t count)
+{
+    uint8_t *buffer = &isotp_rx.buffer[isotp_rx.offset];
+    uint32_t i;
+
+    for (i = 0U; i < count; i++)
+    {
+        buffer[i] = (uint8_t)(frame >> (8U * (first + i)));
+    }
+    isotp_rx.offset += count;
+}
+
+static void isotp_on_single(uint64_t frame, uint32_t dlc)
+{
+    const uint32_t length = (uint32_t)frame & 0x0FU;
+
+    if ((length == 0U) || (length > ISOTP_SF_MAX) || (dlc < (length + 1U)) || (isotp_rx.state == ISOTP_RX_IDLE)
+        || (length > isotp_rx.size))
+    {
+        return;
+    }
+    /* also ends a message being received */
+    isotp_rx.length = length;
+    isotp_rx.offset = 0U;
+    isotp_unpack(frame, 1U, length);
+    isotp_rx_finish(HAL_OK);
+}
+
+static void isotp_on_first(uint64_t frame, uint32_t dlc)
+{
+    const uint32_t length = (((uint32_t)frame & 0x0FU) << 8U) | ((uint32_t)(frame >> 8U) & 0xFFU);
+
+    if ((length <= ISOTP_SF_MAX) || (dlc < 8U))
+    {
+        return;
+    }
+    if ((isotp_rx.state == ISOTP_RX_IDLE) || (length > isotp_rx.size))
+    {
+        isotp_send_fc(ISOTP_FS_OVFLW);
+        return;
+    }
+    isotp_rx.state = ISOTP_RX_BUSY;
+    isotp_rx.length = length;
+    isotp_rx.offset = 0U;
+    isotp_rx.sn = 1U;
+    isotp_rx.block_left = isotp_config.block_size;
+    isotp_rx.deadline = xTaskGetTickCountFromISR() + ISOTP_TIMEOUT;
+    isotp_unpack(frame, 2U, ISOTP_FF_DATA);
+    isotp_send_fc(ISOTP_FS_CTS);
+}
+
+static void isotp_on_consecutive(uint64_t frame, uint32_t dlc)
+{
+    const uint32_t left = isotp_rx.length - isotp_rx.offset;
+    const uint32_t count = (left < ISOTP_CF_DATA) ? left : ISOTP_CF_DATA;
+
+    if (isotp_rx.state != ISOTP_RX_BUSY)
+    {
+        return;
+    }
+    if ((((uint32_t)frame & 0x0FU) != isotp_rx.sn) || (dlc < (count + 1U)))
+    {
+        isotp_rx_finish(HAL_ERROR);
+        return;
+    }
+    isotp_unpack(frame, 1U, count);
+    isotp_rx.sn = (isotp_rx.sn + 1U) & 0x0FU;
+    if (isotp_rx.offset == isotp_rx.length)
+    {
+        isotp_rx_finish(HAL_OK);
+        return;
+    }
+    isotp_rx.deadline = xTaskGetTickCountFromISR() + ISOTP_TIMEOUT;
+    if ((isotp_config.block_size != 0U) && (--isotp_rx.block_left == 0U))
+    {
+        isotp_rx.block_left = isotp_config.block_size;
+        isotp_send_fc(ISOTP_FS_CTS);
+    }
+}
+
+/* Returns 1 when the sender has a frame due again. */
+static uint32_t isotp_on_flow_control(uint64_t frame, uint32_t dlc)
+{
+    if ((isotp_tx.state != ISOTP_TX_WAIT_FC) || (dlc < 3U))
+    {
+        return 0U;
+    }
+    switch ((uint32_t)frame & 0x0FU)
+    {
+    case ISOTP_FS_CTS:
+        isotp_tx.block_size = (uint32_t)(frame >> 8U) & 0xFFU;
+        isotp_tx.block_left = isotp_tx.block_size;
+        isotp_tx.st_ticks = isotp_st_ticks((uint32_t)(frame >> 16U) & 0xFFU);
+        isotp_tx.state = ISOTP_TX_SEND;
+        return 1U;
+    case ISOTP_FS_WAIT:
+        isotp_tx.deadline = xTaskGetTickCountFromISR() + ISOTP_TIMEOUT;
+        return 0U;
+    default:
+        isotp_tx_finish(HAL_ERROR);
+        return 0U;
+    }
+}
+
+/* RX hook: takes the data frames of rx_id.  Frames of the sender (single,
+ * first, consecutive) go to the receiver, flow control to the sender. */
+static uint32_t isotp_on_frame(uint32_t rir, uint32_t rdtr, uint32_t rdlr, uint32_t rdhr)
+{
+    const uint64_t frame = (uint64_t)rdlr | ((uint64_t)rdhr << 32U);
+    const uint32_t dlc = rdtr & CAN_RDT0R_DLC;
+    uint32_t resume = 0U;
+    UBaseType_t mask;
+
+    if (((rir & (CAN_RI0R_STID | CAN_RI0R_EXID | CAN_RI0R_IDE | CAN_RI0R_RTR)) != isotp_rx_key) || (dlc == 0U))
+    {
+        return 0U;
+    }
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    switch (rdlr & 0xF0U)
+    {
+    case ISOTP_PCI_SF:
+        isotp_on_single(frame, dlc);
+        break;
+    case ISOTP_PCI_FF:
+        isotp_on_first(frame, dlc);
+        break;
+    case ISOTP_PCI_CF:
+        isotp_on_consecutive(frame, dlc);
+        break;
+    case ISOTP_PCI_FC:
+        resume = isotp_on_flow_control(frame, dlc);
+        break;
+    default:
+        break;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    if (resume != 0U)
+    {
+        can_tx_resume();
+    }
+    return 1U;
+}
+
+void isotp_init(const isotp_config_t *config)
+{
+    UBaseType_t mask;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    isotp_config = *config;
+    isotp_tx_key = isotp_key(config->tx_id, config->ide);
+    isotp_rx_key = isotp_key(config->rx_id, config->ide);
+    /* nothing to wait for yet */
+    if (isotp_tx.state == ISOTP_TX_IDLE)
+    {
+        isotp_tx.result = HAL_ERROR;
+    }
+    if (isotp_rx.state == ISOTP_RX_IDLE)
+    {
+        isotp_rx.result = HAL_ERROR;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    can_tx_set_source(&isotp_source);
+    can_rx_set_hook(isotp_on_frame);
+}
+
+HAL_StatusTypeDef isotp_send_start(const uint8_t data[], uint32_t length)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+    UBaseType_t mask;
+
+    if ((length == 0U) || (length > ISOTP_MAX_LENGTH))
+    {
+        return HAL_ERROR;
+    }
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    if (isotp_tx.state != ISOTP_TX_IDLE)
+    {
+        status = HAL_BUSY;
+    }
+    else
+    {
+        isotp_tx.data = data;
+        isotp_tx.length = length;
+        isotp_tx.offset = 0U;
+        isotp_tx.state = ISOTP_TX_SEND;
+        isotp_tx.result = HAL_BUSY;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    if (status == HAL_OK)
+    {
+        can_tx_resume();
+    }
+    return status;
+}
+
+HAL_StatusTypeDef isotp_receive_start(uint8_t buffer[], uint32_t size)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+    UBaseType_t mask;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    if (isotp_rx.state == ISOTP_RX_BUSY)
+    {
+        status = HAL_BUSY;
+    }
+    else
+    {
+        isotp_rx.buffer = buffer;
+        isotp_rx.size = size;
+        isotp_rx.state = ISOTP_RX_READY;
+        isotp_rx.result = HAL_BUSY;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    return status;
+}
+
+static HAL_StatusTypeDef isotp_wait(HAL_StatusTypeDef *result, TaskHandle_t *waiter, TickType_t timeout)
+{
+    HAL_StatusTypeDef status;
+    TimeOut_t start;
+
+    vTaskSetTimeOutState(&start);
+    for (;;)
+    {
+        status = __atomic_load_n(result, __ATOMIC_ACQUIRE);
+        if (status != HAL_BUSY)
+        {
+            return status;
+        }
+        __atomic_store_n(waiter, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+        status = __atomic_load_n(result, __ATOMIC_ACQUIRE);
+        if ((status != HAL_BUSY) || (xTaskCheckForTimeOut(&start, &timeout) != pdFALSE))
+        {
+            __atomic_store_n(waiter, NULL, __ATOMIC_RELAXED);
+            return status;
+        }
+        (void)ulTaskNotifyTake(pdTRUE, timeout);
+    }
+}
+
+HAL_StatusTypeDef isotp_send_wait(TickType_t timeout)
+{
+    return isotp_wait(&isotp_tx.result, &isotp_tx.waiter, timeout);
+}
+
+HAL_StatusTypeDef isotp_receive_wait(uint32_t *length, TickType_t timeout)
+{
+    const HAL_StatusTypeDef status = isotp_wait(&isotp_rx.result, &isotp_rx.waiter, timeout);
+
+    if (status == HAL_OK)
+    {
+        *length = isotp_rx.length;
+    }
+    return status;
+}
+
+void isotp_tick(void)
+{
+    const TickType_t now = xTaskGetTickCountFromISR();
+    uint32_t resume = 0U;
+    UBaseType_t mask;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    if ((isotp_tx.state == ISOTP_TX_WAIT_ST) && (isotp_expired(isotp_tx.deadline, now) != 0U))
+    {
+        isotp_tx.state = ISOTP_TX_SEND;
+        resume = 1U;
+    }
+    else if ((isotp_tx.state == ISOTP_TX_WAIT_FC) && (isotp_expired(isotp_tx.deadline, now) != 0U))
+    {
+        isotp_tx_finish(HAL_TIMEOUT);
+    }
+    else
+    {
+        /* sending or idle */
+    }
+    if ((isotp_rx.state == ISOTP_RX_BUSY) && (isotp_expired(isotp_rx.deadline, now) != 0U))
+    {
+        isotp_rx_finish(HAL_TIMEOUT);
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    if (resume != 0U)
+    {
+        can_tx_resume();
+    }
+}
+
+uint32_t isotp_busy(void)
+{
+    return ((isotp_tx.state == ISOTP_TX_WAIT_ST) || (isotp_tx.state == ISOTP_TX_WAIT_FC) ||
+            (isotp_rx.state == ISOTP_RX_BUSY)) ? 1U : 0U;
+}
@@ -0,0 +1,431 @@
+/**
+ ******************************************************************************
+ * @file           : kernel_bench.c
+ * @brief          : Micro-benchmarks of the FreeRTOS primitives
+ ******************************************************************************
+ * Every test times single calls, so the min column is the cost of the call
+ * itself and avg/max show what the tick and the other tasks add on top.  The
+ * cost of reading the counter is measured first and taken off every sample.
+ *
+ *  - xQueueSend/xQueueReceive:   1-item queue, nobody waiting on it.
+ *  - osSemaphoreRelease/Wait:    binary semaphore through cmsis_os.c.
+ *  - xTaskNotify:                to the calling task, no task woken.
+ *  - xTaskNotify+switch:         wakes the partner task of higher priority,
+ *                                up to the partner running.
+ *  - ulTaskNotifyTake+switch:    the partner blocks again, up to the bench
+ *                                task running.
+ *  - vTaskDelay wakeup:          from the tick that ends vTaskDelay(1) up to
+ *                                the task running.
+ *  - xTaskIncrementTick:         the tick (xPortSysTickHandler()), "+wake"
+ *                                for the ticks that unblock a task.
+ *  - TIM1 tick ISR:              the whole TIM1_UP_IRQHandler() of the
+ *                                ticks above that unblock nothing, the time
+ *                                the host spends in its register model
+ *                                taken off.
+ *  - vTaskSwitchContext:         the scheduler picking the bench task again,
+ *                                the run time stats and switch hook of
+ *                                USE_RTSTATS included.
+ ******************************************************************************
+ */
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "printf.h"
+#include "console.h"
+#include "kernel_bench.h"
+
+#if defined(USE_KERNEL_BENCH)
+
+#if defined(USE_HOST_SIM)
+#include <stdlib.h>
+#include <time.h>
+#endif
+
+#define KERNEL_BENCH_ITERATIONS         1000U
+#define KERNEL_BENCH_TICKS              100U
+#define KERNEL_BENCH_STACK_SIZE         160U
+#define KERNEL_BENCH_PARTNER_STACK_SIZE 64U
+
+typedef enum
+{
+    KERNEL_BENCH_QUEUE_SEND = 0,
+    KERNEL_BENCH_QUEUE_RECEIVE,
+    KERNEL_BENCH_SEM_RELEASE,
+    KERNEL_BENCH_SEM_WAIT,
+    KERNEL_BENCH_NOTIFY,
+    KERNEL_BENCH_NOTIFY_SWITCH,
+    KERNEL_BENCH_TAKE_SWITCH,
+    KERNEL_BENCH_DELAY_WAKEUP,
+    KERNEL_BENCH_TICK,
+    KERNEL_BENCH_TICK_WAKE,
+    KERNEL_BENCH_TICK_ISR,
+    KERNEL_BENCH_SWITCH_CONTEXT,
+    KERNEL_BENCH_COUNT
+} kernel_bench_test_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} kernel_bench_stat_t;
+
+static const char *const kernel_bench_names[KERNEL_BENCH_COUNT] =
+{
+    "xQueueSend",
+    "xQueueReceive",
+    "osSemaphoreRelease",
+    "osSemaphoreWait",
+    "xTaskNotify",
+    "xTaskNotify+switch",
+    "ulTaskNotifyTake+switch",
+    "vTaskDelay wakeup",
+    "xTaskIncrementTick",
+    "xTaskIncrementTick+wake",
+    "TIM1 tick ISR",
+    "vTaskSwitchContext",
+};
+
+static kernel_bench_stat_t kernel_bench_stats[KERNEL_BENCH_COUNT];
+static uint32_t kernel_bench_overhead;
+
+static TaskHandle_t kernel_bench_task;
+static TaskHandle_t kernel_bench_partner;
+static volatile uint32_t kernel_bench_partner_block;
+static volatile uint32_t kernel_bench_partner_wake;
+
+static volatile uint32_t kernel_bench_tick_armed;
+static volatile uint32_t kernel_bench_tick_begin;
+static volatile uint32_t kernel_bench_tick_end;
+static uint32_t kernel_bench_isr_begin;
+#if defined(USE_HOST_SIM)
+static uint64_t kernel_bench_isr_sync_ns;
+#endif
+
+osSemaphoreDef(kernel_bench_sem);
+
+#if defined(USE_HOST_SIM)
+static inline uint32_t kernel_bench_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec);
+}
+
+static uint32_t kernel_bench_counter_init(void)
+{
+    return 1U;
+}
+#else
+static inline uint32_t kernel_bench_now(void)
+{
+    return DWT->CYCCNT;
+}
+
+static uint32_t kernel_bench_counter_init(void)
+{
+    if ((DWT->CTRL & DWT_CTRL_NOCYCCNT_Msk) != 0U)
+    {
+        return 0U;
+    }
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    return 1U;
+}
+#endif
+
+static void kernel_bench_record(kernel_bench_test_t test, uint32_t start, uint32_t end)
+{
+    kernel_bench_stat_t *stat = &kernel_bench_stats[test];
+    uint32_t delta = end - start;
+
+    delta = (delta > kernel_bench_overhead) ? (delta - kernel_bench_overhead) : 0U;
+    if ((stat->count == 0U) || (delta < stat->min))
+    {
+        stat->min = delta;
+    }
+    if (delta > stat->max)
+    {
+        stat->max = delta;
+    }
+    stat->sum += delta;
+    stat->count++;
+}
+
+void kernel_bench_tick_enter(void)
+{
+    kernel_bench_tick_begin = kernel_bench_now();
+}
+
+void kernel_bench_tick_exit(void)
+{
+    kernel_bench_tick_end = kernel_bench_now();
+    if (kernel_bench_tick_armed != 0U)
+    {
+        kernel_bench_record(KERNEL_BENCH_TICK, kernel_bench_tick_begin, kernel_bench_tick_end);
+    }
+}
+
+void kernel_bench_isr_enter(void)
+{
+#if defined(USE_HOST_SIM)
+    kernel_bench_isr_sync_ns = host_periph_stats.sync_ns;
+#endif
+    kernel_bench_isr_begin = kernel_bench_now();
+}
+
+void kernel_bench_isr_exit(void)
+{
+    uint32_t end = kernel_bench_now();
+
+    if (kernel_bench_tick_armed != 0U)
+    {
+#if defined(USE_HOST_SIM)
+        /* the syncs of the HAL functions called, the host only */
+        end -= (uint32_t)(host_periph_stats.sync_ns - kernel_bench_isr_sync_ns);
+#endif
+        kernel_bench_record(KERNEL_BENCH_TICK_ISR, kernel_bench_isr_begin, end);
+    }
+}
+
+static void kernel_bench_measure_overhead(void)
+{
+    uint32_t i;
+    uint32_t t0;
+    uint32_t t1;
+
+    kernel_bench_overhead = UINT32_MAX;
+    for (i = 0U; i < KERNEL_BENCH_ITERATIONS; i++)
+    {
+        t0 = kernel_bench_now();
+        t1 = kernel_bench_now();
+        if ((t1 - t0) < kernel_bench_overhead)
+        {
+            kernel_bench_overhead = t1 - t0;
+        }
+    }
+}
+
+static void kernel_bench_queue(void)
+{
+    QueueHandle_t queue = xQueueCreate(1U, sizeof(uint32_t));
+    uint32_t item = 0U;
+    uint32_t i;
+    uint32_t t0;
+    uint32_t t1;
+
+    for (i = 0U; i < KERNEL_BENCH_ITERATIONS; i++)
+    {
+        t0 = kernel_bench_now();
+        (void)xQueueSend(queue, &i, 0U);
+        t1 = kernel_bench_now();
+        kernel_bench_record(KERNEL_BENCH_QUEUE_SEND, t0, t1);
+
+        t0 = kernel_bench_now();
+        (void)xQueueReceive(queue, &item, 0U);
+        t1 = kernel_bench_now();
+        kernel_bench_record(KERNEL_BENCH_QUEUE_RECEIVE, t0, t1);
+    }
+    vQueueDelete(queue);
+}
+
+static void kernel_bench_semaphore(void)
+{
+    osSemaphoreId sem = osSemaphoreCreate(osSemaphore(kernel_bench_sem), 1);
+    uint32_t i;
+    uint32_t t0;
+    uint32_t t1;
+
+    /* osSemaphoreCreate() gives a binary semaphore once: taken here, so that
+     * every release is timed on an empty one */
+    (void)osSemaphoreWait(sem, 0U);
+    for (i = 0U; i < KERNEL_BENCH_ITERATIONS; i++)
+    {
+        t0 = kernel_bench_now();
+        (void)osSemaphoreRelease(sem);
+        t1 = kernel_bench_now();
+        kernel_bench_record(KERNEL_BENCH_SEM_RELEASE, t0, t1);
+
+        t0 = kernel_bench_now();
+        (void)osSemaphoreWait(sem, 0U);
+        t1 = kernel_bench_now();
+        kernel_bench_record(KERNEL_BENCH_SEM_WAIT, t0, t1);
+    }
+    (void)osSemaphoreDelete(sem);
+}
+
+static void kernel_bench_partner_task(void *argument)
+{
+    (void)argument;
+
+    for (;;)
+    {
+        kernel_bench_partner_block = kernel_bench_now();
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        kernel_bench_partner_wake = kernel_bench_now();
+    }
+}
+
+static void kernel_bench_notify(void)
+{
+    uint32_t i;
+    uint32_t t0;
+    uint32_t t1;
+
+    for (i = 0U; i < KERNEL_BENCH_ITERATIONS; i++)
+    {
+        t0 = kernel_bench_now();
+        (void)xTaskNotify(kernel_bench_task, 0U, eIncrement);
+        t1 = kernel_bench_now();
+        kernel_bench_record(KERNEL_BENCH_NOTIFY, t0, t1);
+    }
+    (void)ulTaskNotifyTake(pdTRUE, 0U);
+
+    /* The partner preempts this task inside xTaskNotify() and blocks again
+     * before it returns. */
+    for (i = 0U; i < KERNEL_BENCH_ITERATIONS; i++)
+    {
+        t0 = kernel_bench_now();
+        (void)xTaskNotify(kernel_bench_partner, 0U, eIncrement);
+        t1 = kernel_bench_now();
+        kernel_bench_record(KERNEL_BENCH_NOTIFY_SWITCH, t0, kernel_bench_partner_wake);
+        kernel_bench_record(KERNEL_BENCH_TAKE_SWITCH, kernel_bench_partner_block, t1);
+    }
+}
+
+static void kernel_bench_tick(void)
+{
+    TickType_t start;
+    uint32_t i;
+    uint32_t t1;
+
+    for (i = 0U; i < KERNEL_BENCH_TICKS; i++)
+    {
+        vTaskDelay(1U);
+        t1 = kernel_bench_now();
+        kernel_bench_record(KERNEL_BENCH_DELAY_WAKEUP, kernel_bench_tick_begin, t1);
+        kernel_bench_record(KERNEL_BENCH_TICK_WAKE, kernel_bench_tick_begin, kernel_bench_tick_end);
+    }
+
+    /* Ticks while this task keeps running: mostly nothing to unblock. */
+    start = xTaskGetTickCount();
+    kernel_bench_tick_armed = 1U;
+    while ((xTaskGetTickCount() - start) < KERNEL_BENCH_TICKS)
+    {
+    }
+    kernel_bench_tick_armed = 0U;
+}
+
+static void kernel_bench_switch_context(void)
+{
+    uint32_t i;
+    uint32_t t0;
+    uint32_t t1;
+
+    /* Called like PendSV calls it, with the kernel interrupts masked.  Nothing
+     * of a higher priority is ready, so the kernel picks this task again,
+     * unless another task of its priority is ready: round robin picks that one
+     * first.  Then the sample is dropped and the kernel is called until it is
+     * back at this task, which never stopped running. */
+    for (i = 0U; i < KERNEL_BENCH_ITERATIONS; i++)
+    {
+        taskENTER_CRITICAL();
+        t0 = kernel_bench_now();
+        vTaskSwitchContext();
+        t1 = kernel_bench_now();
+        if (xTaskGetCurrentTaskHandle() == kernel_bench_task)
+        {
+            kernel_bench_record(KERNEL_BENCH_SWITCH_CONTEXT, t0, t1);
+        }
+        while (xTaskGetCurrentTaskHandle() != kernel_bench_task)
+        {
+            vTaskSwitchContext();
+        }
+        taskEXIT_CRITICAL();
+    }
+}
+
+static void kernel_bench_print(void)
+{
+    const kernel_bench_stat_t *stat;
+    uint64_t clk = SystemCoreClock;
+    uint64_t v[3];
+    uint32_t i;
+    uint32_t j;
+
+    printf("test,iterations,min_cycles,avg_cycles,max_cycles,min_ns,avg_ns,max_ns\n");
+    for (i = 0U; i < (uint32_t)KERNEL_BENCH_COUNT; i++)
+    {
+        stat = &kernel_bench_stats[i];
+        if (stat->count == 0U)
+        {
+            continue;
+        }
+        v[0] = stat->min;
+        v[1] = stat->sum / stat->count;
+        v[2] = stat->max;
+
+        printf("%s,%u", kernel_bench_names[i], (unsigned int)stat->count);
+        for (j = 0U; j < 3U; j++)
+        {
+#if defined(USE_HOST_SIM)
+            printf(",%u", (unsigned int)((v[j] * clk) / 1000000000ULL));
+#else
+            printf(",%u", (unsigned int)v[j]);
+#endif
+        }
+        for (j = 0U; j < 3U; j++)
+        {
+#if defined(USE_HOST_SIM)
+            printf(",%u", (unsigned int)v[j]);
+#else
+            printf(",%u", (unsigned int)((v[j] * 1000000000ULL) / clk));
+#endif
+        }
+        printf("\n");
+    }
+}
+
+static void kernel_bench_main_task(void *argument)
+{
+    (void)argument;
+
+    if (kernel_bench_counter_init() == 0U)
+    {
+        printf("kernel bench: no cycle counter\n");
+    }
+    else
+    {
+        kernel_bench_measure_overhead();
+        kernel_bench_queue();
+        kernel_bench_semaphore();
+        kernel_bench_notify();
+        kernel_bench_tick();
+        kernel_bench_switch_context();
+        kernel_bench_print();
+    }
+
+#if defined(USE_HOST_SIM)
+    console_flush();
+    exit(0);
+#endif
+    for (;;)
+    {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+void kernel_bench_start(void)
+{
+    (void)xTaskCreate(kernel_bench_main_task, "bench", KERNEL_BENCH_STACK_SIZE, NULL,
+                      tskIDLE_PRIORITY + 1U, &kernel_bench_task);
+    (void)xTaskCreate(kernel_bench_partner_task, "bench2", KERNEL_BENCH_PARTNER_STACK_SIZE, NULL,
+                      configMAX_PRIORITIES - 1U, &kernel_bench_partner);
+}
+
+#endif
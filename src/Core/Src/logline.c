@@ -0,0 +1,177 @@
+/**
+ ******************************************************************************
+ * @file           : logline.c
+ * @brief          : Whole-line printf logging from many tasks, without locks
+ ******************************************************************************
+ * Same ring as binlog.c: a writer reserves its record with a compare-and-swap
+ * on head, copies the text in and writes the length byte last.  Until then
+ * the drainer reads a 0 there and stops.  The drainer clears what it took
+ * before it moves tail, so a slot reads 0 until the next record in it is
+ * complete.
+ *
+ * Whoever commits a line also drains the ring, unless someone else is
+ * draining already; the drainer hands every line to console_write() in one
+ * call.
+ ******************************************************************************
+ */
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "console.h"
+#include "printf.h"
+#include "logline.h"
+
+#define LOGLINE_MASK                    (LOGLINE_BUFFER_SIZE - 1U)
+
+#if (LOGLINE_BUFFER_SIZE & LOGLINE_MASK) != 0U
+#error "LOGLINE_BUFFER_SIZE must be a power of 2"
+#endif
+
+#if (LOGLINE_SIZE < 2U) || (LOGLINE_SIZE > 256U)
+#error "LOGLINE_SIZE must be 2 .. 256, the length of a line is a byte"
+#endif
+
+#if LOGLINE_BUFFER_SIZE < LOGLINE_SIZE
+#error "LOGLINE_BUFFER_SIZE must hold a line"
+#endif
+
+static uint8_t logline_ring[LOGLINE_BUFFER_SIZE];
+static uint32_t logline_head;
+static uint32_t logline_tail;
+static uint32_t logline_busy;
+static uint32_t logline_lost;
+
+uint32_t logline_dropped(void)
+{
+    return __atomic_load_n(&logline_lost, __ATOMIC_RELAXED);
+}
+
+/* Moves the oldest line to the console if it is complete.  Only called by
+ * the drainer. */
+static uint32_t logline_pop(void)
+{
+    char line[LOGLINE_SIZE];
+    uint32_t tail = logline_tail;
+    uint32_t len;
+    uint32_t i;
+
+    len = __atomic_load_n(&logline_ring[tail & LOGLINE_MASK], __ATOMIC_ACQUIRE);
+    if (len == 0U)
+    {
+        return 0U;
+    }
+
+    for (i = 0U; i < len; i++)
+    {
+        line[i] = (char)logline_ring[(tail + 1U + i) & LOGLINE_MASK];
+    }
+    for (i = 0U; i <= len; i++)
+    {
+        logline_ring[(tail + i) & LOGLINE_MASK] = 0U;
+    }
+    __atomic_store_n(&logline_tail, tail + 1U + len, __ATOMIC_RELEASE);
+
+    (void)console_write(line, len);
+    return 1U;
+}
+
+static void logline_drain(void)
+{
+    /* A line committed after the drainer looked at it, but before it let
+     * go, is picked up by the next round. */
+    while ((__atomic_load_n(&logline_ring[logline_tail & LOGLINE_MASK], __ATOMIC_ACQUIRE) != 0U) &&
+           (__atomic_exchange_n(&logline_busy, 1U, __ATOMIC_ACQUIRE) == 0U))
+    {
+        while (logline_pop() != 0U)
+        {
+        }
+        __atomic_store_n(&logline_busy, 0U, __ATOMIC_RELEASE);
+    }
+}
+
+__attribute__((weak)) uint32_t logline_wait(void)
+{
+    return 0U;
+}
+
+/* Reserves 1 + len bytes.  Returns 0 when the ring is full. */
+static uint32_t logline_reserve(uint32_t len, uint32_t *head)
+{
+    *head = __atomic_load_n(&logline_head, __ATOMIC_RELAXED);
+    do
+    {
+        if ((LOGLINE_BUFFER_SIZE - (*head - __atomic_load_n(&logline_tail, __ATOMIC_ACQUIRE))) < (1U + len))
+        {
+            return 0U;
+        }
+    } while (__atomic_compare_exchange_n(&logline_head, head, *head + 1U + len, 1, __ATOMIC_RELAXED,
+                                         __ATOMIC_RELAXED) == 0);
+    return 1U;
+}
+
+void logline_write(const char *line, uint32_t len)
+{
+    uint32_t head;
+    uint32_t reserved;
+    uint32_t i;
+
+    if (len == 0U)
+    {
+        return;
+    }
+    if (len > (LOGLINE_SIZE - 1U))
+    {
+        len = LOGLINE_SIZE - 1U;
+    }
+
+    /* full: drain if nobody else does, else wait for the drainer */
+    reserved = logline_reserve(len, &head);
+    while (reserved == 0U)
+    {
+        logline_drain();
+        reserved = logline_reserve(len, &head);
+        if ((reserved == 0U) && (logline_wait() == 0U))
+        {
+            break;
+        }
+    }
+    if (reserved == 0U)
+    {
+        (void)__atomic_fetch_add(&logline_lost, 1U, __ATOMIC_RELAXED);
+        return;
+    }
+
+    for (i = 0U; i < len; i++)
+    {
+        logline_ring[(head + 1U + i) & LOGLINE_MASK] = (uint8_t)line[i];
+    }
+    __atomic_store_n(&logline_ring[head & LOGLINE_MASK], (uint8_t)len, __ATOMIC_RELEASE);
+
+    logline_drain();
+}
+
+int logline_printf(const char *format, ...)
+{
+    char line[LOGLINE_SIZE];
+    va_list va;
+    int ret;
+    uint32_t len;
+
+    va_start(va, format);
+    ret = vsnprintf_(line, sizeof(line), format, va);
+    va_end(va);
+
+    if (ret <= 0)
+    {
+        return ret;
+    }
+    len = (uint32_t)ret;
+    if (len >= LOGLINE_SIZE)
+    {
+        /* cut, but still a line */
+        len = LOGLINE_SIZE - 1U;
+        line[len - 1U] = '\n';
+    }
+    logline_write(line, len);
+    return (int)len;
+}
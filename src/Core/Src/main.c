@@ -29,6 +29,37 @@
 #include "string.h"
 #include "cmsis_gcc.h"
 #include "user.h"
+#include "console.h"
+#include "can_tx.h"
+#include "can_rx.h"
+#include "isotp.h"
+#include "can_stats.h"
+#include "slcan.h"
+#include "trace.h"
+#if defined(USE_KERNEL_BENCH)
+#include "kernel_bench.h"
+#endif
+#if defined(USE_CAN_BENCH)
+#include "host_can_bench.h"
+#endif
+#if defined(USE_ISOTP_BENCH)
+#include "host_isotp_bench.h"
+#endif
+#if defined(USE_SLCAN_BENCH)
+#include "host_slcan_bench.h"
+#endif
+#if defined(USE_XCP_BENCH)
+#include "host_xcp_bench.h"
+#endif
+#if defined(USE_TRACE_BENCH)
+#include "host_trace_bench.h"
+#endif
+#if defined(USE_TICKLESS_BENCH)
+#include "host_tickless_bench.h"
+#endif
+#if defined(USE_STATIC_BENCH)
+#include "host_static_bench.h"
+#endif
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -46,17 +77,19 @@
 /* Private variables ---------------------------------------------------------*/
 UART_HandleTypeDef huart1;
 CAN_HandleTypeDef hcan;
+DMA_HandleTypeDef hdma_usart1_tx;
 osThreadId t1000Handle;
 osThreadId t500Handle;
 
 
 /* USER CODE BEGIN PV */
-
+osThreadId canrxHandle;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART1_UART_Init(void);
 static void MX_CAN_Init(void);
 void freertos_lld_1000ms_task(void const *argument);
@@ -69,9 +102,13 @@ void freertos_lld_task_500ms(void const *argument);
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
-/* add this empty interface so the function provided by CubeIDE would be disabled */
+/* add this interface so the function provided by CubeIDE would be disabled.
+ * The tick is TIM1, running since HAL_Init(): the kernel calls this with the
+ * interrupts masked as its scheduler starts, from here on HAL_IncTick()
+ * passes the tick to the kernel. */
 void vPortSetupTimerInterrupt(void)
 {
+    user_tick_kernel = 1U;
 }
 
 /* USER CODE END 0 */
@@ -98,17 +135,30 @@ int main(void)
     SystemClock_Config();
 
     /* USER CODE BEGIN SysInit */
-
+#if defined(USE_TRACE)
+    trace_init();
+#endif
     /* USER CODE END SysInit */
 
     /* Initialize all configured peripherals */
     MX_GPIO_Init();
+    MX_DMA_Init();
     MX_USART1_UART_Init();
     MX_CAN_Init();
     /* USER CODE BEGIN 2 */
+    console_init();
     user_can_set_rx_filer();
+#if defined(USE_CAN_STATS)
+    can_stats_init(&hcan);
+#endif
     HAL_CAN_Start(&hcan);
-    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING);
+    can_rx_init(&hcan);
+    can_tx_init(&hcan);
+#if defined(USE_SLCAN)
+    slcan_init(&hcan);
+#else
+    isotp_init(&user_isotp_config);
+#endif
     /* USER CODE END 2 */
 
     /* USER CODE BEGIN RTOS_MUTEX */
@@ -129,15 +179,45 @@ int main(void)
 
     /* Create the thread(s) */
     /* definition and creation of t1000 */
-    osThreadDef(t1000, freertos_lld_1000ms_task, osPriorityLow, 0, 160);
+    osThreadDef(t1000, freertos_lld_1000ms_task, osPriorityLow, 0, 176);
     t1000Handle = osThreadCreate(osThread(t1000), NULL);
 
     /* definition and creation of t500 */
-    osThreadDef(t500, freertos_lld_task_500ms, osPriorityBelowNormal, 0, 160);
+    osThreadDef(t500, freertos_lld_task_500ms, osPriorityBelowNormal, 0, 176);
     t500Handle = osThreadCreate(osThread(t500), NULL);
 
     /* USER CODE BEGIN RTOS_THREADS */
     /* add threads, ... */
+#if defined(USE_KERNEL_BENCH)
+    kernel_bench_start();
+#endif
+#if defined(USE_SLCAN)
+    osThreadDef(canrx, slcan_task, osPriorityNormal, 0, 128);
+#else
+    osThreadDef(canrx, freertos_lld_can_rx_task, osPriorityNormal, 0, 96);
+#endif
+    canrxHandle = osThreadCreate(osThread(canrx), NULL);
+#if defined(USE_CAN_BENCH)
+    host_can_bench_start();
+#endif
+#if defined(USE_ISOTP_BENCH)
+    host_isotp_bench_start();
+#endif
+#if defined(USE_SLCAN_BENCH)
+    host_slcan_bench_start();
+#endif
+#if defined(USE_XCP_BENCH)
+    host_xcp_bench_start();
+#endif
+#if defined(USE_TRACE_BENCH)
+    host_trace_bench_start();
+#endif
+#if defined(USE_TICKLESS_BENCH)
+    host_tickless_bench_start();
+#endif
+#if defined(USE_STATIC_BENCH)
+    host_static_bench_start();
+#endif
     /* USER CODE END RTOS_THREADS */
 
     /* Start scheduler */
@@ -227,6 +307,22 @@ static void MX_USART1_UART_Init(void)
     /* USER CODE END USART1_Init 2 */
 }
 
+/**
+ * Enable DMA controller clock
+ */
+static void MX_DMA_Init(void)
+{
+
+    /* DMA controller clock enable */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    /* DMA interrupt init */
+    /* DMA1_Channel4_IRQn interrupt configuration */
+    HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+
+}
+
 /**
  * @brief GPIO Initialization Function
  * @param None
@@ -278,7 +374,7 @@ static void MX_CAN_Init(void)
     hcan.Init.AutoWakeUp = DISABLE;
     hcan.Init.AutoRetransmission = DISABLE;
     hcan.Init.ReceiveFifoLocked = DISABLE;
-    hcan.Init.TransmitFifoPriority = DISABLE;
+    hcan.Init.TransmitFifoPriority = ENABLE;
     if (HAL_CAN_Init(&hcan) != HAL_OK)
     {
         Error_Handler();
@@ -333,21 +429,21 @@ __weak void freertos_lld_task_500ms(void const *argument)
 
 /**
  * @brief  Period elapsed callback in non blocking mode
- * @note   This function is called  when TIM1 interrupt took place, inside
- * HAL_TIM_IRQHandler(). It makes a direct call to HAL_IncTick() to increment
- * a global variable "uwTick" used as application time base.
+ * @note   This function is called inside HAL_TIM_IRQHandler().  TIM1, the
+ * time base, does not come here: TIM1_UP_IRQHandler() calls HAL_IncTick()
+ * itself.
  * @param  htim : TIM handle
  * @retval None
  */
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
     /* USER CODE BEGIN Callback 0 */
-
+    /* TIM1 takes its tick in TIM1_UP_IRQHandler(), which returns before
+     * HAL_TIM_IRQHandler() and so never gets here.  The generated branch
+     * calling HAL_IncTick() for TIM1 was removed by hand; regenerating the
+     * code puts it back, where it does not run either. */
+    (void)htim;
     /* USER CODE END Callback 0 */
-    if (htim->Instance == TIM1)
-    {
-        HAL_IncTick();
-    }
     /* USER CODE BEGIN Callback 1 */
     /* 按照上面的注释，这个 是TIM1的中断发生的时�?�的回调函数。相关的调用
      * 在HAL_TIM_IRQHandler() 接口当中。�?�从代码内容看，这个应该是tick
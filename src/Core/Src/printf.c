@@ -32,6 +32,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "printf.h"
 
@@ -64,13 +65,38 @@
 #define PRINTF_FTOA_BUFFER_SIZE    32U
 #endif
 
-// support for the floating point type (%f)
-// default: activated
+// support for the floating point type (%f) with double arithmetic
+// default: activated, off in this project (soft-double on the Cortex-M3), define
+// PRINTF_ENABLE_SUPPORT_FLOAT to get it back
+#if !defined(PRINTF_ENABLE_SUPPORT_FLOAT) && !defined(PRINTF_DISABLE_SUPPORT_FLOAT)
 #define PRINTF_DISABLE_SUPPORT_FLOAT
+#endif
 #ifndef PRINTF_DISABLE_SUPPORT_FLOAT
 #define PRINTF_SUPPORT_FLOAT
 #endif
 
+// support for fixed-point output with integer arithmetic only: %k/%K for signed/
+// unsigned Q-format values in an int, and %f when PRINTF_SUPPORT_FLOAT is off,
+// the double is taken apart into integer and fraction bits (integer part up to
+// 32 bits, larger values print as "ovf")
+// default: activated
+#ifndef PRINTF_DISABLE_SUPPORT_FIXED
+#define PRINTF_SUPPORT_FIXED
+#endif
+
+// fraction bits of the %k/%K arguments
+// default: 16 (Q16.16)
+#ifndef PRINTF_FIXED_FRAC_BITS
+#define PRINTF_FIXED_FRAC_BITS  16U
+#endif
+
+// 'fixtoa' conversion buffer size: sign, 10 integer digits, the point and the
+// fraction digits, which are exact up to the bits there are
+// default: 32 byte
+#ifndef PRINTF_FIXTOA_BUFFER_SIZE
+#define PRINTF_FIXTOA_BUFFER_SIZE  32U
+#endif
+
 // support for exponential floating point notation (%e/%g)
 // default: activated
 #define PRINTF_DISABLE_SUPPORT_EXPONENTIAL
@@ -90,6 +116,14 @@
 #define PRINTF_MAX_FLOAT  1e9
 #endif
 
+// fast conversion of 32-bit values in base 10 and 16: two decimal digits per
+// step from a table and a multiply instead of a division, hex digits written
+// in order; other bases and wider values take the generic loop
+// default: activated
+#ifndef PRINTF_DISABLE_FAST_NTOA
+#define PRINTF_FAST_NTOA
+#endif
+
 // support for the long long types (%llu or %p)
 // default: activated
 #define PRINTF_DISABLE_SUPPORT_LONG_LONG
@@ -107,18 +141,18 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// internal flag definitions
-#define FLAGS_ZEROPAD   (1U <<  0U)
-#define FLAGS_LEFT      (1U <<  1U)
-#define FLAGS_PLUS      (1U <<  2U)
-#define FLAGS_SPACE     (1U <<  3U)
-#define FLAGS_HASH      (1U <<  4U)
-#define FLAGS_UPPERCASE (1U <<  5U)
-#define FLAGS_CHAR      (1U <<  6U)
-#define FLAGS_SHORT     (1U <<  7U)
-#define FLAGS_LONG      (1U <<  8U)
-#define FLAGS_LONG_LONG (1U <<  9U)
-#define FLAGS_PRECISION (1U << 10U)
+// internal flag definitions, the parsed ones are shared with printf_op_t
+#define FLAGS_ZEROPAD   PRINTF_FLAGS_ZEROPAD
+#define FLAGS_LEFT      PRINTF_FLAGS_LEFT
+#define FLAGS_PLUS      PRINTF_FLAGS_PLUS
+#define FLAGS_SPACE     PRINTF_FLAGS_SPACE
+#define FLAGS_HASH      PRINTF_FLAGS_HASH
+#define FLAGS_UPPERCASE PRINTF_FLAGS_UPPERCASE
+#define FLAGS_CHAR      PRINTF_FLAGS_CHAR
+#define FLAGS_SHORT     PRINTF_FLAGS_SHORT
+#define FLAGS_LONG      PRINTF_FLAGS_LONG
+#define FLAGS_LONG_LONG PRINTF_FLAGS_LONG_LONG
+#define FLAGS_PRECISION PRINTF_FLAGS_PRECISION
 #define FLAGS_ADAPT_EXP (1U << 11U)
 
 
@@ -128,8 +162,9 @@
 #endif
 
 
-// output function type
-typedef void (*out_fct_type)(char character, void* buffer, size_t idx, size_t maxlen);
+// output function type, takes 'len' characters at once: literal runs of the
+// format, converted numbers, strings and padding
+typedef void (*out_fct_type)(const char* data, size_t len, void* buffer, size_t idx, size_t maxlen);
 
 
 // wrapper (used as buffer) for output function type
@@ -138,6 +173,13 @@ typedef struct {
     void* arg;
 } out_fct_wrap_type;
 
+
+// wrapper (used as buffer) for span output function type
+typedef struct {
+    void  (*fct)(const char* data, size_t len, void* arg);
+    void* arg;
+} out_span_wrap_type;
+
 uint8_t can_printf_en_queue(uint8_t c);
 
 /*
@@ -149,43 +191,88 @@ void _putchar(char character)
 }
 #endif
 
+// default block output: one _putchar() per character
+__attribute__((weak)) void _putspan(const char* data, size_t len)
+{
+    while (len--) {
+        _putchar(*data++);
+    }
+}
+
+
 // internal buffer output
-__inline__ static void _out_buffer(char character, void* buffer, size_t idx, size_t maxlen)
+static void _out_buffer(const char* data, size_t len, void* buffer, size_t idx, size_t maxlen)
 {
     if (idx < maxlen) {
-        ((char*)buffer)[idx] = character;
+        char* dst = &((char*)buffer)[idx];
+        len = (len < maxlen - idx) ? len : maxlen - idx;
+        // most spans are a few characters, not worth a memcpy() call
+        if (len > 8U) {
+            memcpy(dst, data, len);
+        }
+        else {
+            while (len--) {
+                *dst++ = *data++;
+            }
+        }
     }
 }
 
 
 // internal null output
-__inline__ static void _out_null(char character, void* buffer, size_t idx, size_t maxlen)
+static void _out_null(const char* data, size_t len, void* buffer, size_t idx, size_t maxlen)
 {
-    (void)character; (void)buffer; (void)idx; (void)maxlen;
+    (void)data; (void)len; (void)buffer; (void)idx; (void)maxlen;
 }
 
 
-// internal _putchar wrapper
-__inline__ static void _out_char(char character, void* buffer, size_t idx, size_t maxlen)
+// internal _putspan wrapper
+static void _out_char(const char* data, size_t len, void* buffer, size_t idx, size_t maxlen)
 {
     (void)buffer; (void)idx; (void)maxlen;
-    if (character) {
-        _putchar(character);
-    }
+    _putspan(data, len);
 }
 
 
 // internal output function wrapper
-__inline__ static void _out_fct(char character, void* buffer, size_t idx, size_t maxlen)
+static void _out_fct(const char* data, size_t len, void* buffer, size_t idx, size_t maxlen)
 {
     (void)idx; (void)maxlen;
-    if (character) {
-        // buffer is the output fct pointer
-        ((out_fct_wrap_type*)buffer)->fct(character, ((out_fct_wrap_type*)buffer)->arg);
+    while (len--) {
+        if (*data) {
+            // buffer is the output fct pointer
+            ((out_fct_wrap_type*)buffer)->fct(*data, ((out_fct_wrap_type*)buffer)->arg);
+        }
+        data++;
     }
 }
 
 
+// internal span output function wrapper
+static void _out_span(const char* data, size_t len, void* buffer, size_t idx, size_t maxlen)
+{
+    (void)idx; (void)maxlen;
+    // buffer is the output fct pointer
+    ((out_span_wrap_type*)buffer)->fct(data, len, ((out_span_wrap_type*)buffer)->arg);
+}
+
+
+// output 'count' spaces
+static size_t _out_spaces(out_fct_type out, char* buffer, size_t idx, size_t maxlen, size_t count)
+{
+    static const char spaces[] = "                ";
+    size_t n;
+
+    while (count) {
+        n = (count < sizeof(spaces) - 1U) ? count : sizeof(spaces) - 1U;
+        out(spaces, n, buffer, idx, maxlen);
+        idx += n;
+        count -= n;
+    }
+    return idx;
+}
+
+
 // internal secure strlen
 // \return The length of the string (excluding the terminating 0) limited by 'maxsize'
 __inline__ static unsigned int _strnlen_s(const char* str, size_t maxsize)
@@ -215,36 +302,47 @@ static unsigned int _atoi(const char** str)
 }
 
 
-// output the specified string in reverse, taking care of any zero-padding
-static size_t _out_rev(out_fct_type out, char* buffer, size_t idx, size_t maxlen, const char* buf, size_t len, unsigned int width, unsigned int flags)
+// output the specified string, taking care of any zero-padding
+static size_t _out_pad(out_fct_type out, char* buffer, size_t idx, size_t maxlen, const char* buf, size_t len, unsigned int width, unsigned int flags)
 {
-    const size_t start_idx = idx;
-    size_t i;
-
     // pad spaces up to given width
-    if (!(flags & FLAGS_LEFT) && !(flags & FLAGS_ZEROPAD)) {
-        for (i = len; i < width; i++) {
-            out(' ', buffer, idx++, maxlen);
-        }
+    if (!(flags & FLAGS_LEFT) && !(flags & FLAGS_ZEROPAD) && (len < width)) {
+        idx = _out_spaces(out, buffer, idx, maxlen, width - len);
     }
 
-    // reverse string
-    while (len) {
-        out(buf[--len], buffer, idx++, maxlen);
-    }
+    out(buf, len, buffer, idx, maxlen);
+    idx += len;
 
     // append pad spaces up to given width
-    if (flags & FLAGS_LEFT) {
-        while (idx - start_idx < width) {
-            out(' ', buffer, idx++, maxlen);
-        }
+    if ((flags & FLAGS_LEFT) && (len < width)) {
+        idx = _out_spaces(out, buffer, idx, maxlen, width - len);
     }
 
     return idx;
 }
 
 
+#if defined(PRINTF_SUPPORT_FLOAT)
+// output the specified string in reverse, taking care of any zero-padding
+static size_t _out_rev(out_fct_type out, char* buffer, size_t idx, size_t maxlen, char* buf, size_t len, unsigned int width, unsigned int flags)
+{
+    size_t i;
+    char c;
+
+    // reverse string in place
+    for (i = 0U; i < len / 2U; i++) {
+        c = buf[i];
+        buf[i] = buf[len - 1U - i];
+        buf[len - 1U - i] = c;
+    }
+
+    return _out_pad(out, buffer, idx, maxlen, buf, len, width, flags);
+}
+#endif  // PRINTF_SUPPORT_FLOAT
+
+
 // internal itoa format
+// the number is right-aligned in buf, prefixes are added in front of it
 static size_t _ntoa_format(out_fct_type out, char* buffer, size_t idx, size_t maxlen, char* buf, size_t len, bool negative, unsigned int base, unsigned int prec, unsigned int width, unsigned int flags)
 {
     // pad leading zeros
@@ -253,10 +351,10 @@ static size_t _ntoa_format(out_fct_type out, char* buffer, size_t idx, size_t ma
             width--;
         }
         while ((len < prec) && (len < PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = '0';
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = '0';
         }
         while ((flags & FLAGS_ZEROPAD) && (len < width) && (len < PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = '0';
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = '0';
         }
     }
 
@@ -269,33 +367,94 @@ static size_t _ntoa_format(out_fct_type out, char* buffer, size_t idx, size_t ma
             }
         }
         if ((base == 16U) && !(flags & FLAGS_UPPERCASE) && (len < PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = 'x';
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = 'x';
         }
         else if ((base == 16U) && (flags & FLAGS_UPPERCASE) && (len < PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = 'X';
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = 'X';
         }
         else if ((base == 2U) && (len < PRINTF_NTOA_BUFFER_SIZE)) {
-            buf[len++] = 'b';
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = 'b';
         }
         if (len < PRINTF_NTOA_BUFFER_SIZE) {
-            buf[len++] = '0';
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = '0';
         }
     }
 
     if (len < PRINTF_NTOA_BUFFER_SIZE) {
         if (negative) {
-            buf[len++] = '-';
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = '-';
         }
         else if (flags & FLAGS_PLUS) {
-            buf[len++] = '+';  // ignore the space if the '+' exists
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = '+';  // ignore the space if the '+' exists
         }
         else if (flags & FLAGS_SPACE) {
-            buf[len++] = ' ';
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = ' ';
         }
     }
 
-    return _out_rev(out, buffer, idx, maxlen, buf, len, width, flags);
+    return _out_pad(out, buffer, idx, maxlen, &buf[PRINTF_NTOA_BUFFER_SIZE - len], len, width, flags);
+}
+
+
+#if defined(PRINTF_FAST_NTOA)
+// "00" to "99"
+static const char _digits2[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+
+// internal base 10 conversion of a 32-bit value, two digits per step
+// writes the digits right before 'end' and returns their count
+static size_t _utoa10(char* end, uint32_t value)
+{
+    char* p = end;
+    uint32_t q;
+
+    while (value >= 100U) {
+        // value / 100 as a multiply by the reciprocal, exact for all 32-bit values
+        q = (uint32_t)(((uint64_t)value * 0x51EB851FU) >> 37U);
+        p -= 2;
+        p[0] = _digits2[(value - q * 100U) * 2U];
+        p[1] = _digits2[(value - q * 100U) * 2U + 1U];
+        value = q;
+    }
+    if (value >= 10U) {
+        p -= 2;
+        p[0] = _digits2[value * 2U];
+        p[1] = _digits2[value * 2U + 1U];
+    }
+    else {
+        *--p = (char)('0' + value);
+    }
+    return (size_t)(end - p);
+}
+
+
+// internal base 16 conversion of a 32-bit value, written front to back
+// writes the digits right before 'end' and returns their count
+static size_t _utoa16(char* end, uint32_t value, unsigned int flags)
+{
+    const char* digits = (flags & FLAGS_UPPERCASE) ? "0123456789ABCDEF" : "0123456789abcdef";
+    const size_t len = (size_t)((35 - __builtin_clz(value | 1U)) / 4);
+    char* p = end - len;
+    unsigned int shift = (unsigned int)(len * 4U);
+
+    while (shift) {
+        shift -= 4U;
+        *p++ = digits[(value >> shift) & 0xFU];
+    }
+    return len;
 }
+#endif  // PRINTF_FAST_NTOA
 
 
 // internal itoa for 'long' type
@@ -311,11 +470,22 @@ static size_t _ntoa_long(out_fct_type out, char* buffer, size_t idx, size_t maxl
 
     // write if precision != 0 and value is != 0
     if (!(flags & FLAGS_PRECISION) || value) {
-        do {
-            const char digit = (char)(value % base);
-            buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
-            value /= base;
-        } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+#if defined(PRINTF_FAST_NTOA)
+        if ((base == 10U) && (value <= UINT32_MAX)) {
+            len = _utoa10(&buf[PRINTF_NTOA_BUFFER_SIZE], (uint32_t)value);
+        }
+        else if ((base == 16U) && (value <= UINT32_MAX)) {
+            len = _utoa16(&buf[PRINTF_NTOA_BUFFER_SIZE], (uint32_t)value, flags);
+        }
+        else
+#endif
+        {
+            do {
+                const char digit = (char)(value % base);
+                buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
+                value /= base;
+            } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+        }
     }
 
     return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int)base, prec, width, flags);
@@ -338,7 +508,7 @@ static size_t _ntoa_long_long(out_fct_type out, char* buffer, size_t idx, size_t
     if (!(flags & FLAGS_PRECISION) || value) {
         do {
             const char digit = (char)(value % base);
-            buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
+            buf[PRINTF_NTOA_BUFFER_SIZE - ++len] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
             value /= base;
         } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
     }
@@ -376,11 +546,11 @@ static size_t _ftoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, d
   
     // test for special values
     if (value != value)
-        return _out_rev(out, buffer, idx, maxlen, "nan", 3, width, flags);
+        return _out_pad(out, buffer, idx, maxlen, "nan", 3, width, flags);
     if (value < -DBL_MAX)
-        return _out_rev(out, buffer, idx, maxlen, "fni-", 4, width, flags);
+        return _out_pad(out, buffer, idx, maxlen, "-inf", 4, width, flags);
     if (value > DBL_MAX)
-        return _out_rev(out, buffer, idx, maxlen, (flags & FLAGS_PLUS) ? "fni+" : "fni", (flags & FLAGS_PLUS) ? 4U : 3U, width, flags);
+        return _out_pad(out, buffer, idx, maxlen, (flags & FLAGS_PLUS) ? "+inf" : "inf", (flags & FLAGS_PLUS) ? 4U : 3U, width, flags);
 
     // test for very large values
     // standard printf behavior is to print EVERY whole number digit -- which could be 100s of characters overflowing your buffers == bad
@@ -594,12 +764,12 @@ static size_t _etoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, d
     // output the exponent part
     if (minwidth) {
         // output the exponential symbol
-        out((flags & FLAGS_UPPERCASE) ? 'E' : 'e', buffer, idx++, maxlen);
+        out((flags & FLAGS_UPPERCASE) ? "E" : "e", 1U, buffer, idx++, maxlen);
         // output the exponent value
         idx = _ntoa_long(out, buffer, idx, maxlen, (expval < 0) ? -expval : expval, expval < 0, 10, 0, minwidth-1, FLAGS_ZEROPAD | FLAGS_PLUS);
         // might need to right-pad spaces
-        if (flags & FLAGS_LEFT) {
-            while (idx - start_idx < width) out(' ', buffer, idx++, maxlen);
+        if ((flags & FLAGS_LEFT) && (idx - start_idx < width)) {
+            idx = _out_spaces(out, buffer, idx, maxlen, width - (idx - start_idx));
         }
     }
     return idx;
@@ -608,6 +778,166 @@ static size_t _etoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, d
 #endif  // PRINTF_SUPPORT_FLOAT
 
 
+#if defined(PRINTF_SUPPORT_FIXED)
+// internal fixed-point ftoa: whole + (frac_hi:frac_lo) / 2^64, 'sticky' when
+// there are more fraction bits below frac_lo; the fraction digits come out
+// exact, one multiply by 10 of the 64-bit fraction per digit, and the last
+// one is rounded half to even
+static size_t _fixtoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, uint32_t whole, uint32_t frac_hi, uint32_t frac_lo, bool sticky, bool negative, unsigned int prec, unsigned int width, unsigned int flags)
+{
+    char buf[PRINTF_FIXTOA_BUFFER_SIZE];
+    size_t pos = PRINTF_FIXTOA_BUFFER_SIZE;
+    uint64_t lo;
+    uint64_t hi;
+    bool up;
+    size_t i;
+
+    // set default precision, if not set explicitly
+    if (!(flags & FLAGS_PRECISION)) {
+        prec = PRINTF_DEFAULT_FLOAT_PRECISION;
+    }
+    // room for the sign, the integer part and the point
+    if (prec > PRINTF_FIXTOA_BUFFER_SIZE - 12U) {
+        prec = PRINTF_FIXTOA_BUFFER_SIZE - 12U;
+    }
+
+    // fraction digits, front to back
+    for (i = PRINTF_FIXTOA_BUFFER_SIZE - prec; i < PRINTF_FIXTOA_BUFFER_SIZE; i++) {
+        lo = (uint64_t)frac_lo * 10U;
+        hi = (uint64_t)frac_hi * 10U + (lo >> 32U);
+        buf[i] = (char)('0' + (hi >> 32U));
+        frac_hi = (uint32_t)hi;
+        frac_lo = (uint32_t)lo;
+    }
+
+    // round what is left
+    if ((frac_hi != 0x80000000U) || frac_lo || sticky) {
+        up = (frac_hi >= 0x80000000U);
+    }
+    else {
+        up = prec ? ((buf[PRINTF_FIXTOA_BUFFER_SIZE - 1U] - '0') & 1) : (whole & 1U);
+    }
+    for (i = PRINTF_FIXTOA_BUFFER_SIZE; up && (i > PRINTF_FIXTOA_BUFFER_SIZE - prec); i--) {
+        if (buf[i - 1U] == '9') {
+            buf[i - 1U] = '0';
+        }
+        else {
+            buf[i - 1U]++;
+            up = false;
+        }
+    }
+    if (up) {
+        if (whole == UINT32_MAX) {
+            return _out_pad(out, buffer, idx, maxlen, "ovf", 3U, width, flags);
+        }
+        whole++;
+    }
+
+    pos -= prec;
+    if (prec) {
+        buf[--pos] = '.';
+    }
+    do {
+        buf[--pos] = (char)('0' + (whole % 10U));
+        whole /= 10U;
+    } while (whole);
+
+    // pad leading zeros
+    if (!(flags & FLAGS_LEFT) && (flags & FLAGS_ZEROPAD)) {
+        if (width && (negative || (flags & (FLAGS_PLUS | FLAGS_SPACE)))) {
+            width--;
+        }
+        while ((PRINTF_FIXTOA_BUFFER_SIZE - pos < width) && (pos > 1U)) {
+            buf[--pos] = '0';
+        }
+    }
+
+    if (negative) {
+        buf[--pos] = '-';
+    }
+    else if (flags & FLAGS_PLUS) {
+        buf[--pos] = '+';  // ignore the space if the '+' exists
+    }
+    else if (flags & FLAGS_SPACE) {
+        buf[--pos] = ' ';
+    }
+
+    return _out_pad(out, buffer, idx, maxlen, &buf[pos], PRINTF_FIXTOA_BUFFER_SIZE - pos, width, flags);
+}
+
+
+// internal %k/%K: Q-format value with PRINTF_FIXED_FRAC_BITS fraction bits
+static size_t _ktoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, uint32_t value, bool negative, unsigned int prec, unsigned int width, unsigned int flags)
+{
+    const uint32_t frac = value & ((1UL << PRINTF_FIXED_FRAC_BITS) - 1U);
+    return _fixtoa(out, buffer, idx, maxlen, value >> PRINTF_FIXED_FRAC_BITS, frac << (32U - PRINTF_FIXED_FRAC_BITS), 0U, false, negative, prec, width, flags);
+}
+
+
+#if !defined(PRINTF_SUPPORT_FLOAT)
+// internal %f without double arithmetic: the IEEE 754 bits of the value are
+// split into integer part and fraction with shifts
+static size_t _dtoa_fixed(out_fct_type out, char* buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags)
+{
+    union {
+        uint64_t U;
+        double   F;
+    } conv;
+    uint64_t mant;
+    uint64_t frac;
+    unsigned int exp;
+    unsigned int shift;
+    bool negative;
+    bool sticky = false;
+
+    conv.F = value;
+    negative = (conv.U >> 63U) != 0U;
+    exp = (unsigned int)((conv.U >> 52U) & 0x07FFU);
+    mant = conv.U & ((1ULL << 52U) - 1U);
+
+    // test for special values
+    if (exp == 0x07FFU) {
+        if (mant) {
+            return _out_pad(out, buffer, idx, maxlen, "nan", 3U, width, flags);
+        }
+        if (negative) {
+            return _out_pad(out, buffer, idx, maxlen, "-inf", 4U, width, flags);
+        }
+        return _out_pad(out, buffer, idx, maxlen, (flags & FLAGS_PLUS) ? "+inf" : "inf", (flags & FLAGS_PLUS) ? 4U : 3U, width, flags);
+    }
+
+    // value = mant / 2^shift
+    if (exp) {
+        mant |= 1ULL << 52U;
+        shift = 1075U - exp;
+    }
+    else {
+        shift = 1074U;
+    }
+    // the integer part must fit in 32 bits: below 2^32 the shift is more than 20
+    if (exp >= 1075U - 20U) {
+        return _out_pad(out, buffer, idx, maxlen, negative ? "-ovf" : "ovf", negative ? 4U : 3U, width, flags);
+    }
+
+    // fraction aligned to 2^-64, the bits below go into 'sticky'
+    if (shift <= 64U) {
+        frac = (mant << (64U - shift));
+    }
+    else if (shift < 128U) {
+        frac = mant >> (shift - 64U);
+        sticky = (mant & ((1ULL << (shift - 64U)) - 1U)) != 0U;
+    }
+    else {
+        frac = 0U;
+        sticky = mant != 0U;
+    }
+
+    return _fixtoa(out, buffer, idx, maxlen, (shift < 64U) ? (uint32_t)(mant >> shift) : 0U, (uint32_t)(frac >> 32U), (uint32_t)frac, sticky, negative, prec, width, flags);
+}
+#endif  // !PRINTF_SUPPORT_FLOAT
+#endif  // PRINTF_SUPPORT_FIXED
+
+
 // internal vsnprintf
 static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const char* format, va_list va)
 {
@@ -626,9 +956,13 @@ static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const
     {
         // format specifier?  %[flags][width][.precision][length]
         if (*format != '%') {
-            // no
-            out(*format, buffer, idx++, maxlen);
-            format++;
+            // no, output the run of literal characters up to the next one
+            const char* run = format;
+            while (*format && (*format != '%')) {
+                format++;
+            }
+            out(run, (size_t)(format - run), buffer, idx, maxlen);
+            idx += (size_t)(format - run);
             continue;
         }
         else {
@@ -762,16 +1096,16 @@ static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const
                 if (flags & FLAGS_LONG_LONG) {
 #if defined(PRINTF_SUPPORT_LONG_LONG)
                     const long long value = va_arg(va, long long);
-                    idx = _ntoa_long_long(out, buffer, idx, maxlen, (unsigned long long)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
+                    idx = _ntoa_long_long(out, buffer, idx, maxlen, (value < 0 ? 0U - (unsigned long long)value : (unsigned long long)value), value < 0, base, precision, width, flags);
 #endif
                 }
                 else if (flags & FLAGS_LONG) {
                     const long value = va_arg(va, long);
-                    idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned long)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
+                    idx = _ntoa_long(out, buffer, idx, maxlen, (value < 0 ? 0U - (unsigned long)value : (unsigned long)value), value < 0, base, precision, width, flags);
                 }
                 else {
                     const int value = (flags & FLAGS_CHAR) ? (char)va_arg(va, int) : (flags & FLAGS_SHORT) ? (short int)va_arg(va, int) : va_arg(va, int);
-                    idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned int)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
+                    idx = _ntoa_long(out, buffer, idx, maxlen, (value < 0 ? 0U - (unsigned int)value : (unsigned int)value), value < 0, base, precision, width, flags);
                 }
             }
             else {
@@ -811,22 +1145,28 @@ static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const
             break;
 #endif  // PRINTF_SUPPORT_EXPONENTIAL
 #endif  // PRINTF_SUPPORT_FLOAT
+#if defined(PRINTF_SUPPORT_FIXED)
+#if !defined(PRINTF_SUPPORT_FLOAT)
+        case 'f' :
+        case 'F' :
+            idx = _dtoa_fixed(out, buffer, idx, maxlen, va_arg(va, double), precision, width, flags);
+            format++;
+            break;
+#endif
+        case 'k' : {
+            const int value = va_arg(va, int);
+            idx = _ktoa(out, buffer, idx, maxlen, (value < 0 ? 0U - (unsigned int)value : (unsigned int)value), value < 0, precision, width, flags);
+            format++;
+            break;
+        }
+        case 'K' :
+            idx = _ktoa(out, buffer, idx, maxlen, va_arg(va, unsigned int), false, precision, width, flags & ~(FLAGS_PLUS | FLAGS_SPACE));
+            format++;
+            break;
+#endif  // PRINTF_SUPPORT_FIXED
         case 'c' : {
-            unsigned int l = 1U;
-            // pre padding
-            if (!(flags & FLAGS_LEFT)) {
-                while (l++ < width) {
-                    out(' ', buffer, idx++, maxlen);
-                }
-            }
-            // char output
-            out((char)va_arg(va, int), buffer, idx++, maxlen);
-            // post padding
-            if (flags & FLAGS_LEFT) {
-                while (l++ < width) {
-                    out(' ', buffer, idx++, maxlen);
-                }
-            }
+            const char c = (char)va_arg(va, int);
+            idx = _out_pad(out, buffer, idx, maxlen, &c, 1U, width, flags & ~FLAGS_ZEROPAD);
             format++;
             break;
         }
@@ -834,25 +1174,10 @@ static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const
         case 's' : {
             const char* p = va_arg(va, char*);
             unsigned int l = _strnlen_s(p, precision ? precision : (size_t)-1);
-            // pre padding
             if (flags & FLAGS_PRECISION) {
                 l = (l < precision ? l : precision);
             }
-            if (!(flags & FLAGS_LEFT)) {
-                while (l++ < width) {
-                    out(' ', buffer, idx++, maxlen);
-                }
-            }
-            // string output
-            while ((*p != 0) && (!(flags & FLAGS_PRECISION) || precision--)) {
-                out(*(p++), buffer, idx++, maxlen);
-            }
-            // post padding
-            if (flags & FLAGS_LEFT) {
-                while (l++ < width) {
-                    out(' ', buffer, idx++, maxlen);
-                }
-            }
+            idx = _out_pad(out, buffer, idx, maxlen, p, l, width, flags & ~FLAGS_ZEROPAD);
             format++;
             break;
         }
@@ -876,25 +1201,147 @@ static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const
         }
 
         case '%' :
-            out('%', buffer, idx++, maxlen);
+            out("%", 1U, buffer, idx++, maxlen);
             format++;
             break;
 
         default :
-            out(*format, buffer, idx++, maxlen);
+            out(format, 1U, buffer, idx++, maxlen);
             format++;
             break;
         }
     }
 
-    // termination
-    out((char)0, buffer, idx < maxlen ? idx : maxlen - 1U, maxlen);
-
     // return written chars without terminating \0
     return (int)idx;
 }
 
 
+// internal vsnprintf of a pre-parsed format: the flags, base and width are final,
+// only the arguments are converted
+static int _vsnprintf_ops(out_fct_type out, char* buffer, const size_t maxlen, const printf_op_t* ops, size_t count, const printf_arg_t* args)
+{
+    size_t idx = 0U;
+    unsigned int flags;
+
+    if (!buffer) {
+        // use null output function
+        out = _out_null;
+    }
+
+    for (; count; count--, ops++) {
+        out(ops->literal, ops->literal_len, buffer, idx, maxlen);
+        idx += ops->literal_len;
+        flags = ops->flags;
+
+        switch (ops->specifier) {
+        case 'd' :
+        case 'i' :
+            if (flags & FLAGS_LONG_LONG) {
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+                const long long value = args->i;
+                idx = _ntoa_long_long(out, buffer, idx, maxlen, (value < 0 ? 0U - (unsigned long long)value : (unsigned long long)value), value < 0, ops->base, ops->precision, ops->width, flags);
+#endif
+            }
+            else {
+                const long value = (flags & FLAGS_CHAR) ? (char)args->i : (flags & FLAGS_SHORT) ? (short int)args->i : (flags & FLAGS_LONG) ? (long)args->i : (int)args->i;
+                idx = _ntoa_long(out, buffer, idx, maxlen, (value < 0 ? 0U - (unsigned long)value : (unsigned long)value), value < 0, ops->base, ops->precision, ops->width, flags);
+            }
+            args++;
+            break;
+        case 'u' :
+        case 'x' :
+        case 'X' :
+        case 'o' :
+        case 'b' :
+            if (flags & FLAGS_LONG_LONG) {
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+                idx = _ntoa_long_long(out, buffer, idx, maxlen, args->u, false, ops->base, ops->precision, ops->width, flags);
+#endif
+            }
+            else {
+                const unsigned long value = (flags & FLAGS_CHAR) ? (unsigned char)args->u : (flags & FLAGS_SHORT) ? (unsigned short int)args->u : (flags & FLAGS_LONG) ? (unsigned long)args->u : (unsigned int)args->u;
+                idx = _ntoa_long(out, buffer, idx, maxlen, value, false, ops->base, ops->precision, ops->width, flags);
+            }
+            args++;
+            break;
+        case 'p' :
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+            if (sizeof(uintptr_t) == sizeof(long long)) {
+                idx = _ntoa_long_long(out, buffer, idx, maxlen, (uintptr_t)args->p, false, 16U, ops->precision, ops->width, flags);
+            }
+            else
+#endif
+            {
+                idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned long)((uintptr_t)args->p), false, 16U, ops->precision, ops->width, flags);
+            }
+            args++;
+            break;
+        case 'c' : {
+            const char c = (char)args->i;
+            idx = _out_pad(out, buffer, idx, maxlen, &c, 1U, ops->width, flags & ~FLAGS_ZEROPAD);
+            args++;
+            break;
+        }
+        case 's' : {
+            const char* p = (const char*)args->p;
+            unsigned int l = _strnlen_s(p, ops->precision ? ops->precision : (size_t)-1);
+            if (flags & FLAGS_PRECISION) {
+                l = (l < ops->precision ? l : ops->precision);
+            }
+            idx = _out_pad(out, buffer, idx, maxlen, p, l, ops->width, flags & ~FLAGS_ZEROPAD);
+            args++;
+            break;
+        }
+#if defined(PRINTF_SUPPORT_FLOAT)
+        case 'f' :
+        case 'F' :
+            idx = _ftoa(out, buffer, idx, maxlen, args->f, ops->precision, ops->width, flags);
+            args++;
+            break;
+#elif defined(PRINTF_SUPPORT_FIXED)
+        case 'f' :
+        case 'F' :
+            idx = _dtoa_fixed(out, buffer, idx, maxlen, args->f, ops->precision, ops->width, flags);
+            args++;
+            break;
+#endif
+#if defined(PRINTF_SUPPORT_FIXED)
+        case 'k' : {
+            const int value = (int)args->i;
+            idx = _ktoa(out, buffer, idx, maxlen, (value < 0 ? 0U - (unsigned int)value : (unsigned int)value), value < 0, ops->precision, ops->width, flags);
+            args++;
+            break;
+        }
+        case 'K' :
+            idx = _ktoa(out, buffer, idx, maxlen, (unsigned int)args->u, false, ops->precision, ops->width, flags);
+            args++;
+            break;
+#endif
+        case '%' :
+            out("%", 1U, buffer, idx++, maxlen);
+            break;
+        default :
+            break;
+        }
+    }
+
+    return (int)idx;
+}
+
+
+// internal vsnprintf into a buffer, with termination
+static int _vsnprintf_buffer(char* buffer, const size_t maxlen, const char* format, va_list va)
+{
+    const int ret = _vsnprintf(_out_buffer, buffer, maxlen, format, va);
+
+    if (buffer && maxlen) {
+        buffer[((size_t)ret < maxlen) ? (size_t)ret : maxlen - 1U] = '\0';
+    }
+    return ret;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 int printf_(const char* format, ...)
@@ -916,7 +1363,7 @@ int sprintf_(char* buffer, const char* format, ...)
     va_list va;
     int ret;
     va_start(va, format);
-    ret = _vsnprintf(_out_buffer, buffer, (size_t)-1, format, va);
+    ret = _vsnprintf_buffer(buffer, (size_t)-1, format, va);
     va_end(va);
     return ret;
 }
@@ -927,7 +1374,7 @@ int snprintf_(char* buffer, size_t count, const char* format, ...)
     va_list va;
     int ret;
     va_start(va, format);
-    ret = _vsnprintf(_out_buffer, buffer, count, format, va);
+    ret = _vsnprintf_buffer(buffer, count, format, va);
     va_end(va);
     return ret;
 }
@@ -942,7 +1389,7 @@ int vprintf_(const char* format, va_list va)
 
 int vsnprintf_(char* buffer, size_t count, const char* format, va_list va)
 {
-    return _vsnprintf(_out_buffer, buffer, count, format, va);
+    return _vsnprintf_buffer(buffer, count, format, va);
 }
 
 
@@ -958,3 +1405,35 @@ int fctprintf(void (*out)(char character, void* arg), void* arg, const char* for
     va_end(va);
     return ret;
 }
+
+
+int printf_ops_(const printf_op_t* ops, size_t count, const printf_arg_t* args)
+{
+    char buffer[1];
+    return _vsnprintf_ops(_out_char, buffer, (size_t)-1, ops, count, args);
+}
+
+
+int snprintf_ops_(char* buffer, size_t n, const printf_op_t* ops, size_t count, const printf_arg_t* args)
+{
+    const int ret = _vsnprintf_ops(_out_buffer, buffer, n, ops, count, args);
+
+    if (buffer && n) {
+        buffer[((size_t)ret < n) ? (size_t)ret : n - 1U] = '\0';
+    }
+    return ret;
+}
+
+
+int spanprintf(void (*out)(const char* data, size_t len, void* arg), void* arg, const char* format, ...)
+{
+    va_list va;
+    out_span_wrap_type out_span_wrap;
+    int ret;
+    va_start(va, format);
+    out_span_wrap.fct = out;
+    out_span_wrap.arg = arg;
+    ret = _vsnprintf(_out_span, (char*)(uintptr_t)&out_span_wrap, (size_t)-1, format, va);
+    va_end(va);
+    return ret;
+}
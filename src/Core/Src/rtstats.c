@@ -0,0 +1,119 @@
+/**
+ ******************************************************************************
+ * @file           : rtstats.c
+ * @brief          : Per task CPU time, stack high-water mark and switches
+ ******************************************************************************
+ * The kernel does the counting (see rtstats.h and FreeRTOSConfig.h), this
+ * file only starts the counter and turns the totals into the differences of
+ * one report period.  The last totals are kept per switch counter slot, so a
+ * task keeps its slot as long as there are no more than RTSTATS_MAX_TASKS.
+ ******************************************************************************
+ */
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "binlog.h"
+#include "rtstats.h"
+
+#if defined(USE_RTSTATS)
+
+#if defined(USE_HOST_SIM)
+#include <time.h>
+#endif
+
+volatile uint32_t rtstats_switches[RTSTATS_MAX_TASKS];
+
+static TaskStatus_t rtstats_status[RTSTATS_MAX_TASKS];
+static uint32_t rtstats_last_run[RTSTATS_MAX_TASKS];
+static uint32_t rtstats_last_switches[RTSTATS_MAX_TASKS];
+static uint32_t rtstats_last_total;
+
+/* The counter starts at 0 with the scheduler: the kernel gives the first task
+ * switched out the time since 0.  On the target it is left running when
+ * trace.c started it, whose times must not jump back. */
+#if defined(USE_HOST_SIM)
+static uint64_t rtstats_clock_base;
+
+static uint64_t rtstats_clock_us(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000ULL) + ((uint64_t)ts.tv_nsec / 1000ULL);
+}
+
+void rtstats_clock_init(void)
+{
+    rtstats_clock_base = rtstats_clock_us();
+}
+
+uint32_t rtstats_clock(void)
+{
+    return (uint32_t)(rtstats_clock_us() - rtstats_clock_base);
+}
+#else
+void rtstats_clock_init(void)
+{
+    /* without a cycle counter every task shows 0 %, one already running is
+     * left as it is */
+    if (((DWT->CTRL & DWT_CTRL_NOCYCCNT_Msk) != 0U) || ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) != 0U))
+    {
+        return;
+    }
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t rtstats_clock(void)
+{
+    return DWT->CYCCNT;
+}
+#endif
+
+void rtstats_report(void)
+{
+    const TaskStatus_t *status;
+    UBaseType_t count;
+    UBaseType_t i;
+    uint32_t total;
+    uint32_t elapsed;
+    uint32_t slot;
+    uint32_t run;
+    uint32_t switches;
+    uint32_t permyriad;
+
+    count = uxTaskGetSystemState(rtstats_status, RTSTATS_MAX_TASKS, &total);
+    if (count == 0U)
+    {
+        LOG_PRINTF("rt more than %u tasks\n", (unsigned int)RTSTATS_MAX_TASKS);
+        return;
+    }
+    elapsed = total - rtstats_last_total;
+    rtstats_last_total = total;
+
+    for (i = 0U; i < count; i++)
+    {
+        status = &rtstats_status[i];
+        slot = (uint32_t)status->xTaskNumber & (RTSTATS_MAX_TASKS - 1U);
+
+        run = status->ulRunTimeCounter - rtstats_last_run[slot];
+        rtstats_last_run[slot] = status->ulRunTimeCounter;
+        switches = rtstats_switches[slot];
+        switches -= rtstats_last_switches[slot];
+        rtstats_last_switches[slot] += switches;
+        permyriad = (elapsed != 0U) ? (uint32_t)(((uint64_t)run * 10000U) / elapsed) : 0U;
+
+#if defined(USE_BINLOG)
+        LOG_PRINTF("rt %u cpu %u.%02u%% stack %u sw %u\n", (unsigned int)status->xTaskNumber,
+                   (unsigned int)(permyriad / 100U), (unsigned int)(permyriad % 100U),
+                   (unsigned int)status->usStackHighWaterMark, (unsigned int)switches);
+#else
+        LOG_PRINTF("rt %u %s cpu %u.%02u%% stack %u sw %u\n", (unsigned int)status->xTaskNumber,
+                   status->pcTaskName, (unsigned int)(permyriad / 100U), (unsigned int)(permyriad % 100U),
+                   (unsigned int)status->usStackHighWaterMark, (unsigned int)switches);
+#endif
+    }
+}
+
+#endif
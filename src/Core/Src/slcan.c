@@ -0,0 +1,482 @@
+/**
+ ******************************************************************************
+ * @file           : slcan.c
+ * @brief          : CAN to USART1 gateway, Lawicel (slcan) compatible
+ ******************************************************************************
+ * Everything runs in slcan_task(): the encoding of the frames, the commands
+ * and their answers, so the stream on USART1 is written by one task only and
+ * an answer never lands in the middle of a frame.  The interrupts only fill
+ * the CAN RX ring and the DMA only the RX buffer.
+ *
+ * The bit timings assume PCLK1 = 36 MHz (SystemClock_Config()).
+ ******************************************************************************
+ */
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "console.h"
+#include "can_rx.h"
+#include "can_tx.h"
+#include "can_filter.h"
+#include "slcan.h"
+
+#define SLCAN_RECORD_MAX                32U         /* one encoded frame or answer */
+#define SLCAN_INPUT_SIZE                64U         /* slcan_input(), a power of 2 */
+#define SLCAN_TIMESTAMP_MOD             60000U
+#define SLCAN_BINARY_HEADER             0x80U
+#define SLCAN_OK                        '\r'
+#define SLCAN_ERROR                     '\a'
+
+/* F status bits */
+#define SLCAN_STATUS_RX_FULL            0x01U
+#define SLCAN_STATUS_WARNING            0x04U
+#define SLCAN_STATUS_OVERRUN            0x08U
+#define SLCAN_STATUS_PASSIVE            0x20U
+#define SLCAN_STATUS_BUS_ERROR          0x80U
+
+typedef struct
+{
+    uint32_t prescaler;
+    uint32_t bs1;
+    uint32_t bs2;
+} slcan_rate_t;
+
+/* S0 .. S8 at PCLK1 = 36 MHz */
+static const slcan_rate_t slcan_rates[] = {
+    {200U, CAN_BS1_13TQ, CAN_BS2_4TQ},      /* 10 kbit/s */
+    {100U, CAN_BS1_13TQ, CAN_BS2_4TQ},      /* 20 kbit/s */
+    {40U, CAN_BS1_13TQ, CAN_BS2_4TQ},       /* 50 kbit/s */
+    {20U, CAN_BS1_13TQ, CAN_BS2_4TQ},       /* 100 kbit/s */
+    {16U, CAN_BS1_13TQ, CAN_BS2_4TQ},       /* 125 kbit/s */
+    {8U, CAN_BS1_13TQ, CAN_BS2_4TQ},        /* 250 kbit/s */
+    {9U, CAN_BS1_3TQ, CAN_BS2_4TQ},         /* 500 kbit/s, as MX_CAN_Init() */
+    {5U, CAN_BS1_6TQ, CAN_BS2_2TQ},         /* 800 kbit/s */
+    {4U, CAN_BS1_6TQ, CAN_BS2_2TQ},         /* 1 Mbit/s */
+};
+
+/* Every identifier, half of each IDE space per FIFO */
+static const can_filter_range_t slcan_ranges[] = {
+    {0x000U, 0x3FFU, 0U, CAN_RX_FIFO0},
+    {0x400U, 0x7FFU, 0U, CAN_RX_FIFO1},
+    {0x00000000U, 0x0FFFFFFFU, 1U, CAN_RX_FIFO0},
+    {0x10000000U, 0x1FFFFFFFU, 1U, CAN_RX_FIFO1},
+};
+
+static const char slcan_hex[] = "0123456789ABCDEF";
+
+extern UART_HandleTypeDef huart1;
+
+static CAN_HandleTypeDef *slcan_hcan;
+static DMA_HandleTypeDef slcan_hdma_rx;
+static uint8_t slcan_rx[SLCAN_RX_SIZE];
+static uint32_t slcan_rx_read;
+static char slcan_input_buf[SLCAN_INPUT_SIZE];
+static volatile uint32_t slcan_input_head;
+static volatile uint32_t slcan_input_tail;
+static char slcan_line[SLCAN_LINE_SIZE];
+static uint32_t slcan_line_len;
+static uint8_t slcan_batch[SLCAN_BATCH_SIZE];
+static uint32_t slcan_rate = 6U;
+static uint32_t slcan_open;
+static uint32_t slcan_timestamps;
+static uint32_t slcan_binary;
+static uint32_t slcan_lost;
+static volatile uint32_t slcan_frames;
+
+uint32_t slcan_forwarded(void)
+{
+    return slcan_frames;
+}
+
+static uint8_t *slcan_put_hex(uint8_t *p, uint32_t value, uint32_t digits)
+{
+    while (digits != 0U)
+    {
+        digits--;
+        *p++ = (uint8_t)slcan_hex[(value >> (digits * 4U)) & 0xFU];
+    }
+    return p;
+}
+
+/* One frame, at most SLCAN_RECORD_MAX bytes; returns the length. */
+static uint32_t slcan_encode(const can_rx_frame_t *frame, uint8_t *out)
+{
+    const uint32_t dlc = (frame->dlc < 8U) ? frame->dlc : 8U;
+    const uint32_t n = (frame->rtr != 0U) ? 0U : dlc;
+    const uint32_t stamp = frame->tick % SLCAN_TIMESTAMP_MOD;
+    uint8_t *p = out;
+    uint32_t i;
+
+    if (slcan_binary != 0U)
+    {
+        *p++ = (uint8_t)(SLCAN_BINARY_HEADER | ((uint32_t)frame->ide << 6U) | ((uint32_t)frame->rtr << 5U)
+                         | (slcan_timestamps << 4U) | dlc);
+        if (frame->ide != 0U)
+        {
+            *p++ = (uint8_t)(frame->id >> 24U);
+            *p++ = (uint8_t)(frame->id >> 16U);
+        }
+        *p++ = (uint8_t)(frame->id >> 8U);
+        *p++ = (uint8_t)frame->id;
+        memcpy(p, frame->data, n);
+        p += n;
+        if (slcan_timestamps != 0U)
+        {
+            *p++ = (uint8_t)(stamp >> 8U);
+            *p++ = (uint8_t)stamp;
+        }
+        return (uint32_t)(p - out);
+    }
+
+    if (frame->ide != 0U)
+    {
+        *p++ = (frame->rtr != 0U) ? 'R' : 'T';
+        p = slcan_put_hex(p, frame->id, 8U);
+    }
+    else
+    {
+        *p++ = (frame->rtr != 0U) ? 'r' : 't';
+        p = slcan_put_hex(p, frame->id, 3U);
+    }
+    *p++ = (uint8_t)('0' + dlc);
+    for (i = 0U; i < n; i++)
+    {
+        *p++ = (uint8_t)slcan_hex[frame->data[i] >> 4U];
+        *p++ = (uint8_t)slcan_hex[frame->data[i] & 0xFU];
+    }
+    if (slcan_timestamps != 0U)
+    {
+        p = slcan_put_hex(p, stamp, 4U);
+    }
+    *p++ = '\r';
+    return (uint32_t)(p - out);
+}
+
+/* digits hex digits of line at *pos, or HAL_ERROR. */
+static HAL_StatusTypeDef slcan_get_hex(const char *line, uint32_t len, uint32_t *pos, uint32_t digits,
+                                       uint32_t *value)
+{
+    uint32_t v = 0U;
+    char c;
+
+    if ((*pos + digits) > len)
+    {
+        return HAL_ERROR;
+    }
+    while (digits != 0U)
+    {
+        c = line[(*pos)++];
+        if ((c >= '0') && (c <= '9'))
+        {
+            v = (v << 4U) | (uint32_t)(c - '0');
+        }
+        else if ((c >= 'A') && (c <= 'F'))
+        {
+            v = (v << 4U) | (uint32_t)(c - 'A' + 10);
+        }
+        else if ((c >= 'a') && (c <= 'f'))
+        {
+            v = (v << 4U) | (uint32_t)(c - 'a' + 10);
+        }
+        else
+        {
+            return HAL_ERROR;
+        }
+        digits--;
+    }
+    *value = v;
+    return HAL_OK;
+}
+
+/* t, T, r and R */
+static HAL_StatusTypeDef slcan_send(const char *line, uint32_t len)
+{
+    CAN_TxHeaderTypeDef header;
+    uint8_t data[8];
+    const uint32_t ext = ((line[0] == 'T') || (line[0] == 'R')) ? 1U : 0U;
+    const uint32_t rtr = ((line[0] == 'r') || (line[0] == 'R')) ? 1U : 0U;
+    uint32_t pos = 1U;
+    uint32_t id;
+    uint32_t dlc;
+    uint32_t byte;
+    uint32_t i;
+
+    if ((slcan_open != 1U) || (slcan_get_hex(line, len, &pos, (ext != 0U) ? 8U : 3U, &id) != HAL_OK)
+        || (slcan_get_hex(line, len, &pos, 1U, &dlc) != HAL_OK) || (dlc > 8U)
+        || (id > ((ext != 0U) ? 0x1FFFFFFFU : 0x7FFU)) || (len != (pos + ((rtr != 0U) ? 0U : (dlc * 2U)))))
+    {
+        return HAL_ERROR;
+    }
+    for (i = 0U; (rtr == 0U) && (i < dlc); i++)
+    {
+        if (slcan_get_hex(line, len, &pos, 2U, &byte) != HAL_OK)
+        {
+            return HAL_ERROR;
+        }
+        data[i] = (uint8_t)byte;
+    }
+    header.StdId = (ext != 0U) ? 0U : id;
+    header.ExtId = (ext != 0U) ? id : 0U;
+    header.IDE = (ext != 0U) ? CAN_ID_EXT : CAN_ID_STD;
+    header.RTR = (rtr != 0U) ? CAN_RTR_REMOTE : CAN_RTR_DATA;
+    header.DLC = dlc;
+    header.TransmitGlobalTime = DISABLE;
+    return can_tx_send(&header, data);
+}
+
+/* O and L: 1 normal, 2 listen only */
+static HAL_StatusTypeDef slcan_set_open(uint32_t open)
+{
+    const slcan_rate_t *rate = &slcan_rates[slcan_rate];
+
+    if ((open != 0U) == (slcan_open != 0U))
+    {
+        return HAL_ERROR;
+    }
+    (void)HAL_CAN_Stop(slcan_hcan);
+    slcan_open = open;
+    if (open == 0U)
+    {
+        return HAL_OK;
+    }
+    slcan_hcan->Init.Mode = (open == 2U) ? CAN_MODE_SILENT : CAN_MODE_NORMAL;
+    slcan_hcan->Init.Prescaler = rate->prescaler;
+    slcan_hcan->Init.SyncJumpWidth = CAN_SJW_1TQ;
+    slcan_hcan->Init.TimeSeg1 = rate->bs1;
+    slcan_hcan->Init.TimeSeg2 = rate->bs2;
+    if ((HAL_CAN_Init(slcan_hcan) != HAL_OK) || (HAL_CAN_Start(slcan_hcan) != HAL_OK))
+    {
+        slcan_open = 0U;
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+static uint32_t slcan_status(void)
+{
+    const uint32_t esr = slcan_hcan->Instance->ESR;
+    const uint32_t lost = can_rx_dropped() + console_dropped();
+    uint32_t status = 0U;
+
+    status |= (can_rx_pending() >= CAN_RX_QUEUE_SIZE) ? SLCAN_STATUS_RX_FULL : 0U;
+    status |= ((esr & CAN_ESR_EWGF) != 0U) ? SLCAN_STATUS_WARNING : 0U;
+    status |= (lost != slcan_lost) ? SLCAN_STATUS_OVERRUN : 0U;
+    status |= ((esr & CAN_ESR_EPVF) != 0U) ? SLCAN_STATUS_PASSIVE : 0U;
+    status |= ((esr & CAN_ESR_LEC) != 0U) ? SLCAN_STATUS_BUS_ERROR : 0U;
+    slcan_lost = lost;
+    return status;
+}
+
+/* One command line without its \r; the answer goes to out.  Returns its
+ * length. */
+static uint32_t slcan_command(const char *line, uint32_t len, uint8_t *out)
+{
+    static const char *const versions[] = {"V0101\r", "v0101\r", "N0001\r"};
+    HAL_StatusTypeDef status = HAL_ERROR;
+    const char *answer = NULL;
+    uint8_t *p = out;
+    uint32_t arg = 0U;
+
+    if (len == 0U)
+    {
+        *p++ = SLCAN_OK;
+        return 1U;
+    }
+    switch (line[0])
+    {
+    case 'S':
+        if ((len == 2U) && (slcan_open == 0U) && (line[1] >= '0') && (line[1] <= '8'))
+        {
+            slcan_rate = (uint32_t)(line[1] - '0');
+            status = HAL_OK;
+        }
+        break;
+    case 'O':
+    case 'L':
+    case 'C':
+        status = (len == 1U) ? slcan_set_open((line[0] == 'O') ? 1U : ((line[0] == 'L') ? 2U : 0U)) : HAL_ERROR;
+        break;
+    case 't':
+    case 'r':
+    case 'T':
+    case 'R':
+        if (slcan_send(line, len) == HAL_OK)
+        {
+            answer = ((line[0] == 't') || (line[0] == 'r')) ? "z\r" : "Z\r";
+        }
+        break;
+    case 'F':
+        if (len == 1U)
+        {
+            *p++ = 'F';
+            p = slcan_put_hex(p, slcan_status(), 2U);
+            *p++ = '\r';
+            return (uint32_t)(p - out);
+        }
+        break;
+    case 'Z':
+    case 'B':
+        if ((len == 2U) && ((line[1] == '0') || (line[1] == '1')))
+        {
+            arg = (uint32_t)(line[1] - '0');
+            if (line[0] == 'Z')
+            {
+                slcan_timestamps = arg;
+            }
+            else
+            {
+                slcan_binary = arg;
+            }
+            status = HAL_OK;
+        }
+        break;
+    case 'V':
+    case 'v':
+    case 'N':
+        answer = (len == 1U) ? versions[(line[0] == 'V') ? 0U : ((line[0] == 'v') ? 1U : 2U)] : NULL;
+        break;
+    default:
+        break;
+    }
+
+    if (answer != NULL)
+    {
+        arg = (uint32_t)strlen(answer);
+        memcpy(out, answer, arg);
+        return arg;
+    }
+    *p++ = (status == HAL_OK) ? SLCAN_OK : SLCAN_ERROR;
+    return (uint32_t)(p - out);
+}
+
+/* Adds one received byte to the line, runs the line at \r.  Returns the
+ * length of the answer written to out. */
+static uint32_t slcan_take_byte(char c, uint8_t *out)
+{
+    uint32_t len;
+
+    if (c == '\r')
+    {
+        /* a line too long for any command is refused */
+        len = (slcan_line_len <= SLCAN_LINE_SIZE) ? slcan_command(slcan_line, slcan_line_len, out) : 0U;
+        if (len == 0U)
+        {
+            *out = SLCAN_ERROR;
+            len = 1U;
+        }
+        slcan_line_len = 0U;
+        return len;
+    }
+    if (c != '\n')
+    {
+        if (slcan_line_len < SLCAN_LINE_SIZE)
+        {
+            slcan_line[slcan_line_len] = c;
+        }
+        slcan_line_len += (slcan_line_len <= SLCAN_LINE_SIZE) ? 1U : 0U;
+    }
+    return 0U;
+}
+
+/* The commands received since the last pass, answers appended to the batch
+ * from len on.  Returns the new length. */
+static uint32_t slcan_commands(uint32_t len)
+{
+    uint32_t write;
+
+    /* the reception stops on a UART error, start it again */
+    if (huart1.RxState == HAL_UART_STATE_READY)
+    {
+        slcan_rx_read = 0U;
+        (void)HAL_UART_Receive_DMA(&huart1, slcan_rx, (uint16_t)SLCAN_RX_SIZE);
+    }
+    write = SLCAN_RX_SIZE - __HAL_DMA_GET_COUNTER(&slcan_hdma_rx);
+    while ((slcan_rx_read != write) && (len <= (SLCAN_BATCH_SIZE - SLCAN_RECORD_MAX)))
+    {
+        len += slcan_take_byte((char)slcan_rx[slcan_rx_read], &slcan_batch[len]);
+        slcan_rx_read = (slcan_rx_read + 1U) % SLCAN_RX_SIZE;
+    }
+    while ((slcan_input_tail != __atomic_load_n(&slcan_input_head, __ATOMIC_ACQUIRE))
+           && (len <= (SLCAN_BATCH_SIZE - SLCAN_RECORD_MAX)))
+    {
+        len += slcan_take_byte(slcan_input_buf[slcan_input_tail % SLCAN_INPUT_SIZE], &slcan_batch[len]);
+        __atomic_store_n(&slcan_input_tail, slcan_input_tail + 1U, __ATOMIC_RELEASE);
+    }
+    return len;
+}
+
+uint32_t slcan_input(const char *data, uint32_t len)
+{
+    UBaseType_t mask;
+    uint32_t head;
+    uint32_t i;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    head = slcan_input_head;
+    for (i = 0U; (i < len) && ((head - slcan_input_tail) < SLCAN_INPUT_SIZE); i++)
+    {
+        slcan_input_buf[head % SLCAN_INPUT_SIZE] = data[i];
+        head++;
+    }
+    __atomic_store_n(&slcan_input_head, head, __ATOMIC_RELEASE);
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    return i;
+}
+
+void slcan_init(CAN_HandleTypeDef *hcan)
+{
+    static can_filter_plan_t plan;
+
+    slcan_hcan = hcan;
+    if (can_filter_plan(slcan_ranges, sizeof(slcan_ranges) / sizeof(slcan_ranges[0]), CAN_FILTER_BANKS, &plan)
+        != HAL_OK)
+    {
+        Error_Handler();
+    }
+    (void)HAL_CAN_Stop(hcan);
+    (void)can_filter_program(hcan, &plan);
+
+    /* circular, no interrupt: the task polls CNDTR */
+    slcan_hdma_rx.Instance = DMA1_Channel5;
+    slcan_hdma_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    slcan_hdma_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    slcan_hdma_rx.Init.MemInc = DMA_MINC_ENABLE;
+    slcan_hdma_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    slcan_hdma_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    slcan_hdma_rx.Init.Mode = DMA_CIRCULAR;
+    slcan_hdma_rx.Init.Priority = DMA_PRIORITY_HIGH;
+    if (HAL_DMA_Init(&slcan_hdma_rx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    __HAL_LINKDMA(&huart1, hdmarx, slcan_hdma_rx);
+    (void)HAL_UART_Receive_DMA(&huart1, slcan_rx, (uint16_t)SLCAN_RX_SIZE);
+}
+
+void slcan_task(void const *argument)
+{
+    can_rx_frame_t frame;
+    uint32_t len;
+
+    (void)argument;
+
+    for (;;)
+    {
+        len = slcan_commands(0U);
+        /* waits a tick at most, for the commands */
+        if (can_rx_receive(&frame, (len != 0U) ? 0U : 1U) != 0U)
+        {
+            do
+            {
+                len += slcan_encode(&frame, &slcan_batch[len]);
+                __atomic_store_n(&slcan_frames, slcan_frames + 1U, __ATOMIC_RELAXED);
+            } while ((len <= (SLCAN_BATCH_SIZE - SLCAN_RECORD_MAX)) && (can_rx_receive(&frame, 0U) != 0U));
+        }
+        if (len != 0U)
+        {
+            (void)console_write((const char *)slcan_batch, len);
+        }
+    }
+}
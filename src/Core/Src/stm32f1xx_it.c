@@ -22,6 +22,8 @@
 #include "stm32f1xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "trace.h"
+#include "kernel_bench.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -56,6 +58,8 @@
 
 /* External variables --------------------------------------------------------*/
 extern CAN_HandleTypeDef hcan;
+extern DMA_HandleTypeDef hdma_usart1_tx;
+extern UART_HandleTypeDef huart1;
 extern TIM_HandleTypeDef htim1;
 
 /* USER CODE BEGIN EV */
@@ -160,28 +164,85 @@ void DebugMon_Handler(void)
 /* please refer to the startup file (startup_stm32f1xx.s).                    */
 /******************************************************************************/
 
+/**
+  * @brief This function handles DMA1 channel4 global interrupt.
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Channel4_IRQn 0 */
+  TRACE_ISR_ENTER(DMA1_Channel4_IRQn);
+  /* USER CODE END DMA1_Channel4_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_usart1_tx);
+  /* USER CODE BEGIN DMA1_Channel4_IRQn 1 */
+  TRACE_ISR_EXIT(DMA1_Channel4_IRQn);
+  /* USER CODE END DMA1_Channel4_IRQn 1 */
+}
+
+/**
+  * @brief This function handles USB high priority or CAN TX interrupts.
+  */
+void USB_HP_CAN1_TX_IRQHandler(void)
+{
+  /* USER CODE BEGIN USB_HP_CAN1_TX_IRQn 0 */
+  TRACE_ISR_ENTER(USB_HP_CAN1_TX_IRQn);
+  /* USER CODE END USB_HP_CAN1_TX_IRQn 0 */
+  HAL_CAN_IRQHandler(&hcan);
+  /* USER CODE BEGIN USB_HP_CAN1_TX_IRQn 1 */
+  TRACE_ISR_EXIT(USB_HP_CAN1_TX_IRQn);
+  /* USER CODE END USB_HP_CAN1_TX_IRQn 1 */
+}
+
 /**
   * @brief This function handles USB low priority or CAN RX0 interrupts.
   */
 void USB_LP_CAN1_RX0_IRQHandler(void)
 {
   /* USER CODE BEGIN USB_LP_CAN1_RX0_IRQn 0 */
-
+  TRACE_ISR_ENTER(USB_LP_CAN1_RX0_IRQn);
   /* USER CODE END USB_LP_CAN1_RX0_IRQn 0 */
   HAL_CAN_IRQHandler(&hcan);
   /* USER CODE BEGIN USB_LP_CAN1_RX0_IRQn 1 */
-
+  TRACE_ISR_EXIT(USB_LP_CAN1_RX0_IRQn);
   /* USER CODE END USB_LP_CAN1_RX0_IRQn 1 */
 }
 
+/**
+  * @brief This function handles CAN RX1 interrupt.
+  */
+void CAN1_RX1_IRQHandler(void)
+{
+  /* USER CODE BEGIN CAN1_RX1_IRQn 0 */
+  TRACE_ISR_ENTER(CAN1_RX1_IRQn);
+  /* USER CODE END CAN1_RX1_IRQn 0 */
+  HAL_CAN_IRQHandler(&hcan);
+  /* USER CODE BEGIN CAN1_RX1_IRQn 1 */
+  TRACE_ISR_EXIT(CAN1_RX1_IRQn);
+  /* USER CODE END CAN1_RX1_IRQn 1 */
+}
+
 /**
   * @brief This function handles TIM1 update interrupt.
   */
 void TIM1_UP_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM1_UP_IRQn 0 */
+  KERNEL_BENCH_ISR_ENTER();
+  TRACE_ISR_ENTER(TIM1_UP_IRQn);
     /* ͨעӿڵĵstartup_stm32f1xx.sġ̵
      * CзҲȷûҵCлĵõ㡣طԴ˽ӿ*/
+  /* The update is the only interrupt of the time base: the tick goes
+   * straight to HAL_IncTick() and returns before the generated
+   * HAL_TIM_IRQHandler() below, which would test every flag and take the
+   * tick a second time through HAL_TIM_PeriodElapsedCallback().  UIF is
+   * still tested: a request left latched in the NVIC must not take a tick. */
+  if ((TIM1->SR & TIM_SR_UIF) != 0U)
+  {
+    TIM1->SR = ~(uint32_t)TIM_SR_UIF;
+    HAL_IncTick();
+  }
+  TRACE_ISR_EXIT(TIM1_UP_IRQn);
+  KERNEL_BENCH_ISR_EXIT();
+  return;
   /* USER CODE END TIM1_UP_IRQn 0 */
   HAL_TIM_IRQHandler(&htim1);
   /* USER CODE BEGIN TIM1_UP_IRQn 1 */
@@ -189,6 +250,20 @@ void TIM1_UP_IRQHandler(void)
   /* USER CODE END TIM1_UP_IRQn 1 */
 }
 
+/**
+  * @brief This function handles USART1 global interrupt.
+  */
+void USART1_IRQHandler(void)
+{
+  /* USER CODE BEGIN USART1_IRQn 0 */
+  TRACE_ISR_ENTER(USART1_IRQn);
+  /* USER CODE END USART1_IRQn 0 */
+  HAL_UART_IRQHandler(&huart1);
+  /* USER CODE BEGIN USART1_IRQn 1 */
+  TRACE_ISR_EXIT(USART1_IRQn);
+  /* USER CODE END USART1_IRQn 1 */
+}
+
 /* USER CODE BEGIN 1 */
 
 /* USER CODE END 1 */
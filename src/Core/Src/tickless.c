@@ -0,0 +1,200 @@
+/**
+ ******************************************************************************
+ * @file           : tickless.c
+ * @brief          : Tickless idle on the TIM1 time base
+ ******************************************************************************
+ * See tickless.h.  The counter period runs from the last update event to
+ * ARR; base is the boundary of the tick running, the ticks before it are
+ * counted already, by interrupt or stepped.  ARR is only written at least
+ * TICKLESS_GUARD counts ahead of the counter, the time it takes from reading
+ * CNT to the write: ARR written behind the counter would let it run up to
+ * 0xFFFF.  Every write is checked, a late one is done again.
+ ******************************************************************************
+ */
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "isotp.h"
+#include "xcp.h"
+#include "tickless.h"
+
+#if defined(USE_HOST_SIM)
+/* the registers of the model change at its syncs, which take some us */
+#define TICKLESS_GUARD                  100U
+#define TICKLESS_SYNC()                 host_periph_sync()
+#define TICKLESS_IRQ_DISABLE()          portDISABLE_INTERRUPTS()
+#define TICKLESS_IRQ_ENABLE()           portENABLE_INTERRUPTS()
+#define TICKLESS_WFI()                  vPortHostWaitForInterrupt()
+#else
+#define TICKLESS_GUARD                  4U
+#define TICKLESS_SYNC()
+#define TICKLESS_IRQ_DISABLE()          __disable_irq()
+#define TICKLESS_IRQ_ENABLE()           __enable_irq()
+#define TICKLESS_WFI()                                                            \
+    do                                                                            \
+    {                                                                             \
+        __DSB();                                                                  \
+        __WFI();                                                                  \
+        __ISB();                                                                  \
+    } while (0)
+#endif
+
+#define TICKLESS_TOP                    0x10000U    /* counter range */
+
+static tickless_stats_t tickless_stats;
+
+/* Ends the counter period at the boundary after the count, once the count
+ * is far enough from it.  Returns the whole ticks from base to the count;
+ * *wrapped tells that the period ended at ARR meanwhile, base is 0 then.
+ * UIF must be clear on entry or be the end of this period.  With *wrapped
+ * set on entry (the tick interrupt, UIF just cleared), a period that ends
+ * while waiting for the count adds its ticks but the last, which its update
+ * interrupt brings. */
+static uint32_t tickless_stop(uint32_t base, uint32_t *wrapped)
+{
+    uint32_t passed = 0U;
+    uint32_t uif = 0U;
+    uint32_t cnt;
+    uint32_t arr;
+
+    for (;;)
+    {
+        TICKLESS_SYNC();
+        /* CNT first: with UIF still clear after it, it is a count of this
+         * period */
+        cnt = TIM1->CNT;
+        if ((uif == 0U) && ((TIM1->SR & TIM_SR_UIF) != 0U))
+        {
+            if (*wrapped != 0U)
+            {
+                passed += ((TIM1->ARR + 1U) / TICKLESS_COUNTS) - 1U;
+            }
+            *wrapped = 1U;
+            uif = TIM_SR_UIF;
+            base = 0U;
+            continue;
+        }
+        if (((cnt - base) % TICKLESS_COUNTS) >= (TICKLESS_COUNTS - TICKLESS_GUARD))
+        {
+            continue;
+        }
+
+        arr = cnt - ((cnt - base) % TICKLESS_COUNTS) + TICKLESS_COUNTS - 1U;
+        TIM1->ARR = arr;
+        TICKLESS_SYNC();
+        if (TIM1->CNT <= arr)
+        {
+            return passed + ((cnt - base) / TICKLESS_COUNTS);
+        }
+    }
+}
+
+void tickless_sleep(TickType_t expected)
+{
+    uint32_t cnt;
+    uint32_t base;
+    uint32_t length;
+    uint32_t ticks;
+    uint32_t wrapped = 0U;
+
+    TICKLESS_IRQ_DISABLE();
+    TICKLESS_SYNC();
+    if ((isotp_busy() != 0U) || (XCP_BUSY() != 0U))
+    {
+        tickless_stats.held++;
+        TICKLESS_IRQ_ENABLE();
+        return;
+    }
+
+    cnt = TIM1->CNT;
+    base = cnt - (cnt % TICKLESS_COUNTS);
+    if (expected > ((TICKLESS_TOP - base) / TICKLESS_COUNTS))
+    {
+        expected = (TICKLESS_TOP - base) / TICKLESS_COUNTS;
+    }
+    if ((eTaskConfirmSleepModeStatus() == eAbortSleep) || ((TIM1->SR & TIM_SR_UIF) != 0U) ||
+        (expected < configEXPECTED_IDLE_TIME_BEFORE_SLEEP))
+    {
+        tickless_stats.aborted++;
+        TICKLESS_IRQ_ENABLE();
+        return;
+    }
+
+    TIM1->ARR = base + (expected * TICKLESS_COUNTS) - 1U;
+    TICKLESS_SYNC();
+    if ((TIM1->SR & TIM_SR_UIF) != 0U)
+    {
+        /* the tick running ended before the write, the counter already
+         * runs the next one: tickless_stop() finds UIF */
+        length = 1U;
+        tickless_stats.aborted++;
+    }
+    else
+    {
+        length = expected;
+        TICKLESS_WFI();
+        tickless_stats.sleeps++;
+    }
+
+    /* The update interrupt at the end brings the last tick of the sleep,
+     * the one of the tick running after an early end comes at its
+     * boundary. */
+    ticks = tickless_stop(base, &wrapped);
+    if (wrapped != 0U)
+    {
+        if (ticks != 0U)
+        {
+            /* Woken a tick or more after the end: the update interrupt
+             * would put ARR back behind the counter, its tick is counted
+             * here instead.  The NVIC has latched the request already,
+             * clearing UIF does not take it back. */
+            TIM1->SR = ~(uint32_t)TIM_SR_UIF;
+            NVIC_ClearPendingIRQ(TIM1_UP_IRQn);
+            TICKLESS_SYNC();
+            ticks++;
+        }
+        ticks += length - 1U;
+    }
+    else
+    {
+        tickless_stats.early++;
+    }
+    tickless_stats.stepped += ticks;
+    uwTick += ticks * uwTickFreq;
+
+    /* The kernel takes no more than the ticks to the next task to wake, a
+     * late wake from the end of the sleep has the others pended. */
+    if (ticks > (expected - 1U))
+    {
+        vTaskStepTick(expected - 1U);
+        for (ticks -= expected - 1U; ticks > 0U; ticks--)
+        {
+            (void)xTaskIncrementTick();
+        }
+    }
+    else
+    {
+        vTaskStepTick(ticks);
+    }
+
+    TICKLESS_IRQ_ENABLE();
+}
+
+uint32_t tickless_tick(void)
+{
+    uint32_t wrapped = 1U;
+
+    /* Back to one tick per period.  An interrupt taken a tick or more after
+     * its update would put ARR behind the counter: the period ends at the
+     * next boundary instead. */
+    return tickless_stop(0U, &wrapped);
+}
+
+void tickless_get(tickless_stats_t *stats)
+{
+    UBaseType_t mask;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    *stats = tickless_stats;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
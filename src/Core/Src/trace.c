@@ -0,0 +1,95 @@
+/**
+ ******************************************************************************
+ * @file           : trace.c
+ * @brief          : Kernel and interrupt event trace in a RAM ring
+ ******************************************************************************
+ * trace_record() is on the path of every task switch, queue operation and
+ * interrupt, so it is one atomic increment, one read of the clock and two
+ * stores, no lock and no check.
+ ******************************************************************************
+ */
+#include "main.h"
+#include "trace.h"
+
+#if defined(USE_HOST_SIM)
+#include <time.h>
+#endif
+
+trace_buffer_t trace_buffer;
+
+static uint32_t trace_queues;
+
+#if defined(USE_HOST_SIM)
+static uint64_t trace_clock_base;
+
+static inline uint64_t trace_clock_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t trace_clock(void)
+{
+    return (uint32_t)(trace_clock_ns() - trace_clock_base);
+}
+
+static uint32_t trace_clock_init(void)
+{
+    trace_clock_base = trace_clock_ns();
+    return 1000000000U;
+}
+#else
+static inline uint32_t trace_clock(void)
+{
+    return DWT->CYCCNT;
+}
+
+static uint32_t trace_clock_init(void)
+{
+    /* without a cycle counter all records have the time 0 */
+    if ((DWT->CTRL & DWT_CTRL_NOCYCCNT_Msk) == 0U)
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    return SystemCoreClock;
+}
+#endif
+
+void trace_init(void)
+{
+    trace_buffer.frequency = trace_clock_init();
+    trace_buffer.records = TRACE_RECORDS;
+    trace_buffer.tasks = TRACE_TASKS;
+    trace_buffer.name_len = TRACE_NAME_LEN;
+    trace_buffer.head = 0U;
+    trace_buffer.magic = TRACE_MAGIC;
+}
+
+void trace_record(uint32_t event, uint32_t id, uint32_t arg)
+{
+    uint32_t slot = __atomic_fetch_add(&trace_buffer.head, 1U, __ATOMIC_RELAXED);
+    trace_record_t *record = &trace_buffer.ring[slot & (TRACE_RECORDS - 1U)];
+
+    record->time = trace_clock();
+    record->info = event | ((id & 0xFFU) << 8) | (arg << 16);
+}
+
+void trace_task_create(uint32_t number, const char *name)
+{
+    char *slot = trace_buffer.names[number & (TRACE_TASKS - 1U)];
+    uint32_t i;
+
+    for (i = 0U; (i < (TRACE_NAME_LEN - 1U)) && (name[i] != '\0'); i++)
+    {
+        slot[i] = name[i];
+    }
+    slot[i] = '\0';
+}
+
+uint32_t trace_queue_create(void)
+{
+    return __atomic_add_fetch(&trace_queues, 1U, __ATOMIC_RELAXED);
+}
@@ -12,6 +12,21 @@
 #include "string.h"
 #include "cmsis_gcc.h"
 #include "user.h"
+#include "console.h"
+#include "binlog.h"
+#include "can_tx.h"
+#include "can_rx.h"
+#include "can_filter.h"
+#include "can_dispatch.h"
+#include "isotp.h"
+#include "can_stats.h"
+#include "user_dbc.h"
+#include "xcp.h"
+#include "rtstats.h"
+#include "tickless.h"
+#if defined(USE_KERNEL_BENCH)
+#include "kernel_bench.h"
+#endif
 
 void user_gpio_test_func(void);
 void user_can_test_func(void);
@@ -20,10 +35,19 @@ uint32_t os_lld_task_1000ms_counter;
 UBaseType_t uxHighWaterMark_500ms;
 UBaseType_t uxHighWaterMark_1000ms;
 CAN_TxHeaderTypeDef user_can_tx_header;
-CAN_RxHeaderTypeDef user_can_rx_header;
 uint8_t user_can_tx_data[8];
-uint8_t user_can_rx_data[8];
-uint32_t tx_buffer;
+uint32_t user_can_rx_frames;
+uint32_t user_can_rx_unrouted;
+uint32_t user_can_rx_status;
+uint32_t user_can_rx_command;
+volatile uint32_t user_tick_kernel;
+
+extern void xPortSysTickHandler(void);
+
+static can_dispatch_t user_can_dispatch;
+
+/* tx_id, rx_id, ide, block_size, st_min */
+const isotp_config_t user_isotp_config = {0x7E8U, 0x7E0U, 0U, 8U, 0U};
 
 void freertos_lld_task_500ms(void *argument)
 {
@@ -34,8 +58,9 @@ void freertos_lld_task_500ms(void *argument)
     for (;;)
     {
         vTaskDelay(500U);
+        XCP_EVENT(XCP_EVENT_500MS);
         uxHighWaterMark_500ms = uxTaskGetStackHighWaterMark(NULL);
-        printf("water mark fo task 500ms: %d\n", uxHighWaterMark_500ms);
+        LOG_PRINTF("water mark fo task 500ms: %u\n", (unsigned int)uxHighWaterMark_500ms);
     }
 }
 
@@ -49,32 +74,127 @@ void freertos_lld_1000ms_task(void *argument)
         uint32_t i = 0U;
         os_lld_task_1000ms_counter++;
         user_gpio_test_func();
+#if defined(USE_SLCAN)
+        (void)i; /* the gateway sends the frames of the host only */
+#else
         for(i = 0U; i < 1U * 9U; i++)
         {
             user_can_test_func();
         }
+#endif
+        LOG_PRINTF("CAN tx queued: %u dropped: %u failed: %u\n", (unsigned int)can_tx_pending(),
+                   (unsigned int)can_tx_dropped(), (unsigned int)can_tx_failed());
+        LOG_PRINTF("CAN rx frames: %u dropped: %u unrouted: %u\n", (unsigned int)user_can_rx_frames,
+                   (unsigned int)can_rx_dropped(), (unsigned int)user_can_rx_unrouted);
+#if defined(USE_CAN_STATS)
+        can_stats_dump();
+#endif
+        RTSTATS_REPORT();
         vTaskDelay(1000U);
-        printf("%d:----------------------------------------------\n", os_lld_task_1000ms_counter);
+        LOG_PRINTF("%u:----------------------------------------------\n", (unsigned int)os_lld_task_1000ms_counter);
         uxHighWaterMark_1000ms = uxTaskGetStackHighWaterMark(NULL);
-        printf("water mark fo task 1000ms: %d\n", uxHighWaterMark_1000ms);
+        LOG_PRINTF("water mark fo task 1000ms: %u\n", (unsigned int)uxHighWaterMark_1000ms);
+    }
+}
+
+/* The one consumer of the CAN RX ring. */
+void freertos_lld_can_rx_task(void const *argument)
+{
+    can_rx_frame_t frame;
+
+    (void)argument;
+
+    for (;;)
+    {
+        if (can_rx_receive(&frame, portMAX_DELAY) != 0U)
+        {
+            user_can_rx_frames++;
+            if (can_dispatch(&user_can_dispatch, &frame) == 0U)
+            {
+                user_can_rx_unrouted++;
+            }
+        }
     }
 }
 
 void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName)
 {
-    printf("stack overflow found.\n");
+    LOG_PRINTF("stack overflow found.\n");
+}
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+/* The storage of the tasks the kernel creates itself. */
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer,
+                                   uint32_t *pulIdleTaskStackSize)
+{
+    static StaticTask_t tcb;
+    static StackType_t stack[configMINIMAL_STACK_SIZE];
+
+    *ppxIdleTaskTCBBuffer = &tcb;
+    *ppxIdleTaskStackBuffer = stack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+#if (configUSE_TIMERS == 1)
+void vApplicationGetTimerTaskMemory(StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer,
+                                    uint32_t *pulTimerTaskStackSize)
+{
+    static StaticTask_t tcb;
+    static StackType_t stack[configTIMER_TASK_STACK_DEPTH];
+
+    *ppxTimerTaskTCBBuffer = &tcb;
+    *ppxTimerTaskStackBuffer = stack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
 }
+#endif
+#endif
 
+/* The tick, called by TIM1_UP_IRQHandler().  uwTick counts the milliseconds of
+ * HAL_GetTick() from HAL_Init() on, the kernel takes the tick from the start
+ * of its scheduler (vPortSetupTimerInterrupt()). */
 void HAL_IncTick(void)
 {
-    osSystickHandler();
+    uint32_t ticks;
+
+    /* a late interrupt of the tickless idle brings the ticks it passed too */
+    for (ticks = TICKLESS_TICK() + 1U; ticks > 0U; ticks--)
+    {
+        uwTick += uwTickFreq;
+        if (user_tick_kernel != 0U)
+        {
+#if defined(USE_KERNEL_BENCH)
+            kernel_bench_tick_enter();
+            xPortSysTickHandler();
+            kernel_bench_tick_exit();
+#else
+            xPortSysTickHandler();
+#endif
+        }
+    }
+    isotp_tick();
+    CAN_STATS_TICK();
+    XCP_EVENT(XCP_EVENT_1MS);
 }
 
 void _putchar(char character)
 {
-    char c = character;
+    (void)console_write(&character, 1U);
+}
 
-    HAL_UART_Transmit(&huart1, (uint8_t *)&c, 1U, 0xFFFFFFFFU);
+void _putspan(const char *data, size_t len)
+{
+    (void)console_write(data, (uint32_t)len);
+}
+
+/* A full log ring: tasks give the drainer a tick, interrupts drop. */
+uint32_t logline_wait(void)
+{
+    if ((__get_IPSR() != 0U) || (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING))
+    {
+        return 0U;
+    }
+    vTaskDelay(1U);
+    return 1U;
 }
 
 void user_gpio_test_func(void)
@@ -82,37 +202,70 @@ void user_gpio_test_func(void)
     HAL_GPIO_TogglePin(mcu_pin_pc13_led_GPIO_Port, mcu_pin_pc13_led_Pin);
 }
 
+/* USER_TEST of Core/Dbc/user.dbc */
 void user_can_test_func(void)
 {
-    uint8_t csend[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+    static uint8_t counter;
+    uint8_t csend[8];
+    user_test_t msg;
+
+    msg.counter = counter++;
+    msg.led = (HAL_GPIO_ReadPin(mcu_pin_pc13_led_GPIO_Port, mcu_pin_pc13_led_Pin) == GPIO_PIN_SET) ? 1U : 0U;
+    msg.tx_pending = (uint8_t)can_tx_pending();
+    msg.uptime = HAL_GetTick();
+    can_dbc_store(csend, user_test_pack(&msg));
 
     user_can_tx_header.IDE = CAN_ID_STD;
-    user_can_tx_header.StdId = 0x77U;
+    user_can_tx_header.StdId = USER_TEST_ID;
+    user_can_tx_header.DLC = USER_TEST_DLC;
     user_can_tx_header.RTR = CAN_RTR_DATA;
     user_can_tx_header.TransmitGlobalTime = DISABLE;
-    HAL_CAN_AddTxMessage(&hcan, &user_can_tx_header, csend, &tx_buffer);
+    (void)can_tx_send(&user_can_tx_header, csend);
+}
 
-    printf("mailbox used for CAN tx: %d\n", tx_buffer);
+static void user_can_on_status(const can_rx_frame_t *frame)
+{
+    (void)frame;
+    user_can_rx_status++;
 }
 
-void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan1)
+static void user_can_on_command(const can_rx_frame_t *frame)
 {
-    HAL_CAN_GetRxMessage(hcan1, CAN_RX_FIFO0, &user_can_rx_header, user_can_rx_data);
+    (void)frame;
+    user_can_rx_command++;
 }
 
+/* The identifiers received, every other frame is dropped by the filters
+ * before it takes an interrupt, and the handler of each range.  The frames
+ * of the ISO-TP link are taken by isotp.c in the interrupt and never reach
+ * the handlers. */
+static const can_filter_range_t user_can_rx_ids[] = {
+    {0x100U, 0x1FFU, 0U, CAN_RX_FIFO0},
+    {0x500U, 0x5FFU, 0U, CAN_RX_FIFO1},
+    {0x7E0U, 0x7E0U, 0U, CAN_RX_FIFO0},
+#if defined(USE_XCP)
+    {XCP_CRO_ID, XCP_CRO_ID, 0U, CAN_RX_FIFO1},
+#endif
+};
+
+static const can_dispatch_handler_t user_can_rx_handlers[] = {
+    user_can_on_status,
+    user_can_on_command,
+    NULL,
+#if defined(USE_XCP)
+    xcp_on_cro,
+#endif
+};
+
 void user_can_set_rx_filer(void)
 {
-    CAN_FilterTypeDef can_filter;
-
-    can_filter.FilterBank = 0;
-    can_filter.FilterMode = CAN_FILTERMODE_IDMASK;
-    can_filter.FilterFIFOAssignment = CAN_RX_FIFO0;
-    can_filter.FilterIdHigh = 0;
-    can_filter.FilterIdLow = 0;
-    can_filter.FilterMaskIdHigh = 0;
-    can_filter.FilterMaskIdLow = 0;
-    can_filter.FilterScale = CAN_FILTERSCALE_32BIT;
-    can_filter.FilterActivation = ENABLE;
-    can_filter.SlaveStartFilterBank = 14;
-    HAL_CAN_ConfigFilter(&hcan, &can_filter);
+    static can_filter_plan_t plan;
+    const uint32_t count = sizeof(user_can_rx_ids) / sizeof(user_can_rx_ids[0]);
+
+    if ((can_filter_plan(user_can_rx_ids, count, CAN_FILTER_BANKS, &plan) != HAL_OK)
+        || (can_dispatch_init(&user_can_dispatch, &plan, user_can_rx_ids, user_can_rx_handlers, count) != HAL_OK))
+    {
+        Error_Handler();
+    }
+    (void)can_filter_program(&hcan, &plan);
 }
@@ -0,0 +1,538 @@
+/**
+ ******************************************************************************
+ * @file           : xcp.c
+ * @brief          : XCP on CAN slave: memory access and synchronous DAQ lists
+ ******************************************************************************
+ * The configuration (lists, ODTs, entries) is only changed by the commands,
+ * in the task, and only while no list runs: START_STOP publishes a list to
+ * the events with one atomic store of its flags, after everything it uses is
+ * written.  The events only read the configuration.
+ ******************************************************************************
+ */
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "can_tx.h"
+#include "xcp.h"
+
+/* Commands */
+#define XCP_CMD_CONNECT                 0xFFU
+#define XCP_CMD_DISCONNECT              0xFEU
+#define XCP_CMD_GET_STATUS              0xFDU
+#define XCP_CMD_SYNCH                   0xFCU
+#define XCP_CMD_SET_MTA                 0xF6U
+#define XCP_CMD_UPLOAD                  0xF5U
+#define XCP_CMD_SHORT_UPLOAD            0xF4U
+#define XCP_CMD_DOWNLOAD                0xF0U
+#define XCP_CMD_SET_DAQ_PTR             0xE2U
+#define XCP_CMD_WRITE_DAQ               0xE1U
+#define XCP_CMD_SET_DAQ_LIST_MODE       0xE0U
+#define XCP_CMD_START_STOP_DAQ_LIST     0xDEU
+#define XCP_CMD_START_STOP_SYNCH        0xDDU
+#define XCP_CMD_GET_DAQ_PROCESSOR_INFO  0xDAU
+#define XCP_CMD_GET_DAQ_RESOLUTION_INFO 0xD9U
+#define XCP_CMD_FREE_DAQ                0xD6U
+#define XCP_CMD_ALLOC_DAQ               0xD5U
+#define XCP_CMD_ALLOC_ODT               0xD4U
+#define XCP_CMD_ALLOC_ODT_ENTRY         0xD3U
+
+/* Packet identifiers of the answers */
+#define XCP_PID_RES                     0xFFU
+#define XCP_PID_ERR                     0xFEU
+
+/* Error codes; XCP_NO_ERROR is none of them */
+#define XCP_NO_ERROR                    0xFFU
+#define XCP_ERR_CMD_SYNCH               0x00U
+#define XCP_ERR_DAQ_ACTIVE              0x11U
+#define XCP_ERR_CMD_UNKNOWN             0x20U
+#define XCP_ERR_CMD_SYNTAX              0x21U
+#define XCP_ERR_OUT_OF_RANGE            0x22U
+#define XCP_ERR_SEQUENCE                0x29U
+#define XCP_ERR_MEMORY_OVERFLOW         0x30U
+
+/* CONNECT: RESOURCE CAL/PAG and DAQ, COMM_MODE_BASIC Intel, byte granularity */
+#define XCP_RESOURCE                    0x05U
+#define XCP_COMM_MODE_BASIC             0x00U
+#define XCP_MAX_CTO                     8U
+#define XCP_MAX_DTO                     8U
+#define XCP_MAX_ODT_SIZE                (XCP_MAX_DTO - 1U)
+#define XCP_VERSION                     0x01U
+
+/* GET_STATUS session status */
+#define XCP_SESSION_DAQ_RUNNING         0x40U
+
+/* GET_DAQ_PROCESSOR_INFO: dynamic configuration, prescaler; absolute ODT
+ * numbers */
+#define XCP_DAQ_PROPERTIES              0x03U
+#define XCP_DAQ_KEY_BYTE                0x00U
+
+/* SET_DAQ_LIST_MODE mode bits this slave refuses: STIM, time stamp, PID off */
+#define XCP_MODE_UNSUPPORTED            0x32U
+
+/* TX queue entries the DAQ bursts leave to the answers */
+#define XCP_TX_RESERVE                  1U
+
+/* Flags of a list */
+#define XCP_DAQ_SELECTED                0x01U
+#define XCP_DAQ_RUNNING                 0x02U
+
+typedef struct
+{
+    uint32_t address;
+    uint8_t size;
+} xcp_entry_t;
+
+typedef struct
+{
+    uint8_t first_entry;
+    uint8_t entries;
+} xcp_odt_t;
+
+typedef struct
+{
+    uint8_t first_odt;
+    uint8_t odts;
+    uint8_t event;
+    uint8_t prescaler;
+    uint8_t count;          /* event cycles since the last sample */
+    uint8_t flags;
+} xcp_daq_t;
+
+volatile uint32_t xcp_event_cycles[XCP_EVENT_CHANNELS];
+
+static xcp_daq_t xcp_daq[XCP_DAQ_MAX];
+static xcp_odt_t xcp_odt[XCP_ODT_MAX];
+static xcp_entry_t xcp_entry[XCP_ODT_ENTRY_MAX];
+static uint32_t xcp_daq_count;
+static uint32_t xcp_odt_count;
+static uint32_t xcp_entry_count;
+static uint32_t xcp_connected;
+static uint32_t xcp_mta;
+static uint32_t xcp_ptr_daq;
+static uint32_t xcp_ptr_entry;      /* absolute, xcp_entry_count: none */
+static uint32_t xcp_ptr_end;
+static volatile uint32_t xcp_overload_count;
+
+uint32_t xcp_overloads(void)
+{
+    return xcp_overload_count;
+}
+
+static void xcp_send(const uint8_t *data, uint32_t len)
+{
+    CAN_TxHeaderTypeDef header;
+
+    header.StdId = XCP_DTO_ID;
+    header.ExtId = 0U;
+    header.IDE = CAN_ID_STD;
+    header.RTR = CAN_RTR_DATA;
+    header.DLC = len;
+    header.TransmitGlobalTime = DISABLE;
+    (void)can_tx_send(&header, data);
+}
+
+static uint16_t xcp_word(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | ((uint32_t)p[1] << 8U));
+}
+
+static uint32_t xcp_dword(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8U) | ((uint32_t)p[2] << 16U) | ((uint32_t)p[3] << 24U);
+}
+
+static uint32_t xcp_running(void)
+{
+    uint32_t i;
+
+    for (i = 0U; i < xcp_daq_count; i++)
+    {
+        if ((__atomic_load_n(&xcp_daq[i].flags, __ATOMIC_RELAXED) & XCP_DAQ_RUNNING) != 0U)
+        {
+            return 1U;
+        }
+    }
+    return 0U;
+}
+
+uint32_t xcp_busy(void)
+{
+    uint32_t i;
+
+    for (i = 0U; i < xcp_daq_count; i++)
+    {
+        if (((__atomic_load_n(&xcp_daq[i].flags, __ATOMIC_ACQUIRE) & XCP_DAQ_RUNNING) != 0U)
+            && (xcp_daq[i].event == XCP_EVENT_1MS))
+        {
+            return 1U;
+        }
+    }
+    return 0U;
+}
+
+/* Starts (1) or stops (0) a list for the events. */
+static void xcp_set_running(xcp_daq_t *daq, uint32_t run)
+{
+    uint8_t flags = daq->flags & (uint8_t)~XCP_DAQ_RUNNING;
+
+    if (run != 0U)
+    {
+        /* the first sample at the next event */
+        daq->count = (uint8_t)(daq->prescaler - 1U);
+        flags |= XCP_DAQ_RUNNING;
+    }
+    __atomic_store_n(&daq->flags, flags, __ATOMIC_RELEASE);
+}
+
+static void xcp_stop_all(void)
+{
+    uint32_t i;
+
+    for (i = 0U; i < xcp_daq_count; i++)
+    {
+        __atomic_store_n(&xcp_daq[i].flags, 0U, __ATOMIC_RELEASE);
+    }
+}
+
+/* Bytes in the ODT of the entry, in all its other entries: the entries can
+ * be written again in any order (SET_DAQ_PTR), those not written yet are 0. */
+static uint32_t xcp_odt_used(uint32_t entry)
+{
+    const xcp_daq_t *daq = &xcp_daq[xcp_ptr_daq];
+    const xcp_odt_t *odt;
+    uint32_t used = 0U;
+    uint32_t i;
+    uint32_t e;
+
+    for (i = daq->first_odt; i < (uint32_t)(daq->first_odt + daq->odts); i++)
+    {
+        odt = &xcp_odt[i];
+        if ((entry >= odt->first_entry) && (entry < (uint32_t)(odt->first_entry + odt->entries)))
+        {
+            for (e = odt->first_entry; e < (uint32_t)(odt->first_entry + odt->entries); e++)
+            {
+                used += (e != entry) ? xcp_entry[e].size : 0U;
+            }
+        }
+    }
+    return used;
+}
+
+/* The DAQ commands: XCP_NO_ERROR with len bytes of answer in res, or an
+ * error code. */
+static uint32_t xcp_daq_command(const uint8_t *cmd, uint8_t *res, uint32_t *len)
+{
+    const uint32_t number = xcp_word(&cmd[2]);
+    const uint32_t event = xcp_word(&cmd[4]);
+    xcp_daq_t *daq = (number < xcp_daq_count) ? &xcp_daq[number] : NULL;
+    uint32_t i;
+
+    switch (cmd[0])
+    {
+    case XCP_CMD_GET_DAQ_PROCESSOR_INFO:
+        res[1] = XCP_DAQ_PROPERTIES;
+        res[2] = (uint8_t)XCP_DAQ_MAX;              /* MAX_DAQ, to allocate */
+        res[3] = (uint8_t)(XCP_DAQ_MAX >> 8U);
+        res[4] = (uint8_t)XCP_EVENT_CHANNELS;
+        res[5] = 0U;
+        res[6] = 0U;                                /* MIN_DAQ */
+        res[7] = XCP_DAQ_KEY_BYTE;
+        *len = 8U;
+        return XCP_NO_ERROR;
+    case XCP_CMD_GET_DAQ_RESOLUTION_INFO:
+        res[1] = 1U;                                /* granularity of the entries */
+        res[2] = (uint8_t)XCP_MAX_ODT_SIZE;
+        memset(&res[3], 0, 5U);                     /* no STIM, no time stamps */
+        *len = 8U;
+        return XCP_NO_ERROR;
+    case XCP_CMD_START_STOP_SYNCH:
+        if (cmd[1] > 2U)
+        {
+            return XCP_ERR_OUT_OF_RANGE;
+        }
+        for (i = 0U; i < xcp_daq_count; i++)
+        {
+            if ((cmd[1] == 0U) || ((xcp_daq[i].flags & XCP_DAQ_SELECTED) != 0U))
+            {
+                xcp_set_running(&xcp_daq[i], (cmd[1] == 1U) ? 1U : 0U);
+                xcp_daq[i].flags &= (uint8_t)~XCP_DAQ_SELECTED;
+            }
+        }
+        return XCP_NO_ERROR;
+    default:
+        break;
+    }
+
+    /* below, nothing may change while a list runs, but for the list itself */
+    if ((cmd[0] != XCP_CMD_START_STOP_DAQ_LIST) && (xcp_running() != 0U))
+    {
+        return XCP_ERR_DAQ_ACTIVE;
+    }
+    switch (cmd[0])
+    {
+    case XCP_CMD_FREE_DAQ:
+        xcp_daq_count = 0U;
+        xcp_odt_count = 0U;
+        xcp_entry_count = 0U;
+        xcp_ptr_entry = 0U;
+        xcp_ptr_end = 0U;
+        return XCP_NO_ERROR;
+    case XCP_CMD_ALLOC_DAQ:
+        if ((xcp_daq_count != 0U) || (xcp_odt_count != 0U))
+        {
+            return XCP_ERR_SEQUENCE;
+        }
+        if (number > XCP_DAQ_MAX)
+        {
+            return XCP_ERR_MEMORY_OVERFLOW;
+        }
+        memset(xcp_daq, 0, sizeof(xcp_daq));
+        xcp_daq_count = number;
+        return XCP_NO_ERROR;
+    case XCP_CMD_ALLOC_ODT:
+        /* the ODTs of a list are consecutive, the lists in any order */
+        if ((daq == NULL) || (daq->odts != 0U) || (xcp_entry_count != 0U))
+        {
+            return (daq == NULL) ? XCP_ERR_OUT_OF_RANGE : XCP_ERR_SEQUENCE;
+        }
+        if ((xcp_odt_count + cmd[4]) > XCP_ODT_MAX)
+        {
+            return XCP_ERR_MEMORY_OVERFLOW;
+        }
+        daq->first_odt = (uint8_t)xcp_odt_count;
+        daq->odts = cmd[4];
+        memset(&xcp_odt[xcp_odt_count], 0, cmd[4] * sizeof(xcp_odt_t));
+        xcp_odt_count += cmd[4];
+        return XCP_NO_ERROR;
+    case XCP_CMD_ALLOC_ODT_ENTRY:
+        if ((daq == NULL) || (cmd[4] >= daq->odts))
+        {
+            return XCP_ERR_OUT_OF_RANGE;
+        }
+        if (xcp_odt[daq->first_odt + cmd[4]].entries != 0U)
+        {
+            return XCP_ERR_SEQUENCE;
+        }
+        if ((xcp_entry_count + cmd[5]) > XCP_ODT_ENTRY_MAX)
+        {
+            return XCP_ERR_MEMORY_OVERFLOW;
+        }
+        xcp_odt[daq->first_odt + cmd[4]].first_entry = (uint8_t)xcp_entry_count;
+        xcp_odt[daq->first_odt + cmd[4]].entries = cmd[5];
+        memset(&xcp_entry[xcp_entry_count], 0, cmd[5] * sizeof(xcp_entry_t));
+        xcp_entry_count += cmd[5];
+        return XCP_NO_ERROR;
+    case XCP_CMD_SET_DAQ_PTR:
+        if ((daq == NULL) || (cmd[4] >= daq->odts) || (cmd[5] >= xcp_odt[daq->first_odt + cmd[4]].entries))
+        {
+            return XCP_ERR_OUT_OF_RANGE;
+        }
+        xcp_ptr_daq = number;
+        xcp_ptr_entry = xcp_odt[daq->first_odt + cmd[4]].first_entry + (uint32_t)cmd[5];
+        xcp_ptr_end = xcp_odt[daq->first_odt + cmd[4]].first_entry + (uint32_t)xcp_odt[daq->first_odt + cmd[4]].entries;
+        return XCP_NO_ERROR;
+    case XCP_CMD_WRITE_DAQ:
+        /* whole bytes only (bit offset 0xFF), address extension 0 */
+        if ((cmd[1] != 0xFFU) || (cmd[3] != 0U))
+        {
+            return XCP_ERR_CMD_SYNTAX;
+        }
+        if (xcp_ptr_entry >= xcp_ptr_end)
+        {
+            return XCP_ERR_SEQUENCE;
+        }
+        if ((cmd[2] == 0U) || ((xcp_odt_used(xcp_ptr_entry) + cmd[2]) > XCP_MAX_ODT_SIZE))
+        {
+            return XCP_ERR_OUT_OF_RANGE;
+        }
+        xcp_entry[xcp_ptr_entry].address = xcp_dword(&cmd[4]);
+        xcp_entry[xcp_ptr_entry].size = cmd[2];
+        xcp_ptr_entry++;
+        return XCP_NO_ERROR;
+    case XCP_CMD_SET_DAQ_LIST_MODE:
+        if ((cmd[1] & XCP_MODE_UNSUPPORTED) != 0U)
+        {
+            return XCP_ERR_CMD_SYNTAX;
+        }
+        if ((daq == NULL) || (event >= XCP_EVENT_CHANNELS) || (cmd[6] == 0U))
+        {
+            return XCP_ERR_OUT_OF_RANGE;
+        }
+        daq->event = (uint8_t)event;
+        daq->prescaler = cmd[6];
+        return XCP_NO_ERROR;
+    case XCP_CMD_START_STOP_DAQ_LIST:
+        if ((daq == NULL) || (cmd[1] > 2U))
+        {
+            return XCP_ERR_OUT_OF_RANGE;
+        }
+        if ((cmd[1] != 0U) && ((daq->odts == 0U) || (daq->prescaler == 0U)))
+        {
+            return XCP_ERR_SEQUENCE;
+        }
+        if (cmd[1] == 2U)
+        {
+            daq->flags |= XCP_DAQ_SELECTED;
+        }
+        else
+        {
+            xcp_set_running(daq, cmd[1]);
+        }
+        res[1] = daq->first_odt;                    /* FIRST_PID */
+        *len = 2U;
+        return XCP_NO_ERROR;
+    default:
+        return XCP_ERR_CMD_UNKNOWN;
+    }
+}
+
+void xcp_on_cro(const can_rx_frame_t *frame)
+{
+    uint8_t cmd[8] = {0};
+    uint8_t res[8];
+    uint32_t len = 1U;
+    uint32_t error = XCP_NO_ERROR;
+    uint32_t n;
+
+    if ((frame->rtr != 0U) || (frame->dlc == 0U))
+    {
+        return;
+    }
+    /* the unused bytes of a short command read as 0 */
+    memcpy(cmd, frame->data, (frame->dlc < 8U) ? frame->dlc : 8U);
+
+    res[0] = XCP_PID_RES;
+    if (cmd[0] == XCP_CMD_CONNECT)
+    {
+        xcp_connected = 1U;
+        res[1] = XCP_RESOURCE;
+        res[2] = XCP_COMM_MODE_BASIC;
+        res[3] = XCP_MAX_CTO;
+        res[4] = (uint8_t)XCP_MAX_DTO;
+        res[5] = 0U;
+        res[6] = XCP_VERSION;                       /* protocol layer */
+        res[7] = XCP_VERSION;                       /* transport layer */
+        xcp_send(res, 8U);
+        return;
+    }
+    if (xcp_connected == 0U)
+    {
+        /* a slave that is not connected stays silent */
+        return;
+    }
+
+    switch (cmd[0])
+    {
+    case XCP_CMD_DISCONNECT:
+        xcp_stop_all();
+        xcp_connected = 0U;
+        break;
+    case XCP_CMD_GET_STATUS:
+        res[1] = (xcp_running() != 0U) ? XCP_SESSION_DAQ_RUNNING : 0U;
+        res[2] = 0U;                                /* no protection */
+        res[3] = 0U;
+        res[4] = 0U;                                /* session configuration id */
+        res[5] = 0U;
+        len = 6U;
+        break;
+    case XCP_CMD_SYNCH:
+        error = XCP_ERR_CMD_SYNCH;
+        break;
+    case XCP_CMD_SET_MTA:
+        xcp_mta = xcp_dword(&cmd[4]);
+        break;
+    case XCP_CMD_SHORT_UPLOAD:
+    case XCP_CMD_UPLOAD:
+        n = cmd[1];
+        if ((n == 0U) || (n > (XCP_MAX_CTO - 1U)))
+        {
+            error = XCP_ERR_OUT_OF_RANGE;
+            break;
+        }
+        if (cmd[0] == XCP_CMD_SHORT_UPLOAD)
+        {
+            xcp_mta = xcp_dword(&cmd[4]);
+        }
+        memcpy(&res[1], (const void *)(uintptr_t)xcp_mta, n);
+        xcp_mta += n;
+        len = 1U + n;
+        break;
+    case XCP_CMD_DOWNLOAD:
+        n = cmd[1];
+        if ((n == 0U) || (n > (XCP_MAX_CTO - 2U)) || ((2U + n) > frame->dlc))
+        {
+            error = XCP_ERR_OUT_OF_RANGE;
+            break;
+        }
+        memcpy((void *)(uintptr_t)xcp_mta, &cmd[2], n);
+        xcp_mta += n;
+        break;
+    default:
+        error = xcp_daq_command(cmd, res, &len);
+        break;
+    }
+
+    if (error != XCP_NO_ERROR)
+    {
+        res[0] = XCP_PID_ERR;
+        res[1] = (uint8_t)error;
+        len = 2U;
+    }
+    xcp_send(res, len);
+}
+
+void xcp_event(uint32_t channel)
+{
+    CAN_TxHeaderTypeDef header;
+    const xcp_entry_t *entry;
+    const xcp_odt_t *odt;
+    xcp_daq_t *daq;
+    uint8_t dto[XCP_MAX_DTO];
+    uint32_t len;
+    uint32_t d;
+    uint32_t o;
+    uint32_t e;
+
+    xcp_event_cycles[channel]++;
+    header.StdId = XCP_DTO_ID;
+    header.ExtId = 0U;
+    header.IDE = CAN_ID_STD;
+    header.RTR = CAN_RTR_DATA;
+    header.TransmitGlobalTime = DISABLE;
+
+    for (d = 0U; d < xcp_daq_count; d++)
+    {
+        daq = &xcp_daq[d];
+        if (((__atomic_load_n(&daq->flags, __ATOMIC_ACQUIRE) & XCP_DAQ_RUNNING) == 0U) || (daq->event != channel))
+        {
+            continue;
+        }
+        if (++daq->count < daq->prescaler)
+        {
+            continue;
+        }
+        daq->count = 0U;
+
+        /* one burst: every ODT of the list from the same event */
+        for (o = daq->first_odt; o < (uint32_t)(daq->first_odt + daq->odts); o++)
+        {
+            odt = &xcp_odt[o];
+            dto[0] = (uint8_t)o;
+            len = 1U;
+            for (e = odt->first_entry; e < (uint32_t)(odt->first_entry + odt->entries); e++)
+            {
+                entry = &xcp_entry[e];
+                memcpy(&dto[len], (const void *)(uintptr_t)entry->address, entry->size);
+                len += entry->size;
+            }
+            header.DLC = len;
+            if ((can_tx_pending() >= (CAN_TX_QUEUE_SIZE - XCP_TX_RESERVE)) || (can_tx_send(&header, dto) != HAL_OK))
+            {
+                __atomic_add_fetch(&xcp_overload_count, 1U, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+    }
+}
@@ -10100,6 +10100,11 @@ typedef struct
   */
 
 
+#if defined(USE_HOST_SIM)
+/* Linux/POSIX host simulation: the peripherals are modeled in memory. */
+#include "host_periph.h"
+#endif /* USE_HOST_SIM */
+
 #ifdef __cplusplus
   }
 #endif /* __cplusplus */
@@ -115,6 +115,11 @@
 #endif
 
 
+#if defined(USE_HOST_SIM)
+/* Linux/POSIX host simulation: no Cortex-M instructions available. */
+#include "cmsis_host.h"
+#else
+
 /* ###########################  Core Function Access  ########################### */
 /** \ingroup  CMSIS_Core_FunctionInterface
     \defgroup CMSIS_Core_RegAccFunctions CMSIS Core Register Access Functions
@@ -2079,6 +2084,8 @@ __STATIC_FORCEINLINE int32_t __SMMLA (int32_t op1, int32_t op2, int32_t op3)
 #endif /* (__ARM_FEATURE_DSP == 1) */
 /*@} end of group CMSIS_SIMD_intrinsics */
 
+#endif /* USE_HOST_SIM */
+
 
 #pragma GCC diagnostic pop
 
@@ -0,0 +1,170 @@
+/**************************************************************************//**
+ * @file     cmsis_host.h
+ * @brief    CMSIS core intrinsics for the Linux/POSIX host simulation
+ ******************************************************************************/
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Included by cmsis_gcc.h instead of the Cortex-M inline assembly when
+ * USE_HOST_SIM is defined.  The interrupt related intrinsics are served by the
+ * FreeRTOS Posix port (portable/GCC/Posix), the others are plain C.
+ */
+
+#ifndef __CMSIS_HOST_H
+#define __CMSIS_HOST_H
+
+#include <stdint.h>
+
+/* provided by the FreeRTOS Posix port */
+extern void vPortDisableInterrupts(void);
+extern void vPortEnableInterrupts(void);
+extern uint32_t ulPortSetInterruptMask(void);
+extern void vPortClearInterruptMask(uint32_t ulMask);
+extern uint32_t ulPortHostGetIPSR(void);
+
+/* ###########################  Core Function Access  ########################### */
+
+__STATIC_FORCEINLINE void __enable_irq(void)
+{
+  vPortEnableInterrupts();
+}
+
+__STATIC_FORCEINLINE void __disable_irq(void)
+{
+  vPortDisableInterrupts();
+}
+
+__STATIC_FORCEINLINE uint32_t __get_IPSR(void)
+{
+  return ulPortHostGetIPSR();
+}
+
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void)
+{
+  uint32_t mask = ulPortSetInterruptMask();
+
+  vPortClearInterruptMask(mask);
+  return mask;
+}
+
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t priMask)
+{
+  if (priMask != 0U)
+  {
+    vPortDisableInterrupts();
+  }
+  else
+  {
+    vPortEnableInterrupts();
+  }
+}
+
+/* ##########################  Core Instruction Access  ######################### */
+
+#define __NOP()     __asm volatile ("nop")
+#define __WFI()     __asm volatile ("nop")
+#define __WFE()     __asm volatile ("nop")
+#define __SEV()     __asm volatile ("nop")
+#define __BKPT(value)   __builtin_trap()
+
+__STATIC_FORCEINLINE void __ISB(void)
+{
+  __sync_synchronize();
+}
+
+__STATIC_FORCEINLINE void __DSB(void)
+{
+  __sync_synchronize();
+}
+
+__STATIC_FORCEINLINE void __DMB(void)
+{
+  __sync_synchronize();
+}
+
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value)
+{
+  return __builtin_bswap32(value);
+}
+
+__STATIC_FORCEINLINE uint32_t __REV16(uint32_t value)
+{
+  return ((value & 0xFF00FF00U) >> 8U) | ((value & 0x00FF00FFU) << 8U);
+}
+
+__STATIC_FORCEINLINE int16_t __REVSH(int16_t value)
+{
+  return (int16_t)__builtin_bswap16((uint16_t)value);
+}
+
+__STATIC_FORCEINLINE uint32_t __ROR(uint32_t op1, uint32_t op2)
+{
+  op2 %= 32U;
+  if (op2 == 0U)
+  {
+    return op1;
+  }
+  return (op1 >> op2) | (op1 << (32U - op2));
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+  uint32_t result = 0U;
+  uint32_t i;
+
+  for (i = 0U; i < 32U; i++)
+  {
+    result = (result << 1U) | (value & 1U);
+    value >>= 1U;
+  }
+  return result;
+}
+
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value)
+{
+  return (value == 0U) ? 32U : (uint8_t)__builtin_clz(value);
+}
+
+/* There is a single simulated core and only one task thread runs at a time,
+   so the exclusive monitor always grants the store. */
+__STATIC_FORCEINLINE uint32_t __LDREXW(volatile uint32_t *addr)
+{
+  return *addr;
+}
+
+__STATIC_FORCEINLINE uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+  *addr = value;
+  return 0U;
+}
+
+__STATIC_FORCEINLINE uint16_t __LDREXH(volatile uint16_t *addr)
+{
+  return *addr;
+}
+
+__STATIC_FORCEINLINE uint32_t __STREXH(uint16_t value, volatile uint16_t *addr)
+{
+  *addr = value;
+  return 0U;
+}
+
+__STATIC_FORCEINLINE void __CLREX(void)
+{
+}
+
+#endif /* __CMSIS_HOST_H */
@@ -1390,9 +1390,19 @@ typedef struct
 #define SCB_BASE            (SCS_BASE +  0x0D00UL)                    /*!< System Control Block Base Address */
 
 #define SCnSCB              ((SCnSCB_Type    *)     SCS_BASE      )   /*!< System control Register not in SCB */
+#if defined(USE_HOST_SIM)
+/* Linux/POSIX host simulation: register blocks of the model in host_periph.c */
+extern SCB_Type     host_scb;
+extern SysTick_Type host_systick;
+extern NVIC_Type    host_nvic;
+#define SCB                 (&host_scb)                                 /*!< SCB configuration struct */
+#define SysTick             (&host_systick)                             /*!< SysTick configuration struct */
+#define NVIC                (&host_nvic)                                /*!< NVIC configuration struct */
+#else
 #define SCB                 ((SCB_Type       *)     SCB_BASE      )   /*!< SCB configuration struct */
 #define SysTick             ((SysTick_Type   *)     SysTick_BASE  )   /*!< SysTick configuration struct */
 #define NVIC                ((NVIC_Type      *)     NVIC_BASE     )   /*!< NVIC configuration struct */
+#endif /* USE_HOST_SIM */
 #define ITM                 ((ITM_Type       *)     ITM_BASE      )   /*!< ITM configuration struct */
 #define DWT                 ((DWT_Type       *)     DWT_BASE      )   /*!< DWT configuration struct */
 #define TPI                 ((TPI_Type       *)     TPI_BASE      )   /*!< TPI configuration struct */
@@ -0,0 +1,22 @@
+/**
+ ******************************************************************************
+ * @file           : host_can_bench.h
+ * @brief          : Host check of the CAN TX queue and RX ring (can_tx.c, can_rx.c)
+ ******************************************************************************
+ * Built with USE_HOST_SIM and USE_CAN_BENCH.  host_can_bench_start() creates
+ * a task that hands can_tx_send() bursts longer than the three mailboxes and
+ * watches the bus of host_can.c, then fills the bus with frames of the other
+ * node for the RX ring.  It prints one CSV row per burst and per RX run and
+ * exits with 1 if a check failed:
+ *
+ *   burst,frames,rejected,on_bus,missing,out_of_order,bus_idle_ns,lost_arbitration,ns_per_frame
+ *   rate,dlc,hold,injected,fifo,fifo_overruns,ring_dropped,received,frames_per_s,bus_frames_per_s,irqs_per_100,irq_ns_per_frame
+ *   stats,rx_frames,tx_frames,model_rx_frames,model_tx_frames,high_water,overruns,latency_max_us (USE_CAN_STATS)
+ ******************************************************************************
+ */
+#ifndef HOST_CAN_BENCH_H
+#define HOST_CAN_BENCH_H
+
+void host_can_bench_start(void);
+
+#endif
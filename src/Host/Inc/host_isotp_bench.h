@@ -0,0 +1,20 @@
+/**
+ ******************************************************************************
+ * @file           : host_isotp_bench.h
+ * @brief          : Host loopback benchmark of the ISO-TP transport (isotp.c)
+ ******************************************************************************
+ * Built with USE_HOST_SIM and USE_ISOTP_BENCH.  host_isotp_bench_start()
+ * creates a task that puts CAN1 in loopback mode and sends messages to
+ * itself over one ISO-TP link, for several bit rates, block sizes, STmin and
+ * lengths.  It prints one CSV row per run and exits with 1 if a message was
+ * lost, corrupted or refused:
+ *
+ *   rate,block_size,st_min,length,messages,frames,payload_bytes_per_s,bus_max_bytes_per_s,efficiency_pct,bus_busy_pct
+ ******************************************************************************
+ */
+#ifndef HOST_ISOTP_BENCH_H
+#define HOST_ISOTP_BENCH_H
+
+void host_isotp_bench_start(void);
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ ******************************************************************************
+ * @file           : host_model.h
+ * @brief          : Interface between the host peripheral models
+ ******************************************************************************
+ * Each model (host_uart.c, host_can.c, host_tim.c, host_dma.c) exposes the
+ * same set of functions to host_periph.c:
+ *  - reset:  puts the registers to their reset values.
+ *  - update: handles the CPU writes found since the last sync, then advances
+ *            the peripheral up to now.  Returns the host time of its next
+ *            event, HOST_TIME_NEVER when there is none.
+ *  - causes: the interrupt causes currently asserted for one IRQ line, the
+ *            handler clears them through the registers like on the target.
+ *
+ * A register the CPU may write is compared with the value the model published
+ * at the previous sync, a difference is a write.  Write-only and
+ * write-1-to-clear registers are published so that any write can be told
+ * apart.
+ ******************************************************************************
+ */
+#ifndef HOST_MODEL_H
+#define HOST_MODEL_H
+
+#include "main.h"
+
+#define HOST_TIME_NEVER                 UINT64_MAX
+#define HOST_NS_PER_S                   1000000000ULL
+
+/* host_periph.c */
+uint32_t host_rcc_pclk1(void);
+uint32_t host_rcc_pclk2(void);
+uint32_t host_rcc_tim1clk(void);
+void host_model_raise(void);
+
+/* host_dma.c */
+#define HOST_DMA_USART1_TX              3U      /* DMA1 channel 4 */
+
+void host_dma_reset(void);
+void host_dma_update(void);
+/* Next item of a memory-to-peripheral request, -1 when the channel is off
+ * or done.  Called by the peripheral models while they advance. */
+int host_dma_request(uint32_t channel, uint32_t *item);
+uint32_t host_dma_ch4_causes(void);
+
+/* host_uart.c */
+void host_uart_reset(void);
+uint64_t host_uart_update(uint64_t now);
+uint32_t host_uart_causes(void);
+
+/* host_can.c */
+void host_can_reset(void);
+uint64_t host_can_update(uint64_t now);
+uint32_t host_can_tx_causes(void);
+uint32_t host_can_rx0_causes(void);
+uint32_t host_can_rx1_causes(void);
+
+/* host_tim.c */
+void host_tim_reset(void);
+uint64_t host_tim_update(uint64_t now);
+uint32_t host_tim_up_causes(void);
+
+#endif
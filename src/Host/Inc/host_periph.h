@@ -0,0 +1,157 @@
+/**
+ ******************************************************************************
+ * @file           : host_periph.h
+ * @brief          : Register model of the STM32F103 peripherals for the host
+ ******************************************************************************
+ * Included at the end of stm32f103x6.h when USE_HOST_SIM is defined.  The
+ * peripheral macros used by this project (RCC, FLASH, AFIO, EXTI, PWR,
+ * GPIOA..GPIOD, USART1, CAN1, TIM1, DMA1 and the NVIC/SCB/SysTick of the
+ * core) are redirected to the in-memory register blocks below, so the HAL
+ * drivers run unmodified on Linux.  Any other peripheral still points to its target
+ * address and must not be touched in the host build.
+ *
+ * Behind the registers runs a behavioral model on the host clock:
+ *  - USART1: TXE/TC follow the shift register at the configured baud rate,
+ *    the transmitted bytes go to stdout.  With CR3.DMAT the TX requests are
+ *    served by DMA1 channel 4.
+ *  - DMA1: memory-to-peripheral requests with CNDTR and the HT/TC flags.  The
+ *    HAL passes CMAR as a 32-bit address: link the host build with -no-pie.
+ *  - CAN1: init/sleep handshake, 3 TX mailboxes with identifier or FIFO
+ *    priority, bus arbitration against injected frames, frame durations in
+ *    bit times including the stuff bits, the filter banks with the filter
+ *    match index and the two 3-deep RX FIFOs.
+ *  - TIM1: up-counter with prescaler, auto-reload and repetition counter.
+ *  - RCC: the RDY bits follow the ON bits, SWS follows SW.
+ *  - GPIO: BSRR/BRR are applied to ODR.
+ *
+ * The model is updated at sync points, all of them on the simulated CPU: on
+ * entry of every HAL function and exit of the outermost one (the HAL sources
+ * are built with -finstrument-functions), in the simulated interrupt and from
+ * host_periph_sync().  Between two sync points the registers are plain memory.
+ ******************************************************************************
+ */
+#ifndef HOST_PERIPH_H
+#define HOST_PERIPH_H
+
+#include <stdint.h>
+
+/* Simulated interrupt of the FreeRTOS Posix port used for the whole NVIC. */
+#define HOST_PERIPH_INTERRUPT           0U
+
+/* Register blocks ------------------------------------------------------------*/
+extern RCC_TypeDef host_rcc;
+extern FLASH_TypeDef host_flash;
+extern AFIO_TypeDef host_afio;
+extern EXTI_TypeDef host_exti;
+extern PWR_TypeDef host_pwr;
+extern GPIO_TypeDef host_gpioa;
+extern GPIO_TypeDef host_gpiob;
+extern GPIO_TypeDef host_gpioc;
+extern GPIO_TypeDef host_gpiod;
+extern USART_TypeDef host_usart1;
+extern CAN_TypeDef host_can1;
+extern TIM_TypeDef host_tim1;
+extern DMA_TypeDef host_dma1;
+extern DMA_Channel_TypeDef host_dma1_channels[7];
+
+#undef RCC
+#undef FLASH
+#undef AFIO
+#undef EXTI
+#undef PWR
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef GPIOD
+#undef USART1
+#undef CAN1
+#undef TIM1
+#undef DMA1
+#undef DMA1_Channel1
+#undef DMA1_Channel2
+#undef DMA1_Channel3
+#undef DMA1_Channel4
+#undef DMA1_Channel5
+#undef DMA1_Channel6
+#undef DMA1_Channel7
+
+#define RCC                             (&host_rcc)
+#define FLASH                           (&host_flash)
+#define AFIO                            (&host_afio)
+#define EXTI                            (&host_exti)
+#define PWR                             (&host_pwr)
+#define GPIOA                           (&host_gpioa)
+#define GPIOB                           (&host_gpiob)
+#define GPIOC                           (&host_gpioc)
+#define GPIOD                           (&host_gpiod)
+#define USART1                          (&host_usart1)
+#define CAN1                            (&host_can1)
+#define TIM1                            (&host_tim1)
+#define DMA1                            (&host_dma1)
+#define DMA1_Channel1                   (&host_dma1_channels[0])
+#define DMA1_Channel2                   (&host_dma1_channels[1])
+#define DMA1_Channel3                   (&host_dma1_channels[2])
+#define DMA1_Channel4                   (&host_dma1_channels[3])
+#define DMA1_Channel5                   (&host_dma1_channels[4])
+#define DMA1_Channel6                   (&host_dma1_channels[5])
+#define DMA1_Channel7                   (&host_dma1_channels[6])
+
+/* NVIC, SCB and SysTick are redirected in core_cm3.h, ahead of the inline
+ * functions that use them.  The HAL writes the RCC bit-band alias through a
+ * uint32_t address, so that window is mapped at its target address
+ * (PERIPH_BB_BASE) instead. */
+
+/* Model interface ------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t id;        /* 11-bit or 29-bit identifier */
+    uint8_t ide;        /* 0: standard identifier, 1: extended identifier */
+    uint8_t rtr;        /* 0: data frame, 1: remote frame */
+    uint8_t dlc;
+    uint8_t data[8];
+} host_can_frame_t;
+
+typedef struct
+{
+    uint64_t syncs;         /* number of model updates */
+    uint64_t sync_ns;       /* host time spent in the model */
+    uint64_t irqs;          /* interrupt handlers called */
+    uint64_t irq_ns;        /* host time spent in them, syncs excluded */
+    uint64_t uart_tx_bytes;
+    uint64_t can_tx_frames;
+    uint64_t can_tx_lost;   /* arbitration lost or aborted */
+    uint64_t can_rx_frames;
+    uint64_t can_rx_overruns;
+    uint64_t can_bus_busy_ns;
+    uint64_t tim_updates;
+    uint64_t tim_counts;    /* counter clock ticks up to the last update event */
+    uint64_t tim_lost;      /* of them in periods whose update found UIF still set */
+} host_periph_stats_t;
+
+extern host_periph_stats_t host_periph_stats;
+
+/* Brings the model up to the current host time.  Only needed by code that
+ * polls a register without calling any HAL function. */
+void host_periph_sync(void);
+
+/* Host time in ns, the time base of the model (CLOCK_MONOTONIC). */
+uint64_t host_periph_time_ns(void);
+
+/* Bytes written by USART1 are passed to the sink, stdout when it is NULL. */
+void host_uart_set_tx_sink(void (*sink)(uint8_t byte));
+
+/* Every frame CAN1 sends successfully on the bus is passed to the listener,
+ * with the model times (ns) of its SOF and of the end of its interframe
+ * space. */
+void host_can_set_tx_listener(void (*listener)(const host_can_frame_t *frame, uint64_t start, uint64_t end));
+
+/* Queues a frame sent by another node, it takes part in the arbitration as
+ * soon as the bus is idle.  May be called from any thread that keeps the port
+ * signals blocked.  Returns -1 when the queue of the other node is full. */
+int host_can_inject(const host_can_frame_t *frame);
+
+/* Number of bits of the frame on the wire: stuff bits, EOF and the interframe
+ * space included. */
+uint32_t host_can_frame_bits(const host_can_frame_t *frame);
+
+#endif
@@ -0,0 +1,22 @@
+/**
+ ******************************************************************************
+ * @file           : host_slcan_bench.h
+ * @brief          : Host benchmark of the CAN to UART gateway (slcan.c)
+ ******************************************************************************
+ * Built with USE_HOST_SIM, USE_SLCAN and USE_SLCAN_BENCH.
+ * host_slcan_bench_start() creates a task that drives the gateway with
+ * Lawicel commands, decodes everything it writes on USART1 and keeps the bus
+ * full with frames of the other node, in ASCII and binary.  It prints one CSV
+ * row per run and exits with 1 if a command got a wrong answer, a frame was
+ * corrupted or lost without being counted, or frames were dropped while the
+ * UART had the bandwidth for them:
+ *
+ *   rate,format,timestamps,ide,dlc,injected,stored,forwarded,frames_per_s,bus_frames_per_s,uart_bytes_per_s,uart_need_pct,fifo_overruns,ring_dropped,mismatches
+ ******************************************************************************
+ */
+#ifndef HOST_SLCAN_BENCH_H
+#define HOST_SLCAN_BENCH_H
+
+void host_slcan_bench_start(void);
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ ******************************************************************************
+ * @file           : host_static_bench.h
+ * @brief          : Host check of the static allocation (USE_STATIC_ALLOC)
+ ******************************************************************************
+ * Built with USE_HOST_SIM and USE_STATIC_BENCH, with or without
+ * USE_STATIC_ALLOC: without it the rows show what the heap takes, and the
+ * creates stop where it runs out.  Every
+ * pvPortMalloc() and vPortFree() of heap_4.c is counted (traceMALLOC and
+ * traceFREE in FreeRTOSConfig.h), those before the scheduler starts as boot.
+ * host_static_bench_start() creates a task that lets the application run
+ * with CAN frames injected, then creates a thread, message queues,
+ * semaphores and memory pools defined with the osXxxDef() macros and times
+ * each create, as CSV:
+ *
+ *   static,boot_heap_calls,boot_heap_bytes,run_heap_calls,run_heap_bytes,frees,heap_free,heap_min_free,can_injected,can_received,errors
+ *   object,creates,min_ns,max_ns
+ *
+ * With USE_STATIC_ALLOC any heap call, at boot or after, is an error, as is
+ * a frame injected and not received or a create that fails.  It exits with
+ * 1 if a check fails.
+ ******************************************************************************
+ */
+#ifndef HOST_STATIC_BENCH_H
+#define HOST_STATIC_BENCH_H
+
+#include <stddef.h>
+
+void host_static_bench_start(void);
+
+/* traceMALLOC()/traceFREE() of heap_4.c */
+void host_static_bench_malloc(void *address, size_t size);
+void host_static_bench_free(void *address, size_t size);
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ ******************************************************************************
+ * @file           : host_tickless_bench.h
+ * @brief          : Host check of the tickless idle (tickless.c)
+ ******************************************************************************
+ * Built with USE_HOST_SIM and USE_TICKLESS_BENCH, with or without
+ * USE_TICKLESS: without it the rows show the interrupts of the 1 ms tick.
+ * host_tickless_bench_start() creates a task that runs two phases, as CSV:
+ *
+ *   phase,seconds,delays,late,tick_irqs_per_s,irqs_per_s,sleeps,early,aborted,held,stepped,lost,can_injected,can_received,tick_mismatches,tick_error_max,errors
+ *
+ *  - idle:   the task blocks for 50 to 250 ticks, only the tasks of the
+ *            application run besides.
+ *  - random: the task blocks for 1 to 60 ticks while a host thread injects
+ *            CAN frames at random times, which end sleeps early.
+ *
+ * After every delay the tick count of the kernel, with the tick interrupt
+ * pending, is checked against the tick boundaries the TIM1 counter passed
+ * (host_periph_stats.tim_counts), and HAL_GetTick() against the kernel: a
+ * wake where either differs is a mismatch, tick_error_max is the largest
+ * difference of the first.  The host may hold a simulated interrupt longer than a counter period, lost
+ * are the ticks of the periods whose update found UIF still set; the tick of
+ * the baseline loses them too.  A delay may not end before its ticks (late
+ * counts those that ended after), every frame injected must be received.
+ * It exits with 1 if a check fails.
+ ******************************************************************************
+ */
+#ifndef HOST_TICKLESS_BENCH_H
+#define HOST_TICKLESS_BENCH_H
+
+void host_tickless_bench_start(void);
+
+#endif
@@ -0,0 +1,25 @@
+/**
+ ******************************************************************************
+ * @file           : host_trace_bench.h
+ * @brief          : Host benchmark of the event trace (trace.c)
+ ******************************************************************************
+ * Built with USE_HOST_SIM, USE_TRACE and USE_TRACE_BENCH.
+ * host_trace_bench_start() creates a task that lets the application run for
+ * a few periods of its 1000 ms task, writes trace_buffer to trace.bin for
+ * Host/Tools/trace2json and checks the records: the times only go back
+ * across a nested record, every interrupt exit matches the last enter.
+ * Then it times trace_record() itself, as CSV:
+ *
+ *   records,span_ms,switches,isrs,queue_ops,delays,notifies,errors
+ *   test,iterations,min_cycles,avg_cycles,max_cycles,min_ns,avg_ns,max_ns
+ *
+ * The cycles are the ns at SystemCoreClock, like kernel_bench.c.  It exits
+ * with 1 if a check fails.
+ ******************************************************************************
+ */
+#ifndef HOST_TRACE_BENCH_H
+#define HOST_TRACE_BENCH_H
+
+void host_trace_bench_start(void);
+
+#endif
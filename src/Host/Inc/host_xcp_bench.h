@@ -0,0 +1,25 @@
+/**
+ ******************************************************************************
+ * @file           : host_xcp_bench.h
+ * @brief          : Host benchmark of the XCP on CAN slave (xcp.c)
+ ******************************************************************************
+ * Built with USE_HOST_SIM, USE_XCP and USE_XCP_BENCH.  host_xcp_bench_start()
+ * creates a task that plays the XCP master as the other node of the CAN
+ * model: it checks the answers to a set of commands, then configures one DAQ
+ * list on the 1 ms event with more and more ODTs and measures what arrives.
+ * One CSV row per run, then the largest list each bit rate carries without
+ * a loss:
+ *
+ *   rate,odts,prescaler,cycles,complete,incomplete,lost,overloads,reordered,mismatches,dto_per_s,daq_bytes_per_s,bus_frames_per_s
+ *   max,rate,odts,dto_per_s,daq_bytes_per_s
+ *
+ * It exits with 1 if an answer is wrong, an ODT carries another sample than
+ * the other ODTs of its cycle, or a cycle is lost without an overload.
+ ******************************************************************************
+ */
+#ifndef HOST_XCP_BENCH_H
+#define HOST_XCP_BENCH_H
+
+void host_xcp_bench_start(void);
+
+#endif
@@ -0,0 +1,846 @@
+/**
+ ******************************************************************************
+ * @file           : host_can.c
+ * @brief          : Behavioral model of the bxCAN (CAN1) for the host simulation
+ ******************************************************************************
+ * The node sits on a simulated bus together with one other node whose frames
+ * are queued by host_can_inject().  Every frame occupies the bus for its exact
+ * number of bit times (stuff bits, EOF and interframe space included), the bit
+ * time comes from BTR and PCLK1.  All the frames on the bus are acknowledged.
+ *
+ * TX: a mailbox is requested when TXRQ is found set in a free mailbox.  When
+ * the bus goes idle the pending mailbox of highest priority (identifier or
+ * request order, see TXFP) arbitrates against the head of the injected queue.
+ * A mailbox that loses is completed with ALST when NART is set, it retries
+ * otherwise.  ABRQ aborts a mailbox that has not started yet.
+ *
+ * RX: injected frames (and our own in loopback mode) go through the filter
+ * banks with the priority rules and the filter numbering of RM0008, then into
+ * the 3-deep FIFO the bank is assigned to.  FULL/FOVR and RFLM behave like on
+ * the target, RFOM releases the output mailbox.
+ *
+ * The time stamps of TDTR/RDTR count bit times since the end of the
+ * initialization mode and are only captured with TTCM set.
+ ******************************************************************************
+ */
+#include <pthread.h>
+#include <string.h>
+
+#include "host_model.h"
+#include "FreeRTOS.h"
+
+#define HOST_CAN_MAILBOXES              3U
+#define HOST_CAN_FIFO_DEPTH             3U
+#define HOST_CAN_FILTER_BANKS           14U
+#define HOST_CAN_INJECT_DEPTH           64U
+
+/* Owner of the bus */
+#define HOST_CAN_BUS_IDLE               (-1)
+#define HOST_CAN_BUS_INJECTED           ((int)HOST_CAN_MAILBOXES)
+
+/* Status bits of one mailbox in TSR, cleared by writing 1 */
+#define HOST_CAN_TSR_STATUS             (CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 | CAN_TSR_TERR0)
+#define HOST_CAN_TSR_SHIFT(m)           (8U * (m))
+
+/* Bits of a frame after the CRC sequence: CRC delimiter, ACK slot, ACK
+ * delimiter, EOF and the interframe space. */
+#define HOST_CAN_TRAILER_BITS           (1U + 2U + 7U + 3U)
+
+typedef struct
+{
+    host_can_frame_t frame;
+    uint32_t pending;       /* waiting for the bus */
+    uint32_t seq;           /* order of the request, used with TXFP */
+    uint64_t time;          /* sync that found the request */
+} host_can_mailbox_t;
+
+typedef struct
+{
+    host_can_frame_t frame;
+    uint32_t fmi;
+    uint32_t time;
+} host_can_rx_t;
+
+typedef struct
+{
+    host_can_rx_t entries[HOST_CAN_FIFO_DEPTH];
+    uint32_t count;
+    uint32_t full;
+    uint32_t overrun;
+    uint32_t rfr;           /* RFxR published at the last sync */
+} host_can_fifo_t;
+
+static void (*host_can_listener)(const host_can_frame_t *frame, uint64_t start, uint64_t end);
+
+static host_can_mailbox_t host_can_mailboxes[HOST_CAN_MAILBOXES];
+static uint32_t host_can_seq;
+static uint32_t host_can_tsr;
+static host_can_fifo_t host_can_fifos[2];
+static uint64_t host_can_epoch;
+
+static int host_can_bus_owner;
+static host_can_frame_t host_can_bus_frame;
+static uint64_t host_can_bus_start;
+static uint64_t host_can_bus_end;
+static uint64_t host_can_bus_idle;
+
+/* Frames of the other node, written by any thread. */
+static pthread_mutex_t host_can_inject_mutex = PTHREAD_MUTEX_INITIALIZER;
+static host_can_frame_t host_can_inject_frames[HOST_CAN_INJECT_DEPTH];
+static uint64_t host_can_inject_times[HOST_CAN_INJECT_DEPTH];
+static uint32_t host_can_inject_head;
+static uint32_t host_can_inject_count;
+
+void host_can_set_tx_listener(void (*listener)(const host_can_frame_t *frame, uint64_t start, uint64_t end))
+{
+    host_can_listener = listener;
+}
+
+int host_can_inject(const host_can_frame_t *frame)
+{
+    uint32_t index;
+
+    pthread_mutex_lock(&host_can_inject_mutex);
+    if (host_can_inject_count == HOST_CAN_INJECT_DEPTH)
+    {
+        pthread_mutex_unlock(&host_can_inject_mutex);
+        return -1;
+    }
+    index = (host_can_inject_head + host_can_inject_count) % HOST_CAN_INJECT_DEPTH;
+    host_can_inject_frames[index] = *frame;
+    host_can_inject_times[index] = host_periph_time_ns();
+    host_can_inject_count++;
+    pthread_mutex_unlock(&host_can_inject_mutex);
+
+    /* Lets the model start the frame if the bus is idle. */
+    vPortGenerateSimulatedInterrupt(HOST_PERIPH_INTERRUPT);
+    return 0;
+}
+
+/* Frame bits -----------------------------------------------------------------*/
+typedef struct
+{
+    uint8_t bits[128];
+    uint32_t count;
+} host_can_bits_t;
+
+static void host_can_push(host_can_bits_t *b, uint32_t value, uint32_t width)
+{
+    while (width > 0U)
+    {
+        width--;
+        b->bits[b->count++] = (uint8_t)((value >> width) & 1U);
+    }
+}
+
+uint32_t host_can_frame_bits(const host_can_frame_t *frame)
+{
+    host_can_bits_t b;
+    uint32_t crc = 0U;
+    uint32_t bytes = (frame->rtr != 0U) ? 0U : ((frame->dlc > 8U) ? 8U : frame->dlc);
+    uint32_t stuffed;
+    uint32_t run;
+    uint32_t last;
+    uint32_t i;
+
+    b.count = 0U;
+    host_can_push(&b, 0U, 1U);                                  /* SOF */
+    if (frame->ide != 0U)
+    {
+        host_can_push(&b, frame->id >> 18U, 11U);
+        host_can_push(&b, 3U, 2U);                              /* SRR, IDE */
+        host_can_push(&b, frame->id & 0x3FFFFU, 18U);
+        host_can_push(&b, frame->rtr, 1U);
+        host_can_push(&b, 0U, 2U);                              /* r1, r0 */
+    }
+    else
+    {
+        host_can_push(&b, frame->id, 11U);
+        host_can_push(&b, frame->rtr, 1U);
+        host_can_push(&b, 0U, 2U);                              /* IDE, r0 */
+    }
+    host_can_push(&b, frame->dlc & 0xFU, 4U);
+    for (i = 0U; i < bytes; i++)
+    {
+        host_can_push(&b, frame->data[i], 8U);
+    }
+
+    /* CRC-15, x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1 */
+    for (i = 0U; i < b.count; i++)
+    {
+        crc = ((crc << 1U) ^ ((((crc >> 14U) ^ b.bits[i]) & 1U) != 0U ? 0x4599U : 0U)) & 0x7FFFU;
+    }
+    host_can_push(&b, crc, 15U);
+
+    /* A stuff bit follows every 5 equal bits up to the end of the CRC, it is
+     * the complement and starts the next run itself. */
+    stuffed = 0U;
+    run = 0U;
+    last = 2U;
+    for (i = 0U; i < b.count; i++)
+    {
+        if (b.bits[i] == last)
+        {
+            run++;
+        }
+        else
+        {
+            last = b.bits[i];
+            run = 1U;
+        }
+        if (run == 5U)
+        {
+            stuffed++;
+            last ^= 1U;
+            run = 1U;
+        }
+    }
+
+    return b.count + stuffed + HOST_CAN_TRAILER_BITS;
+}
+
+/* Lower key wins the arbitration: identifier, then SRR/RTR, IDE, extension. */
+static uint64_t host_can_arb_key(const host_can_frame_t *frame)
+{
+    if (frame->ide != 0U)
+    {
+        return ((uint64_t)(frame->id >> 18U) << 21U) | (1ULL << 20U) | (1ULL << 19U)
+               | ((uint64_t)(frame->id & 0x3FFFFU) << 1U) | frame->rtr;
+    }
+    return ((uint64_t)frame->id << 21U) | ((uint64_t)frame->rtr << 20U);
+}
+
+/* Register layouts -----------------------------------------------------------*/
+static uint32_t host_can_id_word(const host_can_frame_t *frame)
+{
+    if (frame->ide != 0U)
+    {
+        return (frame->id << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE | ((uint32_t)frame->rtr << CAN_TI0R_RTR_Pos);
+    }
+    return (frame->id << CAN_TI0R_STID_Pos) | ((uint32_t)frame->rtr << CAN_TI0R_RTR_Pos);
+}
+
+static uint32_t host_can_id_half(const host_can_frame_t *frame)
+{
+    if (frame->ide != 0U)
+    {
+        return ((frame->id >> 18U) << 5U) | ((uint32_t)frame->rtr << 4U) | (1U << 3U) | ((frame->id >> 15U) & 7U);
+    }
+    return (frame->id << 5U) | ((uint32_t)frame->rtr << 4U);
+}
+
+static void host_can_frame_from_mailbox(host_can_frame_t *frame, const CAN_TxMailBox_TypeDef *mb)
+{
+    uint32_t i;
+
+    frame->ide = ((mb->TIR & CAN_TI0R_IDE) != 0U) ? 1U : 0U;
+    frame->rtr = ((mb->TIR & CAN_TI0R_RTR) != 0U) ? 1U : 0U;
+    frame->id = (frame->ide != 0U) ? (mb->TIR >> CAN_TI0R_EXID_Pos) : (mb->TIR >> CAN_TI0R_STID_Pos);
+    frame->dlc = (uint8_t)(mb->TDTR & CAN_TDT0R_DLC);
+    for (i = 0U; i < 4U; i++)
+    {
+        frame->data[i] = (uint8_t)(mb->TDLR >> (8U * i));
+        frame->data[i + 4U] = (uint8_t)(mb->TDHR >> (8U * i));
+    }
+}
+
+/* Timing ---------------------------------------------------------------------*/
+static uint64_t host_can_bits_ns(uint32_t bits)
+{
+    uint32_t btr = host_can1.BTR;
+    uint64_t tq_per_bit = 3U + ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) + ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos);
+    uint64_t brp = (btr & CAN_BTR_BRP) + 1U;
+    uint32_t pclk = host_rcc_pclk1();
+
+    if (pclk == 0U)
+    {
+        return 0U;
+    }
+    return ((uint64_t)bits * tq_per_bit * brp * HOST_NS_PER_S) / pclk;
+}
+
+static uint32_t host_can_timestamp(uint64_t t)
+{
+    uint64_t bit_ns = host_can_bits_ns(1U);
+
+    if (((host_can1.MCR & CAN_MCR_TTCM) == 0U) || (bit_ns == 0U) || (t < host_can_epoch))
+    {
+        return 0U;
+    }
+    return (uint32_t)(((t - host_can_epoch) / bit_ns) & 0xFFFFU);
+}
+
+static uint32_t host_can_normal_mode(void)
+{
+    return ((host_can1.MSR & (CAN_MSR_INAK | CAN_MSR_SLAK)) == 0U) ? 1U : 0U;
+}
+
+/* RX -------------------------------------------------------------------------*/
+
+/* Finds the filter of highest priority that accepts the frame: 32-bit before
+ * 16-bit scale, list before mask mode, then the lowest bank.  The filter
+ * numbers count all the filters assigned to the same FIFO, active or not. */
+static uint32_t host_can_filter(const host_can_frame_t *frame, uint32_t *fifo, uint32_t *fmi)
+{
+    uint32_t word = host_can_id_word(frame);
+    uint32_t half = host_can_id_half(frame);
+    uint32_t number[2] = {0U, 0U};
+    uint32_t best_rank = 4U;
+    uint32_t bank;
+    uint32_t bit;
+    uint32_t f;
+    uint32_t scale32;
+    uint32_t list;
+    uint32_t rank;
+    uint32_t hit;
+    uint32_t fr1;
+    uint32_t fr2;
+
+    for (bank = 0U; bank < HOST_CAN_FILTER_BANKS; bank++)
+    {
+        bit = 1UL << bank;
+        f = ((host_can1.FFA1R & bit) != 0U) ? 1U : 0U;
+        scale32 = ((host_can1.FS1R & bit) != 0U) ? 1U : 0U;
+        list = ((host_can1.FM1R & bit) != 0U) ? 1U : 0U;
+        rank = ((scale32 != 0U) ? 0U : 2U) + ((list != 0U) ? 0U : 1U);
+        hit = 4U;
+
+        if (((host_can1.FA1R & bit) != 0U) && (rank < best_rank))
+        {
+            fr1 = host_can1.sFilterRegister[bank].FR1;
+            fr2 = host_can1.sFilterRegister[bank].FR2;
+
+            if ((scale32 != 0U) && (list == 0U))
+            {
+                /* bit 0 is reserved, it never takes part in the match */
+                if (((word ^ fr1) & fr2 & ~1U) == 0U)
+                {
+                    hit = 0U;
+                }
+            }
+            else if (scale32 != 0U)
+            {
+                if (((word ^ fr1) & ~1U) == 0U)
+                {
+                    hit = 0U;
+                }
+                else if (((word ^ fr2) & ~1U) == 0U)
+                {
+                    hit = 1U;
+                }
+            }
+            else if (list == 0U)
+            {
+                /* FRx: identifier in the low half, mask in the high half */
+                if (((half ^ fr1) & (fr1 >> 16U)) == 0U)
+                {
+                    hit = 0U;
+                }
+                else if (((half ^ fr2) & (fr2 >> 16U)) == 0U)
+                {
+                    hit = 1U;
+                }
+            }
+            else
+            {
+                if (half == (fr1 & 0xFFFFU))
+                {
+                    hit = 0U;
+                }
+                else if (half == (fr1 >> 16U))
+                {
+                    hit = 1U;
+                }
+                else if (half == (fr2 & 0xFFFFU))
+                {
+                    hit = 2U;
+                }
+                else if (half == (fr2 >> 16U))
+                {
+                    hit = 3U;
+                }
+            }
+
+            if (hit < 4U)
+            {
+                best_rank = rank;
+                *fifo = f;
+                *fmi = number[f] + hit;
+            }
+        }
+
+        number[f] += (scale32 != 0U) ? ((list != 0U) ? 2U : 1U) : ((list != 0U) ? 4U : 2U);
+    }
+
+    return (best_rank < 4U) ? 1U : 0U;
+}
+
+static void host_can_receive(const host_can_frame_t *frame, uint64_t sof)
+{
+    host_can_fifo_t *fifo;
+    host_can_rx_t *entry;
+    uint32_t f = 0U;
+    uint32_t fmi = 0U;
+
+    if (((host_can1.FMR & CAN_FMR_FINIT) != 0U) || (host_can_filter(frame, &f, &fmi) == 0U))
+    {
+        return;
+    }
+
+    fifo = &host_can_fifos[f];
+    if (fifo->count == HOST_CAN_FIFO_DEPTH)
+    {
+        fifo->overrun = 1U;
+        host_periph_stats.can_rx_overruns++;
+        if ((host_can1.MCR & CAN_MCR_RFLM) != 0U)
+        {
+            return;
+        }
+        /* not locked: the last message is overwritten */
+        entry = &fifo->entries[HOST_CAN_FIFO_DEPTH - 1U];
+    }
+    else
+    {
+        entry = &fifo->entries[fifo->count];
+        fifo->count++;
+        if (fifo->count == HOST_CAN_FIFO_DEPTH)
+        {
+            fifo->full = 1U;
+        }
+    }
+
+    entry->frame = *frame;
+    entry->fmi = fmi;
+    entry->time = host_can_timestamp(sof);
+    host_periph_stats.can_rx_frames++;
+}
+
+static void host_can_release(host_can_fifo_t *fifo)
+{
+    if (fifo->count > 0U)
+    {
+        memmove(&fifo->entries[0], &fifo->entries[1], (fifo->count - 1U) * sizeof(host_can_rx_t));
+        fifo->count--;
+    }
+}
+
+/* TX and bus -----------------------------------------------------------------*/
+static void host_can_tx_done(uint32_t m, uint32_t status)
+{
+    host_can_mailboxes[m].pending = 0U;
+    host_can_tsr &= ~(HOST_CAN_TSR_STATUS << HOST_CAN_TSR_SHIFT(m));
+    host_can_tsr |= (status << HOST_CAN_TSR_SHIFT(m)) | (CAN_TSR_TME0 << m);
+    host_can1.sTxMailBox[m].TIR &= ~CAN_TI0R_TXRQ;
+}
+
+static void host_can_bus_complete(void)
+{
+    int owner = host_can_bus_owner;
+
+    host_periph_stats.can_bus_busy_ns += host_can_bus_end - host_can_bus_start;
+    host_can_bus_owner = HOST_CAN_BUS_IDLE;
+    host_can_bus_idle = host_can_bus_end;
+
+    if (owner == HOST_CAN_BUS_INJECTED)
+    {
+        if (host_can_normal_mode() != 0U)
+        {
+            host_can_receive(&host_can_bus_frame, host_can_bus_start);
+        }
+        return;
+    }
+
+    host_can_tx_done((uint32_t)owner, CAN_TSR_RQCP0 | CAN_TSR_TXOK0);
+    host_periph_stats.can_tx_frames++;
+    if (((host_can1.BTR & CAN_BTR_SILM) == 0U) && (host_can_listener != NULL))
+    {
+        host_can_listener(&host_can_bus_frame, host_can_bus_start, host_can_bus_end);
+    }
+    if ((host_can1.BTR & CAN_BTR_LBKM) != 0U)
+    {
+        host_can_receive(&host_can_bus_frame, host_can_bus_start);
+    }
+}
+
+/* Pending mailbox of highest priority among the ones requested by t, -1 when
+ * there is none. */
+static int host_can_best_mailbox(uint64_t t)
+{
+    int best = -1;
+    uint32_t m;
+    const host_can_mailbox_t *mb;
+
+    for (m = 0U; m < HOST_CAN_MAILBOXES; m++)
+    {
+        mb = &host_can_mailboxes[m];
+        if ((mb->pending == 0U) || (mb->time > t))
+        {
+            continue;
+        }
+        if (best < 0)
+        {
+            best = (int)m;
+        }
+        else if ((host_can1.MCR & CAN_MCR_TXFP) != 0U)
+        {
+            if (mb->seq < host_can_mailboxes[best].seq)
+            {
+                best = (int)m;
+            }
+        }
+        else if (host_can_arb_key(&mb->frame) < host_can_arb_key(&host_can_mailboxes[best].frame))
+        {
+            best = (int)m;
+        }
+    }
+    return best;
+}
+
+/* Time the bus starts its next frame: when it goes idle, or later when the
+ * first request arrives.  HOST_TIME_NEVER when nothing is requested. */
+static uint64_t host_can_bus_next_start(void)
+{
+    uint64_t first = HOST_TIME_NEVER;
+    uint32_t m;
+
+    if (host_can_normal_mode() != 0U)
+    {
+        for (m = 0U; m < HOST_CAN_MAILBOXES; m++)
+        {
+            if ((host_can_mailboxes[m].pending != 0U) && (host_can_mailboxes[m].time < first))
+            {
+                first = host_can_mailboxes[m].time;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&host_can_inject_mutex);
+    if ((host_can_inject_count > 0U) && (host_can_inject_times[host_can_inject_head] < first))
+    {
+        first = host_can_inject_times[host_can_inject_head];
+    }
+    pthread_mutex_unlock(&host_can_inject_mutex);
+
+    if (first == HOST_TIME_NEVER)
+    {
+        return HOST_TIME_NEVER;
+    }
+    return (first > host_can_bus_idle) ? first : host_can_bus_idle;
+}
+
+/* Arbitration at the start of a frame: the best mailbox against the frame of
+ * the other node, both requested by start. */
+static void host_can_bus_start_frame(uint64_t start)
+{
+    int m = (host_can_normal_mode() != 0U) ? host_can_best_mailbox(start) : -1;
+    uint32_t injected;
+
+    pthread_mutex_lock(&host_can_inject_mutex);
+    injected = ((host_can_inject_count > 0U) && (host_can_inject_times[host_can_inject_head] <= start)) ? 1U : 0U;
+
+    if ((injected != 0U)
+        && ((m < 0) || (host_can_arb_key(&host_can_inject_frames[host_can_inject_head]) < host_can_arb_key(&host_can_mailboxes[m].frame))))
+    {
+        host_can_bus_frame = host_can_inject_frames[host_can_inject_head];
+        host_can_inject_head = (host_can_inject_head + 1U) % HOST_CAN_INJECT_DEPTH;
+        host_can_inject_count--;
+        host_can_bus_owner = HOST_CAN_BUS_INJECTED;
+
+        if ((m >= 0) && ((host_can1.MCR & CAN_MCR_NART) != 0U))
+        {
+            /* single shot: the mailbox that lost is done */
+            host_can_tx_done((uint32_t)m, CAN_TSR_RQCP0 | CAN_TSR_ALST0);
+            host_periph_stats.can_tx_lost++;
+        }
+    }
+    else
+    {
+        host_can_bus_frame = host_can_mailboxes[m].frame;
+        host_can_mailboxes[m].pending = 0U;
+        host_can_bus_owner = m;
+        if ((host_can1.MCR & CAN_MCR_TTCM) != 0U)
+        {
+            host_can1.sTxMailBox[m].TDTR = (host_can1.sTxMailBox[m].TDTR & 0xFFFFU) | (host_can_timestamp(start) << CAN_TDT0R_TIME_Pos);
+        }
+    }
+    pthread_mutex_unlock(&host_can_inject_mutex);
+
+    host_can_bus_start = start;
+    host_can_bus_end = start + host_can_bits_ns(host_can_frame_bits(&host_can_bus_frame));
+}
+
+/* Runs the bus up to t, returns the time of its next event. */
+static uint64_t host_can_bus_run(uint64_t t)
+{
+    uint64_t start;
+
+    for (;;)
+    {
+        if (host_can_bus_owner != HOST_CAN_BUS_IDLE)
+        {
+            if (host_can_bus_end > t)
+            {
+                return host_can_bus_end;
+            }
+            host_can_bus_complete();
+        }
+
+        start = host_can_bus_next_start();
+        if (start > t)
+        {
+            return start;
+        }
+        host_can_bus_start_frame(start);
+    }
+}
+
+/* Registers ------------------------------------------------------------------*/
+static void host_can_reset_core(void)
+{
+    uint32_t m;
+
+    host_can1.MCR = 0x00010002U;
+    host_can1.MSR = 0x00000C02U;
+    host_can1.RF0R = 0U;
+    host_can1.RF1R = 0U;
+    host_can1.IER = 0U;
+    host_can1.ESR = 0U;
+    host_can1.BTR = 0x01230000U;
+
+    host_can_tsr = CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2;
+    host_can1.TSR = host_can_tsr;
+    for (m = 0U; m < HOST_CAN_MAILBOXES; m++)
+    {
+        host_can_mailboxes[m].pending = 0U;
+        host_can1.sTxMailBox[m].TIR &= ~CAN_TI0R_TXRQ;
+    }
+    memset(host_can_fifos, 0, sizeof(host_can_fifos));
+    memset((void *)host_can1.sFIFOMailBox, 0, sizeof(host_can1.sFIFOMailBox));
+
+    host_can_bus_owner = HOST_CAN_BUS_IDLE;
+    host_can_bus_idle = 0U;
+}
+
+void host_can_reset(void)
+{
+    memset(&host_can1, 0, sizeof(host_can1));
+    host_can1.FMR = 0x2A1C0E01U;
+    host_can_reset_core();
+}
+
+static void host_can_update_mode(uint64_t now)
+{
+    uint32_t mcr = host_can1.MCR;
+    uint32_t msr = host_can1.MSR & ~(CAN_MSR_INAK | CAN_MSR_SLAK);
+    uint32_t was_normal = host_can_normal_mode();
+
+    if ((mcr & CAN_MCR_INRQ) != 0U)
+    {
+        msr |= CAN_MSR_INAK;
+    }
+    else if ((mcr & CAN_MCR_SLEEP) != 0U)
+    {
+        msr |= CAN_MSR_SLAK;
+    }
+    host_can1.MSR = msr;
+
+    if ((was_normal == 0U) && (host_can_normal_mode() != 0U))
+    {
+        host_can_epoch = now;
+    }
+}
+
+static void host_can_update_tsr(void)
+{
+    uint32_t w = host_can1.TSR;
+    uint32_t status;
+    uint32_t m;
+
+    if (w == host_can_tsr)
+    {
+        return;
+    }
+
+    for (m = 0U; m < HOST_CAN_MAILBOXES; m++)
+    {
+        status = (w >> HOST_CAN_TSR_SHIFT(m)) & HOST_CAN_TSR_STATUS;
+        if ((status & CAN_TSR_RQCP0) != 0U)
+        {
+            /* clearing RQCP clears all the status bits of the mailbox */
+            status = HOST_CAN_TSR_STATUS;
+        }
+        host_can_tsr &= ~(status << HOST_CAN_TSR_SHIFT(m));
+
+        if (((w & (CAN_TSR_ABRQ0 << HOST_CAN_TSR_SHIFT(m))) != 0U) && (host_can_mailboxes[m].pending != 0U))
+        {
+            host_can_tx_done(m, CAN_TSR_RQCP0);
+            host_periph_stats.can_tx_lost++;
+        }
+    }
+}
+
+static void host_can_update_requests(uint64_t now)
+{
+    CAN_TxMailBox_TypeDef *mb;
+    uint32_t m;
+
+    for (m = 0U; m < HOST_CAN_MAILBOXES; m++)
+    {
+        mb = &host_can1.sTxMailBox[m];
+        if (((host_can_tsr & (CAN_TSR_TME0 << m)) != 0U) && ((mb->TIR & CAN_TI0R_TXRQ) != 0U))
+        {
+            host_can_frame_from_mailbox(&host_can_mailboxes[m].frame, mb);
+            host_can_mailboxes[m].pending = 1U;
+            host_can_mailboxes[m].seq = host_can_seq++;
+            host_can_mailboxes[m].time = now;
+            /* a request clears RQCP, TXOK, ALST and TERR of the mailbox:
+             * status the CPU did not clear in time, e.g. when the last of
+             * several writes to TSR between two syncs hid the others */
+            host_can_tsr &= ~((CAN_TSR_TME0 << m) | (HOST_CAN_TSR_STATUS << HOST_CAN_TSR_SHIFT(m)));
+        }
+    }
+}
+
+static void host_can_update_fifo(host_can_fifo_t *fifo, volatile uint32_t *rfr)
+{
+    uint32_t w = *rfr;
+
+    if (w == fifo->rfr)
+    {
+        return;
+    }
+    if ((w & CAN_RF0R_FULL0) != 0U)
+    {
+        fifo->full = 0U;
+    }
+    if ((w & CAN_RF0R_FOVR0) != 0U)
+    {
+        fifo->overrun = 0U;
+    }
+    if ((w & CAN_RF0R_RFOM0) != 0U)
+    {
+        host_can_release(fifo);
+    }
+}
+
+static void host_can_publish_fifo(host_can_fifo_t *fifo, volatile uint32_t *rfr, CAN_FIFOMailBox_TypeDef *out)
+{
+    const host_can_rx_t *head = &fifo->entries[0];
+
+    fifo->rfr = fifo->count;
+    if (fifo->full != 0U)
+    {
+        fifo->rfr |= CAN_RF0R_FULL0;
+    }
+    if (fifo->overrun != 0U)
+    {
+        fifo->rfr |= CAN_RF0R_FOVR0;
+    }
+    *rfr = fifo->rfr;
+
+    if (fifo->count > 0U)
+    {
+        out->RIR = host_can_id_word(&head->frame);
+        out->RDTR = (head->frame.dlc & 0xFU) | (head->fmi << CAN_RDT0R_FMI_Pos) | (head->time << CAN_RDT0R_TIME_Pos);
+        out->RDLR = (uint32_t)head->frame.data[0] | ((uint32_t)head->frame.data[1] << 8U)
+                    | ((uint32_t)head->frame.data[2] << 16U) | ((uint32_t)head->frame.data[3] << 24U);
+        out->RDHR = (uint32_t)head->frame.data[4] | ((uint32_t)head->frame.data[5] << 8U)
+                    | ((uint32_t)head->frame.data[6] << 16U) | ((uint32_t)head->frame.data[7] << 24U);
+    }
+}
+
+static void host_can_publish(void)
+{
+    uint32_t tsr = host_can_tsr & ~(CAN_TSR_CODE | CAN_TSR_LOW);
+    uint32_t msr = host_can1.MSR & ~(CAN_MSR_TXM | CAN_MSR_RXM);
+    uint32_t m;
+
+    /* CODE: the next free mailbox */
+    for (m = 0U; m < HOST_CAN_MAILBOXES; m++)
+    {
+        if ((tsr & (CAN_TSR_TME0 << m)) != 0U)
+        {
+            tsr |= m << CAN_TSR_CODE_Pos;
+            break;
+        }
+    }
+    host_can_tsr = tsr;
+    host_can1.TSR = tsr;
+
+    if (host_can_bus_owner == HOST_CAN_BUS_INJECTED)
+    {
+        msr |= CAN_MSR_RXM;
+    }
+    else if (host_can_bus_owner != HOST_CAN_BUS_IDLE)
+    {
+        msr |= CAN_MSR_TXM;
+    }
+    host_can1.MSR = msr;
+
+    host_can_publish_fifo(&host_can_fifos[0], &host_can1.RF0R, &host_can1.sFIFOMailBox[0]);
+    host_can_publish_fifo(&host_can_fifos[1], &host_can1.RF1R, &host_can1.sFIFOMailBox[1]);
+}
+
+uint64_t host_can_update(uint64_t now)
+{
+    uint64_t next;
+
+    if ((host_can1.MCR & CAN_MCR_RESET) != 0U)
+    {
+        host_can_reset_core();
+        return HOST_TIME_NEVER;
+    }
+
+    /* The CPU writes are compared with the registers published at the last
+     * sync, then the bus runs up to now.  A new request takes part from now,
+     * a status bit set by the bus after the write stays set. */
+    host_can_update_mode(now);
+    host_can_update_tsr();
+    host_can_update_requests(now);
+    host_can_update_fifo(&host_can_fifos[0], &host_can1.RF0R);
+    host_can_update_fifo(&host_can_fifos[1], &host_can1.RF1R);
+
+    next = host_can_bus_run(now);
+    host_can_publish();
+
+    return next;
+}
+
+uint32_t host_can_tx_causes(void)
+{
+    if ((host_can1.IER & CAN_IER_TMEIE) != 0U)
+    {
+        return host_can_tsr & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2);
+    }
+    return 0U;
+}
+
+static uint32_t host_can_rx_causes(const host_can_fifo_t *fifo, uint32_t fmpie, uint32_t ffie, uint32_t fovie)
+{
+    uint32_t ier = host_can1.IER;
+    uint32_t causes = 0U;
+
+    if (((ier & fmpie) != 0U) && (fifo->count != 0U))
+    {
+        causes |= CAN_RF0R_FMP0;
+    }
+    if (((ier & ffie) != 0U) && (fifo->full != 0U))
+    {
+        causes |= CAN_RF0R_FULL0;
+    }
+    if (((ier & fovie) != 0U) && (fifo->overrun != 0U))
+    {
+        causes |= CAN_RF0R_FOVR0;
+    }
+    return causes;
+}
+
+uint32_t host_can_rx0_causes(void)
+{
+    return host_can_rx_causes(&host_can_fifos[0], CAN_IER_FMPIE0, CAN_IER_FFIE0, CAN_IER_FOVIE0);
+}
+
+uint32_t host_can_rx1_causes(void)
+{
+    return host_can_rx_causes(&host_can_fifos[1], CAN_IER_FMPIE1, CAN_IER_FFIE1, CAN_IER_FOVIE1);
+}
@@ -0,0 +1,457 @@
+/**
+ ******************************************************************************
+ * @file           : host_can_bench.c
+ * @brief          : Host check of the CAN TX queue and RX ring (can_tx.c, can_rx.c)
+ ******************************************************************************
+ * Two bursts of CAN_TX_QUEUE_SIZE + 3 frames, standard and extended
+ * identifiers mixed, some of them twice; data[0] is the index of the frame in
+ * the burst.  Each burst is handed to can_tx_send() inside one critical
+ * section, so the TX interrupt only starts to refill the mailboxes after the
+ * whole burst is queued.
+ *
+ *  - priority:     one more frame than fits, which must be rejected.  The
+ *                  first three frames take the mailboxes in call order, the
+ *                  others must follow in arbitration order, equal
+ *                  identifiers in call order.
+ *  - arbitration:  the other node of host_can.c sends frames of identifier
+ *                  0 during the burst, every one of them wins against a
+ *                  mailbox (NART: ALST).  Every frame must still go out once.
+ *
+ * bus_idle_ns is the time the bus was idle between the first SOF of the
+ * burst and the end of its last frame.  The queue refills a mailbox while the
+ * other two are on the bus, so it is 0 unless the simulated interrupt comes
+ * more than two frames late, which the host scheduler does now and then; it
+ * is reported, not checked.  Frames of identifier 0x77 come from
+ * user_can_test_func() and are ignored.
+ *
+ * RX: at 500 kbit/s and 1 Mbit/s, with 0 and 8 data bytes, the other node
+ * keeps the bus full for HOST_CAN_BENCH_RX_TIME ticks.  The FIFO is locked
+ * (RFLM) during the run, so a frame the FIFO had no room for is lost before
+ * the ring and every frame stored in it must reach the task of user.c:
+ *
+ *   rate,dlc,hold,injected,fifo,fifo_overruns,ring_dropped,received,frames_per_s,bus_frames_per_s,irqs_per_100,irq_ns_per_frame
+ *
+ * fifo_overruns come from the latency of the simulated interrupt, which on a
+ * loaded host is far above the three frames of the FIFO; they are reported,
+ * not checked.  bus_frames_per_s is the rate of a full bus.  The hold rows
+ * mask the interrupts for HOST_CAN_BENCH_RX_HOLD frame times every tick, like
+ * a long critical section, so that frames pile up in the FIFOs.
+ *
+ * irqs_per_100 counts the interrupt handlers called per 100 frames stored in
+ * a FIFO, irq_ns_per_frame the host time spent in them per frame, the syncs
+ * of the model excluded: the work of the handlers themselves.
+ *
+ * With USE_CAN_STATS a last row compares the frame counts of can_stats.c
+ * with those of the model and can_stats_dump() prints the statistics.
+ ******************************************************************************
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "printf.h"
+#include "console.h"
+#include "user.h"
+#include "can_tx.h"
+#include "can_rx.h"
+#include "can_stats.h"
+#include "host_periph.h"
+#include "host_can_bench.h"
+
+#define HOST_CAN_BENCH_FRAMES           (CAN_TX_QUEUE_SIZE + 3U)
+#define HOST_CAN_BENCH_INJECTED         4U
+#define HOST_CAN_BENCH_STACK_SIZE       256U
+#define HOST_CAN_BENCH_SETTLE           300U        /* ticks, start-up log */
+#define HOST_CAN_BENCH_TIMEOUT          1000U       /* ticks */
+#define HOST_CAN_BENCH_APP_ID           0x77U
+#define HOST_CAN_BENCH_RX_TIME          200U        /* ticks */
+#define HOST_CAN_BENCH_RX_DRAIN         50U         /* ticks */
+#define HOST_CAN_BENCH_RX_ID            0x100U
+#define HOST_CAN_BENCH_RX_HOLD          5U          /* frame times */
+
+typedef struct
+{
+    uint32_t id;
+    uint32_t ide;
+} host_can_bench_id_t;
+
+typedef struct
+{
+    uint8_t index;
+    uint64_t start;
+    uint64_t end;
+} host_can_bench_seen_t;
+
+typedef struct
+{
+    const char *name;
+    uint32_t prescaler;
+    uint32_t bs1;
+    uint32_t bs2;
+} host_can_bench_rate_t;
+
+/* PCLK1 = 36 MHz */
+static const host_can_bench_rate_t host_can_bench_rates[] = {
+    {"500k", 9U, CAN_BS1_3TQ, CAN_BS2_4TQ},
+    {"1M", 4U, CAN_BS1_6TQ, CAN_BS2_2TQ},
+};
+
+/* 0 .. HOST_CAN_BENCH_FRAMES - 1 go in the burst, the last one is the extra
+ * frame of the priority burst. */
+static const host_can_bench_id_t host_can_bench_ids[] = {
+    {0x300U, 0U}, {0x100U, 0U}, {0x1234567U, 1U}, {0x050U, 0U},
+    {0x100U, 0U}, {0x0020000U, 1U}, {0x7FFU, 0U}, {0x008U, 0U},
+    {0x200U, 0U}, {0x1234567U, 1U}, {0x050U, 0U}, {0x010U, 0U},
+    {0x0000001U, 1U}, {0x400U, 0U}, {0x0FFU, 0U}, {0x100U, 0U},
+    {0x1FFFFFFFU, 1U}, {0x020U, 0U}, {0x001U, 0U}, {0x555U, 0U},
+};
+
+static host_can_bench_seen_t host_can_bench_seen[2U * HOST_CAN_BENCH_FRAMES];
+static uint32_t host_can_bench_count;
+
+/* Called by host_can.c for every frame CAN1 sends. */
+static void host_can_bench_listener(const host_can_frame_t *frame, uint64_t start, uint64_t end)
+{
+    uint32_t n;
+
+    if ((frame->ide == 0U) && (frame->id == HOST_CAN_BENCH_APP_ID))
+    {
+        return;
+    }
+    n = __atomic_load_n(&host_can_bench_count, __ATOMIC_RELAXED);
+    if (n < (sizeof(host_can_bench_seen) / sizeof(host_can_bench_seen[0])))
+    {
+        host_can_bench_seen[n].index = frame->data[0];
+        host_can_bench_seen[n].start = start;
+        host_can_bench_seen[n].end = end;
+    }
+    __atomic_store_n(&host_can_bench_count, n + 1U, __ATOMIC_RELEASE);
+}
+
+/* Identifier word of the mailbox (TIR), compares like the arbitration. */
+static uint32_t host_can_bench_key(uint32_t index)
+{
+    const host_can_bench_id_t *id = &host_can_bench_ids[index];
+
+    return (id->ide != 0U) ? ((id->id << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE) : (id->id << CAN_TI0R_STID_Pos);
+}
+
+/* Order the frames of the priority burst must have on the bus. */
+static void host_can_bench_expected(uint8_t order[])
+{
+    uint32_t i;
+    uint32_t j;
+    uint8_t v;
+
+    for (i = 0U; i < HOST_CAN_BENCH_FRAMES; i++)
+    {
+        order[i] = (uint8_t)i;
+    }
+    /* insertion sort behind the three mailboxes, stable */
+    for (i = 4U; i < HOST_CAN_BENCH_FRAMES; i++)
+    {
+        v = order[i];
+        for (j = i; (j > 3U) && (host_can_bench_key(order[j - 1U]) > host_can_bench_key(v)); j--)
+        {
+            order[j] = order[j - 1U];
+        }
+        order[j] = v;
+    }
+}
+
+static void host_can_bench_wait_idle(void)
+{
+    uint32_t t;
+
+    for (t = 0U; t < HOST_CAN_BENCH_TIMEOUT; t++)
+    {
+        if ((can_tx_pending() == 0U) && (HAL_CAN_GetTxMailboxesFreeLevel(&hcan) == 3U))
+        {
+            return;
+        }
+        vTaskDelay(1U);
+    }
+}
+
+/* Runs one burst, prints its row and returns the number of failed checks. */
+static uint32_t host_can_bench_burst(uint32_t arbitration)
+{
+    uint8_t expected[HOST_CAN_BENCH_FRAMES];
+    uint32_t times[HOST_CAN_BENCH_FRAMES] = {0U};
+    const uint32_t submit = (arbitration != 0U) ? HOST_CAN_BENCH_FRAMES : (HOST_CAN_BENCH_FRAMES + 1U);
+    CAN_TxHeaderTypeDef header;
+    host_can_frame_t other;
+    uint8_t data[8];
+    uint64_t busy;
+    uint64_t lost;
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0U;
+    uint64_t idle;
+    uint32_t rejected = 0U;
+    uint32_t missing = 0U;
+    uint32_t out_of_order = 0U;
+    uint32_t failed = 0U;
+    uint32_t seen;
+    uint32_t t;
+    uint32_t i;
+    UBaseType_t mask;
+
+    host_can_bench_wait_idle();
+    host_can_bench_expected(expected);
+    __atomic_store_n(&host_can_bench_count, 0U, __ATOMIC_RELEASE);
+    busy = host_periph_stats.can_bus_busy_ns;
+    lost = host_periph_stats.can_tx_lost;
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    for (i = 0U; i < submit; i++)
+    {
+        header.StdId = (host_can_bench_ids[i].ide != 0U) ? 0U : host_can_bench_ids[i].id;
+        header.ExtId = (host_can_bench_ids[i].ide != 0U) ? host_can_bench_ids[i].id : 0U;
+        header.IDE = (host_can_bench_ids[i].ide != 0U) ? CAN_ID_EXT : CAN_ID_STD;
+        header.RTR = CAN_RTR_DATA;
+        header.DLC = 1U + (i & 7U);
+        header.TransmitGlobalTime = DISABLE;
+        data[0] = (uint8_t)i;
+        for (t = 1U; t < 8U; t++)
+        {
+            data[t] = (uint8_t)(i + t);
+        }
+        if (can_tx_send(&header, data) != HAL_OK)
+        {
+            rejected++;
+        }
+    }
+    if (arbitration != 0U)
+    {
+        other.id = 0U;
+        other.ide = 0U;
+        other.rtr = 0U;
+        other.dlc = 0U;
+        for (i = 0U; i < HOST_CAN_BENCH_INJECTED; i++)
+        {
+            (void)host_can_inject(&other);
+        }
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    for (t = 0U; (t < HOST_CAN_BENCH_TIMEOUT) && (__atomic_load_n(&host_can_bench_count, __ATOMIC_ACQUIRE) < HOST_CAN_BENCH_FRAMES); t++)
+    {
+        vTaskDelay(1U);
+    }
+    host_can_bench_wait_idle();
+    seen = __atomic_load_n(&host_can_bench_count, __ATOMIC_ACQUIRE);
+    busy = host_periph_stats.can_bus_busy_ns - busy;
+    lost = host_periph_stats.can_tx_lost - lost;
+
+    for (i = 0U; (i < seen) && (i < (sizeof(host_can_bench_seen) / sizeof(host_can_bench_seen[0]))); i++)
+    {
+        if (host_can_bench_seen[i].index < HOST_CAN_BENCH_FRAMES)
+        {
+            times[host_can_bench_seen[i].index]++;
+        }
+        if ((i < HOST_CAN_BENCH_FRAMES) && (host_can_bench_seen[i].index != expected[i]))
+        {
+            out_of_order++;
+        }
+        first = (host_can_bench_seen[i].start < first) ? host_can_bench_seen[i].start : first;
+        last = (host_can_bench_seen[i].end > last) ? host_can_bench_seen[i].end : last;
+    }
+    for (i = 0U; i < HOST_CAN_BENCH_FRAMES; i++)
+    {
+        missing += (times[i] == 1U) ? 0U : 1U;
+    }
+    /* the bus time of the burst not spent on a frame, ours or the other's */
+    idle = ((seen > 0U) && ((last - first) > busy)) ? ((last - first) - busy) : 0U;
+
+    printf("%s,%u,%u,%u,%u,%u,%u,%u,%u\n", (arbitration != 0U) ? "arbitration" : "priority",
+           (unsigned int)submit, (unsigned int)rejected, (unsigned int)seen, (unsigned int)missing,
+           (unsigned int)out_of_order, (unsigned int)idle, (unsigned int)lost,
+           (unsigned int)((seen > 0U) ? ((last - first) / seen) : 0U));
+
+    failed += (seen == HOST_CAN_BENCH_FRAMES) ? 0U : 1U;
+    failed += (missing == 0U) ? 0U : 1U;
+    if (arbitration != 0U)
+    {
+        /* a lost mailbox goes back to the queue, after the two still
+         * waiting in the other mailboxes: the order is not checked */
+        failed += (rejected == 0U) ? 0U : 1U;
+        failed += (lost > 0U) ? 0U : 1U;
+    }
+    else
+    {
+        failed += (rejected == 1U) ? 0U : 1U;
+        failed += (out_of_order == 0U) ? 0U : 1U;
+    }
+    return failed;
+}
+
+/* Re-initialises CAN1, keeping its filters and interrupts. */
+static void host_can_bench_set_rate(const host_can_bench_rate_t *rate, uint32_t locked)
+{
+    host_can_bench_wait_idle();
+    (void)HAL_CAN_Stop(&hcan);
+    hcan.Init.Prescaler = rate->prescaler;
+    hcan.Init.TimeSeg1 = rate->bs1;
+    hcan.Init.TimeSeg2 = rate->bs2;
+    hcan.Init.ReceiveFifoLocked = (locked != 0U) ? ENABLE : DISABLE;
+    (void)HAL_CAN_Init(&hcan);
+    (void)HAL_CAN_Start(&hcan);
+}
+
+/* Runs one RX row, prints it and returns the number of failed checks.  With
+ * hold, the interrupts are masked for that many frame times every tick. */
+static uint32_t host_can_bench_rx(const host_can_bench_rate_t *rate, uint8_t dlc, uint32_t hold)
+{
+    host_can_frame_t other;
+    uint32_t injected = 0U;
+    uint32_t received;
+    uint32_t routed;
+    uint32_t unrouted;
+    uint32_t dropped;
+    uint32_t last;
+    uint64_t stored;
+    uint64_t overruns;
+    uint64_t irqs;
+    uint64_t irq_ns;
+    uint64_t start;
+    uint64_t end;
+    uint64_t frame_ns;
+    uint64_t held;
+    uint32_t tq;
+    uint32_t t;
+    UBaseType_t mask;
+
+    host_can_bench_set_rate(rate, 1U);
+    memset(&other, 0, sizeof(other));
+    other.dlc = dlc;
+    tq = 1U + ((rate->bs1 >> CAN_BTR_TS1_Pos) + 1U) + ((rate->bs2 >> CAN_BTR_TS2_Pos) + 1U);
+    frame_ns = ((uint64_t)host_can_frame_bits(&other) * rate->prescaler * tq * 1000U) / 36U;
+
+    received = user_can_rx_frames;
+    routed = user_can_rx_status + user_can_rx_command;
+    unrouted = user_can_rx_unrouted;
+    dropped = can_rx_dropped();
+    stored = host_periph_stats.can_rx_frames;
+    overruns = host_periph_stats.can_rx_overruns;
+    irqs = host_periph_stats.irqs;
+    irq_ns = host_periph_stats.irq_ns;
+    start = host_periph_time_ns();
+    end = start;
+
+    for (t = 0U; t < HOST_CAN_BENCH_RX_TIME; t++)
+    {
+        /* host_can_inject() wants the signals of the port blocked */
+        mask = taskENTER_CRITICAL_FROM_ISR();
+        for (;;)
+        {
+            /* every other frame above 0x3FF, to FIFO 1 */
+            other.id = HOST_CAN_BENCH_RX_ID + ((injected & 1U) << 10U) + ((injected >> 1U) & 0xFFU);
+            other.data[0] = (uint8_t)injected;
+            if (host_can_inject(&other) != 0)
+            {
+                break;
+            }
+            injected++;
+        }
+        held = host_periph_time_ns();
+        while ((host_periph_time_ns() - held) < (hold * frame_ns))
+        {
+        }
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+        vTaskDelay(1U);
+    }
+    /* until the last injected frame has gone through the ring */
+    last = user_can_rx_frames;
+    for (t = 0U; t < HOST_CAN_BENCH_RX_DRAIN; t++)
+    {
+        vTaskDelay(1U);
+        if ((user_can_rx_frames != last) || (can_rx_pending() != 0U))
+        {
+            last = user_can_rx_frames;
+            end = host_periph_time_ns();
+            t = 0U;
+        }
+    }
+
+    received = user_can_rx_frames - received;
+    routed = user_can_rx_status + user_can_rx_command - routed;
+    unrouted = user_can_rx_unrouted - unrouted;
+    dropped = can_rx_dropped() - dropped;
+    stored = host_periph_stats.can_rx_frames - stored;
+    overruns = host_periph_stats.can_rx_overruns - overruns;
+    irqs = host_periph_stats.irqs - irqs;
+    irq_ns = host_periph_stats.irq_ns - irq_ns;
+
+    printf("%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", rate->name, (unsigned int)dlc, (unsigned int)hold,
+           (unsigned int)injected,
+           (unsigned int)stored, (unsigned int)overruns, (unsigned int)dropped, (unsigned int)received,
+           (unsigned int)((end > start) ? (((uint64_t)received * 1000000000ULL) / (end - start)) : 0U),
+           (unsigned int)(1000000000ULL / frame_ns),
+           (unsigned int)((stored > 0U) ? ((irqs * 100U) / stored) : 0U),
+           (unsigned int)((stored > 0U) ? (irq_ns / stored) : 0U));
+
+    /* every frame reaches the handler of its range through the FMI */
+    return ((dropped == 0U) && (received == stored) && (received > 0U) && (routed == received) && (unrouted == 0U))
+               ? 0U
+               : 1U;
+}
+
+#if defined(USE_CAN_STATS)
+/* Every frame the model stored in a FIFO went through the hooks, and every
+ * frame it sent but up to the three whose interrupt may still be due. */
+static uint32_t host_can_bench_stats(void)
+{
+    can_stats_t stats;
+
+    can_stats_get(&stats);
+    printf("stats,rx_frames,tx_frames,model_rx_frames,model_tx_frames,high_water,overruns,latency_max_us\n");
+    printf("stats,%u,%u,%u,%u,%u/%u,%u/%u,%u\n", (unsigned int)stats.rx_frames, (unsigned int)stats.tx_frames,
+           (unsigned int)host_periph_stats.can_rx_frames, (unsigned int)host_periph_stats.can_tx_frames,
+           (unsigned int)stats.rx_high_water[0], (unsigned int)stats.rx_high_water[1],
+           (unsigned int)stats.rx_overruns[0], (unsigned int)stats.rx_overruns[1], (unsigned int)stats.latency_max_us);
+    can_stats_dump();
+    return ((stats.rx_frames == host_periph_stats.can_rx_frames)
+            && ((host_periph_stats.can_tx_frames - stats.tx_frames) <= 3U))
+               ? 0U
+               : 1U;
+}
+#endif
+
+static void host_can_bench_task(void *argument)
+{
+    uint32_t failed = 0U;
+    uint32_t i;
+
+    (void)argument;
+
+    vTaskDelay(HOST_CAN_BENCH_SETTLE);
+    host_can_set_tx_listener(host_can_bench_listener);
+    printf("burst,frames,rejected,on_bus,missing,out_of_order,bus_idle_ns,lost_arbitration,ns_per_frame\n");
+    failed += host_can_bench_burst(0U);
+    failed += host_can_bench_burst(1U);
+    host_can_set_tx_listener(NULL);
+
+    printf("rate,dlc,hold,injected,fifo,fifo_overruns,ring_dropped,received,frames_per_s,bus_frames_per_s,irqs_per_100,irq_ns_per_frame\n");
+    for (i = 0U; i < (sizeof(host_can_bench_rates) / sizeof(host_can_bench_rates[0])); i++)
+    {
+        failed += host_can_bench_rx(&host_can_bench_rates[i], 0U, 0U);
+        failed += host_can_bench_rx(&host_can_bench_rates[i], 8U, 0U);
+        failed += host_can_bench_rx(&host_can_bench_rates[i], 0U, HOST_CAN_BENCH_RX_HOLD);
+        failed += host_can_bench_rx(&host_can_bench_rates[i], 8U, HOST_CAN_BENCH_RX_HOLD);
+    }
+    host_can_bench_set_rate(&host_can_bench_rates[0], 0U);
+#if defined(USE_CAN_STATS)
+    failed += host_can_bench_stats();
+#endif
+
+    console_flush();
+    exit((failed == 0U) ? 0 : 1);
+}
+
+void host_can_bench_start(void)
+{
+    (void)xTaskCreate(host_can_bench_task, "canbench", HOST_CAN_BENCH_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2U,
+                      NULL);
+}
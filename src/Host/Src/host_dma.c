@@ -0,0 +1,147 @@
+/**
+ ******************************************************************************
+ * @file           : host_dma.c
+ * @brief          : Behavioral model of DMA1 for the host simulation
+ ******************************************************************************
+ * Peripheral requests only: a peripheral model asks its channel for the next
+ * item when its request line goes up (USART1 TX on channel 4 when TXE is set
+ * and CR3.DMAT is on), the channel reads it from memory and counts down
+ * CNDTR, with the HT/TC flags and their interrupts.  Memory-to-memory
+ * transfers and the channel priorities are not modeled.
+ *
+ * CMAR holds the low 32 bits of a host pointer, like the HAL passes it.  The
+ * host build is linked with -no-pie so that static buffers live below 4 GiB
+ * and those 32 bits are the whole address.
+ *
+ * CNDTR can only be written while the channel is off, the HAL always does so
+ * right before setting EN: a CNDTR or CMAR that differs from the published
+ * value starts a new transfer.
+ ******************************************************************************
+ */
+#include <string.h>
+
+#include "host_model.h"
+
+#define HOST_DMA_CHANNELS               7U
+
+/* ISR/IFCR bits of one channel */
+#define HOST_DMA_FLAGS(ch)              (0xFU << ((ch) * 4U))
+#define HOST_DMA_GIF(ch)                (DMA_ISR_GIF1 << ((ch) * 4U))
+#define HOST_DMA_TCIF(ch)               (DMA_ISR_TCIF1 << ((ch) * 4U))
+#define HOST_DMA_HTIF(ch)               (DMA_ISR_HTIF1 << ((ch) * 4U))
+
+typedef struct
+{
+    uint32_t cndtr;         /* CNDTR published at the last sync */
+    uint32_t cmar;          /* CMAR at the start of the transfer */
+    uint32_t total;         /* items of the transfer */
+    uint32_t mem;           /* address of the next item */
+} host_dma_channel_t;
+
+static host_dma_channel_t host_dma_channels[HOST_DMA_CHANNELS];
+static uint32_t host_dma_isr;
+
+void host_dma_reset(void)
+{
+    memset(&host_dma1, 0, sizeof(host_dma1));
+    memset(host_dma1_channels, 0, sizeof(host_dma1_channels));
+    memset(host_dma_channels, 0, sizeof(host_dma_channels));
+    host_dma_isr = 0U;
+}
+
+void host_dma_update(void)
+{
+    DMA_Channel_TypeDef *regs;
+    host_dma_channel_t *ch;
+    uint32_t i;
+
+    /* IFCR is write-only, it is published as 0 */
+    for (i = 0U; i < HOST_DMA_CHANNELS; i++)
+    {
+        if ((host_dma1.IFCR & HOST_DMA_GIF(i)) != 0U)
+        {
+            host_dma1.IFCR |= HOST_DMA_FLAGS(i);
+        }
+    }
+    host_dma_isr &= ~host_dma1.IFCR;
+    host_dma1.IFCR = 0U;
+
+    for (i = 0U; i < HOST_DMA_CHANNELS; i++)
+    {
+        regs = &host_dma1_channels[i];
+        ch = &host_dma_channels[i];
+
+        if (((regs->CNDTR & 0xFFFFU) != ch->cndtr) || (regs->CMAR != ch->cmar))
+        {
+            ch->cndtr = regs->CNDTR & 0xFFFFU;
+            ch->total = ch->cndtr;
+            ch->cmar = regs->CMAR;
+            ch->mem = regs->CMAR;
+        }
+        regs->CNDTR = ch->cndtr;
+    }
+    host_dma1.ISR = host_dma_isr;
+}
+
+int host_dma_request(uint32_t channel, uint32_t *item)
+{
+    DMA_Channel_TypeDef *regs = &host_dma1_channels[channel];
+    host_dma_channel_t *ch = &host_dma_channels[channel];
+    uint32_t ccr = regs->CCR;
+    uint32_t size;
+
+    if (((ccr & DMA_CCR_EN) == 0U) || ((ccr & DMA_CCR_DIR) == 0U) || (ch->cndtr == 0U))
+    {
+        return -1;
+    }
+
+    /* MSIZE: 8, 16 or 32 bits */
+    size = 1U << ((ccr & DMA_CCR_MSIZE) >> DMA_CCR_MSIZE_Pos);
+    *item = 0U;
+    memcpy(item, (const void *)(uintptr_t)ch->mem, size);
+    if ((ccr & DMA_CCR_MINC) != 0U)
+    {
+        ch->mem += size;
+    }
+
+    ch->cndtr--;
+    if (ch->cndtr == (ch->total / 2U))
+    {
+        host_dma_isr |= HOST_DMA_HTIF(channel) | HOST_DMA_GIF(channel);
+    }
+    if (ch->cndtr == 0U)
+    {
+        host_dma_isr |= HOST_DMA_TCIF(channel) | HOST_DMA_GIF(channel);
+        if ((ccr & DMA_CCR_CIRC) != 0U)
+        {
+            ch->cndtr = ch->total;
+            ch->mem = regs->CMAR;
+        }
+    }
+
+    regs->CNDTR = ch->cndtr;
+    host_dma1.ISR = host_dma_isr;
+    return 0;
+}
+
+static uint32_t host_dma_causes(uint32_t channel)
+{
+    uint32_t ccr = host_dma1_channels[channel].CCR;
+    uint32_t flags = (host_dma_isr >> (channel * 4U)) & 0xFU;
+    uint32_t causes = 0U;
+
+    if (((ccr & DMA_CCR_TCIE) != 0U) && ((flags & DMA_ISR_TCIF1) != 0U))
+    {
+        causes |= DMA_ISR_TCIF1;
+    }
+    if (((ccr & DMA_CCR_HTIE) != 0U) && ((flags & DMA_ISR_HTIF1) != 0U))
+    {
+        causes |= DMA_ISR_HTIF1;
+    }
+    return causes;
+}
+
+uint32_t host_dma_ch4_causes(void)
+{
+    return host_dma_causes(HOST_DMA_USART1_TX);
+}
@@ -0,0 +1,219 @@
+/**
+ ******************************************************************************
+ * @file           : host_isotp_bench.c
+ * @brief          : Host loopback benchmark of the ISO-TP transport (isotp.c)
+ ******************************************************************************
+ * CAN1 runs in loopback mode (LBKM) and the link has tx_id equal to rx_id,
+ * so every first and consecutive frame comes back to the receiving side of
+ * the same node and its flow control back to the sending side.  Each message
+ * is sent from one buffer and received into another, then compared.
+ *
+ * payload_bytes_per_s is the length of the messages over the model time from
+ * isotp_send_start() to the end of isotp_receive_wait().  bus_max_bytes_per_s
+ * is the most ISO-TP can carry on the bus: 7 bytes per 8-byte consecutive
+ * frame, back to back, without stuff bits (111 bits with the interframe
+ * space).  efficiency_pct is the ratio of the two, bus_busy_pct the share of
+ * the time the bus carried a frame; the difference between the two is the
+ * stuff bits, the first frame and the flow control.
+ *
+ * The STmin row waits at least 1 ms between consecutive frames, rounded up
+ * to whole ticks (see isotp.h), and runs one short message.  The overflow
+ * row offers a buffer one byte short and checks that the sender is refused.
+ ******************************************************************************
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "printf.h"
+#include "console.h"
+#include "user.h"
+#include "can_tx.h"
+#include "isotp.h"
+#include "host_periph.h"
+#include "host_isotp_bench.h"
+
+#define HOST_ISOTP_BENCH_STACK_SIZE     256U
+#define HOST_ISOTP_BENCH_SETTLE         300U        /* ticks, start-up log */
+#define HOST_ISOTP_BENCH_TIMEOUT        5000U       /* ticks */
+#define HOST_ISOTP_BENCH_BYTES          16384U      /* per row */
+#define HOST_ISOTP_BENCH_ID             0x7E0U      /* let in by the filters of user.c */
+#define HOST_ISOTP_BENCH_CF_BITS        111U
+
+typedef struct
+{
+    const char *name;
+    uint32_t bit_rate;
+    uint32_t prescaler;
+    uint32_t bs1;
+    uint32_t bs2;
+} host_isotp_bench_rate_t;
+
+typedef struct
+{
+    uint8_t block_size;
+    uint8_t st_min;
+    uint16_t length;
+} host_isotp_bench_run_t;
+
+/* PCLK1 = 36 MHz */
+static const host_isotp_bench_rate_t host_isotp_bench_rates[] = {
+    {"500k", 500000U, 9U, CAN_BS1_3TQ, CAN_BS2_4TQ},
+    {"1M", 1000000U, 4U, CAN_BS1_6TQ, CAN_BS2_2TQ},
+};
+
+static const host_isotp_bench_run_t host_isotp_bench_runs[] = {
+    {0U, 0U, 7U},
+    {0U, 0U, 62U},
+    {0U, 0U, 500U},
+    {0U, 0U, 4095U},
+    {8U, 0U, 4095U},
+    {2U, 0U, 4095U},
+    {0U, 1U, 62U},
+};
+
+static uint8_t host_isotp_bench_tx[ISOTP_MAX_LENGTH];
+static uint8_t host_isotp_bench_rx[ISOTP_MAX_LENGTH];
+static uint32_t host_isotp_bench_frames;
+
+static void host_isotp_bench_listener(const host_can_frame_t *frame, uint64_t start, uint64_t end)
+{
+    (void)start;
+    (void)end;
+    if ((frame->ide == 0U) && (frame->id == HOST_ISOTP_BENCH_ID))
+    {
+        __atomic_add_fetch(&host_isotp_bench_frames, 1U, __ATOMIC_RELAXED);
+    }
+}
+
+/* Re-initialises CAN1 in loopback mode, keeping its filters and
+ * interrupts. */
+static void host_isotp_bench_set_rate(const host_isotp_bench_rate_t *rate)
+{
+    (void)HAL_CAN_Stop(&hcan);
+    hcan.Init.Mode = CAN_MODE_LOOPBACK;
+    hcan.Init.Prescaler = rate->prescaler;
+    hcan.Init.TimeSeg1 = rate->bs1;
+    hcan.Init.TimeSeg2 = rate->bs2;
+    (void)HAL_CAN_Init(&hcan);
+    (void)HAL_CAN_Start(&hcan);
+}
+
+/* One message: 1 when it arrived whole. */
+static uint32_t host_isotp_bench_message(uint32_t length, uint32_t seed)
+{
+    uint32_t received = 0U;
+    uint32_t i;
+
+    for (i = 0U; i < length; i++)
+    {
+        host_isotp_bench_tx[i] = (uint8_t)((seed * 131U) + (i * 7U) + (i >> 8U));
+    }
+    memset(host_isotp_bench_rx, 0, length);
+    if ((isotp_receive_start(host_isotp_bench_rx, sizeof(host_isotp_bench_rx)) != HAL_OK)
+        || (isotp_send_start(host_isotp_bench_tx, length) != HAL_OK))
+    {
+        return 0U;
+    }
+    if ((isotp_send_wait(HOST_ISOTP_BENCH_TIMEOUT) != HAL_OK)
+        || (isotp_receive_wait(&received, HOST_ISOTP_BENCH_TIMEOUT) != HAL_OK))
+    {
+        return 0U;
+    }
+    return ((received == length) && (memcmp(host_isotp_bench_tx, host_isotp_bench_rx, length) == 0)) ? 1U : 0U;
+}
+
+/* Runs one row, prints it and returns the number of failed checks. */
+static uint32_t host_isotp_bench_run(const host_isotp_bench_rate_t *rate, const host_isotp_bench_run_t *run)
+{
+    const isotp_config_t config = {HOST_ISOTP_BENCH_ID, HOST_ISOTP_BENCH_ID, 0U, run->block_size, run->st_min};
+    const uint32_t messages = (run->st_min != 0U) ? 1U : ((HOST_ISOTP_BENCH_BYTES / run->length) + 1U);
+    const uint64_t max = ((uint64_t)rate->bit_rate * 7U) / HOST_ISOTP_BENCH_CF_BITS;
+    uint32_t failed = 0U;
+    uint64_t busy;
+    uint64_t start;
+    uint64_t ns;
+    uint64_t rate_bps;
+    uint32_t frames;
+    uint32_t i;
+
+    isotp_init(&config);
+    __atomic_store_n(&host_isotp_bench_frames, 0U, __ATOMIC_RELAXED);
+    busy = host_periph_stats.can_bus_busy_ns;
+    start = host_periph_time_ns();
+    for (i = 0U; i < messages; i++)
+    {
+        failed += (host_isotp_bench_message(run->length, i) != 0U) ? 0U : 1U;
+    }
+    ns = host_periph_time_ns() - start;
+    busy = host_periph_stats.can_bus_busy_ns - busy;
+    frames = __atomic_load_n(&host_isotp_bench_frames, __ATOMIC_RELAXED);
+    rate_bps = (ns > 0U) ? (((uint64_t)run->length * messages * 1000000000ULL) / ns) : 0U;
+
+    printf("%s,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", rate->name, (unsigned int)run->block_size,
+           (unsigned int)run->st_min, (unsigned int)run->length, (unsigned int)messages, (unsigned int)frames,
+           (unsigned int)rate_bps, (unsigned int)max, (unsigned int)((rate_bps * 100U) / max),
+           (unsigned int)((ns > 0U) ? ((busy * 100U) / ns) : 0U));
+    return failed;
+}
+
+/* A message one byte longer than the buffer must be refused. */
+static uint32_t host_isotp_bench_overflow(void)
+{
+    const isotp_config_t config = {HOST_ISOTP_BENCH_ID, HOST_ISOTP_BENCH_ID, 0U, 0U, 0U};
+    HAL_StatusTypeDef sent;
+    uint32_t received = 0U;
+
+    isotp_init(&config);
+    if ((isotp_receive_start(host_isotp_bench_rx, 99U) != HAL_OK)
+        || (isotp_send_start(host_isotp_bench_tx, 100U) != HAL_OK))
+    {
+        return 1U;
+    }
+    sent = isotp_send_wait(HOST_ISOTP_BENCH_TIMEOUT);
+    /* the buffer is still offered, a short message fits */
+    if ((sent != HAL_ERROR) || (isotp_send_start(host_isotp_bench_tx, 99U) != HAL_OK)
+        || (isotp_send_wait(HOST_ISOTP_BENCH_TIMEOUT) != HAL_OK)
+        || (isotp_receive_wait(&received, HOST_ISOTP_BENCH_TIMEOUT) != HAL_OK) || (received != 99U))
+    {
+        return 1U;
+    }
+    return 0U;
+}
+
+static void host_isotp_bench_task(void *argument)
+{
+    uint32_t failed = 0U;
+    uint32_t overflow;
+    uint32_t i;
+    uint32_t r;
+
+    (void)argument;
+
+    vTaskDelay(HOST_ISOTP_BENCH_SETTLE);
+    host_can_set_tx_listener(host_isotp_bench_listener);
+    printf("rate,block_size,st_min,length,messages,frames,payload_bytes_per_s,bus_max_bytes_per_s,efficiency_pct,bus_busy_pct\n");
+    for (r = 0U; r < (sizeof(host_isotp_bench_rates) / sizeof(host_isotp_bench_rates[0])); r++)
+    {
+        host_isotp_bench_set_rate(&host_isotp_bench_rates[r]);
+        for (i = 0U; i < (sizeof(host_isotp_bench_runs) / sizeof(host_isotp_bench_runs[0])); i++)
+        {
+            failed += host_isotp_bench_run(&host_isotp_bench_rates[r], &host_isotp_bench_runs[i]);
+        }
+    }
+    overflow = host_isotp_bench_overflow();
+    printf("overflow,%s\n", (overflow == 0U) ? "ok" : "failed");
+    failed += overflow;
+    host_can_set_tx_listener(NULL);
+
+    console_flush();
+    exit((failed == 0U) ? 0 : 1);
+}
+
+void host_isotp_bench_start(void)
+{
+    (void)xTaskCreate(host_isotp_bench_task, "isotpbench", HOST_ISOTP_BENCH_STACK_SIZE, NULL,
+                      tskIDLE_PRIORITY + 2U, NULL);
+}
@@ -0,0 +1,597 @@
+/**
+ ******************************************************************************
+ * @file           : host_periph.c
+ * @brief          : Register blocks, sync points and NVIC of the host model
+ ******************************************************************************
+ * Owns the register blocks of host_periph.h, the small models that do not
+ * deserve a file of their own (RCC, GPIO, NVIC) and the glue to the FreeRTOS
+ * Posix port:
+ *  - host_periph_sync() updates every model, it is called from the
+ *    -finstrument-functions hooks of the HAL and from the interrupt below.
+ *  - A timer thread raises HOST_PERIPH_INTERRUPT at the next event of the
+ *    models, so a CPU that polls a flag sees it change in time.
+ *  - The interrupt handler plays the NVIC: it calls the IRQ handlers of
+ *    stm32f1xx_it.c for every enabled line with an asserted cause.
+ *
+ * The model never runs twice at the same time: it only runs on the thread of
+ * the simulated CPU and an interrupt that hits a sync in progress is deferred
+ * until the end of the sync.
+ ******************************************************************************
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <time.h>
+
+#include "host_model.h"
+#include "FreeRTOS.h"
+
+/* RCC bit-band alias, see host_periph.h */
+#define HOST_RCC_BB_BASE                (PERIPH_BB_BASE + ((RCC_BASE - PERIPH_BASE) * 32U))
+#define HOST_RCC_BB_SIZE                (0x400U * 32U)
+#define HOST_BB_UNTOUCHED               0xA5A5A5A5U
+
+/* ST_NVIC_ISER..ICPR words used by the IRQ numbers of the STM32F103x6 */
+#define HOST_NVIC_WORDS                 2U
+
+typedef struct
+{
+    IRQn_Type irq;
+    void (*handler)(void);
+    uint32_t (*causes)(void);
+} host_irq_line_t;
+
+/* Handlers of stm32f1xx_it.c, the unused ones stay NULL. */
+extern void USB_HP_CAN1_TX_IRQHandler(void) __attribute__((weak));
+extern void USB_LP_CAN1_RX0_IRQHandler(void) __attribute__((weak));
+extern void CAN1_RX1_IRQHandler(void) __attribute__((weak));
+extern void TIM1_UP_IRQHandler(void) __attribute__((weak));
+extern void USART1_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Channel4_IRQHandler(void) __attribute__((weak));
+
+RCC_TypeDef host_rcc;
+FLASH_TypeDef host_flash;
+AFIO_TypeDef host_afio;
+EXTI_TypeDef host_exti;
+PWR_TypeDef host_pwr;
+GPIO_TypeDef host_gpioa;
+GPIO_TypeDef host_gpiob;
+GPIO_TypeDef host_gpioc;
+GPIO_TypeDef host_gpiod;
+USART_TypeDef host_usart1;
+CAN_TypeDef host_can1;
+TIM_TypeDef host_tim1;
+DMA_TypeDef host_dma1;
+DMA_Channel_TypeDef host_dma1_channels[7];
+NVIC_Type host_nvic;
+SCB_Type host_scb;
+SysTick_Type host_systick;
+
+host_periph_stats_t host_periph_stats;
+
+static GPIO_TypeDef *const host_gpio_ports[] = {&host_gpioa, &host_gpiob, &host_gpioc, &host_gpiod};
+
+static const host_irq_line_t host_irq_lines[] =
+{
+    {USB_HP_CAN1_TX_IRQn, USB_HP_CAN1_TX_IRQHandler, host_can_tx_causes},
+    {USB_LP_CAN1_RX0_IRQn, USB_LP_CAN1_RX0_IRQHandler, host_can_rx0_causes},
+    {CAN1_RX1_IRQn, CAN1_RX1_IRQHandler, host_can_rx1_causes},
+    {TIM1_UP_IRQn, TIM1_UP_IRQHandler, host_tim_up_causes},
+    {USART1_IRQn, USART1_IRQHandler, host_uart_causes},
+    {DMA1_Channel4_IRQn, DMA1_Channel4_IRQHandler, host_dma_ch4_causes},
+};
+
+static volatile uint32_t *host_rcc_bb;
+static uint32_t host_nvic_enabled[HOST_NVIC_WORDS];
+static uint32_t host_nvic_pending[HOST_NVIC_WORDS];
+
+/* Only touched by the thread of the simulated CPU. */
+static volatile sig_atomic_t host_model_busy;
+static volatile sig_atomic_t host_irq_deferred;
+static volatile sig_atomic_t host_irq_raised;
+static volatile sig_atomic_t host_irq_active;
+
+static pthread_mutex_t host_timer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_timer_cond;
+static uint64_t host_timer_deadline = HOST_TIME_NEVER;
+static uint64_t host_timer_sleep;       /* deadline the timer thread sleeps to */
+
+uint64_t host_periph_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * HOST_NS_PER_S) + (uint64_t)ts.tv_nsec;
+}
+
+/* RCC ------------------------------------------------------------------------*/
+static void host_rcc_reset(void)
+{
+    uint32_t i;
+
+    memset(&host_rcc, 0, sizeof(host_rcc));
+    host_rcc.CR = 0x00000083U;
+    host_rcc.AHBENR = 0x00000014U;
+    host_rcc.CSR = 0x0C000000U;
+
+    for (i = 0U; i < (HOST_RCC_BB_SIZE / 4U); i++)
+    {
+        host_rcc_bb[i] = HOST_BB_UNTOUCHED;
+    }
+}
+
+static void host_rcc_bb_apply(volatile uint32_t *reg, uint32_t offset)
+{
+    volatile uint32_t *alias = &host_rcc_bb[offset * 8U];
+    uint32_t bit;
+
+    for (bit = 0U; bit < 32U; bit++)
+    {
+        if (alias[bit] != HOST_BB_UNTOUCHED)
+        {
+            if ((alias[bit] & 1U) != 0U)
+            {
+                *reg |= (1UL << bit);
+            }
+            else
+            {
+                *reg &= ~(1UL << bit);
+            }
+            alias[bit] = HOST_BB_UNTOUCHED;
+        }
+    }
+}
+
+static void host_rcc_update(void)
+{
+    uint32_t cr;
+
+    host_rcc_bb_apply(&host_rcc.CR, 0x00U);
+    host_rcc_bb_apply(&host_rcc.BDCR, 0x20U);
+    host_rcc_bb_apply(&host_rcc.CSR, 0x24U);
+
+    /* The oscillators are ready as soon as they are switched on. */
+    cr = host_rcc.CR & ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY);
+    if ((cr & RCC_CR_HSION) != 0U)
+    {
+        cr |= RCC_CR_HSIRDY;
+    }
+    if ((cr & RCC_CR_HSEON) != 0U)
+    {
+        cr |= RCC_CR_HSERDY;
+    }
+    if ((cr & RCC_CR_PLLON) != 0U)
+    {
+        cr |= RCC_CR_PLLRDY;
+    }
+    host_rcc.CR = cr;
+
+    host_rcc.CFGR = (host_rcc.CFGR & ~RCC_CFGR_SWS) | ((host_rcc.CFGR & RCC_CFGR_SW) << RCC_CFGR_SWS_Pos);
+
+    if ((host_rcc.BDCR & RCC_BDCR_LSEON) != 0U)
+    {
+        host_rcc.BDCR |= RCC_BDCR_LSERDY;
+    }
+    else
+    {
+        host_rcc.BDCR &= ~RCC_BDCR_LSERDY;
+    }
+
+    if ((host_rcc.CSR & RCC_CSR_LSION) != 0U)
+    {
+        host_rcc.CSR |= RCC_CSR_LSIRDY;
+    }
+    else
+    {
+        host_rcc.CSR &= ~RCC_CSR_LSIRDY;
+    }
+    if ((host_rcc.CSR & RCC_CSR_RMVF) != 0U)
+    {
+        host_rcc.CSR &= ~(RCC_CSR_RMVF | 0xFC000000U);
+    }
+}
+
+static uint32_t host_rcc_hclk(void)
+{
+    static const uint8_t ahb_shift[16] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 6, 7, 8, 9};
+    uint32_t cfgr = host_rcc.CFGR;
+    uint32_t sysclk;
+    uint32_t pllin;
+
+    switch (cfgr & RCC_CFGR_SWS)
+    {
+    case RCC_CFGR_SWS_HSE:
+        sysclk = HSE_VALUE;
+        break;
+    case RCC_CFGR_SWS_PLL:
+        if ((cfgr & RCC_CFGR_PLLSRC) != 0U)
+        {
+            pllin = ((cfgr & RCC_CFGR_PLLXTPRE) != 0U) ? (HSE_VALUE / 2U) : HSE_VALUE;
+        }
+        else
+        {
+            pllin = HSI_VALUE / 2U;
+        }
+        sysclk = pllin * ((((cfgr & RCC_CFGR_PLLMULL) >> RCC_CFGR_PLLMULL_Pos) + 2U) & 0x1FU);
+        if (sysclk > (pllin * 16U))
+        {
+            sysclk = pllin * 16U;
+        }
+        break;
+    default:
+        sysclk = HSI_VALUE;
+        break;
+    }
+
+    return sysclk >> ahb_shift[(cfgr & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
+}
+
+static uint32_t host_rcc_apb_shift(uint32_t ppre)
+{
+    return ((ppre & 4U) != 0U) ? ((ppre & 3U) + 1U) : 0U;
+}
+
+uint32_t host_rcc_pclk1(void)
+{
+    return host_rcc_hclk() >> host_rcc_apb_shift((host_rcc.CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos);
+}
+
+uint32_t host_rcc_pclk2(void)
+{
+    return host_rcc_hclk() >> host_rcc_apb_shift((host_rcc.CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos);
+}
+
+uint32_t host_rcc_tim1clk(void)
+{
+    /* The APB2 timers run at twice PCLK2 when APB2 is divided. */
+    if (host_rcc_apb_shift((host_rcc.CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos) != 0U)
+    {
+        return host_rcc_pclk2() * 2U;
+    }
+    return host_rcc_pclk2();
+}
+
+/* GPIO -----------------------------------------------------------------------*/
+static void host_gpio_reset(void)
+{
+    uint32_t i;
+
+    for (i = 0U; i < (sizeof(host_gpio_ports) / sizeof(host_gpio_ports[0])); i++)
+    {
+        memset(host_gpio_ports[i], 0, sizeof(GPIO_TypeDef));
+        host_gpio_ports[i]->CRL = 0x44444444U;
+        host_gpio_ports[i]->CRH = 0x44444444U;
+    }
+}
+
+static void host_gpio_update(void)
+{
+    GPIO_TypeDef *port;
+    uint32_t bsrr;
+    uint32_t i;
+
+    for (i = 0U; i < (sizeof(host_gpio_ports) / sizeof(host_gpio_ports[0])); i++)
+    {
+        port = host_gpio_ports[i];
+
+        /* BSRR and BRR are write-only, they read back as 0 on the target.  The
+         * set bits of BSRR win over its reset bits. */
+        bsrr = port->BSRR;
+        if (bsrr != 0U)
+        {
+            port->ODR = (port->ODR & ~(bsrr >> 16U)) | (bsrr & 0xFFFFU);
+            port->BSRR = 0U;
+        }
+        if (port->BRR != 0U)
+        {
+            port->ODR &= ~(port->BRR & 0xFFFFU);
+            port->BRR = 0U;
+        }
+        port->IDR = port->ODR & 0xFFFFU;
+    }
+}
+
+/* NVIC -----------------------------------------------------------------------*/
+static void host_nvic_reset(void)
+{
+    memset(&host_nvic, 0, sizeof(host_nvic));
+    memset(host_nvic_enabled, 0, sizeof(host_nvic_enabled));
+    memset(host_nvic_pending, 0, sizeof(host_nvic_pending));
+
+    memset(&host_scb, 0, sizeof(host_scb));
+    host_scb.AIRCR = 0xFA050000U;
+
+    memset(&host_systick, 0, sizeof(host_systick));
+}
+
+static void host_nvic_update(void)
+{
+    uint32_t i;
+
+    /* The set/clear registers are published as 0, so any value found there
+     * has been written by the CPU since the last sync. */
+    for (i = 0U; i < HOST_NVIC_WORDS; i++)
+    {
+        host_nvic_enabled[i] |= host_nvic.ISER[i];
+        host_nvic_enabled[i] &= ~host_nvic.ICER[i];
+        host_nvic_pending[i] |= host_nvic.ISPR[i];
+        host_nvic_pending[i] &= ~host_nvic.ICPR[i];
+        host_nvic.ISER[i] = 0U;
+        host_nvic.ICER[i] = 0U;
+        host_nvic.ISPR[i] = 0U;
+        host_nvic.ICPR[i] = 0U;
+    }
+}
+
+static uint32_t host_nvic_test(const uint32_t *bits, IRQn_Type irq)
+{
+    return bits[(uint32_t)irq >> 5U] & (1UL << ((uint32_t)irq & 0x1FU));
+}
+
+/* The enabled line with an asserted cause or a software pending request and
+ * the highest priority, the lowest IRQ number first on equal priority. */
+static const host_irq_line_t *host_irq_next(void)
+{
+    const host_irq_line_t *best = NULL;
+    const host_irq_line_t *line;
+    uint32_t i;
+
+    for (i = 0U; i < (sizeof(host_irq_lines) / sizeof(host_irq_lines[0])); i++)
+    {
+        line = &host_irq_lines[i];
+        if ((host_nvic_test(host_nvic_enabled, line->irq) != 0U)
+            && ((line->causes() != 0U) || (host_nvic_test(host_nvic_pending, line->irq) != 0U)))
+        {
+            if ((best == NULL) || (host_nvic.IP[line->irq] < host_nvic.IP[best->irq]))
+            {
+                best = line;
+            }
+        }
+    }
+    return best;
+}
+
+/* Timer thread ---------------------------------------------------------------*/
+static void *host_timer_thread(void *argument)
+{
+    struct timespec ts;
+    uint64_t now;
+
+    (void)argument;
+
+    /* The default slack of 50 us would be longer than a UART byte. */
+    prctl(PR_SET_TIMERSLACK, 1UL);
+
+    pthread_mutex_lock(&host_timer_mutex);
+    for (;;)
+    {
+        now = host_periph_time_ns();
+        if (now >= host_timer_deadline)
+        {
+            host_timer_deadline = HOST_TIME_NEVER;
+            pthread_mutex_unlock(&host_timer_mutex);
+            vPortGenerateSimulatedInterrupt(HOST_PERIPH_INTERRUPT);
+            pthread_mutex_lock(&host_timer_mutex);
+            continue;
+        }
+
+        /* A later deadline does not wake this thread, it finds out here
+         * after waking up too early. */
+        host_timer_sleep = host_timer_deadline;
+        if (host_timer_deadline == HOST_TIME_NEVER)
+        {
+            pthread_cond_wait(&host_timer_cond, &host_timer_mutex);
+        }
+        else
+        {
+            ts.tv_sec = (time_t)(host_timer_deadline / HOST_NS_PER_S);
+            ts.tv_nsec = (long)(host_timer_deadline % HOST_NS_PER_S);
+            pthread_cond_timedwait(&host_timer_cond, &host_timer_mutex, &ts);
+        }
+        host_timer_sleep = 0U;
+    }
+    return NULL;
+}
+
+/* May run in the signal handler of the simulated interrupt.  The mutex is
+ * never held by the interrupted code: the handler does not touch the model
+ * while a sync is in progress on the same thread.  The thread is only woken
+ * for a deadline earlier than the one it sleeps to, which keeps the syncs
+ * free of system calls most of the time. */
+static void host_timer_arm(uint64_t deadline)
+{
+    if (deadline == host_timer_deadline)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&host_timer_mutex);
+    host_timer_deadline = deadline;
+    if (deadline < host_timer_sleep)
+    {
+        pthread_cond_signal(&host_timer_cond);
+    }
+    pthread_mutex_unlock(&host_timer_mutex);
+}
+
+/* Sync -----------------------------------------------------------------------*/
+void host_model_raise(void)
+{
+    host_irq_raised = 1;
+    vPortGenerateSimulatedInterrupt(HOST_PERIPH_INTERRUPT);
+}
+
+static uint64_t host_min(uint64_t a, uint64_t b)
+{
+    return (a < b) ? a : b;
+}
+
+void host_periph_sync(void)
+{
+    uint64_t now;
+    uint64_t next;
+    uint32_t raise;
+
+    if (host_model_busy != 0)
+    {
+        return;
+    }
+    host_model_busy = 1;
+
+    now = host_periph_time_ns();
+
+    host_rcc_update();
+    host_gpio_update();
+    host_nvic_update();
+    host_dma_update();
+    next = host_uart_update(now);
+    next = host_min(next, host_can_update(now));
+    next = host_min(next, host_tim_update(now));
+    host_timer_arm(next);
+
+    /* Inside the interrupt the dispatch loop checks the lines itself. */
+    raise = ((host_irq_active == 0) && (host_irq_raised == 0) && (host_irq_next() != NULL)) ? 1U : 0U;
+
+    host_periph_stats.syncs++;
+    host_periph_stats.sync_ns += host_periph_time_ns() - now;
+    host_model_busy = 0;
+
+    if ((raise != 0U) || (host_irq_deferred != 0))
+    {
+        host_irq_deferred = 0;
+        host_model_raise();
+    }
+}
+
+static void host_periph_irq(void)
+{
+    const host_irq_line_t *line;
+    uint64_t start;
+    uint64_t sync_ns;
+    uint32_t irq;
+
+    if (host_model_busy != 0)
+    {
+        host_irq_deferred = 1;
+        return;
+    }
+
+    host_irq_raised = 0;
+    host_irq_active = 1;
+    for (;;)
+    {
+        host_periph_sync();
+        line = host_irq_next();
+        if (line == NULL)
+        {
+            break;
+        }
+
+        if (line->handler == NULL)
+        {
+            fprintf(stderr, "host_periph: IRQ %d enabled without a handler\n", (int)line->irq);
+            abort();
+        }
+
+        irq = (uint32_t)line->irq;
+        host_nvic_pending[irq >> 5U] &= ~(1UL << (irq & 0x1FU));
+        host_periph_stats.irqs++;
+        start = host_periph_time_ns();
+        sync_ns = host_periph_stats.sync_ns;
+        line->handler();
+        host_periph_stats.irq_ns += (host_periph_time_ns() - start) - (host_periph_stats.sync_ns - sync_ns);
+    }
+    host_irq_active = 0;
+}
+
+/* Instrumentation hooks of the HAL sources.  Every entry syncs, so a polling
+ * loop sees the flags move through the HAL_GetTick() it calls.  Only the exit
+ * of the outermost HAL function syncs: the writes of the inner ones are
+ * picked up by the next entry anyway.  The depth is per task, tasks are
+ * threads in the Posix port. */
+static __thread uint32_t host_hal_depth;
+
+void __cyg_profile_func_enter(void *this_fn, void *call_site) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void *this_fn, void *call_site) __attribute__((no_instrument_function));
+
+void __cyg_profile_func_enter(void *this_fn, void *call_site)
+{
+    (void)this_fn;
+    (void)call_site;
+
+    host_hal_depth++;
+    host_periph_sync();
+}
+
+void __cyg_profile_func_exit(void *this_fn, void *call_site)
+{
+    (void)this_fn;
+    (void)call_site;
+
+    host_hal_depth--;
+    if (host_hal_depth == 0U)
+    {
+        host_periph_sync();
+    }
+}
+
+/* Init -----------------------------------------------------------------------*/
+__attribute__((constructor)) static void host_periph_init(void)
+{
+    pthread_condattr_t cond_attr;
+    pthread_t thread;
+    sigset_t all;
+    sigset_t saved;
+    void *bb;
+
+    bb = mmap((void *)(uintptr_t)HOST_RCC_BB_BASE, HOST_RCC_BB_SIZE, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (bb != (void *)(uintptr_t)HOST_RCC_BB_BASE)
+    {
+        fprintf(stderr, "host_periph: cannot map the RCC bit-band alias at 0x%08x\n", (unsigned)HOST_RCC_BB_BASE);
+        abort();
+    }
+    host_rcc_bb = (volatile uint32_t *)bb;
+
+    /* DMA addresses are 32 bits wide, see host_dma.c */
+    if ((uintptr_t)&host_usart1 > UINT32_MAX)
+    {
+        fprintf(stderr, "host_periph: the register blocks are above 4 GiB, link with -no-pie\n");
+        abort();
+    }
+
+    host_rcc_reset();
+    memset(&host_flash, 0, sizeof(host_flash));
+    host_flash.ACR = 0x00000030U;
+    memset(&host_afio, 0, sizeof(host_afio));
+    memset(&host_exti, 0, sizeof(host_exti));
+    memset(&host_pwr, 0, sizeof(host_pwr));
+    host_gpio_reset();
+    host_nvic_reset();
+    host_dma_reset();
+    host_uart_reset();
+    host_can_reset();
+    host_tim_reset();
+
+    vPortSetInterruptHandler(HOST_PERIPH_INTERRUPT, host_periph_irq);
+
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&host_timer_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    /* The timer thread must never be the one that takes an interrupt. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    if (pthread_create(&thread, NULL, host_timer_thread, NULL) != 0)
+    {
+        fprintf(stderr, "host_periph: cannot start the timer thread\n");
+        abort();
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    pthread_detach(thread);
+}
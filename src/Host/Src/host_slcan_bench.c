@@ -0,0 +1,493 @@
+/**
+ ******************************************************************************
+ * @file           : host_slcan_bench.c
+ * @brief          : Host benchmark of the CAN to UART gateway (slcan.c)
+ ******************************************************************************
+ * The host model has no USART1 reception, the commands go in through
+ * slcan_input() and take the same path as received bytes from there on.
+ * Everything the gateway writes on USART1 goes to the decoder of this file
+ * (host_uart_set_tx_sink()), which splits it into answers and frames, ASCII
+ * or binary, and checks every frame against the pattern of the other node:
+ * data bytes 0..3 are the index of the frame in the run (xor 0x11 * i),
+ * identifier bits 0..7 its low byte, and the indexes only go up.  The rows
+ * are kept in memory and printed once the sink is given back.
+ *
+ * Commands: bit rates out of range and while open, a frame sent with t and T
+ * that must reach the bus as written (host_can_set_tx_listener()), malformed
+ * frames (identifier, length, a data byte that is not hex), F, V and a line
+ * too long.
+ *
+ * Rows: the other node keeps the bus full for HOST_SLCAN_BENCH_TIME ticks at
+ * 500 kbit/s and 1 Mbit/s, standard and extended identifiers, 0 and 8 data
+ * bytes, every frame to FIFO 0 so that they come out in bus order.
+ * uart_need_pct is the UART bandwidth the full bus needs in that format
+ * against the 200000 bytes/s of 2 Mbaud.  Every frame the model stored in a
+ * FIFO must be forwarded or counted in ring_dropped (can_rx_dropped()), and
+ * below HOST_SLCAN_BENCH_NEED_MAX percent none may be dropped.  Above that
+ * the ring overflows by design; fifo_overruns come from the latency of the
+ * simulated interrupt and are reported, not checked.
+ ******************************************************************************
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "printf.h"
+#include "console.h"
+#include "can_rx.h"
+#include "slcan.h"
+#include "host_periph.h"
+#include "host_slcan_bench.h"
+
+#define HOST_SLCAN_BENCH_STACK_SIZE     256U
+#define HOST_SLCAN_BENCH_SETTLE         300U        /* ticks */
+#define HOST_SLCAN_BENCH_ANSWER_TIME    100U        /* ticks */
+#define HOST_SLCAN_BENCH_TIME           300U        /* ticks per row */
+#define HOST_SLCAN_BENCH_DRAIN          50U         /* ticks */
+#define HOST_SLCAN_BENCH_UART_BPS       200000U     /* bytes/s at 2 Mbaud */
+#define HOST_SLCAN_BENCH_NEED_MAX       90U         /* percent */
+#define HOST_SLCAN_BENCH_STD_ID         0x100U
+#define HOST_SLCAN_BENCH_EXT_ID         0x0ABC000U
+#define HOST_SLCAN_BENCH_LINE_SIZE      48U
+#define HOST_SLCAN_BENCH_REPORT_SIZE    2048U
+
+typedef struct
+{
+    const char *name;
+    const char *command;
+    uint32_t prescaler;
+    uint32_t tq;
+} host_slcan_bench_rate_t;
+
+typedef struct
+{
+    uint32_t rate;
+    uint8_t binary;
+    uint8_t timestamps;
+    uint8_t ide;
+    uint8_t dlc;
+} host_slcan_bench_run_t;
+
+/* The entries S6 and S8 of slcan.c, PCLK1 = 36 MHz */
+static const host_slcan_bench_rate_t host_slcan_bench_rates[] = {
+    {"500k", "S6\r", 9U, 8U},
+    {"1M", "S8\r", 4U, 9U},
+};
+
+static const host_slcan_bench_run_t host_slcan_bench_runs[] = {
+    {0U, 0U, 0U, 0U, 8U},
+    {0U, 0U, 0U, 1U, 8U},
+    {0U, 0U, 0U, 0U, 0U},
+    {0U, 1U, 1U, 1U, 8U},
+    {1U, 0U, 0U, 0U, 8U},
+    {1U, 0U, 1U, 0U, 8U},
+    {1U, 0U, 0U, 1U, 8U},
+    {1U, 0U, 0U, 0U, 0U},
+    {1U, 0U, 0U, 1U, 0U},
+    {1U, 1U, 0U, 0U, 8U},
+    {1U, 1U, 1U, 1U, 8U},
+    {1U, 1U, 0U, 0U, 0U},
+};
+
+/* Decoder, run by the UART model */
+static uint8_t host_slcan_bench_line[HOST_SLCAN_BENCH_LINE_SIZE];
+static uint32_t host_slcan_bench_line_len;
+static uint32_t host_slcan_bench_binary_len;
+static uint32_t host_slcan_bench_last;
+static const host_slcan_bench_run_t *host_slcan_bench_expected;
+static volatile uint32_t host_slcan_bench_binary;
+static volatile uint32_t host_slcan_bench_frames;
+static volatile uint32_t host_slcan_bench_mismatches;
+static volatile uint64_t host_slcan_bench_last_ns;
+static char host_slcan_bench_answer[HOST_SLCAN_BENCH_LINE_SIZE];
+static volatile uint32_t host_slcan_bench_answers;
+
+/* Frames sent by the gateway on the bus */
+static host_can_frame_t host_slcan_bench_sent;
+static volatile uint32_t host_slcan_bench_sent_count;
+
+static char host_slcan_bench_report[HOST_SLCAN_BENCH_REPORT_SIZE];
+static uint32_t host_slcan_bench_report_len;
+
+static uint32_t host_slcan_bench_hex(const uint8_t *p, uint32_t digits, uint32_t *value)
+{
+    uint32_t v = 0U;
+    uint8_t c;
+
+    while (digits != 0U)
+    {
+        c = *p++;
+        if ((c >= '0') && (c <= '9'))
+        {
+            v = (v << 4U) | (uint32_t)(c - '0');
+        }
+        else if ((c >= 'A') && (c <= 'F'))
+        {
+            v = (v << 4U) | (uint32_t)(c - 'A' + 10U);
+        }
+        else
+        {
+            return 0U;
+        }
+        digits--;
+    }
+    *value = v;
+    return 1U;
+}
+
+/* One decoded frame against the pattern of the run. */
+static void host_slcan_bench_check(uint32_t id, uint32_t ide, uint32_t dlc, uint32_t timestamps,
+                                   const uint8_t data[8])
+{
+    const host_slcan_bench_run_t *run = host_slcan_bench_expected;
+    uint32_t base;
+    uint32_t index;
+    uint32_t ok;
+    uint32_t i;
+
+    host_slcan_bench_last_ns = host_periph_time_ns();
+    __atomic_add_fetch(&host_slcan_bench_frames, 1U, __ATOMIC_RELEASE);
+    if (run == NULL)
+    {
+        __atomic_add_fetch(&host_slcan_bench_mismatches, 1U, __ATOMIC_RELAXED);
+        return;
+    }
+    base = (run->ide != 0U) ? HOST_SLCAN_BENCH_EXT_ID : HOST_SLCAN_BENCH_STD_ID;
+    ok = ((ide == run->ide) && (dlc == run->dlc) && (timestamps == run->timestamps) && (id >= base)
+          && (id <= (base + 0xFFU)))
+             ? 1U
+             : 0U;
+    if ((ok != 0U) && (dlc == 8U))
+    {
+        index = 0U;
+        for (i = 0U; i < 4U; i++)
+        {
+            index |= (uint32_t)(data[i] ^ (uint8_t)(i * 0x11U)) << (i * 8U);
+        }
+        for (i = 4U; i < 8U; i++)
+        {
+            ok &= (data[i] == (uint8_t)((index >> ((i & 3U) * 8U)) ^ (i * 0x11U))) ? 1U : 0U;
+        }
+        ok &= (((id - base) == (index & 0xFFU)) && ((host_slcan_bench_last == 0U) || (index >= host_slcan_bench_last)))
+                  ? 1U
+                  : 0U;
+        host_slcan_bench_last = index + 1U;
+    }
+    if (ok == 0U)
+    {
+        __atomic_add_fetch(&host_slcan_bench_mismatches, 1U, __ATOMIC_RELAXED);
+    }
+}
+
+static void host_slcan_bench_ascii(const uint8_t *line, uint32_t len)
+{
+    const uint32_t ide = ((line[0] == 'T') || (line[0] == 'R')) ? 1U : 0U;
+    const uint32_t digits = (ide != 0U) ? 8U : 3U;
+    uint8_t data[8] = {0};
+    uint32_t id = 0U;
+    uint32_t dlc = 9U;
+    uint32_t byte;
+    uint32_t i;
+
+    if ((line[0] != 't') && (line[0] != 'T') && (line[0] != 'r') && (line[0] != 'R'))
+    {
+        /* an answer */
+        memcpy(host_slcan_bench_answer, line, len);
+        host_slcan_bench_answer[len] = '\0';
+        __atomic_add_fetch(&host_slcan_bench_answers, 1U, __ATOMIC_RELEASE);
+        return;
+    }
+    if ((len < (digits + 3U)) || (host_slcan_bench_hex(&line[1], digits, &id) == 0U)
+        || (host_slcan_bench_hex(&line[1U + digits], 1U, &dlc) == 0U) || (dlc > 8U))
+    {
+        __atomic_add_fetch(&host_slcan_bench_mismatches, 1U, __ATOMIC_RELAXED);
+        return;
+    }
+    for (i = 0U; i < dlc; i++)
+    {
+        if (host_slcan_bench_hex(&line[2U + digits + (i * 2U)], 2U, &byte) == 0U)
+        {
+            __atomic_add_fetch(&host_slcan_bench_mismatches, 1U, __ATOMIC_RELAXED);
+            return;
+        }
+        data[i] = (uint8_t)byte;
+    }
+    /* what is left before \r is the time stamp */
+    host_slcan_bench_check(id, ide, dlc, (len == (digits + 3U + (dlc * 2U) + 4U)) ? 1U : 0U, data);
+}
+
+static void host_slcan_bench_record(const uint8_t *record)
+{
+    const uint32_t ide = (record[0] >> 6U) & 1U;
+    const uint32_t dlc = record[0] & 0xFU;
+    const uint8_t *p = &record[1];
+    uint8_t data[8] = {0};
+    uint32_t id = 0U;
+    uint32_t i;
+
+    for (i = 0U; i < ((ide != 0U) ? 4U : 2U); i++)
+    {
+        id = (id << 8U) | *p++;
+    }
+    memcpy(data, p, (dlc < 8U) ? dlc : 8U);
+    host_slcan_bench_check(id, ide, dlc, (record[0] >> 4U) & 1U, data);
+}
+
+static void host_slcan_bench_sink(uint8_t byte)
+{
+    uint32_t dlc;
+
+    if (host_slcan_bench_line_len >= HOST_SLCAN_BENCH_LINE_SIZE)
+    {
+        host_slcan_bench_line_len = 0U;
+        host_slcan_bench_binary_len = 0U;
+        __atomic_add_fetch(&host_slcan_bench_mismatches, 1U, __ATOMIC_RELAXED);
+    }
+    if ((host_slcan_bench_line_len == 0U) && (host_slcan_bench_binary != 0U) && ((byte & 0x80U) != 0U))
+    {
+        dlc = byte & 0xFU;
+        dlc = (((byte & 0x20U) != 0U) || (dlc > 8U)) ? 0U : dlc;
+        host_slcan_bench_binary_len = 1U + (((byte & 0x40U) != 0U) ? 4U : 2U) + dlc + (((byte & 0x10U) != 0U) ? 2U : 0U);
+    }
+    host_slcan_bench_line[host_slcan_bench_line_len++] = byte;
+    if (host_slcan_bench_binary_len != 0U)
+    {
+        if (host_slcan_bench_line_len == host_slcan_bench_binary_len)
+        {
+            host_slcan_bench_record(host_slcan_bench_line);
+            host_slcan_bench_line_len = 0U;
+            host_slcan_bench_binary_len = 0U;
+        }
+    }
+    else if ((byte == '\r') || (byte == '\a'))
+    {
+        host_slcan_bench_ascii(host_slcan_bench_line, host_slcan_bench_line_len);
+        host_slcan_bench_line_len = 0U;
+    }
+}
+
+static void host_slcan_bench_listener(const host_can_frame_t *frame, uint64_t start, uint64_t end)
+{
+    (void)start;
+    (void)end;
+    host_slcan_bench_sent = *frame;
+    __atomic_add_fetch(&host_slcan_bench_sent_count, 1U, __ATOMIC_RELEASE);
+}
+
+/* Sends one command line and compares its answer; 0 when it matches. */
+static uint32_t host_slcan_bench_command(const char *command, const char *answer)
+{
+    const uint32_t answers = __atomic_load_n(&host_slcan_bench_answers, __ATOMIC_ACQUIRE);
+    uint32_t t;
+
+    (void)slcan_input(command, (uint32_t)strlen(command));
+    for (t = 0U; (t < HOST_SLCAN_BENCH_ANSWER_TIME) && (__atomic_load_n(&host_slcan_bench_answers, __ATOMIC_ACQUIRE) == answers); t++)
+    {
+        vTaskDelay(1U);
+    }
+    if ((__atomic_load_n(&host_slcan_bench_answers, __ATOMIC_ACQUIRE) != answers) && (strcmp(host_slcan_bench_answer, answer) == 0))
+    {
+        return 0U;
+    }
+    host_slcan_bench_report_len += (uint32_t)snprintf(&host_slcan_bench_report[host_slcan_bench_report_len],
+                                                      HOST_SLCAN_BENCH_REPORT_SIZE - host_slcan_bench_report_len,
+                                                      "command,failed,%.*s\n", (int)(strlen(command) - 1U), command);
+    return 1U;
+}
+
+/* A frame sent with t or T, 0 when it reached the bus as written. */
+static uint32_t host_slcan_bench_send(const char *command, const char *answer, uint32_t id, uint32_t ide,
+                                      uint32_t dlc, const uint8_t *data)
+{
+    const uint32_t sent = __atomic_load_n(&host_slcan_bench_sent_count, __ATOMIC_ACQUIRE);
+    uint32_t failed = host_slcan_bench_command(command, answer);
+    uint32_t t;
+
+    for (t = 0U; (t < HOST_SLCAN_BENCH_ANSWER_TIME) && (__atomic_load_n(&host_slcan_bench_sent_count, __ATOMIC_ACQUIRE) == sent); t++)
+    {
+        vTaskDelay(1U);
+    }
+    if ((__atomic_load_n(&host_slcan_bench_sent_count, __ATOMIC_ACQUIRE) != (sent + 1U)) || (host_slcan_bench_sent.id != id)
+        || (host_slcan_bench_sent.ide != ide) || (host_slcan_bench_sent.dlc != dlc) || (host_slcan_bench_sent.rtr != 0U)
+        || (memcmp(host_slcan_bench_sent.data, data, dlc) != 0))
+    {
+        failed++;
+    }
+    return failed;
+}
+
+static uint32_t host_slcan_bench_commands(void)
+{
+    static const uint8_t data[] = {0xAAU, 0xBBU};
+    uint32_t failed = 0U;
+
+    failed += host_slcan_bench_command("V\r", "V0101\r");
+    failed += host_slcan_bench_command("S9\r", "\a");
+    failed += host_slcan_bench_command("t1230\r", "\a");   /* closed */
+    failed += host_slcan_bench_command("S8\r", "\r");
+    failed += host_slcan_bench_command("O\r", "\r");
+    failed += host_slcan_bench_command("O\r", "\a");
+    failed += host_slcan_bench_command("S6\r", "\a");
+    failed += host_slcan_bench_send("t1232AABB\r", "z\r", 0x123U, 0U, 2U, data);
+    failed += host_slcan_bench_send("T1ABCDEF80\r", "Z\r", 0x1ABCDEF8U, 1U, 0U, data);
+    failed += host_slcan_bench_command("t8000\r", "\a");   /* identifier */
+    failed += host_slcan_bench_command("t1232AA\r", "\a"); /* length */
+    failed += host_slcan_bench_command("t1232AAXB\r", "\a"); /* data digit */
+    failed += host_slcan_bench_command("F\r", "F00\r");
+    failed += host_slcan_bench_command("T1ABCDEF88AABBCCDDEEFF0011223344\r", "\a");
+    failed += host_slcan_bench_command("C\r", "\r");
+    return failed;
+}
+
+/* Runs one row, adds it to the report and returns the number of failed
+ * checks. */
+static uint32_t host_slcan_bench_run(const host_slcan_bench_run_t *run)
+{
+    const host_slcan_bench_rate_t *rate = &host_slcan_bench_rates[run->rate];
+    host_can_frame_t other;
+    uint32_t failed = 0U;
+    uint32_t injected = 0U;
+    uint32_t record;
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t last;
+    uint64_t frame_ns;
+    uint64_t stored;
+    uint64_t overruns;
+    uint64_t bytes;
+    uint64_t start;
+    uint64_t ns;
+    uint32_t need;
+    uint32_t i;
+    uint32_t t;
+    UBaseType_t mask;
+
+    failed += host_slcan_bench_command(rate->command, "\r");
+    failed += host_slcan_bench_command((run->timestamps != 0U) ? "Z1\r" : "Z0\r", "\r");
+    failed += host_slcan_bench_command((run->binary != 0U) ? "B1\r" : "B0\r", "\r");
+    host_slcan_bench_binary = run->binary;
+    failed += host_slcan_bench_command("O\r", "\r");
+
+    memset(&other, 0, sizeof(other));
+    other.ide = run->ide;
+    other.dlc = run->dlc;
+    frame_ns = ((uint64_t)host_can_frame_bits(&other) * rate->prescaler * rate->tq * 1000U) / 36U;
+    if (run->binary != 0U)
+    {
+        record = 1U + ((run->ide != 0U) ? 4U : 2U) + run->dlc + ((run->timestamps != 0U) ? 2U : 0U);
+    }
+    else
+    {
+        record = 1U + ((run->ide != 0U) ? 8U : 3U) + 1U + (run->dlc * 2U) + ((run->timestamps != 0U) ? 4U : 0U) + 1U;
+    }
+    need = (uint32_t)((1000000000ULL * record * 100U) / (frame_ns * HOST_SLCAN_BENCH_UART_BPS));
+
+    host_slcan_bench_last = 0U;
+    host_slcan_bench_expected = run;
+    frames = __atomic_load_n(&host_slcan_bench_frames, __ATOMIC_ACQUIRE);
+    dropped = can_rx_dropped();
+    stored = host_periph_stats.can_rx_frames;
+    overruns = host_periph_stats.can_rx_overruns;
+    bytes = host_periph_stats.uart_tx_bytes;
+    start = host_periph_time_ns();
+    host_slcan_bench_last_ns = start;
+
+    for (t = 0U; t < HOST_SLCAN_BENCH_TIME; t++)
+    {
+        /* host_can_inject() wants the signals of the port blocked */
+        mask = taskENTER_CRITICAL_FROM_ISR();
+        for (;;)
+        {
+            other.id = ((run->ide != 0U) ? HOST_SLCAN_BENCH_EXT_ID : HOST_SLCAN_BENCH_STD_ID) + (injected & 0xFFU);
+            for (i = 0U; i < run->dlc; i++)
+            {
+                other.data[i] = (uint8_t)((injected >> ((i & 3U) * 8U)) ^ (i * 0x11U));
+            }
+            if (host_can_inject(&other) != 0)
+            {
+                break;
+            }
+            injected++;
+        }
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+        vTaskDelay(1U);
+    }
+    /* until the last frame has gone out on the UART */
+    last = __atomic_load_n(&host_slcan_bench_frames, __ATOMIC_ACQUIRE);
+    for (t = 0U; t < HOST_SLCAN_BENCH_DRAIN; t++)
+    {
+        vTaskDelay(1U);
+        if ((__atomic_load_n(&host_slcan_bench_frames, __ATOMIC_ACQUIRE) != last) || (can_rx_pending() != 0U))
+        {
+            last = __atomic_load_n(&host_slcan_bench_frames, __ATOMIC_ACQUIRE);
+            t = 0U;
+        }
+    }
+    failed += host_slcan_bench_command("C\r", "\r");
+    host_slcan_bench_expected = NULL;
+
+    frames = __atomic_load_n(&host_slcan_bench_frames, __ATOMIC_ACQUIRE) - frames;
+    dropped = can_rx_dropped() - dropped;
+    stored = host_periph_stats.can_rx_frames - stored;
+    overruns = host_periph_stats.can_rx_overruns - overruns;
+    bytes = host_periph_stats.uart_tx_bytes - bytes;
+    ns = host_slcan_bench_last_ns - start;
+
+    host_slcan_bench_report_len += (uint32_t)snprintf(
+        &host_slcan_bench_report[host_slcan_bench_report_len], HOST_SLCAN_BENCH_REPORT_SIZE - host_slcan_bench_report_len,
+        "%s,%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", rate->name, (run->binary != 0U) ? "binary" : "ascii",
+        (unsigned int)run->timestamps, (unsigned int)run->ide, (unsigned int)run->dlc, (unsigned int)injected,
+        (unsigned int)stored, (unsigned int)frames,
+        (unsigned int)((ns > 0U) ? (((uint64_t)frames * 1000000000ULL) / ns) : 0U),
+        (unsigned int)(1000000000ULL / frame_ns),
+        (unsigned int)((ns > 0U) ? ((bytes * 1000000000ULL) / ns) : 0U), (unsigned int)need,
+        (unsigned int)overruns, (unsigned int)dropped, (unsigned int)host_slcan_bench_mismatches);
+
+    /* every frame stored is forwarded or counted, none lost below the UART
+     * limit; the FIFO overwrites its last frame on an overrun (RFLM off) */
+    failed += ((frames > 0U) && ((frames + dropped) <= stored) && ((frames + dropped + overruns) >= stored)
+               && ((need >= HOST_SLCAN_BENCH_NEED_MAX) || (dropped == 0U)))
+                  ? 0U
+                  : 1U;
+    failed += host_slcan_bench_mismatches;
+    host_slcan_bench_mismatches = 0U;
+    return failed;
+}
+
+static void host_slcan_bench_task(void *argument)
+{
+    uint32_t failed = 0U;
+    uint32_t i;
+
+    (void)argument;
+
+    vTaskDelay(HOST_SLCAN_BENCH_SETTLE);
+    console_flush();
+    host_uart_set_tx_sink(host_slcan_bench_sink);
+    host_can_set_tx_listener(host_slcan_bench_listener);
+
+    failed += host_slcan_bench_commands();
+    host_slcan_bench_report_len += (uint32_t)snprintf(
+        &host_slcan_bench_report[host_slcan_bench_report_len], HOST_SLCAN_BENCH_REPORT_SIZE - host_slcan_bench_report_len,
+        "rate,format,timestamps,ide,dlc,injected,stored,forwarded,frames_per_s,bus_frames_per_s,uart_bytes_per_s,uart_need_pct,fifo_overruns,ring_dropped,mismatches\n");
+    for (i = 0U; i < (sizeof(host_slcan_bench_runs) / sizeof(host_slcan_bench_runs[0])); i++)
+    {
+        failed += host_slcan_bench_run(&host_slcan_bench_runs[i]);
+    }
+    failed += host_slcan_bench_mismatches;
+
+    host_can_set_tx_listener(NULL);
+    host_uart_set_tx_sink(NULL);
+    printf("%s", host_slcan_bench_report);
+    printf("result,%s\n", (failed == 0U) ? "ok" : "failed");
+    console_flush();
+    exit((failed == 0U) ? 0 : 1);
+}
+
+void host_slcan_bench_start(void)
+{
+    (void)xTaskCreate(host_slcan_bench_task, "slcanbench", HOST_SLCAN_BENCH_STACK_SIZE, NULL,
+                      tskIDLE_PRIORITY + 2U, NULL);
+}
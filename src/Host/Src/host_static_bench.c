@@ -0,0 +1,272 @@
+/**
+ ******************************************************************************
+ * @file           : host_static_bench.c
+ * @brief          : Host check of the static allocation (USE_STATIC_ALLOC)
+ ******************************************************************************
+ * The heap calls are counted from inside heap_4.c, with the scheduler
+ * suspended, so the counters need no lock.  The objects created after the
+ * run are defined in the function, like the threads of main(); in the
+ * static mode every create of an object works on the same storage again,
+ * which is fine as long as the one before is not in use.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "printf.h"
+#include "console.h"
+#include "user.h"
+#include "host_static_bench.h"
+
+#define HOST_STATIC_BENCH_STACK_SIZE    256U
+#define HOST_STATIC_BENCH_SETTLE        300U        /* ticks, start-up log */
+#define HOST_STATIC_BENCH_TIME          2000U       /* ticks, one frame each */
+#define HOST_STATIC_BENCH_DRAIN         200U        /* ticks */
+#define HOST_STATIC_BENCH_CREATES       8U
+#define HOST_STATIC_BENCH_CAN_ID        0x100U
+
+typedef enum
+{
+    HOST_STATIC_BENCH_THREAD = 0,
+    HOST_STATIC_BENCH_MESSAGEQ,
+    HOST_STATIC_BENCH_SEMAPHORE,
+    HOST_STATIC_BENCH_POOL,
+    HOST_STATIC_BENCH_COUNT
+} host_static_bench_object_t;
+
+typedef struct
+{
+    uint32_t calls;
+    uint64_t bytes;
+} host_static_bench_heap_t;
+
+typedef struct
+{
+    uint32_t creates;
+    uint64_t min;
+    uint64_t max;
+} host_static_bench_create_t;
+
+typedef struct
+{
+    uint32_t id;
+    uint8_t data[8];
+} host_static_bench_block_t;
+
+static const char *const host_static_bench_names[HOST_STATIC_BENCH_COUNT] =
+{
+    "osThreadCreate",
+    "osMessageCreate",
+    "osSemaphoreCreate",
+    "osPoolCreate",
+};
+
+static host_static_bench_heap_t host_static_bench_boot;
+static host_static_bench_heap_t host_static_bench_run;
+static uint32_t host_static_bench_frees;
+static host_static_bench_create_t host_static_bench_creates[HOST_STATIC_BENCH_COUNT];
+
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+static StaticTask_t host_static_bench_tcb;
+static StackType_t host_static_bench_stack[HOST_STATIC_BENCH_STACK_SIZE];
+#endif
+
+void host_static_bench_malloc(void *address, size_t size)
+{
+    host_static_bench_heap_t *heap;
+
+    (void)address;
+
+    heap = (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) ? &host_static_bench_boot
+                                                                   : &host_static_bench_run;
+    heap->calls++;
+    heap->bytes += size;
+}
+
+void host_static_bench_free(void *address, size_t size)
+{
+    (void)address;
+    (void)size;
+
+    host_static_bench_frees++;
+}
+
+static uint64_t host_static_bench_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static void host_static_bench_record(host_static_bench_object_t object, uint64_t start, void *created)
+{
+    host_static_bench_create_t *create = &host_static_bench_creates[object];
+    uint64_t ns = host_static_bench_now() - start;
+
+    if (created == NULL)
+    {
+        return;
+    }
+    if ((create->creates == 0U) || (ns < create->min))
+    {
+        create->min = ns;
+    }
+    if (ns > create->max)
+    {
+        create->max = ns;
+    }
+    create->creates++;
+}
+
+static void host_static_bench_idle_thread(void const *argument)
+{
+    (void)argument;
+
+    for (;;)
+    {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+static void host_static_bench_create(void)
+{
+    osThreadDef(staticidle, host_static_bench_idle_thread, osPriorityLow, 0, 64);
+    osMessageQDef(staticq, 4, uint32_t);
+    osSemaphoreDef(staticsem);
+    osPoolDef(staticpool, 8, host_static_bench_block_t);
+    host_static_bench_block_t *block;
+    osMessageQId queue;
+    osSemaphoreId sem;
+    osPoolId pool;
+    osEvent event;
+    uint64_t start;
+    uint32_t i;
+
+    /* a thread cannot be deleted in this configuration: once */
+    start = host_static_bench_now();
+    host_static_bench_record(HOST_STATIC_BENCH_THREAD, start, osThreadCreate(osThread(staticidle), NULL));
+
+    for (i = 0U; i < HOST_STATIC_BENCH_CREATES; i++)
+    {
+        start = host_static_bench_now();
+        queue = osMessageCreate(osMessageQ(staticq), NULL);
+        host_static_bench_record(HOST_STATIC_BENCH_MESSAGEQ, start, queue);
+
+        start = host_static_bench_now();
+        sem = osSemaphoreCreate(osSemaphore(staticsem), 1);
+        host_static_bench_record(HOST_STATIC_BENCH_SEMAPHORE, start, sem);
+
+        start = host_static_bench_now();
+        pool = osPoolCreate(osPool(staticpool));
+        host_static_bench_record(HOST_STATIC_BENCH_POOL, start, pool);
+
+        /* and they work */
+        if ((queue == NULL) || (osMessagePut(queue, i, 0U) != osOK))
+        {
+            continue;
+        }
+        event = osMessageGet(queue, 0U);
+        if ((event.status != osEventMessage) || (event.value.v != i))
+        {
+            host_static_bench_creates[HOST_STATIC_BENCH_MESSAGEQ].creates--;
+        }
+        if ((sem == NULL) || (osSemaphoreWait(sem, 0U) != osOK))
+        {
+            host_static_bench_creates[HOST_STATIC_BENCH_SEMAPHORE].creates -= (sem != NULL) ? 1U : 0U;
+        }
+        block = (pool != NULL) ? (host_static_bench_block_t *)osPoolAlloc(pool) : NULL;
+        if ((block == NULL) || (osPoolFree(pool, block) != osOK))
+        {
+            host_static_bench_creates[HOST_STATIC_BENCH_POOL].creates -= (pool != NULL) ? 1U : 0U;
+        }
+    }
+}
+
+static void host_static_bench_task(void *argument)
+{
+    host_can_frame_t frame;
+    UBaseType_t mask;
+    uint32_t injected = 0U;
+    uint32_t received;
+    uint32_t errors = 0U;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    uint32_t expected;
+#endif
+    uint32_t i;
+    uint32_t t;
+
+    (void)argument;
+
+    vTaskDelay(HOST_STATIC_BENCH_SETTLE);
+    console_flush();
+
+    received = user_can_rx_frames;
+    memset(&frame, 0, sizeof(frame));
+    frame.id = HOST_STATIC_BENCH_CAN_ID;
+    frame.dlc = 8U;
+    for (t = 0U; t < HOST_STATIC_BENCH_TIME; t++)
+    {
+        /* host_can_inject() wants the signals of the port blocked */
+        mask = taskENTER_CRITICAL_FROM_ISR();
+        frame.data[0] = (uint8_t)t;
+        if (host_can_inject(&frame) == 0)
+        {
+            injected++;
+        }
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+        vTaskDelay(1U);
+    }
+    for (t = 0U; (t < HOST_STATIC_BENCH_DRAIN) && ((user_can_rx_frames - received) != injected); t++)
+    {
+        vTaskDelay(1U);
+    }
+    received = user_can_rx_frames - received;
+    host_static_bench_create();
+
+    errors += (received == injected) ? 0U : 1U;
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    /* the heap runs out before the creates end without it */
+    errors += host_static_bench_boot.calls + host_static_bench_run.calls + host_static_bench_frees;
+    for (i = 0U; i < (uint32_t)HOST_STATIC_BENCH_COUNT; i++)
+    {
+        expected = (i == (uint32_t)HOST_STATIC_BENCH_THREAD) ? 1U : HOST_STATIC_BENCH_CREATES;
+        errors += (host_static_bench_creates[i].creates == expected) ? 0U : 1U;
+    }
+#endif
+
+    printf("static,boot_heap_calls,boot_heap_bytes,run_heap_calls,run_heap_bytes,frees,heap_free,heap_min_free,"
+           "can_injected,can_received,errors\n");
+    printf("%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", (unsigned int)configSUPPORT_STATIC_ALLOCATION,
+           (unsigned int)host_static_bench_boot.calls, (unsigned int)host_static_bench_boot.bytes,
+           (unsigned int)host_static_bench_run.calls, (unsigned int)host_static_bench_run.bytes,
+           (unsigned int)host_static_bench_frees, (unsigned int)xPortGetFreeHeapSize(),
+           (unsigned int)xPortGetMinimumEverFreeHeapSize(), (unsigned int)injected, (unsigned int)received,
+           (unsigned int)errors);
+    printf("object,creates,min_ns,max_ns\n");
+    for (i = 0U; i < (uint32_t)HOST_STATIC_BENCH_COUNT; i++)
+    {
+        printf("%s,%u,%u,%u\n", host_static_bench_names[i], (unsigned int)host_static_bench_creates[i].creates,
+               (unsigned int)host_static_bench_creates[i].min, (unsigned int)host_static_bench_creates[i].max);
+    }
+
+    console_flush();
+    exit((errors == 0U) ? 0 : 1);
+}
+
+void host_static_bench_start(void)
+{
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    (void)xTaskCreateStatic(host_static_bench_task, "staticbench", HOST_STATIC_BENCH_STACK_SIZE, NULL,
+                            tskIDLE_PRIORITY + 2U, host_static_bench_stack, &host_static_bench_tcb);
+#else
+    (void)xTaskCreate(host_static_bench_task, "staticbench", HOST_STATIC_BENCH_STACK_SIZE, NULL,
+                      tskIDLE_PRIORITY + 2U, NULL);
+#endif
+}
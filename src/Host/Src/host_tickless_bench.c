@@ -0,0 +1,260 @@
+/**
+ ******************************************************************************
+ * @file           : host_tickless_bench.c
+ * @brief          : Host check of the tickless idle (tickless.c)
+ ******************************************************************************
+ * The random numbers come from fixed seeds, the host scheduler still makes
+ * every run a little different.  The injector is a host thread like the
+ * other node of a real bus: it is started with the signals of the port
+ * blocked, so it never takes a simulated interrupt, and stops by itself at
+ * the end of the phase.
+ ******************************************************************************
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "printf.h"
+#include "console.h"
+#include "user.h"
+#include "tickless.h"
+#include "host_tickless_bench.h"
+
+#define HOST_TICKLESS_BENCH_STACK_SIZE  256U
+#define HOST_TICKLESS_BENCH_SETTLE      300U        /* ticks, start-up log */
+#define HOST_TICKLESS_BENCH_TIME        8000U       /* ticks per phase */
+#define HOST_TICKLESS_BENCH_DRAIN       200U        /* ticks */
+#define HOST_TICKLESS_BENCH_SEED        1U
+#define HOST_TICKLESS_BENCH_CAN_ID      0x100U
+#define HOST_TICKLESS_BENCH_CAN_GAP     20000U      /* us, longest between two frames */
+
+typedef struct
+{
+    const char *name;
+    uint32_t delay_min;                 /* ticks */
+    uint32_t delay_max;
+    uint32_t inject;
+} host_tickless_bench_phase_t;
+
+static const host_tickless_bench_phase_t host_tickless_bench_phases[] =
+{
+    {"idle", 50U, 250U, 0U},
+    {"random", 1U, 60U, 1U},
+};
+
+typedef struct
+{
+    TickType_t tick;
+    uint32_t hal_tick;                  /* HAL_GetTick() */
+    uint32_t pending;                   /* ticks the tick interrupt takes */
+    uint64_t lost;                      /* TIM1 counter clock ticks */
+    uint64_t counts;                    /* TIM1 counter clock ticks, to the last update */
+    uint32_t cnt;
+} host_tickless_bench_sample_t;
+
+static uint32_t host_tickless_bench_injecting;
+static uint32_t host_tickless_bench_injected;
+
+static void *host_tickless_bench_injector(void *argument)
+{
+    unsigned int seed = HOST_TICKLESS_BENCH_SEED;
+    host_can_frame_t frame;
+    struct timespec gap;
+
+    (void)argument;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.id = HOST_TICKLESS_BENCH_CAN_ID;
+    frame.dlc = 8U;
+    while (__atomic_load_n(&host_tickless_bench_injecting, __ATOMIC_ACQUIRE) != 0U)
+    {
+        gap.tv_sec = 0;
+        gap.tv_nsec = (long)((uint32_t)rand_r(&seed) % HOST_TICKLESS_BENCH_CAN_GAP) * 1000L;
+        (void)nanosleep(&gap, NULL);
+        frame.data[0]++;
+        if (host_can_inject(&frame) == 0)
+        {
+            __atomic_add_fetch(&host_tickless_bench_injected, 1U, __ATOMIC_RELEASE);
+        }
+    }
+    return NULL;
+}
+
+static void host_tickless_bench_inject(void)
+{
+    pthread_t thread;
+
+    __atomic_store_n(&host_tickless_bench_injecting, 1U, __ATOMIC_RELEASE);
+    /* the thread inherits the signal mask of the critical section */
+    taskENTER_CRITICAL();
+    if (pthread_create(&thread, NULL, host_tickless_bench_injector, NULL) == 0)
+    {
+        (void)pthread_detach(thread);
+    }
+    taskEXIT_CRITICAL();
+}
+
+/* The kernel and the model at one sync with the interrupts masked. */
+static void host_tickless_bench_sample(host_tickless_bench_sample_t *sample)
+{
+    taskENTER_CRITICAL();
+    host_periph_sync();
+    sample->tick = xTaskGetTickCount();
+    sample->hal_tick = HAL_GetTick();
+    sample->lost = host_periph_stats.tim_lost;
+    sample->counts = host_periph_stats.tim_counts;
+    sample->cnt = TIM1->CNT;
+    /* its update and, held off a tick or more, the ticks passed since */
+    sample->pending = ((TIM1->SR & TIM_SR_UIF) != 0U) ? (1U + (sample->cnt / TICKLESS_COUNTS)) : 0U;
+    taskEXIT_CRITICAL();
+}
+
+/* Ticks the kernel has (taken or pending), the lost updates included, less
+ * the tick boundaries the counter passed since the first sample.  Every
+ * counter period is a whole number of ticks, so the boundaries are
+ * TICKLESS_COUNTS apart from the update before the first sample. */
+static int64_t host_tickless_bench_error(const host_tickless_bench_sample_t *first,
+                                         const host_tickless_bench_sample_t *now)
+{
+    int64_t ticks = (int64_t)(TickType_t)(now->tick - first->tick) + (int64_t)now->pending - (int64_t)first->pending
+                    + (int64_t)((now->lost - first->lost) / TICKLESS_COUNTS);
+    int64_t boundaries = (int64_t)((now->counts + now->cnt - first->counts) / TICKLESS_COUNTS)
+                         - (int64_t)(first->cnt / TICKLESS_COUNTS);
+
+    return ticks - boundaries;
+}
+
+static void host_tickless_bench_stats(tickless_stats_t *stats)
+{
+#if defined(USE_TICKLESS)
+    tickless_get(stats);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+static uint32_t host_tickless_bench_phase(const host_tickless_bench_phase_t *phase, unsigned int *seed)
+{
+    host_tickless_bench_sample_t first;
+    host_tickless_bench_sample_t sample;
+    tickless_stats_t stats0;
+    tickless_stats_t stats;
+    TickType_t before;
+    TickType_t delay;
+    uint64_t t0;
+    uint64_t seconds_ns;
+    uint64_t updates;
+    uint64_t irqs;
+    int64_t error;
+    int64_t error_max = 0;
+    uint32_t mismatches = 0U;
+    uint32_t received;
+    uint32_t injected;
+    uint32_t delays = 0U;
+    uint32_t late = 0U;
+    uint32_t errors = 0U;
+    uint32_t t;
+
+    /* from the start of a tick */
+    vTaskDelay(1U);
+    t0 = host_periph_time_ns();
+    host_tickless_bench_sample(&first);
+    sample = first;
+    updates = host_periph_stats.tim_updates;
+    irqs = host_periph_stats.irqs;
+    received = user_can_rx_frames;
+    injected = __atomic_load_n(&host_tickless_bench_injected, __ATOMIC_ACQUIRE);
+    host_tickless_bench_stats(&stats0);
+    if (phase->inject != 0U)
+    {
+        host_tickless_bench_inject();
+    }
+
+    while ((TickType_t)(xTaskGetTickCount() - first.tick) < HOST_TICKLESS_BENCH_TIME)
+    {
+        delay = phase->delay_min + ((uint32_t)rand_r(seed) % (phase->delay_max - phase->delay_min + 1U));
+        before = xTaskGetTickCount();
+        vTaskDelay(delay);
+        host_tickless_bench_sample(&sample);
+
+        delays++;
+        if ((TickType_t)(sample.tick - before) < delay)
+        {
+            errors++;
+        }
+        else if ((TickType_t)(sample.tick - before) > delay)
+        {
+            late++;
+        }
+        else
+        {
+            /* on time */
+        }
+        error = host_tickless_bench_error(&first, &sample);
+        if ((error != 0) || ((sample.hal_tick - first.hal_tick) != (uint32_t)(TickType_t)(sample.tick - first.tick)))
+        {
+            mismatches++;
+            error_max = (llabs(error) > llabs(error_max)) ? error : error_max;
+        }
+    }
+    seconds_ns = host_periph_time_ns() - t0;
+    updates = host_periph_stats.tim_updates - updates;
+    irqs = host_periph_stats.irqs - irqs;
+    host_tickless_bench_stats(&stats);
+
+    __atomic_store_n(&host_tickless_bench_injecting, 0U, __ATOMIC_RELEASE);
+    /* the injector may still send one frame after the flag */
+    vTaskDelay(HOST_TICKLESS_BENCH_CAN_GAP / 1000U);
+    injected = __atomic_load_n(&host_tickless_bench_injected, __ATOMIC_ACQUIRE) - injected;
+    for (t = 0U; (t < HOST_TICKLESS_BENCH_DRAIN) && ((user_can_rx_frames - received) != injected); t++)
+    {
+        vTaskDelay(1U);
+    }
+    received = user_can_rx_frames - received;
+
+    errors += mismatches;
+    errors += (received == injected) ? 0U : 1U;
+
+    printf("%s,%u.%03u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%d,%u\n", phase->name,
+           (unsigned int)(seconds_ns / 1000000000ULL), (unsigned int)((seconds_ns / 1000000ULL) % 1000U),
+           (unsigned int)delays, (unsigned int)late, (unsigned int)((updates * 1000000000ULL) / seconds_ns),
+           (unsigned int)((irqs * 1000000000ULL) / seconds_ns), (unsigned int)(stats.sleeps - stats0.sleeps),
+           (unsigned int)(stats.early - stats0.early), (unsigned int)(stats.aborted - stats0.aborted),
+           (unsigned int)(stats.held - stats0.held), (unsigned int)(stats.stepped - stats0.stepped),
+           (unsigned int)((sample.lost - first.lost) / TICKLESS_COUNTS), (unsigned int)injected, (unsigned int)received,
+           (unsigned int)mismatches, (int)error_max, (unsigned int)errors);
+    return errors;
+}
+
+static void host_tickless_bench_task(void *argument)
+{
+    unsigned int seed = HOST_TICKLESS_BENCH_SEED;
+    uint32_t errors = 0U;
+    uint32_t i;
+
+    (void)argument;
+
+    vTaskDelay(HOST_TICKLESS_BENCH_SETTLE);
+    console_flush();
+
+    printf("phase,seconds,delays,late,tick_irqs_per_s,irqs_per_s,sleeps,early,aborted,held,stepped,lost,"
+           "can_injected,can_received,tick_mismatches,tick_error_max,errors\n");
+    for (i = 0U; i < (sizeof(host_tickless_bench_phases) / sizeof(host_tickless_bench_phases[0])); i++)
+    {
+        errors += host_tickless_bench_phase(&host_tickless_bench_phases[i], &seed);
+    }
+
+    console_flush();
+    exit((errors == 0U) ? 0 : 1);
+}
+
+void host_tickless_bench_start(void)
+{
+    (void)xTaskCreate(host_tickless_bench_task, "idlebench", HOST_TICKLESS_BENCH_STACK_SIZE, NULL,
+                      tskIDLE_PRIORITY + 2U, NULL);
+}
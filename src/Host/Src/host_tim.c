@@ -0,0 +1,225 @@
+/**
+ ******************************************************************************
+ * @file           : host_tim.c
+ * @brief          : Behavioral model of TIM1 for the host simulation
+ ******************************************************************************
+ * Time base only, the way stm32f1xx_hal_timebase_tim.c uses TIM1: edge
+ * aligned up-counter, prescaler and auto-reload with their preload registers,
+ * repetition counter, UG, UDIS/URS/OPM and the update interrupt.  The capture
+ * compare channels, the slave modes and the down/center counting modes are
+ * not modeled.
+ *
+ * The counter is derived from the host clock: CNT is the value captured at
+ * host_tim_ref plus the ticks of the counter clock elapsed since then.  Every
+ * update event moves the reference, so a new prescaler takes effect exactly
+ * there like on the target.
+ ******************************************************************************
+ */
+#include <string.h>
+
+#include "host_model.h"
+
+/* Updates the loop below handles one by one before it skips ahead. */
+#define HOST_TIM_MAX_STEPS              16U
+
+static uint32_t host_tim_sr;
+static uint32_t host_tim_cnt;       /* CNT published at the last sync */
+static uint32_t host_tim_psc;       /* active prescaler */
+static uint32_t host_tim_arr;       /* active auto-reload */
+static uint32_t host_tim_rep;       /* repetition down-counter */
+static uint32_t host_tim_running;
+static uint64_t host_tim_ref;       /* host time of host_tim_ref_cnt */
+static uint32_t host_tim_ref_cnt;
+static uint64_t host_tim_counts_uif; /* tim_counts at the last update that set UIF */
+static uint32_t host_tim_ref_counts; /* ticks of the period before host_tim_ref_cnt */
+static uint64_t host_tim_sync;      /* host time of the last sync */
+
+void host_tim_reset(void)
+{
+    memset(&host_tim1, 0, sizeof(host_tim1));
+    host_tim1.ARR = 0xFFFFU;
+
+    host_tim_sr = 0U;
+    host_tim_cnt = 0U;
+    host_tim_counts_uif = host_periph_stats.tim_counts;
+    host_tim_ref_counts = 0U;
+    host_tim_psc = 0U;
+    host_tim_arr = 0xFFFFU;
+    host_tim_rep = 0U;
+    host_tim_running = 0U;
+}
+
+/* Host time the counter needs for n ticks from the reference. */
+static uint64_t host_tim_ticks_ns(uint64_t ticks)
+{
+    uint32_t clk = host_rcc_tim1clk();
+
+    if (clk == 0U)
+    {
+        return HOST_TIME_NEVER;
+    }
+    return (uint64_t)(((unsigned __int128)ticks * (host_tim_psc + 1U) * HOST_NS_PER_S + (clk - 1U)) / clk);
+}
+
+static uint64_t host_tim_elapsed_ticks(uint64_t now)
+{
+    uint32_t clk = host_rcc_tim1clk();
+
+    return (uint64_t)(((unsigned __int128)(now - host_tim_ref) * clk) / ((uint64_t)(host_tim_psc + 1U) * HOST_NS_PER_S));
+}
+
+/* Update event: preload registers, repetition counter and UIF. */
+static void host_tim_update_event(uint32_t set_uif)
+{
+    host_tim_psc = host_tim1.PSC & 0xFFFFU;
+    host_tim_arr = host_tim1.ARR & 0xFFFFU;
+
+    if (host_tim_rep == 0U)
+    {
+        host_tim_rep = host_tim1.RCR & 0xFFU;
+        if (set_uif != 0U)
+        {
+            if ((host_tim_sr & TIM_SR_UIF) != 0U)
+            {
+                host_periph_stats.tim_lost += host_periph_stats.tim_counts - host_tim_counts_uif;
+            }
+            host_tim_counts_uif = host_periph_stats.tim_counts;
+            host_tim_sr |= TIM_SR_UIF;
+            host_periph_stats.tim_updates++;
+        }
+    }
+    else
+    {
+        host_tim_rep--;
+    }
+}
+
+/* Host time of the next overflow, a counter written above ARR runs up to
+ * 0xFFFF first. */
+static uint64_t host_tim_next_overflow(void)
+{
+    uint64_t top = (host_tim_ref_cnt <= host_tim_arr) ? ((uint64_t)host_tim_arr + 1U) : 0x10000U;
+
+    return host_tim_ref + host_tim_ticks_ns(top - host_tim_ref_cnt);
+}
+
+static void host_tim_run(uint64_t now)
+{
+    uint64_t overflow;
+    uint64_t period_ns;
+    uint64_t periods;
+    uint32_t steps = 0U;
+
+    while (host_tim_running != 0U)
+    {
+        overflow = host_tim_next_overflow();
+        if (overflow > now)
+        {
+            host_tim_cnt = host_tim_ref_cnt + (uint32_t)host_tim_elapsed_ticks(now);
+            return;
+        }
+
+        host_periph_stats.tim_counts += ((host_tim_ref_cnt <= host_tim_arr) ? ((uint64_t)host_tim_arr + 1U) : 0x10000U)
+                                        - host_tim_ref_cnt + host_tim_ref_counts;
+        host_tim_ref = overflow;
+        host_tim_ref_cnt = 0U;
+        host_tim_ref_counts = 0U;
+        if ((host_tim1.CR1 & TIM_CR1_UDIS) == 0U)
+        {
+            host_tim_update_event(1U);
+        }
+        if ((host_tim1.CR1 & TIM_CR1_OPM) != 0U)
+        {
+            host_tim1.CR1 &= ~TIM_CR1_CEN;
+            host_tim_running = 0U;
+        }
+
+        /* Far behind (the host did not run the simulation for a while): the
+         * missed periods are all alike, only the last one is kept. */
+        steps++;
+        if ((steps >= HOST_TIM_MAX_STEPS) && (host_tim_running != 0U))
+        {
+            period_ns = host_tim_ticks_ns((uint64_t)host_tim_arr + 1U);
+            periods = (now - host_tim_ref) / period_ns;
+            host_tim_ref += periods * period_ns;
+            host_periph_stats.tim_counts += periods * ((uint64_t)host_tim_arr + 1U);
+            host_periph_stats.tim_lost += periods * ((uint64_t)host_tim_arr + 1U);
+            host_tim_counts_uif = host_periph_stats.tim_counts;
+        }
+    }
+    host_tim_cnt = host_tim_ref_cnt + ((host_tim_running != 0U) ? (uint32_t)host_tim_elapsed_ticks(now) : 0U);
+}
+
+uint64_t host_tim_update(uint64_t now)
+{
+    uint32_t cr1;
+    uint32_t sr = host_tim1.SR;
+    uint32_t cnt_written = (host_tim1.CNT != host_tim_cnt) ? 1U : 0U;
+
+    /* rc_w0 flags cleared since the last sync, an update found by the run
+     * below stays set. */
+    if (sr != host_tim_sr)
+    {
+        host_tim_sr &= sr;
+    }
+
+    /* ARR without preload is taken as written right after the last sync,
+     * like the flags: the CPU writes it from a count it has just read. */
+    if ((host_tim1.CR1 & TIM_CR1_ARPE) == 0U)
+    {
+        host_tim_arr = host_tim1.ARR & 0xFFFFU;
+        if ((host_tim_running != 0U) && (host_tim_cnt > host_tim_arr) && (host_tim_ref_cnt <= host_tim_arr))
+        {
+            /* ARR written below the counter: it runs up to 0xFFFF */
+            host_tim_ref_counts += host_tim_cnt - host_tim_ref_cnt;
+            host_tim_ref = host_tim_sync;
+            host_tim_ref_cnt = host_tim_cnt;
+        }
+    }
+
+    host_tim_run(now);
+    cr1 = host_tim1.CR1;
+
+    /* The other CPU writes take effect now. */
+    if (cnt_written != 0U)
+    {
+        host_tim_cnt = host_tim1.CNT & 0xFFFFU;
+        host_tim_ref_cnt = host_tim_cnt;
+        host_tim_ref = now;
+    }
+    if ((host_tim1.EGR & TIM_EGR_UG) != 0U)
+    {
+        /* UG restarts the counter, it sets UIF unless URS is set */
+        host_tim_cnt = 0U;
+        host_tim_ref_cnt = 0U;
+        host_tim_ref_counts = 0U;
+        host_tim_ref = now;
+        host_tim_rep = 0U;
+        host_tim_update_event(((cr1 & TIM_CR1_URS) == 0U) ? 1U : 0U);
+    }
+    host_tim1.EGR = 0U;
+
+    if (((cr1 & TIM_CR1_CEN) != 0U) != (host_tim_running != 0U))
+    {
+        /* started or stopped: the counter goes on from its current value */
+        host_tim_running = ((cr1 & TIM_CR1_CEN) != 0U) ? 1U : 0U;
+        host_tim_ref_counts += host_tim_cnt - host_tim_ref_cnt;
+        host_tim_ref_cnt = host_tim_cnt;
+        host_tim_ref = now;
+    }
+
+    host_tim1.SR = host_tim_sr;
+    host_tim1.CNT = host_tim_cnt;
+    host_tim_sync = now;
+
+    return (host_tim_running != 0U) ? host_tim_next_overflow() : HOST_TIME_NEVER;
+}
+
+uint32_t host_tim_up_causes(void)
+{
+    if ((host_tim1.DIER & TIM_DIER_UIE) != 0U)
+    {
+        return host_tim_sr & TIM_SR_UIF;
+    }
+    return 0U;
+}
@@ -0,0 +1,203 @@
+/**
+ ******************************************************************************
+ * @file           : host_trace_bench.c
+ * @brief          : Host benchmark of the event trace (trace.c)
+ ******************************************************************************
+ * The trace is copied out with the simulated interrupts masked, so it ends
+ * in one consistent state, and written as it is, the layout of a debugger
+ * dump of the target.
+ *
+ * A record's time may be earlier than the one before when an interrupt came
+ * between the slot and the clock read of the record before; that step back
+ * is at most the length of the interrupt, HOST_TRACE_BENCH_STEP_BACK allows
+ * for a slow host.  Any longer step back is an error.
+ *
+ * trace_record() is timed in batches of HOST_TRACE_BENCH_BATCH calls, the
+ * cost of reading the clock taken off, into a ring that is no longer looked
+ * at.
+ ******************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "printf.h"
+#include "console.h"
+#include "trace.h"
+#include "host_trace_bench.h"
+
+#define HOST_TRACE_BENCH_STACK_SIZE     256U
+#define HOST_TRACE_BENCH_TIME           3300U       /* ticks, 3 runs of the 1000 ms task */
+#define HOST_TRACE_BENCH_FILE           "trace.bin"
+#define HOST_TRACE_BENCH_STEP_BACK      1000000     /* ns */
+#define HOST_TRACE_BENCH_NESTING        8U
+#define HOST_TRACE_BENCH_ITERATIONS     1000U
+#define HOST_TRACE_BENCH_BATCH          8U
+
+static trace_buffer_t host_trace_bench_copy;
+
+static uint32_t host_trace_bench_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec);
+}
+
+static void host_trace_bench_snapshot(void)
+{
+    FILE *f;
+
+    taskENTER_CRITICAL();
+    (void)memcpy(&host_trace_bench_copy, &trace_buffer, sizeof(trace_buffer));
+    taskEXIT_CRITICAL();
+
+    f = fopen(HOST_TRACE_BENCH_FILE, "wb");
+    if (f != NULL)
+    {
+        (void)fwrite(&host_trace_bench_copy, sizeof(host_trace_bench_copy), 1U, f);
+        (void)fclose(f);
+    }
+}
+
+static uint32_t host_trace_bench_check(void)
+{
+    const trace_buffer_t *trace = &host_trace_bench_copy;
+    uint32_t counts[TRACE_EVENT_NOTIFY_ISR + 1U] = {0U};
+    uint32_t stack[HOST_TRACE_BENCH_NESTING];
+    uint32_t depth = 0U;
+    uint32_t errors = 0U;
+    uint32_t n;
+    uint32_t i;
+    uint32_t event;
+    uint32_t id;
+    uint32_t prev = 0U;
+    int32_t step;
+    int64_t now = 0;
+    int64_t last = 0;
+
+    n = (trace->head < TRACE_RECORDS) ? trace->head : TRACE_RECORDS;
+    errors += (trace->magic == TRACE_MAGIC) ? 0U : 1U;
+    for (i = trace->head - n; i != trace->head; i++)
+    {
+        const trace_record_t *record = &trace->ring[i & (TRACE_RECORDS - 1U)];
+
+        event = record->info & 0xFFU;
+        id = (record->info >> 8) & 0xFFU;
+        if (i != (trace->head - n))
+        {
+            step = (int32_t)(record->time - prev);
+            now += step;
+            errors += (step >= -HOST_TRACE_BENCH_STEP_BACK) ? 0U : 1U;
+        }
+        prev = record->time;
+        last = (now > last) ? now : last;
+
+        if ((event < TRACE_EVENT_SWITCH) || (event > TRACE_EVENT_NOTIFY_ISR))
+        {
+            errors++;
+            continue;
+        }
+        counts[event]++;
+        if (event == TRACE_EVENT_ISR_ENTER)
+        {
+            if (depth < HOST_TRACE_BENCH_NESTING)
+            {
+                stack[depth] = id;
+            }
+            depth++;
+        }
+        else if (event == TRACE_EVENT_ISR_EXIT)
+        {
+            /* the ring may have lost the enter when it wrapped */
+            if (((depth == 0U) && (n == trace->head)) ||
+                ((depth != 0U) && (depth <= HOST_TRACE_BENCH_NESTING) && (stack[depth - 1U] != id)))
+            {
+                errors++;
+            }
+            depth = (depth != 0U) ? (depth - 1U) : 0U;
+        }
+    }
+    errors += (depth == 0U) ? 0U : 1U;
+
+    printf("records,span_ms,switches,isrs,queue_ops,delays,notifies,errors\n");
+    printf("%u,%u,%u,%u,%u,%u,%u,%u\n", (unsigned int)n, (unsigned int)(last / 1000000),
+           (unsigned int)counts[TRACE_EVENT_SWITCH], (unsigned int)counts[TRACE_EVENT_ISR_ENTER],
+           (unsigned int)(counts[TRACE_EVENT_QUEUE_SEND] + counts[TRACE_EVENT_QUEUE_SEND_ISR] +
+                          counts[TRACE_EVENT_QUEUE_RECEIVE] + counts[TRACE_EVENT_QUEUE_RECEIVE_ISR]),
+           (unsigned int)counts[TRACE_EVENT_DELAY],
+           (unsigned int)(counts[TRACE_EVENT_NOTIFY] + counts[TRACE_EVENT_NOTIFY_ISR]), (unsigned int)errors);
+
+    /* the application tasks must have run and blocked */
+    errors += (counts[TRACE_EVENT_SWITCH] != 0U) ? 0U : 1U;
+    errors += (counts[TRACE_EVENT_DELAY] != 0U) ? 0U : 1U;
+    errors += (counts[TRACE_EVENT_ISR_ENTER] != 0U) ? 0U : 1U;
+    return errors;
+}
+
+static void host_trace_bench_cost(void)
+{
+    uint64_t clk = SystemCoreClock;
+    uint64_t sum = 0U;
+    uint32_t overhead = UINT32_MAX;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0U;
+    uint32_t t0;
+    uint32_t t1;
+    uint32_t delta;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0U; i < HOST_TRACE_BENCH_ITERATIONS; i++)
+    {
+        t0 = host_trace_bench_now();
+        t1 = host_trace_bench_now();
+        overhead = ((t1 - t0) < overhead) ? (t1 - t0) : overhead;
+    }
+    for (i = 0U; i < HOST_TRACE_BENCH_ITERATIONS; i++)
+    {
+        t0 = host_trace_bench_now();
+        for (j = 0U; j < HOST_TRACE_BENCH_BATCH; j++)
+        {
+            trace_record(TRACE_EVENT_QUEUE_SEND, 0U, j);
+        }
+        t1 = host_trace_bench_now();
+        delta = t1 - t0;
+        delta = ((delta > overhead) ? (delta - overhead) : 0U) / HOST_TRACE_BENCH_BATCH;
+        min = (delta < min) ? delta : min;
+        max = (delta > max) ? delta : max;
+        sum += delta;
+    }
+
+    printf("test,iterations,min_cycles,avg_cycles,max_cycles,min_ns,avg_ns,max_ns\n");
+    printf("trace_record,%u,%u,%u,%u,%u,%u,%u\n", (unsigned int)(HOST_TRACE_BENCH_ITERATIONS * HOST_TRACE_BENCH_BATCH),
+           (unsigned int)((min * clk) / 1000000000ULL),
+           (unsigned int)(((sum / HOST_TRACE_BENCH_ITERATIONS) * clk) / 1000000000ULL),
+           (unsigned int)((max * clk) / 1000000000ULL), (unsigned int)min,
+           (unsigned int)(sum / HOST_TRACE_BENCH_ITERATIONS), (unsigned int)max);
+}
+
+static void host_trace_bench_task(void *argument)
+{
+    uint32_t errors;
+
+    (void)argument;
+
+    vTaskDelay(HOST_TRACE_BENCH_TIME);
+    host_trace_bench_snapshot();
+    errors = host_trace_bench_check();
+    host_trace_bench_cost();
+
+    console_flush();
+    exit((errors == 0U) ? 0 : 1);
+}
+
+void host_trace_bench_start(void)
+{
+    (void)xTaskCreate(host_trace_bench_task, "tracebench", HOST_TRACE_BENCH_STACK_SIZE, NULL,
+                      tskIDLE_PRIORITY + 2U, NULL);
+}
@@ -0,0 +1,184 @@
+/**
+ ******************************************************************************
+ * @file           : host_uart.c
+ * @brief          : Behavioral model of USART1 for the host simulation
+ ******************************************************************************
+ * Transmitter only: TDR, the shift register and the TXE/TC flags.  A byte
+ * written to DR moves to the shift register as soon as it is free, TXE is set
+ * again at that moment and TC once the shift register runs empty.  The time a
+ * byte stays in the shift register is given by BRR, the word length and the
+ * stop bits, so the flags follow the configured baud rate.  With CR3.DMAT set
+ * TXE is a request to DMA1 channel 4, which refills TDR right away.
+ *
+ * DR is published with HOST_UART_DR_IDLE in its reserved upper half, the HAL
+ * always writes a value below 0x200 there, so a write can be told apart from
+ * the published value even when the same byte is sent twice.
+ ******************************************************************************
+ */
+#include <string.h>
+#include <unistd.h>
+
+#include "host_model.h"
+
+#define HOST_UART_DR_IDLE               0xFFFF0000U
+
+/* SR bits cleared by writing 0 */
+#define HOST_UART_SR_RC_W0              (USART_SR_CTS | USART_SR_LBD | USART_SR_TC | USART_SR_RXNE)
+
+static void (*host_uart_sink)(uint8_t byte);
+
+static uint32_t host_uart_sr;
+static uint32_t host_uart_tdr;
+static uint32_t host_uart_tdr_full;
+static uint32_t host_uart_shift;
+static uint32_t host_uart_shift_busy;
+static uint64_t host_uart_shift_end;
+
+void host_uart_set_tx_sink(void (*sink)(uint8_t byte))
+{
+    host_uart_sink = sink;
+}
+
+void host_uart_reset(void)
+{
+    memset(&host_usart1, 0, sizeof(host_usart1));
+    host_uart_sr = USART_SR_TXE | USART_SR_TC;
+    host_usart1.SR = host_uart_sr;
+    host_usart1.DR = HOST_UART_DR_IDLE;
+
+    host_uart_tdr_full = 0U;
+    host_uart_shift_busy = 0U;
+}
+
+/* Duration of one frame on the line: start bit, data bits and stop bits. */
+static uint64_t host_uart_byte_ns(void)
+{
+    /* CR2.STOP in half bits: 1, 0.5, 2, 1.5 */
+    static const uint32_t stop_half_bits[4] = {2U, 1U, 4U, 3U};
+    uint32_t half_bits;
+    uint32_t pclk = host_rcc_pclk2();
+    uint32_t brr = host_usart1.BRR & 0xFFFFU;
+
+    if ((pclk == 0U) || (brr == 0U))
+    {
+        return 0U;
+    }
+
+    half_bits = 2U * (1U + (((host_usart1.CR1 & USART_CR1_M) != 0U) ? 9U : 8U));
+    half_bits += stop_half_bits[(host_usart1.CR2 & USART_CR2_STOP) >> USART_CR2_STOP_Pos];
+
+    /* baud = PCLK2 / BRR */
+    return ((uint64_t)brr * half_bits * HOST_NS_PER_S) / (2ULL * pclk);
+}
+
+static void host_uart_emit(uint8_t byte)
+{
+    host_periph_stats.uart_tx_bytes++;
+
+    if (host_uart_sink != NULL)
+    {
+        host_uart_sink(byte);
+    }
+    else
+    {
+        (void)write(STDOUT_FILENO, &byte, 1U);
+    }
+}
+
+static void host_uart_load_shift(uint64_t t)
+{
+    host_uart_shift = host_uart_tdr;
+    host_uart_tdr_full = 0U;
+    host_uart_shift_busy = 1U;
+    host_uart_shift_end = t + host_uart_byte_ns();
+    host_uart_sr |= USART_SR_TXE;
+    host_uart_sr &= ~USART_SR_TC;
+}
+
+/* TXE raises the DMA request, the channel writes DR at once. */
+static void host_uart_dma_fill(void)
+{
+    uint32_t item;
+
+    if (((host_usart1.CR3 & USART_CR3_DMAT) != 0U) && (host_uart_tdr_full == 0U) &&
+        (host_dma_request(HOST_DMA_USART1_TX, &item) == 0))
+    {
+        host_uart_tdr = item & 0x1FFU;
+        host_uart_tdr_full = 1U;
+        host_uart_sr &= ~(USART_SR_TXE | USART_SR_TC);
+    }
+}
+
+uint64_t host_uart_update(uint64_t now)
+{
+    uint32_t enabled = ((host_usart1.CR1 & (USART_CR1_UE | USART_CR1_TE)) == (USART_CR1_UE | USART_CR1_TE)) ? 1U : 0U;
+    uint32_t sr = host_usart1.SR;
+    uint32_t dr = host_usart1.DR;
+
+    /* Flags the CPU cleared since the last sync, a flag the line sets
+     * afterwards stays set. */
+    if (sr != host_uart_sr)
+    {
+        host_uart_sr &= sr | ~HOST_UART_SR_RC_W0;
+    }
+
+    /* Advance the line up to now, then take the byte written since the last
+     * sync. */
+    while ((host_uart_shift_busy != 0U) && (host_uart_shift_end <= now))
+    {
+        host_uart_emit((uint8_t)host_uart_shift);
+        host_uart_shift_busy = 0U;
+
+        if (host_uart_tdr_full != 0U)
+        {
+            host_uart_load_shift(host_uart_shift_end);
+            host_uart_dma_fill();
+        }
+        else
+        {
+            host_uart_sr |= USART_SR_TC;
+        }
+    }
+
+    if ((dr & HOST_UART_DR_IDLE) != HOST_UART_DR_IDLE)
+    {
+        host_uart_sr &= ~USART_SR_TC;
+        if (enabled != 0U)
+        {
+            host_uart_tdr = dr & 0x1FFU;
+            host_uart_tdr_full = 1U;
+            host_uart_sr &= ~USART_SR_TXE;
+        }
+    }
+
+    if (enabled != 0U)
+    {
+        host_uart_dma_fill();
+    }
+    if ((host_uart_tdr_full != 0U) && (host_uart_shift_busy == 0U))
+    {
+        host_uart_load_shift(now);
+        host_uart_dma_fill();
+    }
+
+    host_usart1.SR = host_uart_sr;
+    host_usart1.DR = HOST_UART_DR_IDLE;
+
+    return (host_uart_shift_busy != 0U) ? host_uart_shift_end : HOST_TIME_NEVER;
+}
+
+uint32_t host_uart_causes(void)
+{
+    uint32_t cr1 = host_usart1.CR1;
+    uint32_t causes = 0U;
+
+    if (((cr1 & USART_CR1_TXEIE) != 0U) && ((host_uart_sr & USART_SR_TXE) != 0U))
+    {
+        causes |= USART_SR_TXE;
+    }
+    if (((cr1 & USART_CR1_TCIE) != 0U) && ((host_uart_sr & USART_SR_TC) != 0U))
+    {
+        causes |= USART_SR_TC;
+    }
+    return causes;
+}
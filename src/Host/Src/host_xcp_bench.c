@@ -0,0 +1,469 @@
+/**
+ ******************************************************************************
+ * @file           : host_xcp_bench.c
+ * @brief          : Host benchmark of the XCP on CAN slave (xcp.c)
+ ******************************************************************************
+ * The master injects its commands on XCP_CRO_ID as the other node of the CAN
+ * model and reads the answers and DTOs of XCP_DTO_ID from the TX listener.
+ *
+ * Commands: silence before CONNECT, the CONNECT answer, SHORT_UPLOAD and
+ * DOWNLOAD of a variable of this file, and the errors of an unknown command,
+ * too many lists, an ODT past 7 bytes (also by rewriting an entry ahead of
+ * others) and a write while DAQ runs.
+ *
+ * DAQ rows: one list of odts ODTs on XCP_EVENT_1MS; every ODT holds
+ * xcp_event_cycles[XCP_EVENT_1MS] (4 bytes) and 3 bytes of a constant
+ * pattern, so all ODTs of a cycle must carry the same cycle number and the
+ * cycle numbers go up by the prescaler.  A cycle is complete when all its
+ * ODTs arrived, incomplete when its burst was cut short (overloads, the TX
+ * queue was full), lost when none of it arrived.  reordered counts the ODTs
+ * that came after a higher PID or after the next cycle had begun, having
+ * lost the arbitration to a command of the master; mismatches the ODTs with
+ * a wrong pattern or cycle number, or twice.  dto_per_s and
+ * daq_bytes_per_s (7 per ODT) are over the model time of the row,
+ * bus_frames_per_s is the rate of a full bus with 8-byte frames.  The tick
+ * of the Posix port is slower than 1 ms on a loaded host, so the event rate
+ * is measured, not assumed; the cycles of a row must still be at least half
+ * its ticks, which a tickless idle that let the tick sleep would miss.
+ ******************************************************************************
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "printf.h"
+#include "console.h"
+#include "user.h"
+#include "xcp.h"
+#include "host_periph.h"
+#include "host_xcp_bench.h"
+
+#define HOST_XCP_BENCH_STACK_SIZE       256U
+#define HOST_XCP_BENCH_SETTLE           300U        /* ticks, start-up log */
+#define HOST_XCP_BENCH_ANSWER_TIME      100U        /* ticks */
+#define HOST_XCP_BENCH_SILENCE          20U         /* ticks */
+#define HOST_XCP_BENCH_TIME             500U        /* ticks per row */
+#define HOST_XCP_BENCH_DRAIN            20U         /* ticks */
+#define HOST_XCP_BENCH_ODT_BYTES        7U
+
+typedef struct
+{
+    const char *name;
+    uint32_t prescaler;
+    uint32_t bs1;
+    uint32_t bs2;
+    uint32_t tq;
+} host_xcp_bench_rate_t;
+
+typedef struct
+{
+    uint8_t odts;
+    uint8_t prescaler;
+} host_xcp_bench_run_t;
+
+/* PCLK1 = 36 MHz */
+static const host_xcp_bench_rate_t host_xcp_bench_rates[] = {
+    {"500k", 9U, CAN_BS1_3TQ, CAN_BS2_4TQ, 8U},
+    {"1M", 4U, CAN_BS1_6TQ, CAN_BS2_2TQ, 9U},
+};
+
+static const host_xcp_bench_run_t host_xcp_bench_runs[] = {
+    {1U, 1U}, {2U, 1U}, {3U, 1U}, {4U, 1U}, {6U, 1U}, {8U, 1U}, {16U, 1U}, {16U, 4U},
+};
+
+/* Sampled by the ODTs, 3 bytes each */
+static const uint8_t host_xcp_bench_pattern[XCP_ODT_MAX * 3U] = {
+    0x10U, 0x21U, 0x32U, 0x43U, 0x54U, 0x65U, 0x76U, 0x87U, 0x98U, 0xA9U, 0xBAU, 0xCBU,
+    0xDCU, 0xEDU, 0xFEU, 0x0FU, 0x11U, 0x22U, 0x33U, 0x44U, 0x55U, 0x66U, 0x77U, 0x88U,
+    0x99U, 0xAAU, 0xBBU, 0xCCU, 0xDDU, 0xEEU, 0xFFU, 0x01U, 0x12U, 0x23U, 0x34U, 0x45U,
+    0x56U, 0x67U, 0x78U, 0x89U, 0x9AU, 0xABU, 0xBCU, 0xCDU, 0xDEU, 0xEFU, 0xF0U, 0x02U,
+};
+
+/* Uploaded and downloaded */
+static volatile uint32_t host_xcp_bench_variable = 0x12345678U;
+
+/* Answers */
+static uint8_t host_xcp_bench_answer[8];
+static uint8_t host_xcp_bench_answer_len;
+static volatile uint32_t host_xcp_bench_answers;
+
+/* DAQ, followed by the listener: the cycle being received and the one
+ * before, which may still get an ODT that lost the arbitration */
+static uint32_t host_xcp_bench_odts;
+static uint32_t host_xcp_bench_prescaler;
+static uint32_t host_xcp_bench_cycle[2];
+static uint32_t host_xcp_bench_mask[2];     /* ODTs received, bit PID */
+static uint32_t host_xcp_bench_cycles;      /* valid entries of the two */
+static volatile uint32_t host_xcp_bench_dtos;
+static volatile uint32_t host_xcp_bench_complete;
+static volatile uint32_t host_xcp_bench_incomplete;
+static volatile uint32_t host_xcp_bench_lost;
+static volatile uint32_t host_xcp_bench_reordered;
+static volatile uint32_t host_xcp_bench_errors;
+static volatile uint64_t host_xcp_bench_first_ns;
+static volatile uint64_t host_xcp_bench_last_ns;
+
+static uint32_t host_xcp_bench_dword(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8U) | ((uint32_t)p[2] << 16U) | ((uint32_t)p[3] << 24U);
+}
+
+/* A cycle no more ODT can come for. */
+static void host_xcp_bench_close(uint32_t mask)
+{
+    if (mask == ((1UL << host_xcp_bench_odts) - 1U))
+    {
+        host_xcp_bench_complete++;
+    }
+    else
+    {
+        host_xcp_bench_incomplete++;
+    }
+}
+
+/* One DTO of the list: its PID (ODT number, the list starts at 0), pattern
+ * and cycle number. */
+static void host_xcp_bench_dto(const host_can_frame_t *frame, uint64_t end)
+{
+    const uint32_t pid = frame->data[0];
+    const uint32_t cycle = host_xcp_bench_dword(&frame->data[1]);
+    const uint32_t bit = 1UL << (pid & 31U);
+
+    host_xcp_bench_dtos++;
+    host_xcp_bench_last_ns = end;
+    if ((frame->dlc != (1U + HOST_XCP_BENCH_ODT_BYTES)) || (pid >= host_xcp_bench_odts)
+        || (memcmp(&frame->data[5], &host_xcp_bench_pattern[pid * 3U], 3U) != 0))
+    {
+        host_xcp_bench_errors++;
+    }
+    else if (host_xcp_bench_cycles == 0U)
+    {
+        host_xcp_bench_first_ns = end;
+        host_xcp_bench_cycle[0] = cycle;
+        host_xcp_bench_mask[0] = bit;
+        host_xcp_bench_cycles = 1U;
+    }
+    else if ((cycle == host_xcp_bench_cycle[0]) && ((host_xcp_bench_mask[0] & bit) == 0U))
+    {
+        /* after a higher PID: it lost the arbitration */
+        host_xcp_bench_reordered += ((host_xcp_bench_mask[0] >> pid) != 0U) ? 1U : 0U;
+        host_xcp_bench_mask[0] |= bit;
+    }
+    else if ((host_xcp_bench_cycles == 2U) && (cycle == host_xcp_bench_cycle[1])
+             && ((host_xcp_bench_mask[1] & bit) == 0U))
+    {
+        host_xcp_bench_reordered++;
+        host_xcp_bench_mask[1] |= bit;
+    }
+    else if ((cycle > host_xcp_bench_cycle[0]) && (((cycle - host_xcp_bench_cycle[0]) % host_xcp_bench_prescaler) == 0U))
+    {
+        if (host_xcp_bench_cycles == 2U)
+        {
+            host_xcp_bench_close(host_xcp_bench_mask[1]);
+        }
+        host_xcp_bench_lost += ((cycle - host_xcp_bench_cycle[0]) / host_xcp_bench_prescaler) - 1U;
+        host_xcp_bench_cycle[1] = host_xcp_bench_cycle[0];
+        host_xcp_bench_mask[1] = host_xcp_bench_mask[0];
+        host_xcp_bench_cycle[0] = cycle;
+        host_xcp_bench_mask[0] = bit;
+        host_xcp_bench_cycles = 2U;
+    }
+    else
+    {
+        /* twice the same ODT, a cycle number off the prescaler or too old */
+        host_xcp_bench_errors++;
+    }
+}
+
+static void host_xcp_bench_listener(const host_can_frame_t *frame, uint64_t start, uint64_t end)
+{
+    (void)start;
+    if ((frame->ide != 0U) || (frame->id != XCP_DTO_ID) || (frame->dlc == 0U))
+    {
+        return;
+    }
+    if (frame->data[0] >= 0xFEU)
+    {
+        memcpy(host_xcp_bench_answer, frame->data, 8U);
+        host_xcp_bench_answer_len = frame->dlc;
+        __atomic_add_fetch(&host_xcp_bench_answers, 1U, __ATOMIC_RELEASE);
+        return;
+    }
+    host_xcp_bench_dto(frame, end);
+}
+
+/* Sends a command, waits up to timeout ticks for its answer.  1 with the
+ * answer in host_xcp_bench_answer, 0 without one. */
+static uint32_t host_xcp_bench_send(const uint8_t *cmd, uint32_t len, uint32_t timeout)
+{
+    const uint32_t answers = __atomic_load_n(&host_xcp_bench_answers, __ATOMIC_ACQUIRE);
+    host_can_frame_t frame;
+    UBaseType_t mask;
+    uint32_t t;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.id = XCP_CRO_ID;
+    frame.dlc = (uint8_t)len;
+    memcpy(frame.data, cmd, len);
+    /* host_can_inject() wants the signals of the port blocked */
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    (void)host_can_inject(&frame);
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    for (t = 0U; (t < timeout) && (__atomic_load_n(&host_xcp_bench_answers, __ATOMIC_ACQUIRE) == answers); t++)
+    {
+        vTaskDelay(1U);
+    }
+    return (__atomic_load_n(&host_xcp_bench_answers, __ATOMIC_ACQUIRE) != answers) ? 1U : 0U;
+}
+
+/* A command that must succeed; 0 when it did. */
+static uint32_t host_xcp_bench_ok(const uint8_t *cmd, uint32_t len)
+{
+    if ((host_xcp_bench_send(cmd, len, HOST_XCP_BENCH_ANSWER_TIME) != 0U) && (host_xcp_bench_answer[0] == 0xFFU))
+    {
+        return 0U;
+    }
+    printf("command,failed,0x%02X\n", (unsigned int)cmd[0]);
+    return 1U;
+}
+
+/* A command that must fail with error; 0 when it did. */
+static uint32_t host_xcp_bench_error(const uint8_t *cmd, uint32_t len, uint8_t error)
+{
+    if ((host_xcp_bench_send(cmd, len, HOST_XCP_BENCH_ANSWER_TIME) != 0U) && (host_xcp_bench_answer[0] == 0xFEU)
+        && (host_xcp_bench_answer[1] == error))
+    {
+        return 0U;
+    }
+    printf("command,not refused,0x%02X\n", (unsigned int)cmd[0]);
+    return 1U;
+}
+
+static uint32_t host_xcp_bench_set_ptr(uint32_t odt)
+{
+    const uint8_t cmd[] = {0xE2U, 0U, 0U, 0U, (uint8_t)odt, 0U};
+
+    return host_xcp_bench_ok(cmd, sizeof(cmd));
+}
+
+/* WRITE_DAQ of size bytes at address */
+static uint32_t host_xcp_bench_write_daq(const volatile void *address, uint32_t size, uint8_t error)
+{
+    const uint32_t a = (uint32_t)(uintptr_t)address;
+    const uint8_t cmd[] = {0xE1U, 0xFFU, (uint8_t)size, 0U, (uint8_t)a, (uint8_t)(a >> 8U), (uint8_t)(a >> 16U),
+                           (uint8_t)(a >> 24U)};
+
+    return (error == 0U) ? host_xcp_bench_ok(cmd, sizeof(cmd)) : host_xcp_bench_error(cmd, sizeof(cmd), error);
+}
+
+/* One list of odts ODTs, not started. */
+static uint32_t host_xcp_bench_configure(uint32_t odts, uint32_t prescaler)
+{
+    const uint8_t free_daq[] = {0xD6U};
+    const uint8_t alloc_daq[] = {0xD5U, 0U, 1U, 0U};
+    const uint8_t alloc_odt[] = {0xD4U, 0U, 0U, 0U, (uint8_t)odts};
+    const uint8_t mode[] = {0xE0U, 0U, 0U, 0U, (uint8_t)XCP_EVENT_1MS, 0U, (uint8_t)prescaler, 0U};
+    uint8_t alloc_entry[] = {0xD3U, 0U, 0U, 0U, 0U, 2U};
+    uint32_t failed = 0U;
+    uint32_t i;
+
+    failed += host_xcp_bench_ok(free_daq, sizeof(free_daq));
+    failed += host_xcp_bench_ok(alloc_daq, sizeof(alloc_daq));
+    failed += host_xcp_bench_ok(alloc_odt, sizeof(alloc_odt));
+    for (i = 0U; i < odts; i++)
+    {
+        alloc_entry[4] = (uint8_t)i;
+        failed += host_xcp_bench_ok(alloc_entry, sizeof(alloc_entry));
+    }
+    for (i = 0U; i < odts; i++)
+    {
+        failed += host_xcp_bench_set_ptr(i);
+        failed += host_xcp_bench_write_daq(&xcp_event_cycles[XCP_EVENT_1MS], 4U, 0U);
+        failed += host_xcp_bench_write_daq(&host_xcp_bench_pattern[i * 3U], 3U, 0U);
+    }
+    failed += host_xcp_bench_ok(mode, sizeof(mode));
+    return failed;
+}
+
+static uint32_t host_xcp_bench_commands(void)
+{
+    const uint32_t a = (uint32_t)(uintptr_t)&host_xcp_bench_variable;
+    const uint8_t connect[] = {0xFFU, 0U};
+    const uint8_t status[] = {0xFDU};
+    const uint8_t upload[] = {0xF4U, 4U, 0U, 0U, (uint8_t)a, (uint8_t)(a >> 8U), (uint8_t)(a >> 16U),
+                              (uint8_t)(a >> 24U)};
+    const uint8_t mta[] = {0xF6U, 0U, 0U, 0U, (uint8_t)a, (uint8_t)(a >> 8U), (uint8_t)(a >> 16U),
+                           (uint8_t)(a >> 24U)};
+    const uint8_t download[] = {0xF0U, 4U, 0xEFU, 0xBEU, 0xADU, 0xDEU};
+    const uint8_t unknown[] = {0xC0U};
+    const uint8_t alloc_daq[] = {0xD5U, 0U, (uint8_t)(XCP_DAQ_MAX + 1U), 0U};
+    const uint8_t start[] = {0xDEU, 1U, 0U, 0U};
+    const uint8_t stop[] = {0xDEU, 0U, 0U, 0U};
+    const uint8_t free_daq[] = {0xD6U};
+    uint32_t failed = 0U;
+
+    /* not connected: no answer */
+    failed += host_xcp_bench_send(status, sizeof(status), HOST_XCP_BENCH_SILENCE);
+    failed += host_xcp_bench_ok(connect, sizeof(connect));
+    failed += ((host_xcp_bench_answer_len == 8U) && (host_xcp_bench_answer[1] == 0x05U)
+               && (host_xcp_bench_answer[3] == 8U) && (host_xcp_bench_answer[4] == 8U))
+                  ? 0U
+                  : 1U;
+    failed += host_xcp_bench_ok(upload, sizeof(upload));
+    failed += ((host_xcp_bench_answer_len == 5U) && (host_xcp_bench_dword(&host_xcp_bench_answer[1]) == 0x12345678U))
+                  ? 0U
+                  : 1U;
+    failed += host_xcp_bench_ok(mta, sizeof(mta));
+    failed += host_xcp_bench_ok(download, sizeof(download));
+    failed += (host_xcp_bench_variable == 0xDEADBEEFU) ? 0U : 1U;
+    failed += host_xcp_bench_error(unknown, sizeof(unknown), 0x20U);
+    failed += host_xcp_bench_ok(free_daq, sizeof(free_daq));
+    failed += host_xcp_bench_error(alloc_daq, sizeof(alloc_daq), 0x30U);
+
+    /* an ODT past 7 bytes; a change while DAQ runs */
+    failed += host_xcp_bench_configure(1U, 100U);
+    failed += host_xcp_bench_set_ptr(0U);
+    failed += host_xcp_bench_write_daq(&xcp_event_cycles[XCP_EVENT_1MS], 4U, 0U);
+    failed += host_xcp_bench_write_daq(&host_xcp_bench_variable, 4U, 0x22U);
+    /* the entries after the one written count as well: 1 + 6, then 7 + 6 */
+    failed += host_xcp_bench_set_ptr(0U);
+    failed += host_xcp_bench_write_daq(&host_xcp_bench_variable, 1U, 0U);
+    failed += host_xcp_bench_write_daq(&host_xcp_bench_pattern[0], 6U, 0U);
+    failed += host_xcp_bench_set_ptr(0U);
+    failed += host_xcp_bench_write_daq(&host_xcp_bench_pattern[0], 7U, 0x22U);
+    failed += host_xcp_bench_ok(start, sizeof(start));
+    failed += host_xcp_bench_error(free_daq, sizeof(free_daq), 0x11U);
+    failed += host_xcp_bench_ok(status, sizeof(status));
+    failed += (host_xcp_bench_answer[1] == 0x40U) ? 0U : 1U;
+    failed += host_xcp_bench_ok(stop, sizeof(stop));
+    printf("commands,%s\n", (failed == 0U) ? "ok" : "failed");
+    return failed;
+}
+
+/* Re-initialises CAN1, keeping its filters and interrupts. */
+static void host_xcp_bench_set_rate(const host_xcp_bench_rate_t *rate)
+{
+    (void)HAL_CAN_Stop(&hcan);
+    hcan.Init.Prescaler = rate->prescaler;
+    hcan.Init.TimeSeg1 = rate->bs1;
+    hcan.Init.TimeSeg2 = rate->bs2;
+    (void)HAL_CAN_Init(&hcan);
+    (void)HAL_CAN_Start(&hcan);
+}
+
+/* Runs one row and prints it.  Returns the number of failed checks, the
+ * rate of DTOs in dto_per_s and 1 in lossless when nothing was lost. */
+static uint32_t host_xcp_bench_run(const host_xcp_bench_rate_t *rate, const host_xcp_bench_run_t *run,
+                                   uint32_t *dto_per_s, uint32_t *lossless)
+{
+    const uint8_t select[] = {0xDEU, 2U, 0U, 0U};
+    const uint8_t start[] = {0xDDU, 1U};
+    const uint8_t stop[] = {0xDDU, 0U};
+    host_can_frame_t full;
+    uint32_t failed;
+    uint32_t overloads;
+    uint32_t cycles;
+    uint64_t frame_ns;
+    uint64_t ns;
+    uint32_t i;
+
+    failed = host_xcp_bench_configure(run->odts, run->prescaler);
+    host_xcp_bench_odts = run->odts;
+    host_xcp_bench_prescaler = run->prescaler;
+    host_xcp_bench_cycles = 0U;
+    host_xcp_bench_dtos = 0U;
+    host_xcp_bench_complete = 0U;
+    host_xcp_bench_incomplete = 0U;
+    host_xcp_bench_lost = 0U;
+    host_xcp_bench_reordered = 0U;
+    host_xcp_bench_errors = 0U;
+    overloads = xcp_overloads();
+    cycles = xcp_event_cycles[XCP_EVENT_1MS];
+
+    failed += host_xcp_bench_ok(select, sizeof(select));
+    failed += host_xcp_bench_ok(start, sizeof(start));
+    vTaskDelay(HOST_XCP_BENCH_TIME);
+    failed += host_xcp_bench_ok(stop, sizeof(stop));
+    vTaskDelay(HOST_XCP_BENCH_DRAIN);
+
+    for (i = host_xcp_bench_cycles; i > 0U; i--)
+    {
+        host_xcp_bench_close(host_xcp_bench_mask[i - 1U]);
+    }
+    overloads = xcp_overloads() - overloads;
+    cycles = xcp_event_cycles[XCP_EVENT_1MS] - cycles;
+    ns = host_xcp_bench_last_ns - host_xcp_bench_first_ns;
+    memset(&full, 0, sizeof(full));
+    full.dlc = 8U;
+    frame_ns = ((uint64_t)host_can_frame_bits(&full) * rate->prescaler * rate->tq * 1000U) / 36U;
+    *dto_per_s = (ns > 0U) ? (uint32_t)(((uint64_t)host_xcp_bench_dtos * 1000000000ULL) / ns) : 0U;
+    *lossless = ((overloads == 0U) && (host_xcp_bench_incomplete == 0U) && (host_xcp_bench_lost == 0U)) ? 1U : 0U;
+
+    printf("%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", rate->name, (unsigned int)run->odts, (unsigned int)run->prescaler,
+           (unsigned int)cycles, (unsigned int)host_xcp_bench_complete, (unsigned int)host_xcp_bench_incomplete,
+           (unsigned int)host_xcp_bench_lost, (unsigned int)overloads, (unsigned int)host_xcp_bench_reordered,
+           (unsigned int)host_xcp_bench_errors,
+           (unsigned int)*dto_per_s,
+           (unsigned int)(*dto_per_s * HOST_XCP_BENCH_ODT_BYTES), (unsigned int)(1000000000ULL / frame_ns));
+
+    /* consistent samples; a cycle is only cut short or lost by an overload */
+    failed += host_xcp_bench_errors;
+    failed += ((host_xcp_bench_complete > 0U)
+               && ((overloads != 0U) || ((host_xcp_bench_incomplete == 0U) && (host_xcp_bench_lost == 0U))))
+                  ? 0U
+                  : 1U;
+    /* the event runs at every tick interrupt of the row, also with
+     * USE_TICKLESS; a late interrupt takes the ticks passed with one */
+    failed += (cycles >= (HOST_XCP_BENCH_TIME / 2U)) ? 0U : 1U;
+    return failed;
+}
+
+static void host_xcp_bench_task(void *argument)
+{
+    const uint8_t disconnect[] = {0xFEU};
+    uint32_t failed = 0U;
+    uint32_t dto_per_s;
+    uint32_t lossless;
+    uint32_t best;
+    uint32_t best_rate;
+    uint32_t i;
+    uint32_t r;
+
+    (void)argument;
+
+    vTaskDelay(HOST_XCP_BENCH_SETTLE);
+    host_can_set_tx_listener(host_xcp_bench_listener);
+    failed += host_xcp_bench_commands();
+    printf("rate,odts,prescaler,cycles,complete,incomplete,lost,overloads,reordered,mismatches,dto_per_s,daq_bytes_per_s,bus_frames_per_s\n");
+    for (r = 0U; r < (sizeof(host_xcp_bench_rates) / sizeof(host_xcp_bench_rates[0])); r++)
+    {
+        host_xcp_bench_set_rate(&host_xcp_bench_rates[r]);
+        best = 0U;
+        best_rate = 0U;
+        for (i = 0U; i < (sizeof(host_xcp_bench_runs) / sizeof(host_xcp_bench_runs[0])); i++)
+        {
+            failed += host_xcp_bench_run(&host_xcp_bench_rates[r], &host_xcp_bench_runs[i], &dto_per_s, &lossless);
+            if ((lossless != 0U) && (host_xcp_bench_runs[i].prescaler == 1U) && (host_xcp_bench_runs[i].odts > best))
+            {
+                best = host_xcp_bench_runs[i].odts;
+                best_rate = dto_per_s;
+            }
+        }
+        printf("max,%s,%u,%u,%u\n", host_xcp_bench_rates[r].name, (unsigned int)best, (unsigned int)best_rate,
+               (unsigned int)(best_rate * HOST_XCP_BENCH_ODT_BYTES));
+        failed += (best != 0U) ? 0U : 1U;
+    }
+    failed += host_xcp_bench_ok(disconnect, sizeof(disconnect));
+    host_can_set_tx_listener(NULL);
+
+    console_flush();
+    exit((failed == 0U) ? 0 : 1);
+}
+
+void host_xcp_bench_start(void)
+{
+    (void)xTaskCreate(host_xcp_bench_task, "xcpbench", HOST_XCP_BENCH_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2U,
+                      NULL);
+}
@@ -0,0 +1,277 @@
+/**
+ ******************************************************************************
+ * @file           : binlog_decode.c
+ * @brief          : Turns a BINLOG stream back into text (Linux tool)
+ ******************************************************************************
+ * binlog_decode <elf> [log]
+ *
+ * Reads the format strings from the binlog_fmt section of the firmware ELF
+ * (32-bit ARM or the 64-bit host build), then the console stream from log or
+ * stdin.  A record is formatted with its format string, every other byte is
+ * copied as it is, so printf text in between comes out unchanged.
+ *
+ * The arguments are 32-bit: length modifiers are ignored, %s and %f print
+ * the raw word in hex.
+ ******************************************************************************
+ */
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BINLOG_SECTION                  "binlog_fmt"
+#define BINLOG_SYNC                     0xA5
+#define BINLOG_MAX_ARGS                 8U
+
+static char *binlog_fmts;
+static size_t binlog_fmts_size;
+
+static void *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    char *data;
+    long len;
+
+    if (f == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    (void)fseek(f, 0L, SEEK_END);
+    len = ftell(f);
+    (void)fseek(f, 0L, SEEK_SET);
+    data = malloc((size_t)len + 1U);
+    if ((data == NULL) || (fread(data, 1U, (size_t)len, f) != (size_t)len))
+    {
+        fprintf(stderr, "%s: read failed\n", path);
+        exit(1);
+    }
+    data[len] = '\0';
+    (void)fclose(f);
+    *size = (size_t)len;
+    return data;
+}
+
+/* Both ELF classes, little endian only like the Cortex-M3 and x86-64. */
+#define FIND_SECTION(Ehdr, Shdr)                                                                    \
+    do                                                                                              \
+    {                                                                                               \
+        const Ehdr *eh = (const Ehdr *)elf;                                                         \
+        const Shdr *sh = (const Shdr *)(elf + eh->e_shoff);                                        \
+        const char *names = elf + sh[eh->e_shstrndx].sh_offset;                                    \
+        unsigned int i;                                                                             \
+        for (i = 0U; i < eh->e_shnum; i++)                                                          \
+        {                                                                                           \
+            if (strcmp(&names[sh[i].sh_name], BINLOG_SECTION) == 0)                                 \
+            {                                                                                       \
+                *offset = sh[i].sh_offset;                                                          \
+                *len = sh[i].sh_size;                                                               \
+                return 0;                                                                           \
+            }                                                                                       \
+        }                                                                                           \
+    } while (0)
+
+static int find_section(const char *elf, size_t size, size_t *offset, size_t *len)
+{
+    if ((size < EI_NIDENT) || (memcmp(elf, ELFMAG, SELFMAG) != 0) || (elf[EI_DATA] != ELFDATA2LSB))
+    {
+        return -1;
+    }
+    if (elf[EI_CLASS] == ELFCLASS32)
+    {
+        FIND_SECTION(Elf32_Ehdr, Elf32_Shdr);
+    }
+    else if (elf[EI_CLASS] == ELFCLASS64)
+    {
+        FIND_SECTION(Elf64_Ehdr, Elf64_Shdr);
+    }
+    return -1;
+}
+
+static void load_formats(const char *path)
+{
+    size_t size;
+    size_t offset;
+    size_t len;
+    char *elf = read_file(path, &size);
+
+    if ((find_section(elf, size, &offset, &len) != 0) || ((offset + len) > size))
+    {
+        fprintf(stderr, "%s: no " BINLOG_SECTION " section\n", path);
+        exit(1);
+    }
+    binlog_fmts = malloc(len + 1U);
+    memcpy(binlog_fmts, &elf[offset], len);
+    binlog_fmts[len] = '\0';
+    binlog_fmts_size = len;
+    free(elf);
+}
+
+static int read_number(FILE *in, uint32_t *value)
+{
+    uint32_t shift = 0U;
+    int c;
+
+    *value = 0U;
+    do
+    {
+        c = getc(in);
+        if (c == EOF)
+        {
+            return -1;
+        }
+        if (shift < 32U)
+        {
+            *value |= (uint32_t)(c & 0x7F) << shift;
+        }
+        shift += 7U;
+    } while ((c & 0x80) != 0);
+    return 0;
+}
+
+/* printf with one conversion at a time, each taking a 32-bit word. */
+static void print_record(const char *fmt, const uint32_t *args, uint32_t nargs)
+{
+    char spec[32];
+    uint32_t next = 0U;
+    size_t n;
+    char conv;
+
+    while (*fmt != '\0')
+    {
+        if (*fmt != '%')
+        {
+            putchar(*fmt++);
+            continue;
+        }
+        if (fmt[1] == '%')
+        {
+            putchar('%');
+            fmt += 2;
+            continue;
+        }
+
+        /* flags, width, precision; '*' takes an argument */
+        n = 0U;
+        spec[n++] = *fmt++;
+        while ((*fmt != '\0') && (strchr("-+ #0123456789.*", *fmt) != NULL) && (n < (sizeof(spec) - 4U)))
+        {
+            if (*fmt == '*')
+            {
+                n += (size_t)snprintf(&spec[n], sizeof(spec) - n, "%d",
+                                      (next < nargs) ? (int32_t)args[next] : 0);
+                next++;
+                fmt++;
+                continue;
+            }
+            spec[n++] = *fmt++;
+        }
+        while ((*fmt != '\0') && (strchr("hlLjzt", *fmt) != NULL))
+        {
+            fmt++;
+        }
+        conv = *fmt;
+        if (conv == '\0')
+        {
+            break;
+        }
+        fmt++;
+
+        if (next >= nargs)
+        {
+            printf("<?>");
+            continue;
+        }
+        spec[n++] = conv;
+        spec[n] = '\0';
+        switch (conv)
+        {
+        case 'd':
+        case 'i':
+        case 'c':
+            printf(spec, (int)(int32_t)args[next]);
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            printf(spec, (unsigned int)args[next]);
+            break;
+        case 'p':
+            printf("0x%08x", (unsigned int)args[next]);
+            break;
+        default:
+            printf("<%%%c 0x%08x>", conv, (unsigned int)args[next]);
+            break;
+        }
+        next++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    uint32_t args[BINLOG_MAX_ARGS];
+    uint32_t id;
+    uint32_t nargs;
+    uint32_t i;
+    int c;
+
+    if ((argc < 2) || (argc > 3))
+    {
+        fprintf(stderr, "usage: %s <elf> [log]\n", argv[0]);
+        return 2;
+    }
+    load_formats(argv[1]);
+    if (argc == 3)
+    {
+        in = fopen(argv[2], "rb");
+        if (in == NULL)
+        {
+            perror(argv[2]);
+            return 1;
+        }
+    }
+
+    while ((c = getc(in)) != EOF)
+    {
+        if (c != BINLOG_SYNC)
+        {
+            putchar(c);
+            if (c == '\n')
+            {
+                (void)fflush(stdout);
+            }
+            continue;
+        }
+        if ((read_number(in, &id) != 0) || (read_number(in, &nargs) != 0))
+        {
+            break;
+        }
+        if (nargs > BINLOG_MAX_ARGS)
+        {
+            printf("<bad record id %u, %u args>\n", (unsigned int)id, (unsigned int)nargs);
+            continue;
+        }
+        for (i = 0U; i < nargs; i++)
+        {
+            if (read_number(in, &args[i]) != 0)
+            {
+                break;
+            }
+        }
+        if (i < nargs)
+        {
+            break;
+        }
+        if (id >= binlog_fmts_size)
+        {
+            printf("<unknown id %u>\n", (unsigned int)id);
+            continue;
+        }
+        print_record(&binlog_fmts[id], args, nargs);
+        (void)fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,320 @@
+/**
+ ******************************************************************************
+ * @file           : can_dbc_check.cpp
+ * @brief          : Host check and benchmark of the dbc_gen headers (Linux tool)
+ ******************************************************************************
+ * Runs the messages of Core/Inc/user_dbc.h and of can_dbc_test.h, made by
+ * dbc_gen from Host/Tools/can_dbc_test.dbc (Intel and Motorola signals,
+ * signed, across the 32-bit words, 64 bits wide, short DLC, no signal),
+ * against a reference that walks the DBC bit numbering one bit at a time.
+ * For CHECK_ROUNDS random messages and payloads each:
+ *
+ *  - pack() of random signals equals the reference, unpack() gives them back;
+ *  - unpack() of a random payload equals the reference signal by signal, and
+ *    pack() of that gives the payload back, bits of no signal cleared;
+ *  - every get() and set() equals the reference.
+ *
+ * Then the time of pack() and unpack() against the reference, in the
+ * messages of its layout, CHECK_SAMPLES payloads in turn:
+ *
+ *   message,signals,pack_ns,unpack_ns,ref_pack_ns,ref_unpack_ns
+ *   round_trips,<count>
+ *   mismatches,<count>
+ *
+ * It also folds a few messages with static_assert, so it does not build when
+ * the functions are not constexpr.
+ ******************************************************************************
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "user_dbc.h"
+#include "can_dbc_test.h"
+
+#define CHECK_ROUNDS                    200000U
+#define CHECK_SAMPLES                   256U
+#define CHECK_ITERATIONS                4000U       /* times CHECK_SAMPLES */
+
+typedef struct
+{
+    uint32_t start;
+    uint32_t length;
+    uint32_t motorola;
+    uint32_t is_signed;
+} check_signal_t;
+
+/* compile time: user.c's test frame, a Motorola signal, sign extension */
+static constexpr user_test_t check_const_test = {0x12U, 1U, 3U, 0x89ABCDEFU};
+static_assert(user_test_pack(&check_const_test) == 0x89ABCDEF00030112ULL, "user_test_pack");
+
+static constexpr uint64_t check_const_big_word(uint16_t value)
+{
+    return motorola_mix_big_word_set(0U, value);
+}
+static_assert(check_const_big_word(0x1234U) == 0x3412U, "Motorola byte order");
+
+static constexpr int8_t check_const_temperature(uint64_t payload)
+{
+    node_status_t msg = {};
+
+    node_status_unpack(&msg, payload);
+    return msg.temperature;
+}
+static_assert(check_const_temperature(0x000000F600000000ULL) == -10, "sign extension");
+
+static uint64_t check_state = 0x9E3779B97F4A7C15ULL;
+static volatile uint64_t check_sink;
+
+static uint64_t check_random(void)
+{
+    check_state ^= check_state << 13U;
+    check_state ^= check_state >> 7U;
+    check_state ^= check_state << 17U;
+    return check_state;
+}
+
+static uint64_t check_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/* The payload bit of DBC bit position pos is bit pos of the word. */
+static uint64_t check_ref_put(uint64_t payload, const check_signal_t *sig, uint64_t raw)
+{
+    uint32_t pos = sig->start;
+    uint32_t i;
+
+    for (i = 0U; i < sig->length; i++)
+    {
+        /* Intel: LSB first, upwards; Motorola: MSB first, down each byte and
+         * on to the top of the next */
+        const uint32_t bit = (sig->motorola != 0U) ? (sig->length - 1U - i) : i;
+
+        payload = (payload & ~(1ULL << pos)) | (((raw >> bit) & 1U) << pos);
+        if (sig->motorola == 0U)
+        {
+            pos++;
+        }
+        else
+        {
+            pos = ((pos % 8U) == 0U) ? (pos + 15U) : (pos - 1U);
+        }
+    }
+    return payload;
+}
+
+/* Sign extended to 64 bits for a signed signal. */
+static uint64_t check_ref_get(uint64_t payload, const check_signal_t *sig)
+{
+    uint64_t raw = 0U;
+    uint32_t pos = sig->start;
+    uint32_t i;
+
+    for (i = 0U; i < sig->length; i++)
+    {
+        const uint32_t bit = (sig->motorola != 0U) ? (sig->length - 1U - i) : i;
+
+        raw |= ((payload >> pos) & 1U) << bit;
+        if (sig->motorola == 0U)
+        {
+            pos++;
+        }
+        else
+        {
+            pos = ((pos % 8U) == 0U) ? (pos + 15U) : (pos - 1U);
+        }
+    }
+    if ((sig->is_signed != 0U) && (sig->length < 64U) && (((raw >> (sig->length - 1U)) & 1U) != 0U))
+    {
+        raw |= ~0ULL << sig->length;
+    }
+    return raw;
+}
+
+/* A raw value that fits the signal, sign extended. */
+static uint64_t check_random_raw(const check_signal_t *sig)
+{
+    check_signal_t low = {0U, sig->length, 0U, sig->is_signed};
+
+    return check_ref_get(check_random() >> (check_random() & 63U), &low);
+}
+
+static uint64_t check_ref_pack(const check_signal_t *sigs, uint32_t count, const uint64_t raw[])
+{
+    uint64_t payload = 0U;
+    uint32_t i;
+
+    for (i = 0U; i < count; i++)
+    {
+        payload = check_ref_put(payload, &sigs[i], raw[i]);
+    }
+    return payload;
+}
+
+static void check_ref_unpack(const check_signal_t *sigs, uint32_t count, uint64_t payload, uint64_t raw[])
+{
+    uint32_t i;
+
+    for (i = 0U; i < count; i++)
+    {
+        raw[i] = check_ref_get(payload, &sigs[i]);
+    }
+}
+
+static uint32_t check_mismatch(const char *message, const char *what, uint64_t value, uint64_t ref)
+{
+    if (value == ref)
+    {
+        return 0U;
+    }
+    fprintf(stdout, "mismatch,%s,%s,%016llx,%016llx\n", message, what, (unsigned long long)value,
+            (unsigned long long)ref);
+    return 1U;
+}
+
+static void check_report(const char *message, uint32_t signals, uint64_t pack, uint64_t unpack, uint64_t ref_pack,
+                         uint64_t ref_unpack)
+{
+    const double calls = (double)CHECK_ITERATIONS * CHECK_SAMPLES;
+
+    fprintf(stdout, "%s,%u,%.2f,%.2f,%.2f,%.2f\n", message, (unsigned int)signals, (double)pack / calls,
+            (double)unpack / calls, (double)ref_pack / calls, (double)ref_unpack / calls);
+}
+
+/* The signal table of a message, with an end entry so that it is never
+ * empty. */
+#define CHECK_TABLE(message, signal, start, length, motorola, is_signed) {start, length, motorola, is_signed},
+#define CHECK_FILL(message, signal, start, length, motorola, is_signed)                                    \
+    raw[n] = check_random_raw(&sigs[n]);                                                                    \
+    msg.signal = (decltype(msg.signal))raw[n];                                                              \
+    n++;
+#define CHECK_FIELDS(message, signal, start, length, motorola, is_signed)                                  \
+    mismatches += check_mismatch(#message, #signal, (uint64_t)msg.signal, raw[n]);                         \
+    n++;
+#define CHECK_ACCESS(message, signal, start, length, motorola, is_signed)                                  \
+    mismatches += check_mismatch(#message, #signal "_get", (uint64_t)message##_##signal##_get(payload),      \
+                                 check_ref_get(payload, &sigs[n]));                                         \
+    raw[n] = check_random_raw(&sigs[n]);                                                                    \
+    mismatches += check_mismatch(#message, #signal "_set",                                                   \
+                                 message##_##signal##_set(payload, (decltype(msg.signal))raw[n]),          \
+                                 check_ref_put(payload, &sigs[n], raw[n]));                                 \
+    n++;
+#define CHECK_SUM(message, signal, start, length, motorola, is_signed) sum += (uint64_t)msg.signal;
+
+#define CHECK_MESSAGE(message, MESSAGE)                                                                     \
+    static uint32_t check_##message(void)                                                                   \
+    {                                                                                                       \
+        static const check_signal_t sigs[] = {MESSAGE##_SIGNALS(CHECK_TABLE){0U, 0U, 0U, 0U}};            \
+        const uint32_t count = (sizeof(sigs) / sizeof(sigs[0])) - 1U;                                       \
+        static message##_t msgs[CHECK_SAMPLES];                                                             \
+        static uint64_t payloads[CHECK_SAMPLES];                                                            \
+        uint64_t raw[(sizeof(sigs) / sizeof(sigs[0]))] = {};                                                \
+        uint32_t mismatches = 0U;                                                                           \
+        uint64_t used;                                                                                      \
+        uint64_t payload;                                                                                   \
+        uint64_t sum = 0U;                                                                                  \
+        uint64_t t[5];                                                                                      \
+        message##_t msg = {};                                                                               \
+        uint32_t round;                                                                                     \
+        uint32_t n;                                                                                         \
+        uint32_t i;                                                                                         \
+                                                                                                            \
+        for (n = 0U; n < count; n++)                                                                        \
+        {                                                                                                   \
+            raw[n] = ~0ULL;                                                                                 \
+        }                                                                                                   \
+        used = check_ref_pack(sigs, count, raw);                                                            \
+        for (round = 0U; round < CHECK_ROUNDS; round++)                                                     \
+        {                                                                                                   \
+            n = 0U;                                                                                         \
+            MESSAGE##_SIGNALS(CHECK_FILL)                                                                   \
+            payload = message##_pack(&msg);                                                                 \
+            mismatches += check_mismatch(#message, "pack", payload, check_ref_pack(sigs, count, raw));      \
+            msg = {};                                                                                       \
+            message##_unpack(&msg, payload);                                                                \
+            n = 0U;                                                                                         \
+            MESSAGE##_SIGNALS(CHECK_FIELDS)                                                                 \
+                                                                                                            \
+            payload = check_random();                                                                       \
+            message##_unpack(&msg, payload);                                                                \
+            check_ref_unpack(sigs, count, payload, raw);                                                    \
+            n = 0U;                                                                                         \
+            MESSAGE##_SIGNALS(CHECK_FIELDS)                                                                 \
+            mismatches += check_mismatch(#message, "round trip", message##_pack(&msg), payload & used);     \
+            n = 0U;                                                                                         \
+            MESSAGE##_SIGNALS(CHECK_ACCESS)                                                                 \
+        }                                                                                                   \
+                                                                                                            \
+        for (i = 0U; i < CHECK_SAMPLES; i++)                                                                \
+        {                                                                                                   \
+            payloads[i] = check_random() & used;                                                            \
+            message##_unpack(&msgs[i], payloads[i]);                                                        \
+        }                                                                                                   \
+        t[0] = check_now();                                                                                 \
+        for (round = 0U; round < CHECK_ITERATIONS; round++)                                                 \
+        {                                                                                                   \
+            for (i = 0U; i < CHECK_SAMPLES; i++)                                                            \
+            {                                                                                               \
+                sum += message##_pack(&msgs[i]);                                                            \
+            }                                                                                               \
+            check_sink = sum;                                                                               \
+        }                                                                                                   \
+        t[1] = check_now();                                                                                 \
+        for (round = 0U; round < CHECK_ITERATIONS; round++)                                                 \
+        {                                                                                                   \
+            for (i = 0U; i < CHECK_SAMPLES; i++)                                                            \
+            {                                                                                               \
+                message##_unpack(&msg, payloads[i]);                                                        \
+                MESSAGE##_SIGNALS(CHECK_SUM)                                                                \
+            }                                                                                               \
+            check_sink = sum;                                                                               \
+        }                                                                                                   \
+        t[2] = check_now();                                                                                 \
+        for (round = 0U; round < CHECK_ITERATIONS; round++)                                                 \
+        {                                                                                                   \
+            for (i = 0U; i < CHECK_SAMPLES; i++)                                                            \
+            {                                                                                               \
+                check_ref_unpack(sigs, count, payloads[i] ^ round, raw);                                   \
+                sum += check_ref_pack(sigs, count, raw);                                                    \
+            }                                                                                               \
+            check_sink = sum;                                                                               \
+        }                                                                                                   \
+        t[3] = check_now();                                                                                 \
+        for (round = 0U; round < CHECK_ITERATIONS; round++)                                                 \
+        {                                                                                                   \
+            for (i = 0U; i < CHECK_SAMPLES; i++)                                                            \
+            {                                                                                               \
+                check_ref_unpack(sigs, count, payloads[i] ^ round, raw);                                   \
+                sum += raw[0];                                                                              \
+            }                                                                                               \
+            check_sink = sum;                                                                               \
+        }                                                                                                   \
+        t[4] = check_now();                                                                                 \
+        /* the reference pack is timed with an unpack in front */                                          \
+        check_report(#message, count, t[1] - t[0], t[2] - t[1],                                             \
+                     ((t[3] - t[2]) > (t[4] - t[3])) ? ((t[3] - t[2]) - (t[4] - t[3])) : 0U, t[4] - t[3]);  \
+        return mismatches;                                                                                  \
+    }
+
+USER_DBC_MESSAGES(CHECK_MESSAGE)
+CAN_DBC_TEST_MESSAGES(CHECK_MESSAGE)
+
+#define CHECK_RUN(message, MESSAGE) mismatches += check_##message();
+#define CHECK_COUNT(message, MESSAGE) +1U
+
+int main(void)
+{
+    uint32_t mismatches = 0U;
+
+    fprintf(stdout, "message,signals,pack_ns,unpack_ns,ref_pack_ns,ref_unpack_ns\n");
+    USER_DBC_MESSAGES(CHECK_RUN)
+    CAN_DBC_TEST_MESSAGES(CHECK_RUN)
+    fprintf(stdout, "round_trips,%u\n",
+            (unsigned int)(CHECK_ROUNDS * 2U * (0U USER_DBC_MESSAGES(CHECK_COUNT) CAN_DBC_TEST_MESSAGES(CHECK_COUNT))));
+    fprintf(stdout, "mismatches,%u\n", (unsigned int)mismatches);
+    return (mismatches == 0U) ? 0 : 1;
+}
@@ -0,0 +1,331 @@
+/**
+ ******************************************************************************
+ * @file           : can_dispatch_bench.c
+ * @brief          : Host benchmark of Core/Src/can_dispatch.c (Linux tool)
+ ******************************************************************************
+ * can_dispatch_bench
+ *
+ * 120 ranges of standard identifiers, 237 identifiers in all, below 0x400 to
+ * FIFO 0 and the others to FIFO 1, are planned over the 14 filter banks and
+ * programmed through HAL_CAN_ConfigFilter() into a CAN_TypeDef in memory.
+ * They need far more than 14 banks as they are, so most of them end up in
+ * merged mask filters with a hash.
+ *
+ * Random frames, nine in ten subscribed, go through those registers with a
+ * matcher that numbers the filters like RM0008 does; the accepted ones get
+ * their FIFO and filter match index as in can_rx_frame_t.  Then each frame is
+ * looked up three ways:
+ *
+ *  - linear:  the ranges in order until one holds the identifier;
+ *  - switch:  a switch with a case range per range, as the compiler lays it
+ *             out (jump tables and compare trees);
+ *  - fmi:     can_dispatch_route(), from the FIFO and FMI.
+ *
+ * All three must give the same range for every frame, and the frames of a
+ * range must come in its FIFO, or the program returns 1.  It prints the plan
+ * and the time per lookup:
+ *
+ *   ranges,ids,filters,banks_used,hashes,hash_slots,frames,rejected,false_accepts
+ *   lookup,frames,ns_per_frame
+ ******************************************************************************
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "main.h"
+#include "can_filter.h"
+#include "can_dispatch.h"
+
+#define BENCH_FRAMES                    (1UL << 20U)
+#define BENCH_ROUNDS                    20U
+
+/* first and last identifier of each range, in order */
+#define BENCH_ROUTES(X) \
+    X(0x031U, 0x031U) X(0x05CU, 0x05CU) X(0x080U, 0x08FU) X(0x099U, 0x099U) \
+    X(0x0A0U, 0x0A0U) X(0x0BEU, 0x0BEU) X(0x0C5U, 0x0C5U) X(0x0CBU, 0x0CBU) \
+    X(0x0EDU, 0x0EDU) X(0x0F1U, 0x0F1U) X(0x0F2U, 0x0F2U) X(0x0F4U, 0x0F4U) \
+    X(0x0F8U, 0x0F8U) X(0x0FDU, 0x0FDU) X(0x101U, 0x101U) X(0x10AU, 0x10AU) \
+    X(0x119U, 0x119U) X(0x11EU, 0x11EU) X(0x128U, 0x128U) X(0x12BU, 0x12BU) \
+    X(0x13DU, 0x13DU) X(0x14AU, 0x14AU) X(0x14FU, 0x14FU) X(0x153U, 0x153U) \
+    X(0x160U, 0x160U) X(0x173U, 0x173U) X(0x17FU, 0x17FU) X(0x181U, 0x181U) \
+    X(0x18FU, 0x18FU) X(0x1A6U, 0x1A6U) X(0x1DFU, 0x1DFU) X(0x1E2U, 0x1E2U) \
+    X(0x1E3U, 0x1E3U) X(0x1FBU, 0x1FBU) X(0x200U, 0x207U) X(0x211U, 0x211U) \
+    X(0x221U, 0x221U) X(0x230U, 0x230U) X(0x24EU, 0x24EU) X(0x269U, 0x269U) \
+    X(0x26AU, 0x26AU) X(0x26BU, 0x26BU) X(0x26EU, 0x26EU) X(0x2A3U, 0x2A3U) \
+    X(0x2A9U, 0x2A9U) X(0x2B0U, 0x2B0U) X(0x2C0U, 0x2DFU) X(0x2E0U, 0x2E0U) \
+    X(0x2E4U, 0x2E4U) X(0x2EAU, 0x2EAU) X(0x301U, 0x301U) X(0x34BU, 0x34BU) \
+    X(0x36FU, 0x36FU) X(0x37DU, 0x37DU) X(0x389U, 0x389U) X(0x392U, 0x392U) \
+    X(0x3B1U, 0x3B1U) X(0x3B6U, 0x3B6U) X(0x3BBU, 0x3BBU) X(0x3D9U, 0x3D9U) \
+    X(0x3E7U, 0x3E7U) X(0x3F6U, 0x3F6U) X(0x3F9U, 0x3F9U) X(0x420U, 0x42BU) \
+    X(0x434U, 0x434U) X(0x451U, 0x451U) X(0x472U, 0x472U) X(0x474U, 0x474U) \
+    X(0x482U, 0x482U) X(0x48DU, 0x48DU) X(0x499U, 0x499U) X(0x49BU, 0x49BU) \
+    X(0x4A2U, 0x4A2U) X(0x4CBU, 0x4CBU) X(0x4CDU, 0x4CDU) X(0x4EFU, 0x4EFU) \
+    X(0x4F4U, 0x4F4U) X(0x505U, 0x505U) X(0x506U, 0x506U) X(0x52EU, 0x52EU) \
+    X(0x571U, 0x571U) X(0x579U, 0x579U) X(0x57EU, 0x57EU) X(0x58DU, 0x58DU) \
+    X(0x59AU, 0x59AU) X(0x5A0U, 0x5B3U) X(0x5BDU, 0x5BDU) X(0x5C9U, 0x5C9U) \
+    X(0x5D9U, 0x5D9U) X(0x5F5U, 0x5F5U) X(0x610U, 0x617U) X(0x62CU, 0x62CU) \
+    X(0x641U, 0x641U) X(0x651U, 0x651U) X(0x658U, 0x658U) X(0x65DU, 0x65DU) \
+    X(0x66DU, 0x66DU) X(0x6A5U, 0x6A5U) X(0x6B0U, 0x6B0U) X(0x6B4U, 0x6B4U) \
+    X(0x6BFU, 0x6BFU) X(0x6CAU, 0x6CAU) X(0x6D7U, 0x6D7U) X(0x6E3U, 0x6E3U) \
+    X(0x6F0U, 0x6F0U) X(0x700U, 0x717U) X(0x721U, 0x721U) X(0x72EU, 0x72EU) \
+    X(0x72FU, 0x72FU) X(0x740U, 0x740U) X(0x74CU, 0x74CU) X(0x763U, 0x763U) \
+    X(0x773U, 0x773U) X(0x795U, 0x795U) X(0x7C0U, 0x7C4U) X(0x7D2U, 0x7D2U) \
+    X(0x7E6U, 0x7E6U) X(0x7EBU, 0x7EBU) X(0x7F1U, 0x7F1U) X(0x7F2U, 0x7F2U)
+
+enum
+{
+#define X(first, last) BENCH_ROUTE_##first,
+    BENCH_ROUTES(X)
+#undef X
+    BENCH_ROUTE_COUNT
+};
+
+static const can_filter_range_t bench_ranges[] = {
+#define X(first, last) {(first), (last), 0U, ((first) < 0x400U) ? CAN_RX_FIFO0 : CAN_RX_FIFO1},
+    BENCH_ROUTES(X)
+#undef X
+};
+
+static can_dispatch_handler_t bench_handlers[BENCH_ROUTE_COUNT];
+static can_filter_plan_t bench_plan;
+static can_dispatch_t bench_table;
+static CAN_TypeDef bench_can;
+static CAN_HandleTypeDef bench_hcan;
+static can_rx_frame_t bench_frames[BENCH_FRAMES];
+
+uint32_t HAL_GetTick(void)
+{
+    return 0U;
+}
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/* RM0008 filter match on the registers for a standard data frame: 1 with the
+ * FIFO and the filter match index when accepted. */
+static uint32_t bench_registers(uint32_t id, uint32_t *fifo, uint32_t *fmi)
+{
+    const uint32_t word = id << 21U;
+    const uint32_t half = id << 5U;
+    uint32_t number[2] = {0U, 0U};
+    uint32_t best = 4U;
+    uint32_t b;
+    uint32_t f;
+    uint32_t fr1;
+    uint32_t fr2;
+    uint32_t scale32;
+    uint32_t list;
+    uint32_t rank;
+    uint32_t hit;
+
+    for (b = 0U; b < CAN_FILTER_BANKS; b++)
+    {
+        f = (bench_can.FFA1R >> b) & 1U;
+        scale32 = (bench_can.FS1R >> b) & 1U;
+        list = (bench_can.FM1R >> b) & 1U;
+        rank = ((scale32 != 0U) ? 0U : 2U) + ((list != 0U) ? 0U : 1U);
+        fr1 = bench_can.sFilterRegister[b].FR1;
+        fr2 = bench_can.sFilterRegister[b].FR2;
+        hit = 4U;
+        if (((bench_can.FA1R >> b) & 1U) == 0U)
+        {
+            /* inactive, it still takes its numbers */
+        }
+        else if ((scale32 != 0U) && (list == 0U))
+        {
+            hit = (((word ^ fr1) & fr2 & ~1U) == 0U) ? 0U : 4U;
+        }
+        else if (scale32 != 0U)
+        {
+            hit = (((word ^ fr1) & ~1U) == 0U) ? 0U : ((((word ^ fr2) & ~1U) == 0U) ? 1U : 4U);
+        }
+        else if (list == 0U)
+        {
+            hit = (((half ^ fr1) & (fr1 >> 16U) & 0xFFFFU) == 0U) ? 0U
+                  : ((((half ^ fr2) & (fr2 >> 16U) & 0xFFFFU) == 0U) ? 1U : 4U);
+        }
+        else
+        {
+            hit = (half == (fr1 & 0xFFFFU)) ? 0U
+                  : (half == (fr1 >> 16U)) ? 1U
+                  : (half == (fr2 & 0xFFFFU)) ? 2U
+                  : (half == (fr2 >> 16U)) ? 3U : 4U;
+        }
+        if ((hit < 4U) && (rank < best))
+        {
+            best = rank;
+            *fifo = f;
+            *fmi = number[f] + hit;
+        }
+        number[f] += (scale32 != 0U) ? ((list != 0U) ? 2U : 1U) : ((list != 0U) ? 4U : 2U);
+    }
+    return (best < 4U) ? 1U : 0U;
+}
+
+static __attribute__((noinline)) uint32_t bench_linear(const can_rx_frame_t *frame)
+{
+    uint32_t i;
+
+    for (i = 0U; i < BENCH_ROUTE_COUNT; i++)
+    {
+        if ((bench_ranges[i].ide == frame->ide) && (bench_ranges[i].first <= frame->id)
+            && (frame->id <= bench_ranges[i].last))
+        {
+            return i;
+        }
+    }
+    return CAN_DISPATCH_NONE;
+}
+
+static __attribute__((noinline)) uint32_t bench_switch(const can_rx_frame_t *frame)
+{
+    if (frame->ide != 0U)
+    {
+        return CAN_DISPATCH_NONE;
+    }
+    switch (frame->id)
+    {
+#define X(first, last) \
+    case (first)...(last): \
+        return BENCH_ROUTE_##first;
+        BENCH_ROUTES(X)
+#undef X
+    default:
+        return CAN_DISPATCH_NONE;
+    }
+}
+
+static __attribute__((noinline)) uint32_t bench_fmi(const can_rx_frame_t *frame)
+{
+    return can_dispatch_route(&bench_table, frame);
+}
+
+static void bench_time(const char *name, uint32_t (*lookup)(const can_rx_frame_t *frame))
+{
+    volatile uint32_t sink;
+    uint64_t start;
+    uint64_t sum = 0U;
+    uint32_t r;
+    uint32_t i;
+
+    start = bench_now_ns();
+    for (r = 0U; r < BENCH_ROUNDS; r++)
+    {
+        for (i = 0U; i < BENCH_FRAMES; i++)
+        {
+            sum += lookup(&bench_frames[i]);
+        }
+    }
+    sink = (uint32_t)sum;
+    (void)sink;
+    (void)printf("%s,%lu,%.2f\n", name, BENCH_FRAMES,
+                 (double)(bench_now_ns() - start) / ((double)BENCH_FRAMES * BENCH_ROUNDS));
+}
+
+int main(void)
+{
+    uint32_t seed = 1U;
+    uint32_t rejected = 0U;
+    uint32_t false_accepts = 0U;
+    uint32_t failed = 0U;
+    uint32_t ids = 0U;
+    uint32_t n = 0U;
+    uint32_t route;
+    uint32_t fifo = 0U;
+    uint32_t fmi = 0U;
+    uint32_t id;
+    uint32_t i;
+
+    if (can_filter_plan(bench_ranges, BENCH_ROUTE_COUNT, CAN_FILTER_BANKS, &bench_plan) != HAL_OK)
+    {
+        (void)fprintf(stderr, "can_filter_plan() failed\n");
+        return 1;
+    }
+    if (can_dispatch_init(&bench_table, &bench_plan, bench_ranges, bench_handlers, BENCH_ROUTE_COUNT) != HAL_OK)
+    {
+        (void)fprintf(stderr, "can_dispatch_init() failed, %u hashes, %u slots\n", bench_table.hashes,
+                      bench_table.hash_used);
+        return 1;
+    }
+    bench_hcan.Instance = &bench_can;
+    bench_hcan.State = HAL_CAN_STATE_READY;
+    if (can_filter_program(&bench_hcan, &bench_plan) != HAL_OK)
+    {
+        (void)fprintf(stderr, "can_filter_program() failed\n");
+        return 1;
+    }
+
+    while (n < BENCH_FRAMES)
+    {
+        seed = seed * 1664525U + 1013904223U;
+        if (((seed >> 8U) % 10U) != 0U)
+        {
+            route = (seed >> 12U) % BENCH_ROUTE_COUNT;
+            id = bench_ranges[route].first + ((seed >> 20U) % (bench_ranges[route].last - bench_ranges[route].first + 1U));
+        }
+        else
+        {
+            id = (seed >> 16U) & 0x7FFU;
+        }
+        if (bench_registers(id, &fifo, &fmi) == 0U)
+        {
+            rejected++;
+            continue;
+        }
+        (void)memset(&bench_frames[n], 0, sizeof(bench_frames[n]));
+        bench_frames[n].id = id;
+        bench_frames[n].fifo = (uint8_t)fifo;
+        bench_frames[n].filter = (uint8_t)fmi;
+        n++;
+    }
+
+    for (i = 0U; i < BENCH_FRAMES; i++)
+    {
+        route = bench_linear(&bench_frames[i]);
+        if (route == CAN_DISPATCH_NONE)
+        {
+            false_accepts++;
+        }
+        else if (bench_frames[i].fifo != bench_ranges[route].fifo)
+        {
+            failed++;
+        }
+        if ((bench_switch(&bench_frames[i]) != route) || (bench_fmi(&bench_frames[i]) != route))
+        {
+            if (failed < 10U)
+            {
+                (void)fprintf(stderr, "id 0x%03X fifo %u fmi %u: linear %u switch %u fmi %u\n",
+                              (unsigned int)bench_frames[i].id, bench_frames[i].fifo, bench_frames[i].filter,
+                              (unsigned int)route, (unsigned int)bench_switch(&bench_frames[i]),
+                              (unsigned int)bench_fmi(&bench_frames[i]));
+            }
+            failed++;
+        }
+    }
+    for (i = 0U; i < BENCH_ROUTE_COUNT; i++)
+    {
+        ids += bench_ranges[i].last - bench_ranges[i].first + 1U;
+    }
+
+    (void)printf("ranges,ids,filters,banks_used,hashes,hash_slots,frames,rejected,false_accepts\n");
+    (void)printf("%u,%u,%u,%u,%u,%u,%lu,%u,%u\n", (unsigned int)BENCH_ROUTE_COUNT, ids, bench_plan.entry_count,
+                 bench_plan.bank_count, bench_table.hashes, bench_table.hash_used, BENCH_FRAMES, rejected, false_accepts);
+    (void)printf("lookup,frames,ns_per_frame\n");
+    bench_time("linear", bench_linear);
+    bench_time("switch", bench_switch);
+    bench_time("fmi", bench_fmi);
+    if (failed != 0U)
+    {
+        (void)fprintf(stderr, "%u frames failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,459 @@
+/**
+ ******************************************************************************
+ * @file           : can_filter_check.c
+ * @brief          : Host check of Core/Src/can_filter.c (Linux tool)
+ ******************************************************************************
+ * can_filter_check [-b banks] [range...]
+ *
+ * Plans identifier sets with can_filter_plan(), programs the plan through the
+ * real HAL_CAN_ConfigFilter() into a CAN_TypeDef in memory, and runs frames
+ * through those registers with a matcher of its own that follows RM0008.
+ * For every plan:
+ *
+ *  - every subscribed identifier must be accepted, into its FIFO;
+ *  - the plan must fit the banks given;
+ *  - can_filter_match() must agree with the registers, over all standard
+ *    identifiers and a sample of extended ones;
+ *  - with enough banks for one filter per block, nothing else gets through.
+ *
+ * Then it prints one line per plan:
+ *
+ *   set,banks,ranges,ids,filters,banks_used,false_accepts,false_rate
+ *
+ * false_accepts is the plan's count of identifiers accepted outside the
+ * ranges, false_rate the same per identifier of the IDE spaces in use that is
+ * not subscribed.  Standard identifiers are also counted one by one through
+ * the registers; the count must not be above the plan's.
+ *
+ * Without ranges it runs the built-in sets over 14 down to 1 banks, then
+ * CHECK_RANDOM_SETS random ones without printing them, and returns 1 on a
+ * failed check.  With ranges, [x]first[-last][/fifo] in hex, x
+ * for extended, it reports that set for -b banks (default 14).
+ ******************************************************************************
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "can_filter.h"
+
+#define CHECK_EXT_SAMPLES               200000U
+#define CHECK_MAX_RANGES                16U
+#define CHECK_RANDOM_SETS               300U
+
+typedef struct
+{
+    const char *name;
+    uint32_t count;
+    can_filter_range_t ranges[CHECK_MAX_RANGES];
+} check_set_t;
+
+static const check_set_t check_sets[] = {
+    /* user_can_set_rx_filer(): the bench traffic, one range per FIFO */
+    {"user", 2U, {{0x100U, 0x1FFU, 0U, 0U}, {0x500U, 0x5FFU, 0U, 1U}}},
+    /* OBD-II requests and responses, a few broadcast identifiers */
+    {"obd",
+     6U,
+     {{0x7DFU, 0x7DFU, 0U, 0U},
+      {0x7E0U, 0x7E7U, 0U, 0U},
+      {0x7E8U, 0x7EFU, 0U, 1U},
+      {0x123U, 0x123U, 0U, 1U},
+      {0x2A5U, 0x2A5U, 0U, 1U},
+      {0x3F0U, 0x3F3U, 0U, 1U}}},
+    /* uneven ranges: many blocks each */
+    {"uneven",
+     4U,
+     {{0x011U, 0x02EU, 0U, 0U}, {0x135U, 0x149U, 0U, 0U}, {0x203U, 0x20AU, 0U, 1U}, {0x6F1U, 0x701U, 0U, 1U}}},
+    /* J1939 on extended identifiers next to standard ones */
+    {"j1939",
+     7U,
+     {{0x18FEF100U, 0x18FEF1FFU, 1U, 0U},
+      {0x18FECA00U, 0x18FECA00U, 1U, 0U},
+      {0x0CF00400U, 0x0CF00400U, 1U, 0U},
+      {0x18DA00F1U, 0x18DA00F1U, 1U, 1U},
+      {0x18DAF100U, 0x18DAF1FFU, 1U, 1U},
+      {0x100U, 0x10FU, 0U, 0U},
+      {0x7DFU, 0x7DFU, 0U, 1U}}},
+    /* scattered single identifiers */
+    {"scatter",
+     14U,
+     {{0x080U, 0x080U, 0U, 0U},
+      {0x0A1U, 0x0A1U, 0U, 0U},
+      {0x0B3U, 0x0B3U, 0U, 0U},
+      {0x111U, 0x111U, 0U, 0U},
+      {0x1C4U, 0x1C4U, 0U, 0U},
+      {0x245U, 0x245U, 0U, 0U},
+      {0x2F0U, 0x2F0U, 0U, 0U},
+      {0x321U, 0x321U, 0U, 0U},
+      {0x3AAU, 0x3AAU, 0U, 0U},
+      {0x402U, 0x402U, 0U, 0U},
+      {0x4E7U, 0x4E7U, 0U, 0U},
+      {0x512U, 0x512U, 0U, 0U},
+      {0x613U, 0x613U, 0U, 0U},
+      {0x77CU, 0x77CU, 0U, 0U}}},
+};
+
+static CAN_TypeDef check_can;
+static CAN_HandleTypeDef check_hcan;
+static uint32_t check_failed;
+static uint32_t check_samples = CHECK_EXT_SAMPLES;
+static uint32_t check_quiet;
+static uint32_t check_unplanned;
+
+uint32_t HAL_GetTick(void)
+{
+    return 0U;
+}
+
+static void check_fail(const char *set, uint32_t banks, const char *what, uint32_t id, uint32_t ide)
+{
+    if (check_failed < 20U)
+    {
+        (void)fprintf(stderr, "%s/%u: %s, %s id 0x%X\n", set, banks, what, (ide != 0U) ? "ext" : "std", id);
+    }
+    check_failed++;
+}
+
+/* RM0008 filter match on the registers, data frames: 1 and the FIFO when
+ * accepted. */
+static uint32_t check_registers(uint32_t id, uint32_t ide, uint32_t *fifo)
+{
+    const uint32_t word = (ide != 0U) ? ((id << 3U) | 4U) : (id << 21U);
+    const uint32_t half = (ide != 0U) ? (((id >> 18U) << 5U) | 8U | ((id >> 15U) & 7U)) : (id << 5U);
+    uint32_t best = 4U;
+    uint32_t rank;
+    uint32_t hit;
+    uint32_t b;
+    uint32_t fr1;
+    uint32_t fr2;
+    uint32_t s;
+    uint32_t list;
+    uint32_t half_id[4];
+    uint32_t half_mask[4];
+
+    for (b = 0U; b < CAN_FILTER_BANKS; b++)
+    {
+        if ((check_can.FA1R & (1UL << b)) == 0U)
+        {
+            continue;
+        }
+        fr1 = check_can.sFilterRegister[b].FR1;
+        fr2 = check_can.sFilterRegister[b].FR2;
+        list = (check_can.FM1R >> b) & 1U;
+        hit = 0U;
+        if (((check_can.FS1R >> b) & 1U) != 0U)
+        {
+            rank = (list != 0U) ? 0U : 1U;
+            hit = (list != 0U) ? ((((word ^ fr1) & ~1U) == 0U) || (((word ^ fr2) & ~1U) == 0U))
+                               : (((word ^ fr1) & fr2 & ~1U) == 0U);
+        }
+        else
+        {
+            rank = (list != 0U) ? 2U : 3U;
+            if (list != 0U)
+            {
+                /* four identifiers: FR1 low, FR1 high, FR2 low, FR2 high */
+                half_id[0] = fr1 & 0xFFFFU;
+                half_id[1] = fr1 >> 16U;
+                half_id[2] = fr2 & 0xFFFFU;
+                half_id[3] = fr2 >> 16U;
+                for (s = 0U; s < 4U; s++)
+                {
+                    hit |= (half == half_id[s]) ? 1U : 0U;
+                }
+            }
+            else
+            {
+                /* two identifier/mask pairs, identifier in the low half */
+                half_id[0] = fr1 & 0xFFFFU;
+                half_mask[0] = fr1 >> 16U;
+                half_id[1] = fr2 & 0xFFFFU;
+                half_mask[1] = fr2 >> 16U;
+                for (s = 0U; s < 2U; s++)
+                {
+                    hit |= (((half ^ half_id[s]) & half_mask[s]) == 0U) ? 1U : 0U;
+                }
+            }
+        }
+        if ((hit != 0U) && (rank < best))
+        {
+            best = rank;
+            *fifo = (check_can.FFA1R >> b) & 1U;
+        }
+    }
+    return (best < 4U) ? 1U : 0U;
+}
+
+static uint32_t check_subscribed(const check_set_t *set, uint32_t id, uint32_t ide, uint32_t *fifo)
+{
+    uint32_t i;
+
+    for (i = 0U; i < set->count; i++)
+    {
+        if ((set->ranges[i].ide == ide) && (set->ranges[i].first <= id) && (id <= set->ranges[i].last))
+        {
+            *fifo = set->ranges[i].fifo;
+            return 1U;
+        }
+    }
+    return 0U;
+}
+
+/* One identifier through the registers and can_filter_match(); returns the
+ * register verdict. */
+static uint32_t check_one(const check_set_t *set, uint32_t banks, const can_filter_plan_t *plan, uint32_t id,
+                          uint32_t ide)
+{
+    uint32_t fifo = 2U;
+    uint32_t plan_fifo = 2U;
+    uint32_t want;
+    uint32_t hit = check_registers(id, ide, &fifo);
+
+    if ((can_filter_match(plan, id, ide, &plan_fifo) != hit) || ((hit != 0U) && (plan_fifo != fifo)))
+    {
+        check_fail(set->name, banks, "can_filter_match() differs from the registers", id, ide);
+    }
+    if (check_subscribed(set, id, ide, &want) != 0U)
+    {
+        if (hit == 0U)
+        {
+            check_fail(set->name, banks, "subscribed identifier dropped", id, ide);
+        }
+        else if (fifo != want)
+        {
+            check_fail(set->name, banks, "subscribed identifier in the wrong FIFO", id, ide);
+        }
+        return 0U;
+    }
+    return hit;
+}
+
+/* Banks the set takes with one filter per aligned block, no merging. */
+static uint32_t check_unmerged_banks(const check_set_t *set)
+{
+    /* [fifo][ide][block]: filters per bank, 16-bit list, 16-bit mask,
+     * 32-bit list, 32-bit mask */
+    static const uint32_t per_bank[2][2] = {{4U, 2U}, {2U, 1U}};
+    uint32_t n[2][2][2] = {{{0U}}};
+    uint32_t banks = 0U;
+    uint64_t first;
+    uint64_t size;
+    uint32_t i;
+    uint32_t f;
+    uint32_t e;
+    uint32_t k;
+
+    for (i = 0U; i < set->count; i++)
+    {
+        first = set->ranges[i].first;
+        while (first <= set->ranges[i].last)
+        {
+            size = 1U;
+            while (((first % (size * 2U)) == 0U) && ((first + size * 2U - 1U) <= set->ranges[i].last)
+                   && (size < 0x20000000U))
+            {
+                size *= 2U;
+            }
+            n[set->ranges[i].fifo][set->ranges[i].ide][(size > 1U) ? 1U : 0U]++;
+            first += size;
+        }
+    }
+    for (f = 0U; f < 2U; f++)
+    {
+        for (e = 0U; e < 2U; e++)
+        {
+            for (k = 0U; k < 2U; k++)
+            {
+                banks += (n[f][e][k] + per_bank[e][k] - 1U) / per_bank[e][k];
+            }
+        }
+    }
+    return banks;
+}
+
+static void check_set(const check_set_t *set, uint32_t banks)
+{
+    static can_filter_plan_t plan;
+    uint64_t ids[2] = {0U, 0U};
+    uint64_t space;
+    uint32_t measured = 0U;
+    uint32_t i;
+    uint32_t id;
+    uint32_t seed = 1U;
+
+    if (can_filter_plan(set->ranges, set->count, banks, &plan) != HAL_OK)
+    {
+        check_unplanned++;
+        if (check_quiet == 0U)
+        {
+            (void)printf("%s,%u,%u,,,,plan failed,\n", set->name, banks, set->count);
+        }
+        return;
+    }
+    (void)memset(&check_can, 0, sizeof(check_can));
+    check_hcan.Instance = &check_can;
+    check_hcan.State = HAL_CAN_STATE_READY;
+    if (can_filter_program(&check_hcan, &plan) != HAL_OK)
+    {
+        check_fail(set->name, banks, "can_filter_program() failed", 0U, 0U);
+        return;
+    }
+    if (plan.bank_count > banks)
+    {
+        check_fail(set->name, banks, "plan does not fit the banks", plan.bank_count, 0U);
+    }
+
+    for (id = 0U; id <= 0x7FFU; id++)
+    {
+        measured += check_one(set, banks, &plan, id, 0U);
+    }
+    for (i = 0U; i < set->count; i++)
+    {
+        ids[set->ranges[i].ide] += (uint64_t)set->ranges[i].last - set->ranges[i].first + 1U;
+        if (set->ranges[i].ide != 0U)
+        {
+            for (id = set->ranges[i].first; id <= set->ranges[i].last; id++)
+            {
+                (void)check_one(set, banks, &plan, id, 1U);
+            }
+        }
+    }
+    for (i = 0U; i < check_samples; i++)
+    {
+        seed = seed * 1664525U + 1013904223U;
+        (void)check_one(set, banks, &plan, seed & 0x1FFFFFFFU, 1U);
+    }
+
+    if (measured > plan.false_accepts)
+    {
+        check_fail(set->name, banks, "more standard false accepts than planned", measured, 0U);
+    }
+    if ((check_unmerged_banks(set) <= banks) && ((plan.false_accepts != 0U) || (measured != 0U)))
+    {
+        check_fail(set->name, banks, "false accepts with room for a filter per block", measured, 0U);
+    }
+
+    if (check_quiet != 0U)
+    {
+        return;
+    }
+    space = ((ids[0] != 0U) ? (0x800U - ids[0]) : 0U) + ((ids[1] != 0U) ? (0x20000000U - ids[1]) : 0U);
+    (void)printf("%s,%u,%u,%llu,%u,%u,%llu,%.6f\n", set->name, banks, set->count,
+                 (unsigned long long)(ids[0] + ids[1]), plan.entry_count, plan.bank_count,
+                 (unsigned long long)plan.false_accepts, (space != 0U) ? ((double)plan.false_accepts / (double)space) : 0.0);
+}
+
+/* Ranges in random order that do not overlap: cut from a random walk over the
+ * identifiers of each IDE. */
+static void check_random(check_set_t *set, uint32_t n)
+{
+    static uint32_t seed = 12345U;
+    uint32_t next[2] = {0U, 0U};
+    uint32_t ide;
+    uint32_t i;
+
+    set->name = "random";
+    set->count = 1U + (n % 8U);
+    next[1] = 0x18000000U;
+    for (i = 0U; i < set->count; i++)
+    {
+        seed = seed * 1103515245U + 12345U;
+        ide = (((seed >> 16U) % 4U) == 0U) ? 1U : 0U;
+        next[ide] += (seed >> 8U) % ((ide != 0U) ? 0x4000U : 0xC0U);
+        set->ranges[i].ide = (uint8_t)ide;
+        set->ranges[i].first = next[ide];
+        seed = seed * 1103515245U + 12345U;
+        next[ide] += (((seed >> 16U) % 3U) == 0U) ? 0U : ((seed >> 8U) % 64U);
+        set->ranges[i].last = next[ide];
+        set->ranges[i].fifo = (uint8_t)((seed >> 4U) & 1U);
+        next[ide]++;
+        if (next[0] > 0x7FFU)
+        {
+            set->count = i;
+            return;
+        }
+    }
+}
+
+/* [x]first[-last][/fifo], hex */
+static uint32_t check_parse(const char *arg, can_filter_range_t *range)
+{
+    char *end;
+
+    range->ide = (arg[0] == 'x') ? 1U : 0U;
+    arg += range->ide;
+    range->first = (uint32_t)strtoul(arg, &end, 16);
+    range->last = range->first;
+    range->fifo = 0U;
+    if (end == arg)
+    {
+        return 0U;
+    }
+    if (*end == '-')
+    {
+        arg = end + 1;
+        range->last = (uint32_t)strtoul(arg, &end, 16);
+    }
+    if (*end == '/')
+    {
+        range->fifo = (uint8_t)strtoul(end + 1, &end, 10);
+    }
+    return (*end == '\0') ? 1U : 0U;
+}
+
+int main(int argc, char **argv)
+{
+    static check_set_t arg_set = {"args", 0U, {{0U}}};
+    uint32_t banks = CAN_FILTER_BANKS;
+    uint32_t s;
+    uint32_t b;
+    int a = 1;
+
+    if ((argc > 2) && (strcmp(argv[1], "-b") == 0))
+    {
+        banks = (uint32_t)strtoul(argv[2], NULL, 10);
+        a = 3;
+    }
+
+    (void)printf("set,banks,ranges,ids,filters,banks_used,false_accepts,false_rate\n");
+    if (a < argc)
+    {
+        for (; (a < argc) && (arg_set.count < CHECK_MAX_RANGES); a++)
+        {
+            if (check_parse(argv[a], &arg_set.ranges[arg_set.count]) == 0U)
+            {
+                (void)fprintf(stderr, "bad range %s\n", argv[a]);
+                return 1;
+            }
+            arg_set.count++;
+        }
+        check_set(&arg_set, banks);
+        return (check_failed != 0U) ? 1 : 0;
+    }
+
+    for (s = 0U; s < (sizeof(check_sets) / sizeof(check_sets[0])); s++)
+    {
+        for (b = CAN_FILTER_BANKS; b > 0U; b--)
+        {
+            check_set(&check_sets[s], b);
+        }
+    }
+
+    /* random sets: up to 8 ranges of up to 64 identifiers, mostly standard */
+    check_quiet = 1U;
+    check_samples = CHECK_EXT_SAMPLES / 20U;
+    check_unplanned = 0U;
+    for (s = 0U; s < CHECK_RANDOM_SETS; s++)
+    {
+        check_random(&arg_set, s);
+        for (b = CAN_FILTER_BANKS; b > 0U; b--)
+        {
+            check_set(&arg_set, b);
+        }
+    }
+    (void)fprintf(stderr, "%u random sets, %u plans failed, %u failed checks\n", CHECK_RANDOM_SETS, check_unplanned,
+                  check_failed);
+    return (check_failed != 0U) ? 1 : 0;
+}
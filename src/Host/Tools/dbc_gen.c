@@ -0,0 +1,549 @@
+/**
+ ******************************************************************************
+ * @file           : dbc_gen.c
+ * @brief          : CAN signal header generator from a DBC file (Linux tool)
+ ******************************************************************************
+ * dbc_gen <dbc> <header>
+ *
+ * Reads the messages (BO_) and their signals (SG_) of a DBC file and writes a
+ * header for them, on top of Core/Inc/can_dbc.h.  For a message FOO_BAR:
+ *
+ *  - FOO_BAR_ID, FOO_BAR_IDE and FOO_BAR_DLC;
+ *  - foo_bar_t, one field per signal with its raw value, in the smallest
+ *    integer type that holds it, signed for the signed signals;
+ *  - foo_bar_pack(&msg) and foo_bar_unpack(&msg, payload), between the
+ *    struct and the 64-bit payload word (see can_dbc.h);
+ *  - foo_bar_<signal>_get(payload) and foo_bar_<signal>_set(payload, value)
+ *    for a single signal.
+ *
+ * Factor, offset, range and unit go into the comment of each field: the
+ * values are raw and pack keeps the low bits of a value too wide for its
+ * signal.  The header also has the layout of every signal as X-macros,
+ * <HEADER>_MESSAGES(X) and FOO_BAR_SIGNALS(S), for checks that need it.
+ *
+ * Everything else in the file (nodes, comments, value tables, attributes) is
+ * ignored.  Multiplexed signals, signals outside the DLC and overlapping
+ * signals are errors: the header is not written and dbc_gen returns 1.
+ ******************************************************************************
+ */
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DBC_MAX_MESSAGES                256U
+#define DBC_MAX_SIGNALS                 64U
+#define DBC_NAME_SIZE                   64U
+#define DBC_TEXT_SIZE                   32U
+#define DBC_LINE_SIZE                   1024U
+#define DBC_EXT_FLAG                    0x80000000UL
+
+typedef struct
+{
+    char name[DBC_NAME_SIZE];
+    uint32_t start;                     /* as in the DBC */
+    uint32_t length;
+    uint32_t motorola;
+    uint32_t is_signed;
+    uint32_t shift;                     /* of the LSB, in the word it is in */
+    uint64_t mask;                      /* length bits, not shifted */
+    char factor[DBC_TEXT_SIZE];
+    char offset[DBC_TEXT_SIZE];
+    char min[DBC_TEXT_SIZE];
+    char max[DBC_TEXT_SIZE];
+    char unit[DBC_TEXT_SIZE];
+} dbc_signal_t;
+
+typedef struct
+{
+    char name[DBC_NAME_SIZE];
+    char sender[DBC_NAME_SIZE];
+    uint32_t id;
+    uint32_t ide;
+    uint32_t dlc;
+    uint32_t count;
+    uint64_t used;                      /* payload bits taken, byte 0 in bits 0 to 7 */
+    dbc_signal_t signals[DBC_MAX_SIGNALS];
+} dbc_message_t;
+
+static dbc_message_t dbc_messages[DBC_MAX_MESSAGES];
+static uint32_t dbc_count;
+static const char *dbc_path;
+static uint32_t dbc_line;
+
+static void dbc_error(const char *what)
+{
+    fprintf(stderr, "%s:%u: %s\n", dbc_path, (unsigned int)dbc_line, what);
+    exit(1);
+}
+
+/* TxPending and TX_PENDING both to tx_pending */
+static void dbc_lower(char *out, const char *in)
+{
+    const char *first = in;
+
+    while (*in != '\0')
+    {
+        if ((in != first) && (isupper((unsigned char)in[0]) != 0)
+            && ((islower((unsigned char)in[-1]) != 0) || (isdigit((unsigned char)in[-1]) != 0)))
+        {
+            *out++ = '_';
+        }
+        *out++ = (char)tolower((unsigned char)*in++);
+    }
+    *out = '\0';
+}
+
+static void dbc_upper(char *out, const char *in)
+{
+    dbc_lower(out, in);
+    while (*out != '\0')
+    {
+        *out = (char)toupper((unsigned char)*out);
+        out++;
+    }
+}
+
+/* BO_ <id> <name>: <dlc> <sender> */
+static void dbc_parse_message(const char *line)
+{
+    dbc_message_t *msg;
+    unsigned long id;
+    unsigned int dlc;
+
+    if (dbc_count == DBC_MAX_MESSAGES)
+    {
+        dbc_error("too many messages");
+    }
+    msg = &dbc_messages[dbc_count];
+    memset(msg, 0, sizeof(*msg));
+    if (sscanf(line, "BO_ %lu %63[^: ] : %u %63s", &id, msg->name, &dlc, msg->sender) < 3)
+    {
+        dbc_error("bad BO_ line");
+    }
+    if (dlc > 8U)
+    {
+        dbc_error("DLC above 8");
+    }
+    msg->ide = ((id & DBC_EXT_FLAG) != 0U) ? 1U : 0U;
+    msg->id = (uint32_t)(id & ~DBC_EXT_FLAG);
+    msg->dlc = dlc;
+    if (msg->id > ((msg->ide != 0U) ? 0x1FFFFFFFUL : 0x7FFUL))
+    {
+        dbc_error("identifier out of range");
+    }
+    dbc_count++;
+}
+
+/* SG_ <name> : <start>|<length>@<order><sign> (<factor>,<offset>) [<min>|<max>] "<unit>" <receivers> */
+static void dbc_parse_signal(const char *line)
+{
+    dbc_message_t *msg;
+    dbc_signal_t *sig;
+    char colon[DBC_NAME_SIZE];
+    unsigned int start;
+    unsigned int length;
+    char order;
+    char sign;
+    const char *unit;
+    const char *end;
+    uint32_t msb;
+    uint64_t bits;
+
+    if (dbc_count == 0U)
+    {
+        dbc_error("SG_ outside a message");
+    }
+    msg = &dbc_messages[dbc_count - 1U];
+    if (msg->count == DBC_MAX_SIGNALS)
+    {
+        dbc_error("too many signals");
+    }
+    sig = &msg->signals[msg->count];
+    memset(sig, 0, sizeof(*sig));
+    if ((sscanf(line, " SG_ %63s %63s", sig->name, colon) != 2) || (strcmp(colon, ":") != 0))
+    {
+        dbc_error("multiplexed signals are not supported");
+    }
+    line = strchr(line, ':') + 1;
+    if (sscanf(line, " %u|%u@%c%c (%31[^,],%31[^)]) [%31[^|]|%31[^]]]", &start, &length, &order, &sign,
+               sig->factor, sig->offset, sig->min, sig->max) != 8)
+    {
+        dbc_error("bad SG_ line");
+    }
+    unit = strchr(line, '"');
+    end = (unit != NULL) ? strchr(unit + 1, '"') : NULL;
+    if ((end != NULL) && ((size_t)(end - unit - 1) < DBC_TEXT_SIZE))
+    {
+        memcpy(sig->unit, unit + 1, (size_t)(end - unit - 1));
+    }
+    if ((length == 0U) || (length > 64U) || (start > 63U) || ((order != '0') && (order != '1'))
+        || ((sign != '+') && (sign != '-')))
+    {
+        dbc_error("bad signal layout");
+    }
+    sig->start = start;
+    sig->length = length;
+    sig->motorola = (order == '0') ? 1U : 0U;
+    sig->is_signed = (sign == '-') ? 1U : 0U;
+    sig->mask = (length == 64U) ? UINT64_MAX : ((1ULL << length) - 1U);
+    if (sig->motorola == 0U)
+    {
+        if ((start + length) > 64U)
+        {
+            dbc_error("signal past the end of the payload");
+        }
+        sig->shift = start;
+        bits = sig->mask << sig->shift;
+    }
+    else
+    {
+        /* the MSB in the swapped word, where byte 0 is on top */
+        msb = ((7U - (start / 8U)) * 8U) + (start % 8U);
+        if ((msb + 1U) < length)
+        {
+            dbc_error("signal past the end of the payload");
+        }
+        sig->shift = msb + 1U - length;
+        bits = __builtin_bswap64(sig->mask << sig->shift);
+    }
+    if ((msg->dlc < 8U) && ((bits >> (msg->dlc * 8U)) != 0U))
+    {
+        dbc_error("signal outside the DLC");
+    }
+    if ((msg->used & bits) != 0U)
+    {
+        dbc_error("signals overlap");
+    }
+    msg->used |= bits;
+    msg->count++;
+}
+
+static const char *dbc_type(const dbc_signal_t *sig)
+{
+    static const char *const types[2][4] = {
+        {"uint8_t", "uint16_t", "uint32_t", "uint64_t"},
+        {"int8_t", "int16_t", "int32_t", "int64_t"},
+    };
+    uint32_t size = 0U;
+
+    while ((8U << size) < sig->length)
+    {
+        size++;
+    }
+    return types[sig->is_signed][size];
+}
+
+/* The raw value of sig in word, cast to its type. */
+static void dbc_write_get(FILE *out, const dbc_signal_t *sig, const char *word)
+{
+    char bits[DBC_NAME_SIZE];
+    char masked[DBC_LINE_SIZE];
+
+    if (sig->shift != 0U)
+    {
+        (void)snprintf(bits, sizeof(bits), "(%s >> %uU)", word, (unsigned int)sig->shift);
+    }
+    else
+    {
+        (void)snprintf(bits, sizeof(bits), "%s", word);
+    }
+    if (sig->length < 64U)
+    {
+        (void)snprintf(masked, sizeof(masked), "(%s & UINT64_C(0x%" PRIX64 "))", bits, sig->mask);
+    }
+    else
+    {
+        (void)snprintf(masked, sizeof(masked), "%s", bits);
+    }
+    if ((sig->is_signed != 0U) && (sig->length < 64U))
+    {
+        /* sign extension: flip the sign bit, take it back off */
+        fprintf(out, "(%s)(int64_t)((%s ^ UINT64_C(0x%" PRIX64 ")) - UINT64_C(0x%" PRIX64 "))", dbc_type(sig), masked,
+                (uint64_t)1U << (sig->length - 1U), (uint64_t)1U << (sig->length - 1U));
+    }
+    else
+    {
+        fprintf(out, "(%s)%s", dbc_type(sig), masked);
+    }
+}
+
+/* value in place, not swapped */
+static void dbc_write_put(FILE *out, const dbc_signal_t *sig, const char *value)
+{
+    char masked[DBC_LINE_SIZE];
+
+    if (sig->length < 64U)
+    {
+        (void)snprintf(masked, sizeof(masked), "((uint64_t)%s & UINT64_C(0x%" PRIX64 "))", value, sig->mask);
+    }
+    else
+    {
+        (void)snprintf(masked, sizeof(masked), "(uint64_t)%s", value);
+    }
+    if (sig->shift != 0U)
+    {
+        fprintf(out, "(%s << %uU)", masked, (unsigned int)sig->shift);
+    }
+    else
+    {
+        fprintf(out, "%s", masked);
+    }
+}
+
+/* OR of the signals of one byte order, 0 when there is none. */
+static uint32_t dbc_write_terms(FILE *out, const dbc_message_t *msg, uint32_t motorola, const char *indent)
+{
+    char value[DBC_LINE_SIZE];
+    uint32_t written = 0U;
+    uint32_t i;
+
+    for (i = 0U; i < msg->count; i++)
+    {
+        if (msg->signals[i].motorola == motorola)
+        {
+            char field[DBC_NAME_SIZE];
+
+            dbc_lower(field, msg->signals[i].name);
+            (void)snprintf(value, sizeof(value), "msg->%s", field);
+            if (written != 0U)
+            {
+                fprintf(out, "\n%s| ", indent);
+            }
+            dbc_write_put(out, &msg->signals[i], value);
+            written++;
+        }
+    }
+    return written;
+}
+
+static void dbc_write_message(FILE *out, const dbc_message_t *msg)
+{
+    char lower[DBC_NAME_SIZE];
+    char upper[DBC_NAME_SIZE];
+    char field[DBC_NAME_SIZE];
+    uint32_t intel = 0U;
+    uint32_t motorola = 0U;
+    uint32_t i;
+
+    dbc_lower(lower, msg->name);
+    dbc_upper(upper, msg->name);
+    for (i = 0U; i < msg->count; i++)
+    {
+        motorola += msg->signals[i].motorola;
+    }
+    intel = msg->count - motorola;
+
+    fprintf(out, "/* %s: 0x%0*" PRIX32 ", %u bytes, from %s */\n", msg->name, (msg->ide != 0U) ? 8 : 3, msg->id,
+            (unsigned int)msg->dlc, msg->sender);
+    fprintf(out, "#define %-32s 0x%" PRIX32 "U\n", strcat(strcpy(field, upper), "_ID"), msg->id);
+    fprintf(out, "#define %-32s %uU\n", strcat(strcpy(field, upper), "_IDE"), (unsigned int)msg->ide);
+    fprintf(out, "#define %-32s %uU\n\n", strcat(strcpy(field, upper), "_DLC"), (unsigned int)msg->dlc);
+
+    fprintf(out, "typedef struct\n{\n");
+    for (i = 0U; i < msg->count; i++)
+    {
+        const dbc_signal_t *sig = &msg->signals[i];
+        char decl[DBC_LINE_SIZE];
+
+        dbc_lower(field, sig->name);
+        (void)snprintf(decl, sizeof(decl), "%s %s;", dbc_type(sig), field);
+        fprintf(out, "    %-36s/* %u|%u@%c%c (%s,%s) [%s|%s] \"%s\" */\n", decl, (unsigned int)sig->start,
+                (unsigned int)sig->length, (sig->motorola != 0U) ? '0' : '1', (sig->is_signed != 0U) ? '-' : '+',
+                sig->factor, sig->offset, sig->min, sig->max, sig->unit);
+    }
+    if (msg->count == 0U)
+    {
+        fprintf(out, "    uint8_t unused;\n");
+    }
+    fprintf(out, "} %s_t;\n\n", lower);
+
+    fprintf(out, "CAN_DBC_FN uint64_t %s_pack(const %s_t *msg)\n{\n", lower, lower);
+    if (msg->count == 0U)
+    {
+        fprintf(out, "    (void)msg;\n    return 0U;\n");
+    }
+    else
+    {
+        fprintf(out, "    return ");
+        (void)dbc_write_terms(out, msg, 0U, "           ");
+        if (motorola != 0U)
+        {
+            fprintf(out, "%scan_dbc_swap(", (intel != 0U) ? "\n           | " : "");
+            (void)dbc_write_terms(out, msg, 1U, "                          ");
+            fprintf(out, ")");
+        }
+        fprintf(out, ";\n");
+    }
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "CAN_DBC_FN void %s_unpack(%s_t *msg, uint64_t payload)\n{\n", lower, lower);
+    if (motorola != 0U)
+    {
+        fprintf(out, "    const uint64_t swapped = can_dbc_swap(payload);\n\n");
+    }
+    for (i = 0U; i < msg->count; i++)
+    {
+        dbc_lower(field, msg->signals[i].name);
+        fprintf(out, "    msg->%s = ", field);
+        dbc_write_get(out, &msg->signals[i], (msg->signals[i].motorola != 0U) ? "swapped" : "payload");
+        fprintf(out, ";\n");
+    }
+    if (msg->count == 0U)
+    {
+        fprintf(out, "    msg->unused = 0U;\n    (void)payload;\n");
+    }
+    fprintf(out, "}\n\n");
+
+    for (i = 0U; i < msg->count; i++)
+    {
+        const dbc_signal_t *sig = &msg->signals[i];
+        const uint64_t keep = ~(sig->mask << sig->shift);
+
+        dbc_lower(field, sig->name);
+        fprintf(out, "CAN_DBC_FN %s %s_%s_get(uint64_t payload)\n{\n    return ", dbc_type(sig), lower, field);
+        dbc_write_get(out, sig, (sig->motorola != 0U) ? "can_dbc_swap(payload)" : "payload");
+        fprintf(out, ";\n}\n\n");
+        fprintf(out, "CAN_DBC_FN uint64_t %s_%s_set(uint64_t payload, %s value)\n{\n", lower, field, dbc_type(sig));
+        if (keep != 0U)
+        {
+            fprintf(out, "    return (payload & UINT64_C(0x%" PRIX64 ")) | ",
+                    (sig->motorola != 0U) ? __builtin_bswap64(keep) : keep);
+        }
+        else
+        {
+            fprintf(out, "    (void)payload;\n    return ");
+        }
+        if (sig->motorola != 0U)
+        {
+            fprintf(out, "can_dbc_swap(");
+            dbc_write_put(out, sig, "value");
+            fprintf(out, ")");
+        }
+        else
+        {
+            dbc_write_put(out, sig, "value");
+        }
+        fprintf(out, ";\n}\n\n");
+    }
+}
+
+static void dbc_write(const char *path)
+{
+    char guard[DBC_LINE_SIZE];
+    const char *base = strrchr(path, '/');
+    const char *src = strrchr(dbc_path, '/');
+    FILE *out;
+    uint32_t i;
+    uint32_t j;
+    char *p;
+
+    base = (base != NULL) ? (base + 1) : path;
+    src = (src != NULL) ? (src + 1) : dbc_path;
+    dbc_upper(guard, base);
+    for (p = guard; *p != '\0'; p++)
+    {
+        *p = (isalnum((unsigned char)*p) != 0) ? *p : '_';
+    }
+    p = strstr(guard, "_H");
+    if ((p != NULL) && (p[2] == '\0'))
+    {
+        *p = '\0';
+    }
+
+    out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    fprintf(out, "/**\n"
+                 " ******************************************************************************\n"
+                 " * @file           : %s\n"
+                 " * @brief          : CAN signals of %s\n"
+                 " ******************************************************************************\n"
+                 " * Generated by Host/Tools/dbc_gen.c, do not edit: change the DBC file and\n"
+                 " * run dbc_gen again.  See Core/Inc/can_dbc.h.\n"
+                 " ******************************************************************************\n"
+                 " */\n",
+            base, src);
+    fprintf(out, "#ifndef %s_H\n#define %s_H\n\n#include \"can_dbc.h\"\n\n", guard, guard);
+    for (i = 0U; i < dbc_count; i++)
+    {
+        dbc_write_message(out, &dbc_messages[i]);
+    }
+
+    fprintf(out, "/* X(message, MESSAGE) for every message */\n#define %s_MESSAGES(X)", guard);
+    for (i = 0U; i < dbc_count; i++)
+    {
+        char lower[DBC_NAME_SIZE];
+        char upper[DBC_NAME_SIZE];
+
+        dbc_lower(lower, dbc_messages[i].name);
+        dbc_upper(upper, dbc_messages[i].name);
+        fprintf(out, " \\\n    X(%s, %s)", lower, upper);
+    }
+    fprintf(out, "\n\n/* S(message, signal, start, length, motorola, signed) as in the DBC */\n");
+    for (i = 0U; i < dbc_count; i++)
+    {
+        const dbc_message_t *msg = &dbc_messages[i];
+        char lower[DBC_NAME_SIZE];
+        char upper[DBC_NAME_SIZE];
+
+        dbc_lower(lower, msg->name);
+        dbc_upper(upper, msg->name);
+        fprintf(out, "#define %s_SIGNALS(S)", upper);
+        for (j = 0U; j < msg->count; j++)
+        {
+            char field[DBC_NAME_SIZE];
+
+            dbc_lower(field, msg->signals[j].name);
+            fprintf(out, " \\\n    S(%s, %s, %uU, %uU, %uU, %uU)", lower, field, (unsigned int)msg->signals[j].start,
+                    (unsigned int)msg->signals[j].length, (unsigned int)msg->signals[j].motorola,
+                    (unsigned int)msg->signals[j].is_signed);
+        }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "\n#endif\n");
+    if (fclose(out) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    char line[DBC_LINE_SIZE];
+    FILE *in;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: dbc_gen <dbc> <header>\n");
+        return 1;
+    }
+    dbc_path = argv[1];
+    in = fopen(dbc_path, "r");
+    if (in == NULL)
+    {
+        perror(dbc_path);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        dbc_line++;
+        if (strncmp(line, "BO_ ", 4U) == 0)
+        {
+            dbc_parse_message(line);
+        }
+        else if (strncmp(line + strspn(line, " \t"), "SG_ ", 4U) == 0)
+        {
+            dbc_parse_signal(line);
+        }
+    }
+    (void)fclose(in);
+    dbc_write(argv[2]);
+    return 0;
+}
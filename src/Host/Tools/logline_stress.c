@@ -0,0 +1,251 @@
+/**
+ ******************************************************************************
+ * @file           : logline_stress.c
+ * @brief          : Host stress test of Core/Src/logline.c (Linux tool)
+ ******************************************************************************
+ * logline_stress [lines]
+ *
+ * 1 to 16 pthreads play the tasks and log lines of different lengths as fast
+ * as they can, in two ways:
+ *
+ *  - printf:   printf_() straight to the console, one console_write() per
+ *              span, which is what the tasks did before.
+ *  - logline:  logline_printf(); a full ring yields to the drainer until
+ *              there is room, so no line is dropped.
+ *
+ * The console is a big buffer, every console_write() or _putspan() lands in
+ * it in one piece.  Afterwards each line of it must be one whole line of one task, and
+ * the lines of a task must come in order:
+ *
+ *   path,tasks,lines,dropped,bad_lines,ns_per_line
+ *
+ * bad_lines counts lines that are not whole lines of one task.  At the end,
+ * "writers" counts console_write() calls of the logline drainer that ran at
+ * the same time as another one.  The printf rows show the interleaving the logline
+ * ones must not have; the program returns 1 if a logline row does.
+ ******************************************************************************
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "console.h"
+#include "printf.h"
+#include "logline.h"
+
+#define STRESS_MAX_TASKS                16U
+#define STRESS_LINES                    10000U
+#define STRESS_LINE_MAX                 64U
+
+typedef enum
+{
+    STRESS_PRINTF = 0,
+    STRESS_LOGLINE
+} stress_path_t;
+
+static char *stress_console;
+static size_t stress_console_size;
+static size_t stress_console_len;
+static uint32_t stress_in_console;
+static uint32_t stress_overlaps;
+static uint32_t stress_lines = STRESS_LINES;
+static stress_path_t stress_path;
+static volatile uint32_t stress_go;
+
+/* One piece per call, like the critical section in console.c. */
+static uint32_t stress_console_put(const char *data, uint32_t len)
+{
+    size_t at = __atomic_fetch_add(&stress_console_len, (size_t)len, __ATOMIC_RELAXED);
+
+    if ((at + len) > stress_console_size)
+    {
+        return 0U;
+    }
+    memcpy(&stress_console[at], data, len);
+    return len;
+}
+
+/* Called by the logline drainer only, which must be alone. */
+uint32_t console_write(const char *data, uint32_t len)
+{
+    uint32_t n;
+
+    if (__atomic_fetch_add(&stress_in_console, 1U, __ATOMIC_ACQUIRE) != 0U)
+    {
+        (void)__atomic_fetch_add(&stress_overlaps, 1U, __ATOMIC_RELAXED);
+    }
+    n = stress_console_put(data, len);
+    (void)__atomic_fetch_sub(&stress_in_console, 1U, __ATOMIC_RELEASE);
+    return n;
+}
+
+/* a full ring waits for the drainer thread instead of dropping */
+uint32_t logline_wait(void)
+{
+    (void)sched_yield();
+    return 1U;
+}
+
+void _putchar(char character)
+{
+    (void)stress_console_put(&character, 1U);
+}
+
+void _putspan(const char *data, size_t len)
+{
+    (void)stress_console_put(data, (uint32_t)len);
+}
+
+static uint64_t stress_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/* 0 .. 31 letters of the task, so the lines have different lengths */
+static uint32_t stress_fill(uint32_t task, uint32_t seq, char *fill)
+{
+    uint32_t n = (seq * 7U + task) & 31U;
+
+    memset(fill, 'a' + (int)task, n);
+    fill[n] = '\0';
+    return n;
+}
+
+static void *stress_task(void *arg)
+{
+    const uint32_t task = (uint32_t)(uintptr_t)arg;
+    char fill[32];
+    uint32_t seq;
+
+    while (__atomic_load_n(&stress_go, __ATOMIC_ACQUIRE) == 0U)
+    {
+    }
+    for (seq = 0U; seq < stress_lines; seq++)
+    {
+        (void)stress_fill(task, seq, fill);
+        if (stress_path == STRESS_PRINTF)
+        {
+            (void)printf_("task %02u seq %06u %s|\n", (unsigned int)task, (unsigned int)seq, fill);
+        }
+        else
+        {
+            (void)logline_printf("task %02u seq %06u %s|\n", (unsigned int)task, (unsigned int)seq, fill);
+        }
+    }
+    return NULL;
+}
+
+/* Every line must be a whole line of one task, in order per task. */
+static uint32_t stress_check(uint32_t tasks, uint32_t *lines_seen)
+{
+    uint32_t next[STRESS_MAX_TASKS] = {0U};
+    char expect[STRESS_LINE_MAX];
+    char fill[32];
+    size_t pos = 0U;
+    uint32_t bad = 0U;
+    unsigned int task;
+    unsigned int seq;
+    size_t len;
+    char *end;
+
+    *lines_seen = 0U;
+    while (pos < stress_console_len)
+    {
+        end = memchr(&stress_console[pos], '\n', stress_console_len - pos);
+        len = (end != NULL) ? (size_t)(end - &stress_console[pos]) + 1U : stress_console_len - pos;
+        (*lines_seen)++;
+
+        if ((sscanf(&stress_console[pos], "task %2u seq %6u", &task, &seq) != 2) || (task >= tasks) ||
+            (seq < next[task]))
+        {
+            bad++;
+        }
+        else
+        {
+            (void)stress_fill(task, seq, fill);
+            (void)snprintf_(expect, sizeof(expect), "task %02u seq %06u %s|\n", task, seq, fill);
+            if ((strlen(expect) != len) || (memcmp(expect, &stress_console[pos], len) != 0))
+            {
+                bad++;
+            }
+            next[task] = seq + 1U;
+        }
+        pos += len;
+    }
+    return bad;
+}
+
+static uint32_t stress_run(stress_path_t path, uint32_t tasks)
+{
+    pthread_t threads[STRESS_MAX_TASKS];
+    uint32_t dropped = logline_dropped();
+    uint32_t seen;
+    uint32_t bad;
+    uint64_t t0;
+    uint64_t t1;
+    uint32_t i;
+
+    stress_path = path;
+    stress_console_len = 0U;
+    stress_go = 0U;
+    for (i = 0U; i < tasks; i++)
+    {
+        (void)pthread_create(&threads[i], NULL, stress_task, (void *)(uintptr_t)i);
+    }
+    t0 = stress_now();
+    __atomic_store_n(&stress_go, 1U, __ATOMIC_RELEASE);
+    for (i = 0U; i < tasks; i++)
+    {
+        (void)pthread_join(threads[i], NULL);
+    }
+    t1 = stress_now();
+
+    dropped = logline_dropped() - dropped;
+    bad = stress_check(tasks, &seen);
+    fprintf(stdout, "%s,%u,%u,%u,%u,%.1f\n", (path == STRESS_PRINTF) ? "printf" : "logline", (unsigned int)tasks,
+            (unsigned int)seen, (unsigned int)dropped, (unsigned int)bad,
+            (double)(t1 - t0) / (double)(tasks * stress_lines));
+    (void)fflush(stdout);
+
+    if ((path == STRESS_LOGLINE) && ((seen != (tasks * stress_lines)) || (dropped != 0U)))
+    {
+        bad++;
+    }
+    return (path == STRESS_LOGLINE) ? bad : 0U;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t task_counts[] = {1U, 2U, 4U, 8U, 16U};
+    uint32_t failures = 0U;
+    uint32_t i;
+
+    if (argc > 1)
+    {
+        stress_lines = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+    stress_console_size = (size_t)STRESS_MAX_TASKS * stress_lines * STRESS_LINE_MAX;
+    stress_console = malloc(stress_console_size);
+    if (stress_console == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    fprintf(stdout, "path,tasks,lines,dropped,bad_lines,ns_per_line\n");
+    for (i = 0U; i < (sizeof(task_counts) / sizeof(task_counts[0])); i++)
+    {
+        (void)stress_run(STRESS_PRINTF, task_counts[i]);
+        failures += stress_run(STRESS_LOGLINE, task_counts[i]);
+    }
+    fprintf(stdout, "writers,%u\n", (unsigned int)stress_overlaps);
+    failures += stress_overlaps;
+    return (failures == 0U) ? 0 : 1;
+}
@@ -0,0 +1,412 @@
+/**
+ ******************************************************************************
+ * @file           : printf_bench.c
+ * @brief          : Host benchmark of Core/Src/printf.c (Linux tool)
+ ******************************************************************************
+ * Formats typical log lines of the application over and over and prints the
+ * time per call as CSV:
+ *
+ *   line,path,ns_per_call
+ *
+ * Paths:
+ *  - snprintf:     snprintf_() into a buffer.
+ *  - printf:       printf_() into a console-like ring through _putspan().
+ *
+ * The "random" lines convert random 32-bit values.
+ *
+ * Built with -DPRINTF_BENCH_REF, the same lines also go through a second copy
+ * of printf.c whose functions are renamed to ref_*(), e.g. the version before
+ * a change.  Its rows are tagged "ref", and the integer conversions are
+ * checked to come out byte for byte the same from both, over a set of
+ * formats, the edge values and PRINTF_BENCH_COMPARE random values.
+ *
+ * Built with -DPRINTF_BENCH_REF_FLOAT as well, the reference has the double
+ * %f (PRINTF_ENABLE_SUPPORT_FLOAT) and the fixed-point %f is checked against
+ * it and against the libc snprintf(), which prints the exact value:
+ *
+ *   float,<checked>,<fixed != libc>,<fixed != double>,<double != libc>
+ *
+ * The double path has its own errors: it takes the fraction before it applies
+ * the default precision of "%f" and its 16-byte buffer cuts long numbers.
+ ******************************************************************************
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "printf.h"
+
+/* the libc one is the reference for %f */
+#undef snprintf
+
+#define PRINTF_BENCH_ITERATIONS         200000U
+#define PRINTF_BENCH_RING_SIZE          1024U
+#define PRINTF_BENCH_LINE_SIZE          128U
+#define PRINTF_BENCH_COMPARE            1000000U
+
+typedef enum
+{
+    PRINTF_BENCH_WATER_MARK = 0,
+    PRINTF_BENCH_SEPARATOR,
+    PRINTF_BENCH_MAILBOX,
+    PRINTF_BENCH_CAN_FRAME,
+    PRINTF_BENCH_STATUS,
+    PRINTF_BENCH_RANDOM_U,
+    PRINTF_BENCH_RANDOM_D,
+    PRINTF_BENCH_RANDOM_X,
+    PRINTF_BENCH_RANDOM_F,
+    PRINTF_BENCH_RANDOM_K,
+    PRINTF_BENCH_COUNT
+} printf_bench_line_t;
+
+static const char *const printf_bench_names[PRINTF_BENCH_COUNT] =
+{
+    "water mark",
+    "separator",
+    "mailbox",
+    "can frame",
+    "status",
+    "random %u",
+    "random %d",
+    "random %08x",
+    "random %.3f",
+    "random %.3k",
+};
+
+#if defined(PRINTF_BENCH_REF)
+int ref_printf_(const char *format, ...);
+int ref_snprintf_(char *buffer, size_t count, const char *format, ...);
+#endif
+
+/* what a console_write() does with a block: a copy into a ring buffer */
+static char printf_bench_ring[PRINTF_BENCH_RING_SIZE];
+static uint32_t printf_bench_head;
+
+static void printf_bench_put(const char *data, size_t len)
+{
+    uint32_t first;
+
+    while (len > 0U)
+    {
+        first = PRINTF_BENCH_RING_SIZE - (printf_bench_head & (PRINTF_BENCH_RING_SIZE - 1U));
+        first = (len < first) ? (uint32_t)len : first;
+        memcpy(&printf_bench_ring[printf_bench_head & (PRINTF_BENCH_RING_SIZE - 1U)], data, first);
+        printf_bench_head += first;
+        data += first;
+        len -= first;
+    }
+}
+
+void _putchar(char character)
+{
+    printf_bench_put(&character, 1U);
+}
+
+void _putspan(const char *data, size_t len)
+{
+    printf_bench_put(data, len);
+}
+
+#if defined(PRINTF_BENCH_REF)
+void ref_putchar(char character)
+{
+    printf_bench_put(&character, 1U);
+}
+#endif
+
+static uint64_t printf_bench_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift32 of i: random but the same for every path */
+static uint32_t printf_bench_random(uint32_t i)
+{
+    uint32_t x = (i * 2654435761U) + 1U;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+/* The lines, with arguments that change every call. */
+#define PRINTF_BENCH_LINES(fn, ...)                                                                          \
+    switch (line)                                                                                            \
+    {                                                                                                        \
+    case PRINTF_BENCH_WATER_MARK:                                                                            \
+        (void)fn(__VA_ARGS__ "water mark fo task 500ms: %d\n", (int)(i & 0xFFU));                          \
+        break;                                                                                               \
+    case PRINTF_BENCH_SEPARATOR:                                                                             \
+        (void)fn(__VA_ARGS__ "%d:----------------------------------------------\n", (int)i);                \
+        break;                                                                                               \
+    case PRINTF_BENCH_MAILBOX:                                                                               \
+        (void)fn(__VA_ARGS__ "mailbox used for CAN tx: %d\n", (int)(1U << (i & 2U)));                       \
+        break;                                                                                               \
+    case PRINTF_BENCH_CAN_FRAME:                                                                             \
+        (void)fn(__VA_ARGS__ "can rx id=0x%03x dlc=%u data=%02x %02x %02x %02x\n", (unsigned int)(i & 0x7FFU), \
+                 (unsigned int)(i & 7U), (unsigned int)(i & 0xFFU), (unsigned int)((i >> 8) & 0xFFU),       \
+                 (unsigned int)((i >> 16) & 0xFFU), 0x5AU);                                                  \
+        break;                                                                                               \
+    case PRINTF_BENCH_STATUS:                                                                                \
+        (void)fn(__VA_ARGS__ "[%8u] %-8s state=%s err=%-4d\n", (unsigned int)i, "can", "active", -(int)(i & 31U)); \
+        break;                                                                                               \
+    case PRINTF_BENCH_RANDOM_U:                                                                              \
+        (void)fn(__VA_ARGS__ "%u", (unsigned int)printf_bench_random(i));                                    \
+        break;                                                                                               \
+    case PRINTF_BENCH_RANDOM_D:                                                                              \
+        (void)fn(__VA_ARGS__ "%d", (int)printf_bench_random(i));                                             \
+        break;                                                                                               \
+    case PRINTF_BENCH_RANDOM_X:                                                                              \
+        (void)fn(__VA_ARGS__ "%08x", (unsigned int)printf_bench_random(i));                                  \
+        break;                                                                                               \
+    case PRINTF_BENCH_RANDOM_F:                                                                              \
+        (void)fn(__VA_ARGS__ "%.3f", (double)(int32_t)printf_bench_random(i) / 1024.0);                     \
+        break;                                                                                               \
+    default:                                                                                                 \
+        (void)fn(__VA_ARGS__ "%.3k", (int)printf_bench_random(i));                                           \
+        break;                                                                                               \
+    }
+
+static void printf_bench_snprintf(printf_bench_line_t line, uint32_t i, char *out)
+{
+    PRINTF_BENCH_LINES(snprintf_, out, PRINTF_BENCH_LINE_SIZE,)
+}
+
+static void printf_bench_printf(printf_bench_line_t line, uint32_t i)
+{
+    PRINTF_BENCH_LINES(printf_,)
+}
+
+#if defined(PRINTF_BENCH_REF)
+static void printf_bench_ref_snprintf(printf_bench_line_t line, uint32_t i, char *out)
+{
+    PRINTF_BENCH_LINES(ref_snprintf_, out, PRINTF_BENCH_LINE_SIZE,)
+}
+
+static void printf_bench_ref_printf(printf_bench_line_t line, uint32_t i)
+{
+    PRINTF_BENCH_LINES(ref_printf_,)
+}
+#endif
+
+#if defined(PRINTF_BENCH_REF)
+static const char *const printf_bench_formats[] =
+{
+    "%u", "%d", "%i", "%x", "%X", "%o", "%b", "%#x", "%#X", "%#o", "%08x", "%-10u|", "%+d", "% d",
+    "%012d", "%-+12d|", "%.12d", "%.0u", "%.0x", "%12.5d", "%#12.10x", "%hhu", "%hd", "%lu", "%lx", "%p",
+};
+
+static const uint32_t printf_bench_edges[] =
+{
+    0U, 1U, 9U, 10U, 99U, 100U, 101U, 999U, 1000U, 9999U, 10000U, 65535U, 65536U, 99999999U, 100000000U,
+    999999999U, 1000000000U, 0x7FFFFFFFU, 0x80000000U, 0x80000001U, 0xFFFFFFFEU, 0xFFFFFFFFU,
+};
+
+static uint32_t printf_bench_check(const char *format, uint32_t value)
+{
+    char out[PRINTF_BENCH_LINE_SIZE];
+    char ref[PRINTF_BENCH_LINE_SIZE];
+    int n;
+    int n_ref;
+
+    if (strcmp(format, "%p") == 0)
+    {
+        n = snprintf_(out, sizeof(out), format, (void *)(uintptr_t)value);
+        n_ref = ref_snprintf_(ref, sizeof(ref), format, (void *)(uintptr_t)value);
+    }
+    else if (format[1] == 'l')
+    {
+        n = snprintf_(out, sizeof(out), format, (unsigned long)value);
+        n_ref = ref_snprintf_(ref, sizeof(ref), format, (unsigned long)value);
+    }
+    else
+    {
+        n = snprintf_(out, sizeof(out), format, value);
+        n_ref = ref_snprintf_(ref, sizeof(ref), format, value);
+    }
+
+    if ((n != n_ref) || (strcmp(out, ref) != 0))
+    {
+        fprintf(stderr, "\"%s\" 0x%08x: \"%s\", ref \"%s\"\n", format, (unsigned int)value, out, ref);
+        return 1U;
+    }
+    return 0U;
+}
+
+static uint32_t printf_bench_compare(void)
+{
+    uint32_t mismatches = 0U;
+    uint32_t f;
+    uint32_t i;
+
+    for (f = 0U; f < (sizeof(printf_bench_formats) / sizeof(printf_bench_formats[0])); f++)
+    {
+        for (i = 0U; i < (sizeof(printf_bench_edges) / sizeof(printf_bench_edges[0])); i++)
+        {
+            mismatches += printf_bench_check(printf_bench_formats[f], printf_bench_edges[i]);
+        }
+        for (i = 0U; i < PRINTF_BENCH_COMPARE; i++)
+        {
+            /* short numbers as often as long ones */
+            mismatches += printf_bench_check(printf_bench_formats[f], printf_bench_random(i) >> (i & 31U));
+        }
+    }
+    return mismatches;
+}
+#endif
+
+#if defined(PRINTF_BENCH_REF_FLOAT)
+static const char *const printf_bench_float_formats[] =
+{
+    "%f", "%.0f", "%.1f", "%.2f", "%.3f", "%.6f", "%.9f", "%10.2f", "%-10.2f|", "%+.2f", "%010.3f", "% .4f",
+};
+
+static const double printf_bench_float_edges[] =
+{
+    0.0, -0.0, 0.5, 1.5, 2.5, -0.5, 0.125, 0.375, 0.05, 0.15, 0.25, 0.999999, 9.9999995, 1.0 / 3.0, 2.0 / 3.0,
+    123.456, -123.456, 1e-9, 1e-300, 4.9e-324, 65535.99998, 999999999.0, 999999999.9999999,
+};
+
+/* random magnitudes from 2^-30 to 2^29, the double path stops at 1e9 */
+static double printf_bench_random_double(uint32_t i)
+{
+    const uint32_t r = printf_bench_random(i);
+    const double mantissa = (double)printf_bench_random(~i) / 4294967296.0;
+
+    return ldexp(1.0 + mantissa, (int)(r % 60U) - 30) * (((r >> 8) & 1U) ? -1.0 : 1.0);
+}
+
+static void printf_bench_compare_float(void)
+{
+    char out[PRINTF_BENCH_LINE_SIZE];
+    char ref[PRINTF_BENCH_LINE_SIZE];
+    char libc[PRINTF_BENCH_LINE_SIZE];
+    const char *format;
+    uint32_t checked = 0U;
+    uint32_t differ_libc = 0U;
+    uint32_t differ_double = 0U;
+    uint32_t double_libc = 0U;
+    double value;
+    uint32_t f;
+    uint32_t i;
+    uint32_t edges = sizeof(printf_bench_float_edges) / sizeof(printf_bench_float_edges[0]);
+
+    for (f = 0U; f < (sizeof(printf_bench_float_formats) / sizeof(printf_bench_float_formats[0])); f++)
+    {
+        format = printf_bench_float_formats[f];
+        for (i = 0U; i < (edges + (PRINTF_BENCH_COMPARE / 10U)); i++)
+        {
+            value = (i < edges) ? printf_bench_float_edges[i] : printf_bench_random_double(i);
+            (void)snprintf_(out, sizeof(out), format, value);
+            (void)ref_snprintf_(ref, sizeof(ref), format, value);
+            (void)snprintf(libc, sizeof(libc), format, value);
+            checked++;
+
+            if (strcmp(out, libc) != 0)
+            {
+                if (differ_libc < 10U)
+                {
+                    fprintf(stderr, "\"%s\" %.17g: \"%s\", libc \"%s\"\n", format, value, out, libc);
+                }
+                differ_libc++;
+            }
+            if (strcmp(out, ref) != 0)
+            {
+                differ_double++;
+            }
+            if (strcmp(ref, libc) != 0)
+            {
+                double_libc++;
+            }
+        }
+    }
+
+    fprintf(stdout, "float,%u,%u,%u,%u\n", (unsigned int)checked, (unsigned int)differ_libc,
+            (unsigned int)differ_double, (unsigned int)double_libc);
+}
+#endif
+
+static void printf_bench_report(printf_bench_line_t line, const char *path, uint64_t t0, uint64_t t1)
+{
+    fprintf(stdout, "%s,%s,%.1f\n", printf_bench_names[line], path,
+           (double)(t1 - t0) / (double)PRINTF_BENCH_ITERATIONS);
+}
+
+int main(void)
+{
+    char out[PRINTF_BENCH_LINE_SIZE];
+    uint32_t line;
+    uint32_t i;
+    uint64_t t0;
+    uint64_t t1;
+#if defined(PRINTF_BENCH_REF)
+    char ref[PRINTF_BENCH_LINE_SIZE];
+    uint32_t mismatches = 0U;
+#endif
+
+    fprintf(stdout, "line,path,ns_per_call\n");
+    for (line = 0U; line < (uint32_t)PRINTF_BENCH_COUNT; line++)
+    {
+        t0 = printf_bench_now();
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i++)
+        {
+            printf_bench_snprintf((printf_bench_line_t)line, i, out);
+        }
+        t1 = printf_bench_now();
+        printf_bench_report((printf_bench_line_t)line, "snprintf", t0, t1);
+
+        t0 = printf_bench_now();
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i++)
+        {
+            printf_bench_printf((printf_bench_line_t)line, i);
+        }
+        t1 = printf_bench_now();
+        printf_bench_report((printf_bench_line_t)line, "printf", t0, t1);
+
+#if defined(PRINTF_BENCH_REF)
+        t0 = printf_bench_now();
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i++)
+        {
+            printf_bench_ref_snprintf((printf_bench_line_t)line, i, ref);
+        }
+        t1 = printf_bench_now();
+        printf_bench_report((printf_bench_line_t)line, "ref snprintf", t0, t1);
+
+        t0 = printf_bench_now();
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i++)
+        {
+            printf_bench_ref_printf((printf_bench_line_t)line, i);
+        }
+        t1 = printf_bench_now();
+        printf_bench_report((printf_bench_line_t)line, "ref printf", t0, t1);
+
+        /* the reference may not know %f and %k */
+        for (i = 0U; (line < (uint32_t)PRINTF_BENCH_RANDOM_F) && (i < PRINTF_BENCH_ITERATIONS); i += 97U)
+        {
+            printf_bench_snprintf((printf_bench_line_t)line, i, out);
+            printf_bench_ref_snprintf((printf_bench_line_t)line, i, ref);
+            if (strcmp(out, ref) != 0)
+            {
+                mismatches++;
+            }
+        }
+#endif
+    }
+
+#if defined(PRINTF_BENCH_REF)
+    mismatches += printf_bench_compare();
+#if defined(PRINTF_BENCH_REF_FLOAT)
+    printf_bench_compare_float();
+#endif
+    fprintf(stdout, "mismatches,%u\n", (unsigned int)mismatches);
+    return (mismatches == 0U) ? 0 : 1;
+#else
+    return 0;
+#endif
+}
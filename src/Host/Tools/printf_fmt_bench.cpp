@@ -0,0 +1,323 @@
+/**
+ ******************************************************************************
+ * @file           : printf_fmt_bench.cpp
+ * @brief          : Host benchmark of the pre-parsed printf formats (Linux tool)
+ ******************************************************************************
+ * The log lines of printf_bench.c, through printf_() and snprintf_() as they
+ * are and through PRINTF_FMT() and SNPRINTF_FMT(), which get them parsed at
+ * compile time:
+ *
+ *   line,path,ns_per_call
+ *
+ * Every line, and a set of formats over the edge values and random values,
+ * must come out byte for byte the same both ways:
+ *
+ *   mismatches,<count>
+ ******************************************************************************
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "printf_fmt.hpp"
+
+#define PRINTF_BENCH_ITERATIONS         200000U
+#define PRINTF_BENCH_RING_SIZE          1024U
+#define PRINTF_BENCH_LINE_SIZE          128U
+#define PRINTF_BENCH_COMPARE            200000U
+
+typedef enum
+{
+    PRINTF_BENCH_WATER_MARK = 0,
+    PRINTF_BENCH_SEPARATOR,
+    PRINTF_BENCH_MAILBOX,
+    PRINTF_BENCH_CAN_FRAME,
+    PRINTF_BENCH_STATUS,
+    PRINTF_BENCH_RANDOM_U,
+    PRINTF_BENCH_RANDOM_D,
+    PRINTF_BENCH_RANDOM_X,
+    PRINTF_BENCH_RANDOM_F,
+    PRINTF_BENCH_RANDOM_K,
+    PRINTF_BENCH_COUNT
+} printf_bench_line_t;
+
+static const char *const printf_bench_names[PRINTF_BENCH_COUNT] =
+{
+    "water mark",
+    "separator",
+    "mailbox",
+    "can frame",
+    "status",
+    "random %u",
+    "random %d",
+    "random %08x",
+    "random %.3f",
+    "random %.3k",
+};
+
+/* what a console_write() does with a block: a copy into a ring buffer */
+static char printf_bench_ring[PRINTF_BENCH_RING_SIZE];
+static uint32_t printf_bench_head;
+
+static void printf_bench_put(const char *data, size_t len)
+{
+    uint32_t first;
+
+    while (len > 0U)
+    {
+        first = PRINTF_BENCH_RING_SIZE - (printf_bench_head & (PRINTF_BENCH_RING_SIZE - 1U));
+        first = (len < first) ? (uint32_t)len : first;
+        memcpy(&printf_bench_ring[printf_bench_head & (PRINTF_BENCH_RING_SIZE - 1U)], data, first);
+        printf_bench_head += first;
+        data += first;
+        len -= first;
+    }
+}
+
+extern "C" void _putchar(char character)
+{
+    printf_bench_put(&character, 1U);
+}
+
+extern "C" void _putspan(const char *data, size_t len)
+{
+    printf_bench_put(data, len);
+}
+
+static uint64_t printf_bench_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift32 of i: random but the same for every path */
+static uint32_t printf_bench_random(uint32_t i)
+{
+    uint32_t x = (i * 2654435761U) + 1U;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+/* The lines of printf_bench.c, fn is a function or one of the macros. */
+#define PRINTF_BENCH_LINES(fn, ...)                                                                          \
+    switch (line)                                                                                            \
+    {                                                                                                        \
+    case PRINTF_BENCH_WATER_MARK:                                                                            \
+        (void)fn(__VA_ARGS__ "water mark fo task 500ms: %d\n", (int)(i & 0xFFU));                          \
+        break;                                                                                               \
+    case PRINTF_BENCH_SEPARATOR:                                                                             \
+        (void)fn(__VA_ARGS__ "%d:----------------------------------------------\n", (int)i);                \
+        break;                                                                                               \
+    case PRINTF_BENCH_MAILBOX:                                                                               \
+        (void)fn(__VA_ARGS__ "mailbox used for CAN tx: %d\n", (int)(1U << (i & 2U)));                       \
+        break;                                                                                               \
+    case PRINTF_BENCH_CAN_FRAME:                                                                             \
+        (void)fn(__VA_ARGS__ "can rx id=0x%03x dlc=%u data=%02x %02x %02x %02x\n", (unsigned int)(i & 0x7FFU), \
+                 (unsigned int)(i & 7U), (unsigned int)(i & 0xFFU), (unsigned int)((i >> 8) & 0xFFU),       \
+                 (unsigned int)((i >> 16) & 0xFFU), 0x5AU);                                                  \
+        break;                                                                                               \
+    case PRINTF_BENCH_STATUS:                                                                                \
+        (void)fn(__VA_ARGS__ "[%8u] %-8s state=%s err=%-4d\n", (unsigned int)i, "can", "active", -(int)(i & 31U)); \
+        break;                                                                                               \
+    case PRINTF_BENCH_RANDOM_U:                                                                              \
+        (void)fn(__VA_ARGS__ "%u", (unsigned int)printf_bench_random(i));                                    \
+        break;                                                                                               \
+    case PRINTF_BENCH_RANDOM_D:                                                                              \
+        (void)fn(__VA_ARGS__ "%d", (int)printf_bench_random(i));                                             \
+        break;                                                                                               \
+    case PRINTF_BENCH_RANDOM_X:                                                                              \
+        (void)fn(__VA_ARGS__ "%08x", (unsigned int)printf_bench_random(i));                                  \
+        break;                                                                                               \
+    case PRINTF_BENCH_RANDOM_F:                                                                              \
+        (void)fn(__VA_ARGS__ "%.3f", (double)(int32_t)printf_bench_random(i) / 1024.0);                     \
+        break;                                                                                               \
+    default:                                                                                                 \
+        (void)fn(__VA_ARGS__ "%.3k", (int)printf_bench_random(i));                                           \
+        break;                                                                                               \
+    }
+
+static void printf_bench_snprintf(printf_bench_line_t line, uint32_t i, char *out)
+{
+    PRINTF_BENCH_LINES(snprintf_, out, PRINTF_BENCH_LINE_SIZE,)
+}
+
+static void printf_bench_printf(printf_bench_line_t line, uint32_t i)
+{
+    PRINTF_BENCH_LINES(printf_,)
+}
+
+static void printf_bench_fmt_snprintf(printf_bench_line_t line, uint32_t i, char *out)
+{
+    PRINTF_BENCH_LINES(SNPRINTF_FMT, out, PRINTF_BENCH_LINE_SIZE,)
+}
+
+static void printf_bench_fmt_printf(printf_bench_line_t line, uint32_t i)
+{
+    PRINTF_BENCH_LINES(PRINTF_FMT,)
+}
+
+static const uint32_t printf_bench_edges[] =
+{
+    0U, 1U, 9U, 10U, 99U, 100U, 101U, 999U, 1000U, 9999U, 10000U, 65535U, 65536U, 99999999U, 100000000U,
+    999999999U, 1000000000U, 0x7FFFFFFFU, 0x80000000U, 0x80000001U, 0xFFFFFFFEU, 0xFFFFFFFFU,
+};
+
+static uint32_t printf_bench_differ(const char *format, uint32_t value, const char *out, const char *ref)
+{
+    if (strcmp(out, ref) != 0)
+    {
+        fprintf(stderr, "\"%s\" 0x%08x: \"%s\", snprintf_ \"%s\"\n", format, (unsigned int)value, out, ref);
+        return 1U;
+    }
+    return 0U;
+}
+
+/* One format with one argument, both ways. */
+#define PRINTF_BENCH_CHECK(format, arg)                                                                      \
+    do                                                                                                       \
+    {                                                                                                        \
+        (void)snprintf_(ref, sizeof(ref), format, arg);                                                      \
+        (void)SNPRINTF_FMT(out, sizeof(out), format, arg);                                                   \
+        mismatches += printf_bench_differ(format, v, out, ref);                                              \
+    } while (0)
+
+static uint32_t printf_bench_check(uint32_t v)
+{
+    char out[PRINTF_BENCH_LINE_SIZE];
+    char ref[PRINTF_BENCH_LINE_SIZE];
+    uint32_t mismatches = 0U;
+
+    PRINTF_BENCH_CHECK("%u", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%d", (int)v);
+    PRINTF_BENCH_CHECK("%i", (int)v);
+    PRINTF_BENCH_CHECK("%x", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%X", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%o", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%b", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%#x", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%#o", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%08x", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%-10u|", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%+d", (int)v);
+    PRINTF_BENCH_CHECK("% d", (int)v);
+    PRINTF_BENCH_CHECK("%012d", (int)v);
+    PRINTF_BENCH_CHECK("%-+12d|", (int)v);
+    PRINTF_BENCH_CHECK("%.12d", (int)v);
+    PRINTF_BENCH_CHECK("%.0u", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%12.5d", (int)v);
+    PRINTF_BENCH_CHECK("%#12.10x", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%hhu", (unsigned char)v);
+    PRINTF_BENCH_CHECK("%hhd", (signed char)v);
+    PRINTF_BENCH_CHECK("%hd", (short)v);
+    PRINTF_BENCH_CHECK("%lu", (unsigned long)v);
+    PRINTF_BENCH_CHECK("%ld", (long)v);
+    PRINTF_BENCH_CHECK("%lx", (unsigned long)v);
+    PRINTF_BENCH_CHECK("%zu", (size_t)v);
+    PRINTF_BENCH_CHECK("%c|", (char)v);
+    PRINTF_BENCH_CHECK("%-3c|", (char)v);
+    PRINTF_BENCH_CHECK("%p", (void *)(uintptr_t)v);
+    PRINTF_BENCH_CHECK("%.4k", (int)v);
+    PRINTF_BENCH_CHECK("%+10.2K", (unsigned int)v);
+    PRINTF_BENCH_CHECK("%.3f", (float)v);
+    PRINTF_BENCH_CHECK("%-12.1F|%%", (double)v);
+    return mismatches;
+}
+
+static uint32_t printf_bench_check_strings(void)
+{
+    static const char *const strings[] = {"", "a", "can", "active", "0123456789abcdef"};
+    char out[PRINTF_BENCH_LINE_SIZE];
+    char ref[PRINTF_BENCH_LINE_SIZE];
+    uint32_t mismatches = 0U;
+    uint32_t v;
+
+    for (v = 0U; v < (sizeof(strings) / sizeof(strings[0])); v++)
+    {
+        PRINTF_BENCH_CHECK("[%s]", strings[v]);
+        PRINTF_BENCH_CHECK("[%8s]", strings[v]);
+        PRINTF_BENCH_CHECK("[%-8s]", strings[v]);
+        PRINTF_BENCH_CHECK("[%.3s]", strings[v]);
+        PRINTF_BENCH_CHECK("[%10.2s]", strings[v]);
+    }
+    return mismatches;
+}
+
+static void printf_bench_report(printf_bench_line_t line, const char *path, uint64_t t0, uint64_t t1)
+{
+    fprintf(stdout, "%s,%s,%.1f\n", printf_bench_names[line], path,
+           (double)(t1 - t0) / (double)PRINTF_BENCH_ITERATIONS);
+}
+
+int main(void)
+{
+    char out[PRINTF_BENCH_LINE_SIZE];
+    char ref[PRINTF_BENCH_LINE_SIZE];
+    uint32_t mismatches = 0U;
+    uint32_t line;
+    uint32_t i;
+    uint64_t t0;
+    uint64_t t1;
+
+    fprintf(stdout, "line,path,ns_per_call\n");
+    for (line = 0U; line < (uint32_t)PRINTF_BENCH_COUNT; line++)
+    {
+        t0 = printf_bench_now();
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i++)
+        {
+            printf_bench_snprintf((printf_bench_line_t)line, i, out);
+        }
+        t1 = printf_bench_now();
+        printf_bench_report((printf_bench_line_t)line, "snprintf", t0, t1);
+
+        t0 = printf_bench_now();
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i++)
+        {
+            printf_bench_fmt_snprintf((printf_bench_line_t)line, i, out);
+        }
+        t1 = printf_bench_now();
+        printf_bench_report((printf_bench_line_t)line, "fmt snprintf", t0, t1);
+
+        t0 = printf_bench_now();
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i++)
+        {
+            printf_bench_printf((printf_bench_line_t)line, i);
+        }
+        t1 = printf_bench_now();
+        printf_bench_report((printf_bench_line_t)line, "printf", t0, t1);
+
+        t0 = printf_bench_now();
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i++)
+        {
+            printf_bench_fmt_printf((printf_bench_line_t)line, i);
+        }
+        t1 = printf_bench_now();
+        printf_bench_report((printf_bench_line_t)line, "fmt printf", t0, t1);
+
+        for (i = 0U; i < PRINTF_BENCH_ITERATIONS; i += 97U)
+        {
+            printf_bench_snprintf((printf_bench_line_t)line, i, ref);
+            printf_bench_fmt_snprintf((printf_bench_line_t)line, i, out);
+            mismatches += printf_bench_differ(printf_bench_names[line], i, out, ref);
+        }
+    }
+
+    for (i = 0U; i < (sizeof(printf_bench_edges) / sizeof(printf_bench_edges[0])); i++)
+    {
+        mismatches += printf_bench_check(printf_bench_edges[i]);
+    }
+    for (i = 0U; i < PRINTF_BENCH_COMPARE; i++)
+    {
+        /* short numbers as often as long ones */
+        mismatches += printf_bench_check(printf_bench_random(i) >> (i & 31U));
+    }
+    mismatches += printf_bench_check_strings();
+
+    fprintf(stdout, "mismatches,%u\n", (unsigned int)mismatches);
+    return (mismatches == 0U) ? 0 : 1;
+}
@@ -0,0 +1,392 @@
+/**
+ ******************************************************************************
+ * @file           : trace2json.c
+ * @brief          : Turns a dump of trace_buffer into Chrome trace JSON (Linux tool)
+ ******************************************************************************
+ * trace2json <dump> <json>
+ *
+ * Reads a dump of trace_buffer (trace.h; a debugger dump of the target or
+ * trace.bin of the host benchmark), writes the events in the Chrome trace
+ * event format, which chrome://tracing and ui.perfetto.dev open:
+ *
+ *  - process "tasks", one thread per task: a slice from every switch in to
+ *    the next switch, instants for the queue operations, vTaskDelay() and the
+ *    notifications the task sends.
+ *  - process "interrupts", one thread per IRQn: a slice from enter to exit,
+ *    instants for what the handler does with the kernel.
+ *
+ * Then one CSV row per task on stdout:
+ *
+ *   task,number,runs,cpu_percent,wakeups,period_min_ms,period_avg_ms,period_max_ms,latency_min_us,latency_max_us
+ *
+ * A wakeup is the first switch into a task after its vTaskDelay(); period is
+ * the time between two wakeups, its spread the jitter, latency the time from
+ * the start of the tick interrupt before it (TIM1_UP) to the switch.
+ *
+ * The records are read in ring order, the time of each taken as a signed
+ * difference to the one before, then sorted by time (see trace.h).
+ ******************************************************************************
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAGIC                     0x31435254U
+#define TRACE_HEADER_WORDS              6U
+#define TRACE_TICK_IRQN                 25U     /* TIM1_UP */
+#define TRACE_NESTING                   8U
+
+enum
+{
+    TRACE_EVENT_SWITCH = 1,
+    TRACE_EVENT_ISR_ENTER,
+    TRACE_EVENT_ISR_EXIT,
+    TRACE_EVENT_QUEUE_SEND,
+    TRACE_EVENT_QUEUE_SEND_ISR,
+    TRACE_EVENT_QUEUE_RECEIVE,
+    TRACE_EVENT_QUEUE_RECEIVE_ISR,
+    TRACE_EVENT_DELAY,
+    TRACE_EVENT_NOTIFY,
+    TRACE_EVENT_NOTIFY_ISR,
+};
+
+typedef struct
+{
+    double us;
+    uint32_t seq;
+    uint8_t event;
+    uint8_t id;
+    uint16_t arg;
+} event_t;
+
+typedef struct
+{
+    int seen;
+    int delayed;
+    uint32_t runs;
+    double busy_us;
+    uint32_t wakeups;
+    double last_wake_us;
+    uint32_t periods;
+    double period_min_us;
+    double period_max_us;
+    double period_sum_us;
+    double latency_min_us;
+    double latency_max_us;
+} task_stat_t;
+
+static const char *const queue_types[] = {
+    "queue", "mutex", "counting semaphore", "binary semaphore", "recursive mutex",
+};
+
+static uint32_t trace_tasks;
+static uint32_t trace_name_len;
+static const char *trace_names;
+static task_stat_t task_stats[256];
+static int irq_seen[256];
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    char *data;
+    long len;
+
+    if (f == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    (void)fseek(f, 0L, SEEK_END);
+    len = ftell(f);
+    (void)fseek(f, 0L, SEEK_SET);
+    data = malloc((size_t)len + 1U);
+    if ((data == NULL) || (fread(data, 1U, (size_t)len, f) != (size_t)len))
+    {
+        fprintf(stderr, "%s: read failed\n", path);
+        exit(1);
+    }
+    (void)fclose(f);
+    *size = (size_t)len;
+    return data;
+}
+
+static const char *task_name(uint32_t number)
+{
+    static char unnamed[16];
+    const char *name = &trace_names[(number & (trace_tasks - 1U)) * trace_name_len];
+
+    if ((number == 0U) || (name[0] == '\0'))
+    {
+        (void)snprintf(unnamed, sizeof(unnamed), "task %u", number);
+        return unnamed;
+    }
+    return name;
+}
+
+/* STM32F103 vector numbers of the handlers that trace */
+static const char *irq_name(uint32_t irqn)
+{
+    static char unnamed[16];
+
+    switch (irqn)
+    {
+    case 14U: return "DMA1_Channel4";
+    case 15U: return "DMA1_Channel5";
+    case 19U: return "CAN1_TX";
+    case 20U: return "CAN1_RX0";
+    case 21U: return "CAN1_RX1";
+    case 25U: return "TIM1_UP";
+    case 37U: return "USART1";
+    default:
+        (void)snprintf(unnamed, sizeof(unnamed), "IRQ %u", irqn);
+        return unnamed;
+    }
+}
+
+static int by_time(const void *a, const void *b)
+{
+    const event_t *ea = a;
+    const event_t *eb = b;
+
+    if (ea->us != eb->us)
+    {
+        return (ea->us < eb->us) ? -1 : 1;
+    }
+    return (ea->seq < eb->seq) ? -1 : (ea->seq > eb->seq);
+}
+
+static void emit(FILE *out, int *first, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+static void emit(FILE *out, int *first, const char *fmt, ...)
+{
+    va_list ap;
+
+    fputs(*first ? "\n" : ",\n", out);
+    *first = 0;
+    va_start(ap, fmt);
+    (void)vfprintf(out, fmt, ap);
+    va_end(ap);
+}
+
+int main(int argc, char **argv)
+{
+    const uint8_t *dump;
+    const uint8_t *ring;
+    event_t *events;
+    FILE *out;
+    size_t size;
+    uint32_t frequency;
+    uint32_t records;
+    uint32_t head;
+    uint32_t n;
+    uint32_t i;
+    uint32_t prev = 0U;
+    int64_t ticks = 0;
+    uint32_t cur = 0U;
+    double cur_start = 0.0;
+    double last_tick = -1.0;
+    double end;
+    uint32_t stack[TRACE_NESTING];
+    double stack_start[TRACE_NESTING];
+    uint32_t depth = 0U;
+    int first = 1;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <dump> <json>\n", argv[0]);
+        return 2;
+    }
+    dump = read_file(argv[1], &size);
+    if ((size < (TRACE_HEADER_WORDS * 4U)) || (get32(dump) != TRACE_MAGIC))
+    {
+        fprintf(stderr, "%s: not a trace_buffer dump\n", argv[1]);
+        return 1;
+    }
+    frequency = get32(&dump[4]);
+    records = get32(&dump[8]);
+    trace_tasks = get32(&dump[12]);
+    trace_name_len = get32(&dump[16]);
+    head = get32(&dump[20]);
+    trace_names = (const char *)&dump[TRACE_HEADER_WORDS * 4U];
+    ring = &dump[(TRACE_HEADER_WORDS * 4U) + (trace_tasks * trace_name_len)];
+    if ((frequency == 0U) || (trace_tasks == 0U) || ((trace_tasks & (trace_tasks - 1U)) != 0U) ||
+        ((records & (records - 1U)) != 0U) ||
+        (size < ((size_t)(ring - dump) + ((size_t)records * 8U))))
+    {
+        fprintf(stderr, "%s: bad header or short dump\n", argv[1]);
+        return 1;
+    }
+
+    n = (head < records) ? head : records;
+    events = calloc((size_t)n + 1U, sizeof(*events));
+    for (i = 0U; i < n; i++)
+    {
+        const uint8_t *r = &ring[((head - n + i) & (records - 1U)) * 8U];
+        uint32_t time = get32(r);
+        uint32_t info = get32(&r[4]);
+
+        ticks += (i == 0U) ? 0 : (int32_t)(time - prev);
+        prev = time;
+        events[i].us = ((double)ticks * 1e6) / (double)frequency;
+        events[i].seq = i;
+        events[i].event = (uint8_t)info;
+        events[i].id = (uint8_t)(info >> 8);
+        events[i].arg = (uint16_t)(info >> 16);
+    }
+    qsort(events, n, sizeof(*events), by_time);
+    end = (n != 0U) ? events[n - 1U].us : 0.0;
+
+    out = fopen(argv[2], "w");
+    if (out == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    emit(out, &first, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"tasks\"}}");
+    emit(out, &first, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"interrupts\"}}");
+
+    for (i = 0U; i < n; i++)
+    {
+        const event_t *e = &events[i];
+        uint32_t pid = (depth != 0U) ? 2U : 1U;
+        uint32_t tid = (depth != 0U) ? stack[(depth - 1U) % TRACE_NESTING] : cur;
+        task_stat_t *task;
+
+        switch (e->event)
+        {
+        case TRACE_EVENT_SWITCH:
+            if (cur != 0U)
+            {
+                emit(out, &first, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                     task_name(cur), cur, cur_start, e->us - cur_start);
+                task_stats[cur].busy_us += e->us - cur_start;
+            }
+            cur = e->id;
+            cur_start = e->us;
+            task = &task_stats[cur];
+            task->seen = 1;
+            task->runs++;
+            if (task->delayed)
+            {
+                task->delayed = 0;
+                if (task->wakeups != 0U)
+                {
+                    double period = e->us - task->last_wake_us;
+
+                    task->period_min_us = ((task->periods == 0U) || (period < task->period_min_us)) ? period
+                                                                                                    : task->period_min_us;
+                    task->period_max_us = (period > task->period_max_us) ? period : task->period_max_us;
+                    task->period_sum_us += period;
+                    task->periods++;
+                }
+                if (last_tick >= 0.0)
+                {
+                    double latency = e->us - last_tick;
+
+                    task->latency_min_us = ((task->wakeups == 0U) || (latency < task->latency_min_us))
+                                               ? latency : task->latency_min_us;
+                    task->latency_max_us = (latency > task->latency_max_us) ? latency : task->latency_max_us;
+                }
+                task->last_wake_us = e->us;
+                task->wakeups++;
+            }
+            break;
+        case TRACE_EVENT_ISR_ENTER:
+            if (depth < TRACE_NESTING)
+            {
+                stack[depth] = e->id;
+                stack_start[depth] = e->us;
+            }
+            depth++;
+            irq_seen[e->id] = 1;
+            if (e->id == TRACE_TICK_IRQN)
+            {
+                last_tick = e->us;
+            }
+            break;
+        case TRACE_EVENT_ISR_EXIT:
+            /* an exit without its enter is from before the start of the ring */
+            if ((depth != 0U) && (depth <= TRACE_NESTING))
+            {
+                emit(out, &first, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":2,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                     irq_name(stack[depth - 1U]), stack[depth - 1U], stack_start[depth - 1U],
+                     e->us - stack_start[depth - 1U]);
+            }
+            depth = (depth != 0U) ? (depth - 1U) : 0U;
+            break;
+        case TRACE_EVENT_QUEUE_SEND:
+        case TRACE_EVENT_QUEUE_SEND_ISR:
+        case TRACE_EVENT_QUEUE_RECEIVE:
+        case TRACE_EVENT_QUEUE_RECEIVE_ISR:
+            emit(out, &first,
+                 "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,"
+                 "\"args\":{\"queue\":%u,\"type\":\"%s\"}}",
+                 ((e->event == TRACE_EVENT_QUEUE_SEND) || (e->event == TRACE_EVENT_QUEUE_SEND_ISR)) ? "send"
+                                                                                                   : "receive",
+                 pid, tid, e->us, e->arg,
+                 (e->id < (sizeof(queue_types) / sizeof(queue_types[0]))) ? queue_types[e->id] : "?");
+            break;
+        case TRACE_EVENT_DELAY:
+            emit(out, &first,
+                 "{\"name\":\"vTaskDelay\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+                 "\"args\":{\"ticks\":%u}}",
+                 (uint32_t)e->id, e->us, e->arg);
+            task_stats[e->id].delayed = 1;
+            break;
+        case TRACE_EVENT_NOTIFY:
+        case TRACE_EVENT_NOTIFY_ISR:
+            emit(out, &first,
+                 "{\"name\":\"notify\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,"
+                 "\"args\":{\"task\":\"%s\"}}",
+                 pid, tid, e->us, task_name(e->id));
+            break;
+        default:
+            break;
+        }
+    }
+    if (cur != 0U)
+    {
+        emit(out, &first, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+             task_name(cur), cur, cur_start, end - cur_start);
+        task_stats[cur].busy_us += end - cur_start;
+    }
+    for (i = 1U; i < 256U; i++)
+    {
+        if (task_stats[i].seen)
+        {
+            emit(out, &first, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 i, task_name(i));
+        }
+        if (irq_seen[i])
+        {
+            emit(out, &first, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 i, irq_name(i));
+        }
+    }
+    fputs("\n]}\n", out);
+    (void)fclose(out);
+
+    printf("task,number,runs,cpu_percent,wakeups,period_min_ms,period_avg_ms,period_max_ms,latency_min_us,latency_max_us\n");
+    for (i = 1U; i < 256U; i++)
+    {
+        const task_stat_t *task = &task_stats[i];
+
+        if (!task->seen)
+        {
+            continue;
+        }
+        printf("%s,%u,%u,%.2f,%u,%.3f,%.3f,%.3f,%.1f,%.1f\n", task_name(i), i, task->runs,
+               (end > 0.0) ? ((task->busy_us * 100.0) / end) : 0.0, task->wakeups, task->period_min_us / 1000.0,
+               (task->periods != 0U) ? (task->period_sum_us / task->periods / 1000.0) : 0.0,
+               task->period_max_us / 1000.0, task->latency_min_us, task->latency_max_us);
+    }
+    return 0;
+}
@@ -757,7 +757,10 @@ osSemaphoreId osSemaphoreCreate(const osSemaphoreDef_t *semaphore_def, int32_t c
     {
         if (count == 1)
         {
-            return xSemaphoreCreateBinaryStatic(semaphore_def->controlblock);
+            /* given, like vSemaphoreCreateBinary() below */
+            sema = xSemaphoreCreateBinaryStatic(semaphore_def->controlblock);
+            (void)xSemaphoreGive(sema);
+            return sema;
         }
         else
         {
@@ -785,9 +788,14 @@ osSemaphoreId osSemaphoreCreate(const osSemaphoreDef_t *semaphore_def, int32_t c
         }
     }
 #elif (configSUPPORT_STATIC_ALLOCATION == 1) // configSUPPORT_DYNAMIC_ALLOCATION == 0
+    osSemaphoreId sema;
+
     if (count == 1)
     {
-        return xSemaphoreCreateBinaryStatic(semaphore_def->controlblock);
+        /* given, like vSemaphoreCreateBinary() */
+        sema = xSemaphoreCreateBinaryStatic(semaphore_def->controlblock);
+        (void)xSemaphoreGive(sema);
+        return sema;
     }
     else
     {
@@ -921,6 +929,9 @@ osStatus osSemaphoreDelete(osSemaphoreId semaphore_id)
 // This is a primitive and inefficient wrapper around the existing FreeRTOS memory management.
 // A better implementation will have to modify heap_x.c!
 
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+typedef osStaticPoolDef_t os_pool_cb_t;
+#else
 typedef struct os_pool_cb
 {
     void *pool;
@@ -929,6 +940,7 @@ typedef struct os_pool_cb
     uint32_t item_sz;
     uint32_t currentIndex;
 } os_pool_cb_t;
+#endif
 
 /**
  * @brief Create and Initialize a memory pool
@@ -938,6 +950,25 @@ typedef struct os_pool_cb
  */
 osPoolId osPoolCreate(const osPoolDef_t *pool_def)
 {
+#if (configSUPPORT_STATIC_ALLOCATION == 1)
+    if (pool_def->controlblock != NULL)
+    {
+        osPoolId thePool = pool_def->controlblock;
+        uint32_t i;
+
+        /* the storage of osPoolDef() */
+        thePool->pool = pool_def->pool;
+        thePool->markers = pool_def->markers;
+        thePool->pool_sz = pool_def->pool_sz;
+        thePool->item_sz = 4 * ((pool_def->item_sz + 3) / 4);
+        thePool->currentIndex = 0;
+        for (i = 0; i < pool_def->pool_sz; i++)
+        {
+            thePool->markers[i] = 0;
+        }
+        return thePool;
+    }
+#endif
 #if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
     osPoolId thePool;
     int itemSize = 4 * ((pool_def->item_sz + 3) / 4);
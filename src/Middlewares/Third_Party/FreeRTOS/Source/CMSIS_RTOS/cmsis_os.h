@@ -270,6 +270,17 @@ typedef StaticSemaphore_t          osStaticMutexDef_t;
 typedef StaticSemaphore_t          osStaticSemaphoreDef_t;
 typedef StaticQueue_t              osStaticMessageQDef_t;
 
+/* FreeRTOS has no memory pool, the control block of cmsis_os.c is declared
+ * here for the static storage of osPoolDef(). */
+typedef struct os_pool_cb
+{
+    void *pool;
+    uint8_t *markers;
+    uint32_t pool_sz;
+    uint32_t item_sz;
+    uint32_t currentIndex;
+} osStaticPoolDef_t;
+
 #endif
 
 
@@ -322,6 +333,10 @@ typedef struct os_pool_def  {
   uint32_t                 pool_sz;    ///< number of items (elements) in the pool
   uint32_t                 item_sz;    ///< size of an item
   void                       *pool;    ///< pointer to memory for pool
+#if( configSUPPORT_STATIC_ALLOCATION == 1 )
+  uint8_t                    *markers;    ///< block in use markers for static allocation; NULL for dynamic allocation
+  osStaticPoolDef_t          *controlblock;    ///< control block for static allocation; NULL for dynamic allocation
+#endif
 } osPoolDef_t;
 
 /// Definition structure for message queue.
@@ -413,9 +428,14 @@ extern const osThreadDef_t os_thread_def_##name
 /* 目前的FreeRTOS的配置中是使能了静态分配模式的，这里会提供两组现成定义的模式。从名称
  * 看，一个是静态的一个是动态的。 */
 #if (configSUPPORT_STATIC_ALLOCATION == 1)
+/* Static allocation (USE_STATIC_ALLOC in FreeRTOSConfig.h): the definitions
+ * below bring the storage of their object, osXxxCreate() takes no heap.  The
+ * stack size is in words, the storage is for one instance. */
 #define osThreadDef(name, thread, priority, instances, stacksz) \
+  static uint32_t os_thread_stack_##name[(stacksz)];            \
+  static osStaticThreadDef_t os_thread_cb_##name;               \
   const osThreadDef_t os_thread_def_##name =                    \
-      {#name, (thread), (priority), (instances), (stacksz), NULL, NULL}
+      {#name, (thread), (priority), (instances), (stacksz), os_thread_stack_##name, &os_thread_cb_##name}
 
 #define osThreadStaticDef(name, thread, priority, instances, stacksz, buffer, control) \
   const osThreadDef_t os_thread_def_##name =                                           \
@@ -504,8 +524,9 @@ extern const osTimerDef_t os_timer_def_##name
 
 #if( configSUPPORT_STATIC_ALLOCATION == 1 ) 
 #define osTimerDef(name, function)  \
+static osStaticTimerDef_t os_timer_cb_##name; \
 const osTimerDef_t os_timer_def_##name = \
-{ (function), NULL }
+{ (function), &os_timer_cb_##name }
 
 #define osTimerStaticDef(name, function, control)  \
 const osTimerDef_t os_timer_def_##name = \
@@ -589,7 +610,8 @@ extern const osMutexDef_t os_mutex_def_##name
 
 #if( configSUPPORT_STATIC_ALLOCATION == 1 )
 #define osMutexDef(name)  \
-const osMutexDef_t os_mutex_def_##name = { 0, NULL }
+static osStaticMutexDef_t os_mutex_cb_##name; \
+const osMutexDef_t os_mutex_def_##name = { 0, &os_mutex_cb_##name }
 
 #define osMutexStaticDef(name, control)  \
 const osMutexDef_t os_mutex_def_##name = { 0, (control) }
@@ -649,7 +671,8 @@ extern const osSemaphoreDef_t os_semaphore_def_##name
 
 #if( configSUPPORT_STATIC_ALLOCATION == 1 )
 #define osSemaphoreDef(name)  \
-const osSemaphoreDef_t os_semaphore_def_##name = { 0, NULL }
+static osStaticSemaphoreDef_t os_semaphore_cb_##name; \
+const osSemaphoreDef_t os_semaphore_def_##name = { 0, &os_semaphore_cb_##name }
 
 #define osSemaphoreStaticDef(name, control)  \
 const osSemaphoreDef_t os_semaphore_def_##name = { 0, (control) }
@@ -710,10 +733,20 @@ osStatus osSemaphoreDelete (osSemaphoreId semaphore_id);
 #define osPoolDef(name, no, type)   \
 extern const osPoolDef_t os_pool_def_##name
 #else                            // define the object
+#if( configSUPPORT_STATIC_ALLOCATION == 1 )
+/* the blocks are rounded up to words like osPoolCreate() does */
+#define osPoolDef(name, no, type)   \
+static uint32_t os_pool_m_##name[(no) * ((sizeof(type) + 3U) / 4U)]; \
+static uint8_t os_pool_markers_##name[(no)]; \
+static osStaticPoolDef_t os_pool_cb_##name; \
+const osPoolDef_t os_pool_def_##name = \
+{ (no), sizeof(type), os_pool_m_##name, os_pool_markers_##name, &os_pool_cb_##name }
+#else
 #define osPoolDef(name, no, type)   \
 const osPoolDef_t os_pool_def_##name = \
 { (no), sizeof(type), NULL }
 #endif
+#endif
 
 /// \brief Access a Memory Pool definition.
 /// \param         name          name of the memory pool
@@ -766,8 +799,10 @@ extern const osMessageQDef_t os_messageQ_def_##name
 #else                            // define the object
 #if( configSUPPORT_STATIC_ALLOCATION == 1 )
 #define osMessageQDef(name, queue_sz, type)   \
+static uint8_t os_messageQ_buffer_##name[(queue_sz) * sizeof (type)]; \
+static osStaticMessageQDef_t os_messageQ_cb_##name; \
 const osMessageQDef_t os_messageQ_def_##name = \
-{ (queue_sz), sizeof (type), NULL, NULL  }
+{ (queue_sz), sizeof (type), os_messageQ_buffer_##name, &os_messageQ_cb_##name }
 
 #define osMessageQStaticDef(name, queue_sz, type, buffer, control)   \
 const osMessageQDef_t os_messageQ_def_##name = \
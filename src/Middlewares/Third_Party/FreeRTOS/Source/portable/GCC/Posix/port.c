@@ -0,0 +1,511 @@
+/*
+ * FreeRTOS Kernel V10.0.1
+ * Copyright (C) 2017 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ * 1 tab == 4 spaces!
+ */
+
+/*-----------------------------------------------------------
+ * Implementation of functions defined in portable.h for the Linux/POSIX
+ * simulator port.
+ *
+ * Each task is backed by a pthread.  A thread only runs while its task is the
+ * one in pxCurrentTCB, all the others wait on their own event.  A context
+ * switch therefore is "wake the next thread, then wait on my own event".
+ *
+ * The interrupts of the real core are replaced by signals.  The tick is
+ * SIGALRM from an interval timer, the simulated peripheral interrupts share
+ * SIGUSR1.  All the threads except the running one keep both signals blocked,
+ * so the kernel sees exactly one interrupted context - the running task -
+ * just like on the target.
+ *----------------------------------------------------------*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define portSIG_TICK        SIGALRM
+#define portSIG_INTERRUPT   SIGUSR1
+
+/* Host stack used by every task thread.  The FreeRTOS stack of the task is
+only used to hold the thread control structure, the code runs on this one. */
+#ifndef portHOST_THREAD_STACK_SIZE
+	#define portHOST_THREAD_STACK_SIZE  ( 64UL * 1024UL )
+#endif
+
+/* The tick handler that is called on every SIGALRM. */
+#ifndef portHOST_TICK_HANDLER
+	#define portHOST_TICK_HANDLER()     xPortSysTickHandler()
+#endif
+
+typedef struct EVENT
+{
+	pthread_mutex_t xMutex;
+	pthread_cond_t xCond;
+	BaseType_t xSet;
+} Event_t;
+
+typedef struct THREAD
+{
+	pthread_t xPthread;
+	TaskFunction_t pxCode;
+	void *pvParams;
+	UBaseType_t uxCriticalNesting;
+	Event_t xEvent;
+} Thread_t;
+
+/* The TCB is opaque here, only its first member - the stack pointer - is used
+to find the thread of a task. */
+typedef void TCB_t;
+extern volatile TCB_t * volatile pxCurrentTCB;
+
+void xPortSysTickHandler( void );
+
+/* Starts the tick timer of the application when portHOST_TICK_TIMER is 0,
+called as the scheduler starts like the ARM_CM3 port does. */
+void vPortSetupTimerInterrupt( void );
+
+/*-----------------------------------------------------------*/
+
+/* The running task owns the critical nesting, it is saved into the thread
+structure while the task is switched out. */
+static volatile UBaseType_t uxCriticalNesting = 0;
+
+/* Set by the interrupt handlers when a context switch is needed on exit, this
+is what PendSV does on the target. */
+static volatile BaseType_t xPortYieldPending = pdFALSE;
+static volatile BaseType_t xPortSchedulerRunning = pdFALSE;
+
+/* Exception number of the interrupt being served, 0 in thread mode. */
+static volatile uint32_t ulPortCurrentInterrupt = 0UL;
+
+static volatile uint32_t ulPortPendingInterrupts = 0UL;
+static void ( *pvPortInterruptHandlers[ portHOST_MAX_INTERRUPTS ] )( void );
+
+static sigset_t xPortInterruptSignals;
+static pthread_once_t xPortSignalsOnce = PTHREAD_ONCE_INIT;
+static Event_t xPortSchedulerEndEvent =
+{
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, pdFALSE
+};
+
+/*-----------------------------------------------------------*/
+
+static void prvEventInit( Event_t *pxEvent )
+{
+	pthread_mutex_init( &pxEvent->xMutex, NULL );
+	pthread_cond_init( &pxEvent->xCond, NULL );
+	pxEvent->xSet = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void prvEventSignal( Event_t *pxEvent )
+{
+	pthread_mutex_lock( &pxEvent->xMutex );
+	pxEvent->xSet = pdTRUE;
+	pthread_cond_signal( &pxEvent->xCond );
+	pthread_mutex_unlock( &pxEvent->xMutex );
+}
+/*-----------------------------------------------------------*/
+
+static void prvEventWait( Event_t *pxEvent )
+{
+	pthread_mutex_lock( &pxEvent->xMutex );
+	while( pxEvent->xSet == pdFALSE )
+	{
+		pthread_cond_wait( &pxEvent->xCond, &pxEvent->xMutex );
+	}
+	pxEvent->xSet = pdFALSE;
+	pthread_mutex_unlock( &pxEvent->xMutex );
+}
+/*-----------------------------------------------------------*/
+
+static Thread_t *prvGetThreadFromTask( volatile TCB_t *pxTCB )
+{
+	/* pxTopOfStack is the first member of the TCB, it points right below the
+	thread structure - see pxPortInitialiseStack(). */
+	StackType_t *pxTopOfStack = *( StackType_t * volatile * ) pxTCB;
+
+	return ( Thread_t * ) ( pxTopOfStack + 1 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSwitchThread( Thread_t *pxTo, Thread_t *pxFrom )
+{
+	if( pxTo != pxFrom )
+	{
+		pxFrom->uxCriticalNesting = uxCriticalNesting;
+		prvEventSignal( &pxTo->xEvent );
+		prvEventWait( &pxFrom->xEvent );
+		uxCriticalNesting = pxFrom->uxCriticalNesting;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTaskExitError( void )
+{
+	/* A function that implements a task must not exit or attempt to return to
+	its caller as there is nothing to return to. */
+	fprintf( stderr, "FreeRTOS posix port: a task returned from its function\n" );
+	abort();
+}
+/*-----------------------------------------------------------*/
+
+static void *prvThreadEntry( void *pvParams )
+{
+	Thread_t *pxThread = ( Thread_t * ) pvParams;
+
+	/* Wait until the scheduler selects the task for the first time. */
+	prvEventWait( &pxThread->xEvent );
+
+	uxCriticalNesting = 0;
+	vPortEnableInterrupts();
+
+	pxThread->pxCode( pxThread->pvParams );
+
+	prvTaskExitError();
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPortExitInterrupt( void )
+{
+	Thread_t *pxFrom;
+
+	/* Interrupts are only delivered while the running task has them unmasked,
+	so the nesting is 0 here and the switch is allowed. */
+	if( ( xPortYieldPending != pdFALSE ) && ( xPortSchedulerRunning != pdFALSE ) )
+	{
+		xPortYieldPending = pdFALSE;
+
+		pxFrom = prvGetThreadFromTask( pxCurrentTCB );
+		vTaskSwitchContext();
+		prvSwitchThread( prvGetThreadFromTask( pxCurrentTCB ), pxFrom );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTickSignalHandler( int iSignal )
+{
+	int iSavedErrno = errno;
+
+	( void ) iSignal;
+
+	ulPortCurrentInterrupt = portHOST_SYSTICK_EXCEPTION_NUMBER;
+	portHOST_TICK_HANDLER();
+	ulPortCurrentInterrupt = 0UL;
+
+	prvPortExitInterrupt();
+
+	errno = iSavedErrno;
+}
+/*-----------------------------------------------------------*/
+
+static void prvInterruptSignalHandler( int iSignal )
+{
+	int iSavedErrno = errno;
+	uint32_t ulPending;
+	uint32_t ulNumber;
+
+	( void ) iSignal;
+
+	/* Lower numbers are served first, like the default NVIC priorities. */
+	while( ( ulPending = __atomic_exchange_n( &ulPortPendingInterrupts, 0UL, __ATOMIC_SEQ_CST ) ) != 0UL )
+	{
+		while( ulPending != 0UL )
+		{
+			ulNumber = ( uint32_t ) __builtin_ctz( ulPending );
+			ulPending &= ~( 1UL << ulNumber );
+
+			if( pvPortInterruptHandlers[ ulNumber ] != NULL )
+			{
+				ulPortCurrentInterrupt = portHOST_FIRST_INTERRUPT_NUMBER + ulNumber;
+				pvPortInterruptHandlers[ ulNumber ]();
+			}
+		}
+	}
+	ulPortCurrentInterrupt = 0UL;
+
+	prvPortExitInterrupt();
+
+	errno = iSavedErrno;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetupSignals( void )
+{
+	struct sigaction xAction;
+
+	sigemptyset( &xPortInterruptSignals );
+	sigaddset( &xPortInterruptSignals, portSIG_TICK );
+	sigaddset( &xPortInterruptSignals, portSIG_INTERRUPT );
+
+	/* One interrupt level only: the handlers mask each other. */
+	memset( &xAction, 0, sizeof( xAction ) );
+	xAction.sa_mask = xPortInterruptSignals;
+	xAction.sa_flags = SA_RESTART;
+
+	xAction.sa_handler = prvTickSignalHandler;
+	sigaction( portSIG_TICK, &xAction, NULL );
+
+	xAction.sa_handler = prvInterruptSignalHandler;
+	sigaction( portSIG_INTERRUPT, &xAction, NULL );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * See header file for description.
+ */
+StackType_t *pxPortInitialiseStack( StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters )
+{
+	Thread_t *pxThread;
+	pthread_attr_t xAttr;
+	sigset_t xSavedMask;
+	int iRet;
+
+	( void ) pthread_once( &xPortSignalsOnce, prvSetupSignals );
+
+	/* The thread structure sits at the top of the FreeRTOS stack, the returned
+	stack pointer is right below it so it can be found from the TCB later. */
+	pxThread = ( Thread_t * ) ( ( ( portPOINTER_SIZE_TYPE ) ( pxTopOfStack + 1 ) - sizeof( Thread_t ) ) & ~( ( portPOINTER_SIZE_TYPE ) portBYTE_ALIGNMENT_MASK ) );
+	pxTopOfStack = ( StackType_t * ) pxThread - 1;
+
+	pxThread->pxCode = pxCode;
+	pxThread->pvParams = pvParameters;
+	pxThread->uxCriticalNesting = 0;
+	prvEventInit( &pxThread->xEvent );
+
+	pthread_attr_init( &xAttr );
+	pthread_attr_setstacksize( &xAttr, portHOST_THREAD_STACK_SIZE );
+
+	/* The new thread inherits the signal mask, it must start with the
+	interrupts masked and only unmask them once it is the running task. */
+	pthread_sigmask( SIG_BLOCK, &xPortInterruptSignals, &xSavedMask );
+	iRet = pthread_create( &pxThread->xPthread, &xAttr, prvThreadEntry, pxThread );
+	pthread_sigmask( SIG_SETMASK, &xSavedMask, NULL );
+
+	pthread_attr_destroy( &xAttr );
+	configASSERT( iRet == 0 );
+
+	return pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortStartScheduler( void )
+{
+	( void ) pthread_once( &xPortSignalsOnce, prvSetupSignals );
+
+	/* From now on the main thread only waits for the end of the scheduler, it
+	must never be the one that takes an interrupt. */
+	pthread_sigmask( SIG_BLOCK, &xPortInterruptSignals, NULL );
+
+#if( portHOST_TICK_TIMER == 1 )
+	{
+		struct itimerval xTimer;
+
+		xTimer.it_interval.tv_sec = 0;
+		xTimer.it_interval.tv_usec = ( suseconds_t ) ( 1000000UL / configTICK_RATE_HZ );
+		xTimer.it_value = xTimer.it_interval;
+		setitimer( ITIMER_REAL, &xTimer, NULL );
+	}
+#else
+	/* The tick comes from a timer of the application, as on the target. */
+	vPortSetupTimerInterrupt();
+#endif /* portHOST_TICK_TIMER */
+
+	/* Start the first task. */
+	xPortSchedulerRunning = pdTRUE;
+	prvEventSignal( &prvGetThreadFromTask( pxCurrentTCB )->xEvent );
+
+	prvEventWait( &xPortSchedulerEndEvent );
+
+	return 0;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+	struct itimerval xTimer;
+
+	memset( &xTimer, 0, sizeof( xTimer ) );
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+
+	xPortSchedulerRunning = pdFALSE;
+	prvEventSignal( &xPortSchedulerEndEvent );
+
+	/* The calling task never runs again. */
+	vPortDisableInterrupts();
+	for( ;; )
+	{
+		pause();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+	Thread_t *pxFrom;
+
+	vPortEnterCritical();
+
+	pxFrom = prvGetThreadFromTask( pxCurrentTCB );
+	vTaskSwitchContext();
+	prvSwitchThread( prvGetThreadFromTask( pxCurrentTCB ), pxFrom );
+
+	vPortExitCritical();
+}
+/*-----------------------------------------------------------*/
+
+void vPortYieldFromISR( void )
+{
+	if( ulPortCurrentInterrupt != 0UL )
+	{
+		/* Switch when the interrupt exits, the way PendSV does. */
+		xPortYieldPending = pdTRUE;
+	}
+	else
+	{
+		vPortYield();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+	pthread_sigmask( SIG_BLOCK, &xPortInterruptSignals, NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+	pthread_sigmask( SIG_UNBLOCK, &xPortInterruptSignals, NULL );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulPortSetInterruptMask( void )
+{
+	sigset_t xOldMask;
+
+	pthread_sigmask( SIG_BLOCK, &xPortInterruptSignals, &xOldMask );
+
+	return ( sigismember( &xOldMask, portSIG_TICK ) == 1 ) ? 1UL : 0UL;
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( uint32_t ulMask )
+{
+	if( ulMask == 0UL )
+	{
+		vPortEnableInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+	vPortDisableInterrupts();
+	uxCriticalNesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+	configASSERT( uxCriticalNesting );
+	uxCriticalNesting--;
+	if( uxCriticalNesting == 0 )
+	{
+		vPortEnableInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void xPortSysTickHandler( void )
+{
+	uint32_t ulSavedMask;
+
+	ulSavedMask = portSET_INTERRUPT_MASK_FROM_ISR();
+	{
+		/* Increment the RTOS tick. */
+		if( xTaskIncrementTick() != pdFALSE )
+		{
+			/* A context switch is required, it is done when the interrupt
+			exits. */
+			xPortYieldPending = pdTRUE;
+		}
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR( ulSavedMask );
+}
+/*-----------------------------------------------------------*/
+
+void vPortSetInterruptHandler( uint32_t ulInterruptNumber, void ( *pvHandler )( void ) )
+{
+	configASSERT( ulInterruptNumber < portHOST_MAX_INTERRUPTS );
+
+	( void ) pthread_once( &xPortSignalsOnce, prvSetupSignals );
+	pvPortInterruptHandlers[ ulInterruptNumber ] = pvHandler;
+}
+/*-----------------------------------------------------------*/
+
+void vPortGenerateSimulatedInterrupt( uint32_t ulInterruptNumber )
+{
+	configASSERT( ulInterruptNumber < portHOST_MAX_INTERRUPTS );
+
+	( void ) pthread_once( &xPortSignalsOnce, prvSetupSignals );
+	__atomic_fetch_or( &ulPortPendingInterrupts, 1UL << ulInterruptNumber, __ATOMIC_SEQ_CST );
+
+	/* The signal goes to the process, the only thread that has it unmasked
+	is the running task.  While the interrupts are masked it stays pending. */
+	kill( getpid(), portSIG_INTERRUPT );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulPortHostGetIPSR( void )
+{
+	return ulPortCurrentInterrupt;
+}
+/*-----------------------------------------------------------*/
+
+void vPortHostWaitForInterrupt( void )
+{
+	sigset_t xWait;
+
+	/* The interrupt signal is masked, so it waits here as pending.  Taking it
+	consumes it: it is sent again for the handler, ulPortPendingInterrupts
+	still holds the interrupts to serve. */
+	sigemptyset( &xWait );
+	sigaddset( &xWait, portSIG_INTERRUPT );
+	while( sigwaitinfo( &xWait, NULL ) < 0 )
+	{
+	}
+	kill( getpid(), portSIG_INTERRUPT );
+}